@@ -99,6 +99,15 @@
  */
 - (void)sd_setImageWithURL:(NSURL *)url placeholderImage:(UIImage *)placeholder options:(SDWebImageOptions)options completed:(SDWebImageCompletionBlock)completedBlock;
 
+/**
+ * Set the annotation `image` with an `url`, placeholder, custom options and a context.
+ *
+ * @param context The context to produce the image for, see `SDWebImageContextThumbnailPixelSize`. With
+ *                `SDWebImageThumbnailToViewSize` the image is decoded to fit the current size of the view.
+ * @see sd_setImageWithURL:placeholderImage:options:completed:
+ */
+- (void)sd_setImageWithURL:(NSURL *)url placeholderImage:(UIImage *)placeholder options:(SDWebImageOptions)options context:(NSDictionary *)context completed:(SDWebImageCompletionBlock)completedBlock;
+
 /**
  * Cancel the current download
  */
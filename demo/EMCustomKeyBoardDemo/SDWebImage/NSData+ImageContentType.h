@@ -5,8 +5,71 @@
 
 #import <Foundation/Foundation.h>
 
+typedef NS_ENUM(NSInteger, SDImageFormat) {
+    SDImageFormatUndefined = -1,
+    SDImageFormatJPEG = 0,
+    SDImageFormatPNG,
+    SDImageFormatGIF,
+    SDImageFormatTIFF,
+    SDImageFormatWebP,
+    SDImageFormatHEIC,
+    SDImageFormatHEIF,
+    SDImageFormatBMP,
+    SDImageFormatICO,
+    SDImageFormatAVIF
+};
+
+/**
+ * What the header of an image tells without decoding it. The fields not found in the bytes read are 0.
+ 图片头部信息（不解码），未找到的字段为0
+ */
+typedef struct {
+    SDImageFormat format;
+    NSUInteger pixelWidth;   // the size of the stored bitmap, before the EXIF orientation
+    NSUInteger pixelHeight;
+    NSUInteger frameCount;   // 1 for still images; for animations the frames found in the bytes read, 0 if not counted
+    BOOL hasAlpha;           // whether the format declares transparency; NO may still be wrong for TIFF
+    int exifOrientation;     // 1 to 8, 1 if not found
+} SDImageHeader;
+
+/**
+ * Reads the format and the header of an image. Nothing is allocated and nothing is decoded: the format comes from a
+ * table of signatures, then the reader of the format parses the fields it needs, skipping segments, chunks and boxes
+ * by their length. The cost is in the number of segments, not in the size of the data.
+ *
+ * Works on a prefix of the data too, e.g. the bytes received so far by a download: the fields after the prefix are 0.
+ 从数据开头读取格式和头部信息：不分配内存、不解码；也适用于下载中只收到开头部分的数据
+ */
+extern SDImageHeader SDImageHeaderFromBytes(const void *bytes, size_t length);
+
+/**
+ * The format of an image from the signature at its beginning, without reading the header.
+ */
+extern SDImageFormat SDImageFormatFromBytes(const void *bytes, size_t length);
+
+/**
+ * A prefix holding the header of most images, the size of a JPEG comes after its EXIF and ICC segments.
+ * Callers reading a prefix (e.g. a download in progress) can wait for this many bytes before giving up on the size.
+ */
+extern const size_t SDImageHeaderMaxLength;
+
 @interface NSData (ImageContentType)
 
+/**
+ * The format of the image data, see `SDImageFormatFromBytes`.
+ */
++ (SDImageFormat)sd_imageFormatForImageData:(NSData *)data;
+
+/**
+ * The header of the image data, see `SDImageHeaderFromBytes`.
+ */
++ (SDImageHeader)sd_imageHeaderForImageData:(NSData *)data;
+
+/**
+ * The MIME type of a format (i.e. image/jpeg), nil for SDImageFormatUndefined.
+ */
++ (NSString *)sd_contentTypeForImageFormat:(SDImageFormat)format;
+
 /**
  *  Compute the content type for an image data
  *
@@ -5,11 +5,460 @@
 
 #import "NSData+ImageContentType.h"
 
+const size_t SDImageHeaderMaxLength = 256 * 1024;
+
+#pragma mark - Byte readers
+
+static inline uint16_t SDReadBE16(const uint8_t *p) { return (uint16_t)(p[0] << 8 | p[1]); }
+static inline uint32_t SDReadBE32(const uint8_t *p) { return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3]; }
+static inline uint16_t SDReadLE16(const uint8_t *p) { return (uint16_t)(p[1] << 8 | p[0]); }
+static inline uint32_t SDReadLE24(const uint8_t *p) { return (uint32_t)p[2] << 16 | (uint32_t)p[1] << 8 | p[0]; }
+static inline uint32_t SDReadLE32(const uint8_t *p) { return (uint32_t)p[3] << 24 | SDReadLE24(p); }
+
+static inline BOOL SDBytesEqual(const uint8_t *p, const char *string) {
+    return memcmp(p, string, strlen(string)) == 0;
+}
+
+static BOOL SDBytesContain(const uint8_t *bytes, size_t length, const char *string) {
+    size_t stringLength = strlen(string);
+    for (size_t i = 0; i + stringLength <= length; i++) {
+        if (memcmp(bytes + i, string, stringLength) == 0) {
+            return YES;
+        }
+    }
+    return NO;
+}
+
+#pragma mark - Header readers
+
+// Reads the first directory of a TIFF stream: the orientation, and for a TIFF image its size and extra samples.
+// The EXIF of JPEG, PNG and WebP is a TIFF stream too
+static void SDReadTIFFDirectory(const uint8_t *tiff, size_t length, BOOL image, SDImageHeader *header) {
+    if (length < 8) {
+        return;
+    }
+    BOOL big = tiff[0] == 'M';
+    uint16_t (*read16)(const uint8_t *) = big ? SDReadBE16 : SDReadLE16;
+    uint32_t (*read32)(const uint8_t *) = big ? SDReadBE32 : SDReadLE32;
+    uint32_t offset = read32(tiff + 4);
+    if (offset > length - 2) {
+        return;
+    }
+    uint16_t count = read16(tiff + offset);
+    const uint8_t *entry = tiff + offset + 2;
+    size_t available = (length - offset - 2) / 12;
+    for (size_t i = 0; i < count && i < available; i++, entry += 12) {
+        uint16_t tag = read16(entry);
+        uint16_t type = read16(entry + 2);
+        uint32_t value = type == 3 ? read16(entry + 8) : read32(entry + 8); // SHORT or LONG
+        if (tag == 274) {
+            if (value >= 1 && value <= 8) {
+                header->exifOrientation = (int)value;
+            }
+        } else if (!image) {
+            continue;
+        } else if (tag == 256) {
+            header->pixelWidth = value;
+        } else if (tag == 257) {
+            header->pixelHeight = value;
+        } else if (tag == 338) {
+            // ExtraSamples: 1 associated alpha, 2 unassociated alpha. Several samples are stored at an offset
+            header->hasAlpha = read32(entry + 4) > 1 || value == 1 || value == 2;
+        }
+    }
+}
+
+static void SDReadJPEGHeader(const uint8_t *bytes, size_t length, SDImageHeader *header) {
+    size_t p = 2;
+    while (p + 4 <= length) {
+        if (bytes[p] != 0xFF) {
+            break;
+        }
+        uint8_t marker = bytes[p + 1];
+        if (marker == 0xFF) {
+            p++; // fill byte
+            continue;
+        }
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD8)) {
+            p += 2; // markers without a segment
+            continue;
+        }
+        if (marker == 0xD9 || marker == 0xDA) {
+            break; // EOI or SOS, the size comes before the scan
+        }
+        size_t segmentLength = SDReadBE16(bytes + p + 2);
+        if (segmentLength < 2) {
+            break;
+        }
+        const uint8_t *segment = bytes + p + 4;
+        size_t available = MIN(segmentLength - 2, length - p - 4);
+        BOOL startOfFrame = marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+        if (startOfFrame) {
+            if (available >= 5) {
+                header->pixelHeight = SDReadBE16(segment + 1);
+                header->pixelWidth = SDReadBE16(segment + 3);
+            }
+            break;
+        }
+        if (marker == 0xE1 && available > 6 && memcmp(segment, "Exif\0\0", 6) == 0) {
+            SDReadTIFFDirectory(segment + 6, available - 6, NO, header);
+        }
+        p += 2 + segmentLength;
+    }
+}
+
+static void SDReadTIFFHeader(const uint8_t *bytes, size_t length, SDImageHeader *header) {
+    SDReadTIFFDirectory(bytes, length, YES, header);
+}
+
+static void SDReadPNGHeader(const uint8_t *bytes, size_t length, SDImageHeader *header) {
+    if (length < 26 || !SDBytesEqual(bytes + 12, "IHDR")) {
+        return;
+    }
+    header->pixelWidth = SDReadBE32(bytes + 16);
+    header->pixelHeight = SDReadBE32(bytes + 20);
+    uint8_t colorType = bytes[25];
+    header->hasAlpha = colorType == 4 || colorType == 6;
+    // acTL and tRNS come before the image data, and eXIf should too
+    size_t p = 8;
+    while (p + 8 <= length) {
+        size_t chunkLength = SDReadBE32(bytes + p);
+        const uint8_t *type = bytes + p + 4;
+        const uint8_t *chunk = bytes + p + 8;
+        size_t available = MIN(chunkLength, length - p - 8);
+        if (SDBytesEqual(type, "IDAT")) {
+            break;
+        } else if (SDBytesEqual(type, "tRNS")) {
+            header->hasAlpha = YES;
+        } else if (SDBytesEqual(type, "acTL") && available >= 4) {
+            header->frameCount = SDReadBE32(chunk);
+        } else if (SDBytesEqual(type, "eXIf")) {
+            SDReadTIFFDirectory(chunk, available, NO, header);
+        }
+        if (chunkLength > length - p - 8) {
+            break;
+        }
+        p += 12 + chunkLength;
+    }
+}
+
+// Skips GIF data sub-blocks, returning the offset after the terminator, or length if they are truncated
+static size_t SDSkipGIFSubBlocks(const uint8_t *bytes, size_t length, size_t p) {
+    while (p < length) {
+        uint8_t blockLength = bytes[p];
+        p += 1 + blockLength;
+        if (blockLength == 0) {
+            return p;
+        }
+    }
+    return length;
+}
+
+static void SDReadGIFHeader(const uint8_t *bytes, size_t length, SDImageHeader *header) {
+    if (length < 13) {
+        return;
+    }
+    header->pixelWidth = SDReadLE16(bytes + 6);
+    header->pixelHeight = SDReadLE16(bytes + 8);
+    header->frameCount = 0;
+    size_t p = 13;
+    if (bytes[10] & 0x80) {
+        p += 3 << ((bytes[10] & 0x07) + 1);
+    }
+    while (p < length) {
+        uint8_t introducer = bytes[p];
+        if (introducer == 0x21 && p + 2 < length) {
+            // The graphic control extension declares the transparent color
+            if (bytes[p + 1] == 0xF9 && p + 3 < length && (bytes[p + 3] & 0x01)) {
+                header->hasAlpha = YES;
+            }
+            p = SDSkipGIFSubBlocks(bytes, length, p + 2);
+        } else if (introducer == 0x2C && p + 10 <= length) {
+            header->frameCount++;
+            uint8_t flags = bytes[p + 9];
+            p += 10;
+            if (flags & 0x80) {
+                p += 3 << ((flags & 0x07) + 1);
+            }
+            p = SDSkipGIFSubBlocks(bytes, length, p + 1); // after the LZW minimum code size
+        } else {
+            break; // the trailer, or truncated data
+        }
+    }
+}
+
+static void SDReadWebPHeader(const uint8_t *bytes, size_t length, SDImageHeader *header) {
+    BOOL extended = NO;
+    BOOL animated = NO;
+    size_t p = 12;
+    while (p + 8 <= length) {
+        const uint8_t *type = bytes + p;
+        size_t chunkLength = SDReadLE32(bytes + p + 4);
+        const uint8_t *chunk = bytes + p + 8;
+        size_t available = MIN(chunkLength, length - p - 8);
+        if (SDBytesEqual(type, "VP8X") && available >= 10) {
+            extended = YES;
+            animated = (chunk[0] & 0x02) != 0;
+            header->hasAlpha = (chunk[0] & 0x10) != 0;
+            header->pixelWidth = SDReadLE24(chunk + 4) + 1;
+            header->pixelHeight = SDReadLE24(chunk + 7) + 1;
+            header->frameCount = animated ? 0 : 1;
+        } else if (SDBytesEqual(type, "ANMF")) {
+            header->frameCount++;
+        } else if (SDBytesEqual(type, "EXIF")) {
+            // Some encoders keep the JPEG prefix
+            if (available > 6 && memcmp(chunk, "Exif\0\0", 6) == 0) {
+                SDReadTIFFDirectory(chunk + 6, available - 6, NO, header);
+            } else {
+                SDReadTIFFDirectory(chunk, available, NO, header);
+            }
+        } else if (!extended && SDBytesEqual(type, "VP8 ")) {
+            if (available >= 10) {
+                header->pixelWidth = SDReadLE16(chunk + 6) & 0x3FFF;
+                header->pixelHeight = SDReadLE16(chunk + 8) & 0x3FFF;
+            }
+            break;
+        } else if (!extended && SDBytesEqual(type, "VP8L")) {
+            if (available >= 5 && chunk[0] == 0x2F) {
+                uint32_t bits = SDReadLE32(chunk + 1);
+                header->pixelWidth = (bits & 0x3FFF) + 1;
+                header->pixelHeight = ((bits >> 14) & 0x3FFF) + 1;
+                header->hasAlpha = (bits >> 28) & 0x01;
+            }
+            break;
+        }
+        // The frames and the EXIF of an extended file come after the VP8X chunk
+        if (chunkLength > length - p - 8) {
+            break;
+        }
+        p += 8 + chunkLength + (chunkLength & 1);
+    }
+}
+
+static void SDReadBMPHeader(const uint8_t *bytes, size_t length, SDImageHeader *header) {
+    if (length < 26) {
+        return;
+    }
+    uint32_t headerSize = SDReadLE32(bytes + 14);
+    if (headerSize == 12) {
+        header->pixelWidth = SDReadLE16(bytes + 18);
+        header->pixelHeight = SDReadLE16(bytes + 20);
+    } else if (headerSize >= 40) {
+        int32_t width = (int32_t)SDReadLE32(bytes + 18);
+        int32_t height = (int32_t)SDReadLE32(bytes + 22);
+        header->pixelWidth = width < 0 ? (NSUInteger)-(int64_t)width : (NSUInteger)width;
+        header->pixelHeight = height < 0 ? (NSUInteger)-(int64_t)height : (NSUInteger)height; // negative for top-down rows
+        // Only the V3 headers and later have an alpha mask
+        if (headerSize >= 56 && length >= 70 && SDReadLE16(bytes + 28) == 32) {
+            header->hasAlpha = SDReadLE32(bytes + 66) != 0;
+        }
+    }
+}
+
+static void SDReadICOHeader(const uint8_t *bytes, size_t length, SDImageHeader *header) {
+    // The largest of the images in the directory, a size of 0 is 256
+    if (length < 6) {
+        return;
+    }
+    uint16_t count = SDReadLE16(bytes + 4);
+    for (size_t i = 0; i < count && 6 + (i + 1) * 16 <= length; i++) {
+        const uint8_t *entry = bytes + 6 + i * 16;
+        NSUInteger width = entry[0] ?: 256;
+        NSUInteger height = entry[1] ?: 256;
+        if (width * height > header->pixelWidth * header->pixelHeight) {
+            header->pixelWidth = width;
+            header->pixelHeight = height;
+        }
+    }
+    header->hasAlpha = YES; // icons have a transparency mask
+}
+
+// The boxes of a ISO base media file (HEIF, AVIF): size, type and payload, with a 64 bit size when the size is 1
+static BOOL SDReadISOBox(const uint8_t *bytes, size_t length, size_t p, const uint8_t **type, size_t *payload, size_t *end) {
+    if (p + 8 > length) {
+        return NO;
+    }
+    uint64_t size = SDReadBE32(bytes + p);
+    size_t headerSize = 8;
+    if (size == 1) {
+        if (p + 16 > length) {
+            return NO;
+        }
+        size = (uint64_t)SDReadBE32(bytes + p + 8) << 32 | SDReadBE32(bytes + p + 12);
+        headerSize = 16;
+    } else if (size == 0) {
+        size = length - p; // to the end of the file
+    }
+    if (size < headerSize) {
+        return NO;
+    }
+    *type = bytes + p + 4;
+    *payload = p + headerSize;
+    *end = size > length - p ? length : p + (size_t)size;
+    return YES;
+}
+
+static void SDReadISOItemProperties(const uint8_t *bytes, size_t length, size_t p, SDImageHeader *header) {
+    const uint8_t *type;
+    size_t payload, end;
+    while (SDReadISOBox(bytes, length, p, &type, &payload, &end)) {
+        if (SDBytesEqual(type, "ispe") && payload + 12 <= end) {
+            // The primary image is the largest, the smaller ones are thumbnails or the tiles of a grid
+            NSUInteger width = SDReadBE32(bytes + payload + 4);
+            NSUInteger height = SDReadBE32(bytes + payload + 8);
+            if (width * height > header->pixelWidth * header->pixelHeight) {
+                header->pixelWidth = width;
+                header->pixelHeight = height;
+            }
+        } else if (SDBytesEqual(type, "irot") && payload < end) {
+            // Anticlockwise quarter turns to display the image, as EXIF orientations
+            static const int orientations[] = {1, 8, 3, 6};
+            header->exifOrientation = orientations[bytes[payload] & 0x03];
+        } else if (SDBytesEqual(type, "auxC") && payload + 4 < end) {
+            const uint8_t *urn = bytes + payload + 4;
+            size_t urnLength = end - payload - 4;
+            if (SDBytesContain(urn, urnLength, "alpha") || SDBytesContain(urn, urnLength, "hevc:2015:auxid:1")) {
+                header->hasAlpha = YES;
+            }
+        }
+        p = end;
+    }
+}
+
+static void SDReadISOHeader(const uint8_t *bytes, size_t length, SDImageHeader *header) {
+    // meta (a full box) > iprp > ipco holds the properties of the items
+    const uint8_t *type;
+    size_t payload, end;
+    size_t p = 0;
+    while (SDReadISOBox(bytes, length, p, &type, &payload, &end)) {
+        if (SDBytesEqual(type, "meta")) {
+            size_t q = payload + 4;
+            while (SDReadISOBox(bytes, end, q, &type, &payload, &q)) {
+                if (SDBytesEqual(type, "iprp")) {
+                    size_t r = payload;
+                    while (SDReadISOBox(bytes, q, r, &type, &payload, &r)) {
+                        if (SDBytesEqual(type, "ipco")) {
+                            SDReadISOItemProperties(bytes, r, payload, header);
+                        }
+                    }
+                }
+            }
+            break;
+        }
+        p = end;
+    }
+    // A brand of image sequence, the frames are in tracks
+    const uint8_t *brand = bytes + 8;
+    if (SDBytesEqual(brand, "avis") || SDBytesEqual(brand, "msf1") || SDBytesEqual(brand, "hevc") || SDBytesEqual(brand, "hevx")) {
+        header->frameCount = 0;
+    }
+}
+
+#pragma mark - Signatures
+
+typedef struct {
+    SDImageFormat format;
+    size_t offset;
+    const char *signature;
+    size_t length;
+    size_t offset2; // a second signature, if length2 is not 0
+    const char *signature2;
+    size_t length2;
+} SDImageSignature;
+
+static const SDImageSignature SDImageSignatures[] = {
+    {SDImageFormatJPEG, 0, "\xFF\xD8\xFF", 3},
+    {SDImageFormatPNG, 0, "\x89PNG\r\n\x1A\n", 8},
+    {SDImageFormatGIF, 0, "GIF8", 4},
+    {SDImageFormatWebP, 0, "RIFF", 4, 8, "WEBP", 4},
+    {SDImageFormatTIFF, 0, "II*\0", 4},
+    {SDImageFormatTIFF, 0, "MM\0*", 4},
+    {SDImageFormatHEIF, 4, "ftyp", 4}, // the brand tells HEIC and AVIF apart
+    {SDImageFormatBMP, 0, "BM", 2},
+    {SDImageFormatICO, 0, "\0\0\1\0", 4},
+};
+
+typedef void (*SDImageHeaderReader)(const uint8_t *bytes, size_t length, SDImageHeader *header);
+
+static const SDImageHeaderReader SDImageHeaderReaders[] = {
+    [SDImageFormatJPEG] = SDReadJPEGHeader,
+    [SDImageFormatPNG] = SDReadPNGHeader,
+    [SDImageFormatGIF] = SDReadGIFHeader,
+    [SDImageFormatTIFF] = SDReadTIFFHeader,
+    [SDImageFormatWebP] = SDReadWebPHeader,
+    [SDImageFormatHEIC] = SDReadISOHeader,
+    [SDImageFormatHEIF] = SDReadISOHeader,
+    [SDImageFormatBMP] = SDReadBMPHeader,
+    [SDImageFormatICO] = SDReadICOHeader,
+    [SDImageFormatAVIF] = SDReadISOHeader,
+};
+
+static SDImageFormat SDImageFormatForBrand(const uint8_t *brand) {
+    if (SDBytesEqual(brand, "avif") || SDBytesEqual(brand, "avis")) {
+        return SDImageFormatAVIF;
+    }
+    static const char *heicBrands[] = {"heic", "heix", "hevc", "hevx", "heim", "heis"};
+    for (size_t i = 0; i < sizeof(heicBrands) / sizeof(heicBrands[0]); i++) {
+        if (SDBytesEqual(brand, heicBrands[i])) {
+            return SDImageFormatHEIC;
+        }
+    }
+    if (SDBytesEqual(brand, "mif1") || SDBytesEqual(brand, "msf1") || SDBytesEqual(brand, "miaf")) {
+        return SDImageFormatHEIF;
+    }
+    return SDImageFormatUndefined;
+}
+
+// The major brand, or for the generic HEIF brands the first specific compatible brand. Other brands are videos
+static SDImageFormat SDImageFormatForFileType(const uint8_t *bytes, size_t length) {
+    if (length < 12) {
+        return SDImageFormatUndefined;
+    }
+    SDImageFormat format = SDImageFormatForBrand(bytes + 8);
+    if (format != SDImageFormatHEIF) {
+        return format;
+    }
+    size_t end = MIN((size_t)SDReadBE32(bytes), length);
+    for (size_t p = 16; p + 4 <= end; p += 4) {
+        SDImageFormat compatible = SDImageFormatForBrand(bytes + p);
+        if (compatible == SDImageFormatAVIF || compatible == SDImageFormatHEIC) {
+            return compatible;
+        }
+    }
+    return format;
+}
+
+SDImageFormat SDImageFormatFromBytes(const void *bytes, size_t length) {
+    const uint8_t *data = bytes;
+    for (size_t i = 0; i < sizeof(SDImageSignatures) / sizeof(SDImageSignatures[0]); i++) {
+        const SDImageSignature *signature = &SDImageSignatures[i];
+        if (length < signature->offset + signature->length || memcmp(data + signature->offset, signature->signature, signature->length) != 0) {
+            continue;
+        }
+        if (signature->length2 && (length < signature->offset2 + signature->length2 || memcmp(data + signature->offset2, signature->signature2, signature->length2) != 0)) {
+            continue;
+        }
+        if (signature->format == SDImageFormatHEIF) {
+            return SDImageFormatForFileType(data, length);
+        }
+        return signature->format;
+    }
+    return SDImageFormatUndefined;
+}
+
+SDImageHeader SDImageHeaderFromBytes(const void *bytes, size_t length) {
+    SDImageHeader header = {SDImageFormatUndefined, 0, 0, 1, NO, 1};
+    header.format = SDImageFormatFromBytes(bytes, length);
+    if (header.format != SDImageFormatUndefined) {
+        SDImageHeaderReaders[header.format](bytes, length, &header);
+    }
+    return header;
+}
 
 @implementation NSData (ImageContentType)
 
 /**
- 
+
  当文件都使用二进制流作为传输时，需要制定一套规范，用来区分该文件到底是什么类型的。 文件头有很多个
  JPEG (jpg)，文件头：FFD8FFE1
  PNG (png)，文件头：89504E47
@@ -18,39 +467,51 @@
  TIFF tif;tiff 0x4D4D002A
  RAR Archive (rar)，文件头：52617221
  WebP : 524946462A73010057454250
- 可以看出来我们通过每个文件头的第一个字节就能判断出是什么类型。但是值得注意的是52开头的。这个要做特别的判断。
- 其中jpeg/png/gif/tiff 是最好判断的。当第一个字节为52时，如果长度<12 我们就认定为不是图片。因此返回nil。
- WebP这种格式很特别。是由12个字节组成的文件头，我们如果把这些字节通过ASCII编码后获得testString,如果testString头部包含RIFF且尾部也包含WEBP，那么就认定该图片格式为webp。
+ HEIC/HEIF/AVIF : 第4个字节开始为ftyp，后面的brand区分格式
+ BMP : 424D
+ ICO : 00000100
+ 文件头都放在SDImageSignatures表中，按表逐项比较字节，不创建任何对象。
  **/
-+ (NSString *)sd_contentTypeForImageData:(NSData *)data {
-    uint8_t c;
-    [data getBytes:&c length:1];
-    switch (c) {
-        case 0xFF:
++ (SDImageFormat)sd_imageFormatForImageData:(NSData *)data {
+    return SDImageFormatFromBytes(data.bytes, data.length);
+}
+
++ (SDImageHeader)sd_imageHeaderForImageData:(NSData *)data {
+    return SDImageHeaderFromBytes(data.bytes, data.length);
+}
+
++ (NSString *)sd_contentTypeForImageFormat:(SDImageFormat)format {
+    switch (format) {
+        case SDImageFormatJPEG:
             return @"image/jpeg";
-        case 0x89:
+        case SDImageFormatPNG:
             return @"image/png";
-        case 0x47:
+        case SDImageFormatGIF:
             return @"image/gif";
-        case 0x49:
-        case 0x4D:
+        case SDImageFormatTIFF:
             return @"image/tiff";
-        case 0x52:
-            // R as RIFF for WEBP
-            if ([data length] < 12) {
-                return nil;
-            }
-
-            NSString *testString = [[NSString alloc] initWithData:[data subdataWithRange:NSMakeRange(0, 12)] encoding:NSASCIIStringEncoding];
-            if ([testString hasPrefix:@"RIFF"] && [testString hasSuffix:@"WEBP"]) {
-                return @"image/webp";
-            }
-
+        case SDImageFormatWebP:
+            return @"image/webp";
+        case SDImageFormatHEIC:
+            return @"image/heic";
+        case SDImageFormatHEIF:
+            return @"image/heif";
+        case SDImageFormatBMP:
+            return @"image/bmp";
+        case SDImageFormatICO:
+            return @"image/x-icon";
+        case SDImageFormatAVIF:
+            return @"image/avif";
+        case SDImageFormatUndefined:
             return nil;
     }
     return nil;
 }
 
++ (NSString *)sd_contentTypeForImageData:(NSData *)data {
+    return [self sd_contentTypeForImageFormat:[self sd_imageFormatForImageData:data]];
+}
+
 @end
 
 //被废弃的方法类后加上 ImageContentTypeDeprecated
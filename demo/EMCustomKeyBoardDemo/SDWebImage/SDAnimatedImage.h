@@ -0,0 +1,89 @@
+/*
+ * This file is part of the SDWebImage package.
+ * (c) Olivier Poitrey <rs@dailymotion.com>
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#import <Foundation/Foundation.h>
+#import "SDWebImageCompat.h"
+
+/**
+ * An animated image that keeps its compressed data and decodes its frames on demand, instead of holding a bitmap per
+ * frame like `+[UIImage animatedImageWithImages:duration:]`. As a UIImage it is the first frame (the poster), so a
+ * plain UIImageView shows the poster and the memory cache only pays for one frame; a `SDAnimatedImageView` plays it
+ * with a bounded buffer of decoded frames.
+ *
+ * Loads with `SDWebImageContextAnimatedImage` (set by `SDAnimatedImageView`) produce this class for animated GIFs.
+ 动画图片：保留压缩数据、按需解码每一帧，本身作为UIImage是第一帧；由SDAnimatedImageView播放
+ */
+@interface SDAnimatedImage : UIImage
+
+/**
+ * Creates an animated image from GIF data, decoding the frames at the thumbnail size of the context if any.
+ * Returns nil if the data has less than two frames.
+ *
+ * @param data    The encoded image data
+ * @param scale   The scale of the frames
+ * @param context The context of the load, see `SDWebImageContextThumbnailPixelSize`
+ 少于两帧时返回nil
+ */
+- (instancetype)initWithData:(NSData *)data scale:(CGFloat)scale context:(NSDictionary *)context;
+
+/**
+ * The same animated image at another scale, sharing the encoded data.
+ */
+- (instancetype)animatedImageWithScale:(CGFloat)scale;
+
+/**
+ * The same animated image with its frames scaled to fill the given size in pixels, the overflow cropped in the middle.
+ * The frames are scaled as they are decoded, see `sd_animatedImageByScalingAndCroppingToSize:`.
+ 同一动画图片，每一帧在解码时缩放并居中裁剪到指定的像素尺寸
+ */
+- (instancetype)animatedImageByScalingAndCroppingToPixelSize:(CGSize)pixelSize scale:(CGFloat)scale;
+
+/**
+ * The encoded image data.
+ */
+@property (strong, readonly, nonatomic) NSData *animatedImageData;
+
+/**
+ * The memory the image holds besides its poster bitmap, in bytes: the encoded data, and the buffers of the decoder
+ * compositing the frames, counted whether the image plays or not as an upper bound: the decoder is only allocated
+ * while it plays. The memory cache adds it to the cost of the image.
+ 除第一帧位图外占用的内存（字节）：压缩数据，以及合成各帧的解码器缓冲区；内存缓存将其计入开销
+ */
+@property (assign, readonly, nonatomic) NSUInteger animatedImageMemoryCost;
+
+/**
+ * The number of frames.
+ */
+@property (assign, readonly, nonatomic) NSUInteger animatedImageFrameCount;
+
+/**
+ * The number of times the animation plays, 0 for forever.
+ 播放次数，0表示无限循环
+ */
+@property (assign, readonly, nonatomic) NSUInteger animatedImageLoopCount;
+
+/**
+ * The duration of a frame in seconds.
+ */
+- (NSTimeInterval)animatedImageDurationAtIndex:(NSUInteger)index;
+
+/**
+ * Decodes a frame. Thread safe, meant to be called on a background queue: the frame is force decoded.
+ * Full size GIF frames are composited in order by `SDGIFDecoder`, so playing forward decodes each frame once.
+ 解码指定的帧（线程安全，应在后台队列调用）
+ */
+- (UIImage *)animatedImageFrameAtIndex:(NSUInteger)index;
+
+/**
+ * Frees the decoder compositing the frames, with its canvas. The next frame decoded creates it again, starting over
+ * from the first frame. `SDAnimatedImageView` calls it when it stops playing.
+ 释放合成各帧的解码器及其画布；之后解码帧时重新创建，从第一帧开始。SDAnimatedImageView停止播放时调用
+ */
+- (void)releaseAnimatedImageDecoder;
+
+@end
@@ -0,0 +1,204 @@
+/*
+ * This file is part of the SDWebImage package.
+ * (c) Olivier Poitrey <rs@dailymotion.com>
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#import "SDAnimatedImage.h"
+#import "SDWebImageDecoder.h"
+#import "UIImage+GIF.h"
+#import <ImageIO/ImageIO.h>
+
+// Decodes a frame into a bitmap of its own. ImageIO does not keep the decoded frame, the caller's buffer does
+//解码一帧到独立的位图，ImageIO不缓存解码结果，由调用方的缓冲区持有
+static UIImage *SDAnimatedImageFrame(CGImageSourceRef source, size_t index, NSDictionary *thumbnailOptions, CGFloat scale) {
+    CGImageRef imageRef = NULL;
+    if (thumbnailOptions) {
+        imageRef = CGImageSourceCreateThumbnailAtIndex(source, index, (__bridge CFDictionaryRef)thumbnailOptions);
+    }
+    else {
+        NSDictionary *options = @{(__bridge NSString *)kCGImageSourceShouldCache : @NO};
+        imageRef = CGImageSourceCreateImageAtIndex(source, index, (__bridge CFDictionaryRef)options);
+    }
+    if (!imageRef) {
+        return nil;
+    }
+    UIImage *frame = [UIImage decodedImageWithImage:[UIImage imageWithCGImage:imageRef scale:scale orientation:UIImageOrientationUp]];
+    CGImageRelease(imageRef);
+    return frame;
+}
+
+@implementation SDAnimatedImage {
+    CGImageSourceRef _source;
+    NSDictionary *_thumbnailOptions;
+    NSArray *_durations;
+    // The size in pixels the frames are scaled and cropped to as they are decoded, zero to keep them as decoded
+    CGSize _framePixelSize;
+    // The bytes of the buffers of the decoder compositing the frames, see animatedImageMemoryCost
+    NSUInteger _decoderByteCount;
+    // Full size GIF frames are composited by the native decoder, which keeps the canvas of the last frame decoded.
+    // Guarded by @synchronized (self)
+    //原尺寸的GIF帧由SDGIFDecoder按顺序合成，画布保留上一次解码的帧
+    SDGIFDecoder *_gifDecoder;
+    NSUInteger _gifFrameIndex;
+    BOOL _gifDecoderFailed;
+}
+
+- (instancetype)initWithData:(NSData *)data scale:(CGFloat)scale context:(NSDictionary *)context {
+    if (!data) {
+        return nil;
+    }
+    CGImageSourceRef source = CGImageSourceCreateWithData((__bridge CFDataRef)data, NULL);
+    if (!source) {
+        return nil;
+    }
+    size_t count = CGImageSourceGetCount(source);
+    NSDictionary *thumbnailOptions = [UIImage sd_thumbnailOptionsForSource:source context:context];
+    UIImage *poster = count > 1 ? SDAnimatedImageFrame(source, 0, thumbnailOptions, scale) : nil;
+    if (!poster || !(self = [super initWithCGImage:poster.CGImage scale:scale orientation:UIImageOrientationUp])) {
+        CFRelease(source);
+        return nil;
+    }
+    _source = source;
+    _thumbnailOptions = thumbnailOptions;
+    _animatedImageData = data;
+    _animatedImageFrameCount = count;
+    if (!thumbnailOptions && [NSData sd_imageFormatForImageData:data] == SDImageFormatGIF) {
+        // SDGIFDecoder: the canvas, the canvas saved for the frames disposed to previous, and a byte of color index
+        // per pixel. ImageIO keeps no canvas for the thumbnails, each frame is decoded on its own
+        //SDGIFDecoder的画布、为“恢复到上一帧”保存的画布，以及每像素1字节的颜色索引
+        _decoderByteCount = CGImageGetWidth(poster.CGImage) * CGImageGetHeight(poster.CGImage) * (4 + 4 + 1);
+    }
+
+    // Only the metadata is read here, no frame but the poster is decoded
+    //这里只读取每帧的时长等元数据，除第一帧外不解码
+    NSMutableArray *durations = [NSMutableArray arrayWithCapacity:count];
+    for (size_t i = 0; i < count; i++) {
+        [durations addObject:@([UIImage sd_frameDurationAtIndex:i source:source])];
+    }
+    _durations = [durations copy];
+    NSDictionary *properties = CFBridgingRelease(CGImageSourceCopyProperties(source, NULL));
+    _animatedImageLoopCount = [properties[(__bridge NSString *)kCGImagePropertyGIFDictionary][(__bridge NSString *)kCGImagePropertyGIFLoopCount] unsignedIntegerValue];
+    return self;
+}
+
+- (void)dealloc {
+    if (_source) {
+        CFRelease(_source);
+    }
+    if (_gifDecoder) {
+        SDGIFDecoderDestroy(_gifDecoder);
+    }
+}
+
+- (instancetype)animatedImageWithScale:(CGFloat)scale {
+    if (scale == self.scale || !_animatedImageData) {
+        return self;
+    }
+    return [self animatedImageWithPoster:self.CGImage scale:scale];
+}
+
+- (instancetype)animatedImageByScalingAndCroppingToPixelSize:(CGSize)pixelSize scale:(CGFloat)scale {
+    if (!_animatedImageData || pixelSize.width <= 0 || pixelSize.height <= 0) {
+        return self;
+    }
+    // Only the poster is scaled here, the other frames are scaled by animatedImageFrameAtIndex:
+    UIImage *poster = [UIImage scaledImageWithImage:[UIImage imageWithCGImage:self.CGImage] fillingPixelSize:pixelSize scale:scale];
+    SDAnimatedImage *image = [self animatedImageWithPoster:poster.CGImage scale:scale];
+    image->_framePixelSize = pixelSize;
+    return image;
+}
+
+// A new image sharing the encoded data, the frames are decoded again by its own decoder
+- (instancetype)animatedImageWithPoster:(CGImageRef)posterRef scale:(CGFloat)scale {
+    SDAnimatedImage *image = [[[self class] alloc] initWithCGImage:posterRef scale:scale orientation:UIImageOrientationUp];
+    image->_source = _source ? (CGImageSourceRef)CFRetain(_source) : NULL;
+    image->_thumbnailOptions = _thumbnailOptions;
+    image->_durations = _durations;
+    image->_framePixelSize = _framePixelSize;
+    image->_decoderByteCount = _decoderByteCount;
+    image->_animatedImageData = _animatedImageData;
+    image->_animatedImageFrameCount = _animatedImageFrameCount;
+    image->_animatedImageLoopCount = _animatedImageLoopCount;
+    return image;
+}
+
+- (NSUInteger)animatedImageMemoryCost {
+    return _animatedImageData.length + _decoderByteCount;
+}
+
+- (NSTimeInterval)animatedImageDurationAtIndex:(NSUInteger)index {
+    return index < _durations.count ? [_durations[index] doubleValue] : 0;
+}
+
+- (UIImage *)animatedImageFrameAtIndex:(NSUInteger)index {
+    if (index >= _animatedImageFrameCount) {
+        return nil;
+    }
+    if (index == 0) {
+        return [UIImage imageWithCGImage:self.CGImage scale:self.scale orientation:UIImageOrientationUp];
+    }
+    UIImage *frame = nil;
+    if (_source && !_thumbnailOptions) {
+        frame = [self gifFrameAtIndex:index];
+    }
+    if (!frame && _source) {
+        frame = SDAnimatedImageFrame(_source, index, _thumbnailOptions, self.scale);
+    }
+    if (frame && _framePixelSize.width > 0) {
+        frame = [UIImage scaledImageWithImage:frame fillingPixelSize:_framePixelSize scale:self.scale];
+    }
+    return frame;
+}
+
+// Frames are played in order: the next frame only composites its own rectangle onto the canvas of the previous one,
+// where ImageIO decodes the frames it depends on again for every frame. Returns nil if the data is not a GIF the
+// decoder can read, ImageIO decodes it instead
+//按顺序播放时，下一帧只需要在上一帧的画布上合成自己的区域；ImageIO每一帧都要重新解码它依赖的帧
+- (UIImage *)gifFrameAtIndex:(NSUInteger)index {
+    @synchronized (self) {
+        if (_gifDecoderFailed) {
+            return nil;
+        }
+        if (!_gifDecoder) {
+            _gifDecoder = SDGIFDecoderCreate();
+            if (!_gifDecoder) {
+                _gifDecoderFailed = YES;
+                return nil;
+            }
+            SDGIFDecoderSetData(_gifDecoder, _animatedImageData.bytes, _animatedImageData.length, 1);
+            _gifFrameIndex = NSNotFound;
+        }
+        if (_gifFrameIndex != NSNotFound && index <= _gifFrameIndex) {
+            // Going back, e.g. when the animation loops
+            SDGIFDecoderRewind(_gifDecoder);
+            _gifFrameIndex = NSNotFound;
+        }
+        while (_gifFrameIndex == NSNotFound || _gifFrameIndex < index) {
+            SDGIFFrameInfo info;
+            if (SDGIFDecoderDecodeFrame(_gifDecoder, &info) != SDGIFDecoderStatusFrame) {
+                // Not a GIF, or fewer frames than ImageIO found
+                _gifDecoderFailed = YES;
+                SDGIFDecoderDestroy(_gifDecoder);
+                _gifDecoder = NULL;
+                return nil;
+            }
+            _gifFrameIndex = info.index;
+        }
+        return [UIImage sd_imageWithGIFDecoderCanvas:_gifDecoder scale:self.scale];
+    }
+}
+
+- (void)releaseAnimatedImageDecoder {
+    @synchronized (self) {
+        if (_gifDecoder) {
+            SDGIFDecoderDestroy(_gifDecoder);
+            _gifDecoder = NULL;
+        }
+        _gifFrameIndex = NSNotFound;
+    }
+}
+
+@end
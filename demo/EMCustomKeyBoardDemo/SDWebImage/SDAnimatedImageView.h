@@ -0,0 +1,41 @@
+/*
+ * This file is part of the SDWebImage package.
+ * (c) Olivier Poitrey <rs@dailymotion.com>
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#import <UIKit/UIKit.h>
+#import "SDWebImageCompat.h"
+
+/**
+ * An image view playing `SDAnimatedImage`. Frames are decoded ahead of time on a background queue into a small buffer
+ * bounded by `maxBufferSize`, so the memory used depends on the buffer, not on the number of frames. When the next
+ * frame is not decoded yet, the current one stays on screen a little longer instead of blocking the main thread.
+ *
+ * Loads through the UIImageView+WebCache methods produce a `SDAnimatedImage` for animated GIFs. Other
+ * images are displayed as by UIImageView.
+ 动画图片播放视图：后台队列预先解码后面几帧到有上限的缓冲区，内存与缓冲区大小成正比，与帧数无关
+ */
+@interface SDAnimatedImageView : UIImageView
+
+/**
+ * The maximum number of bytes of decoded frames kept in the buffer, the displayed frame included. When all the frames
+ * fit, they are decoded once and kept. Defaults to 0: 1/128 of the physical memory, at most 16MB. At least the
+ * displayed frame and the next one are kept whatever the limit.
+ 缓冲区中已解码的帧占用内存的上限，0表示自动（物理内存的1/128，最多16MB）
+ */
+@property (assign, nonatomic) NSUInteger maxBufferSize;
+
+/**
+ * The run loop mode of the display link. Defaults to NSRunLoopCommonModes, the animation plays while scrolling.
+ */
+@property (copy, nonatomic) NSString *runLoopMode;
+
+/**
+ * The index of the frame on screen.
+ */
+@property (assign, readonly, nonatomic) NSUInteger currentFrameIndex;
+
+@end
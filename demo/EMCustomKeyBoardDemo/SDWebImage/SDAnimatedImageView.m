@@ -0,0 +1,338 @@
+/*
+ * This file is part of the SDWebImage package.
+ * (c) Olivier Poitrey <rs@dailymotion.com>
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#import "SDAnimatedImageView.h"
+#import "SDAnimatedImage.h"
+#import "UIView+WebCacheOperation.h"
+
+@interface SDAnimatedImageView ()
+
+@property (strong, nonatomic) SDAnimatedImage *animatedImage;
+@property (strong, nonatomic) UIImage *currentFrame;
+@property (assign, nonatomic, readwrite) NSUInteger currentFrameIndex;
+@property (assign, nonatomic) NSUInteger currentLoop;
+// Time spent on the current frame
+@property (assign, nonatomic) NSTimeInterval currentTime;
+@property (strong, nonatomic) CADisplayLink *displayLink;
+@property (strong, nonatomic) NSOperationQueue *fetchQueue;
+// frame index (NSNumber) -> decoded frame, filled by the fetch queue. Guarded by @synchronized
+//帧序号 -> 已解码的帧，由后台队列填充
+@property (strong, nonatomic) NSMutableDictionary *frameBuffer;
+
+- (void)displayDidRefresh:(CADisplayLink *)displayLink;
+
+@end
+
+// CADisplayLink retains its target, the view is only referenced weakly so that it can be deallocated
+//CADisplayLink会强引用target，通过弱引用避免循环引用
+@interface SDAnimatedImageViewDisplayTarget : NSObject
+
+@property (weak, nonatomic) SDAnimatedImageView *view;
+
+@end
+
+@implementation SDAnimatedImageViewDisplayTarget
+
+- (void)displayDidRefresh:(CADisplayLink *)displayLink {
+    SDAnimatedImageView *view = self.view;
+    if (!view) {
+        [displayLink invalidate];
+        return;
+    }
+    [view displayDidRefresh:displayLink];
+}
+
+@end
+
+@implementation SDAnimatedImageView
+
+- (instancetype)initWithFrame:(CGRect)frame {
+    if ((self = [super initWithFrame:frame])) {
+        [self commonInit];
+    }
+    return self;
+}
+
+- (instancetype)initWithCoder:(NSCoder *)aDecoder {
+    if ((self = [super initWithCoder:aDecoder])) {
+        [self commonInit];
+    }
+    return self;
+}
+
+- (void)commonInit {
+    [[NSNotificationCenter defaultCenter] addObserver:self
+                                             selector:@selector(didReceiveMemoryWarning:)
+                                                 name:UIApplicationDidReceiveMemoryWarningNotification
+                                               object:nil];
+}
+
+- (void)dealloc {
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+    [_displayLink invalidate];
+    [_fetchQueue cancelAllOperations];
+}
+
+// Created lazily: UIImageView initializers may set the image before commonInit
+- (NSOperationQueue *)fetchQueue {
+    if (!_fetchQueue) {
+        _fetchQueue = [NSOperationQueue new];
+        _fetchQueue.name = @"com.hackemist.SDAnimatedImageView";
+        _fetchQueue.maxConcurrentOperationCount = 1;
+        _fetchQueue.qualityOfService = NSQualityOfServiceUserInitiated;
+    }
+    return _fetchQueue;
+}
+
+- (NSMutableDictionary *)frameBuffer {
+    if (!_frameBuffer) {
+        _frameBuffer = [NSMutableDictionary new];
+    }
+    return _frameBuffer;
+}
+
+- (NSString *)runLoopMode {
+    return _runLoopMode ?: NSRunLoopCommonModes;
+}
+
+- (void)setRunLoopMode:(NSString *)runLoopMode {
+    if (self.displayLink) {
+        [self.displayLink removeFromRunLoop:[NSRunLoop mainRunLoop] forMode:self.runLoopMode];
+        [self.displayLink addToRunLoop:[NSRunLoop mainRunLoop] forMode:runLoopMode ?: NSRunLoopCommonModes];
+    }
+    _runLoopMode = [runLoopMode copy];
+}
+
+// Animated images get their frames decoded on demand rather than all at once
+//通过UIImageView+WebCache加载时，动画图片解码为按需解码帧的SDAnimatedImage
+- (NSDictionary *)sd_contextWithContext:(NSDictionary *)context options:(SDWebImageOptions)options contentMode:(UIViewContentMode)contentMode {
+    context = [super sd_contextWithContext:context options:options contentMode:contentMode];
+    if (context[SDWebImageContextAnimatedImage]) {
+        return context;
+    }
+    NSMutableDictionary *mutableContext = context ? [context mutableCopy] : [NSMutableDictionary dictionary];
+    mutableContext[SDWebImageContextAnimatedImage] = @YES;
+    return [mutableContext copy];
+}
+
+#pragma mark - Image
+
+- (void)setImage:(UIImage *)image {
+    if (self.image == image) {
+        return;
+    }
+    [self resetAnimatedImage];
+    if ([image isKindOfClass:[SDAnimatedImage class]] && ((SDAnimatedImage *)image).animatedImageFrameCount > 1) {
+        // As a UIImage the animated image is its first frame
+        //动画图片本身就是第一帧
+        self.animatedImage = (SDAnimatedImage *)image;
+        self.currentFrame = image;
+        @synchronized (self.frameBuffer) {
+            self.frameBuffer[@0] = image;
+        }
+    }
+    [super setImage:image];
+    [self.layer setNeedsDisplay];
+    if (self.animatedImage && self.window) {
+        [self startAnimating];
+    }
+}
+
+- (void)resetAnimatedImage {
+    [self.displayLink invalidate];
+    self.displayLink = nil;
+    // The fetch operations check for cancellation before filling the buffer
+    [_fetchQueue cancelAllOperations];
+    @synchronized (self.frameBuffer) {
+        [self.frameBuffer removeAllObjects];
+    }
+    [self.animatedImage releaseAnimatedImageDecoder];
+    self.animatedImage = nil;
+    self.currentFrame = nil;
+    self.currentFrameIndex = 0;
+    self.currentLoop = 0;
+    self.currentTime = 0;
+}
+
+- (void)displayLayer:(CALayer *)layer {
+    UIImage *currentFrame = self.currentFrame;
+    if (self.animatedImage && currentFrame) {
+        layer.contentsScale = currentFrame.scale;
+        layer.contents = (__bridge id)currentFrame.CGImage;
+    }
+    else if ([UIImageView instancesRespondToSelector:@selector(displayLayer:)]) {
+        [super displayLayer:layer];
+    }
+}
+
+#pragma mark - Animation
+
+- (void)startAnimating {
+    if (!self.animatedImage) {
+        [super startAnimating];
+        return;
+    }
+    if (!self.displayLink) {
+        SDAnimatedImageViewDisplayTarget *target = [SDAnimatedImageViewDisplayTarget new];
+        target.view = self;
+        self.displayLink = [CADisplayLink displayLinkWithTarget:target selector:@selector(displayDidRefresh:)];
+        [self.displayLink addToRunLoop:[NSRunLoop mainRunLoop] forMode:self.runLoopMode];
+    }
+    self.displayLink.paused = NO;
+}
+
+- (void)stopAnimating {
+    if (!self.animatedImage) {
+        [super stopAnimating];
+        return;
+    }
+    self.displayLink.paused = YES;
+    // The decoder canvas is only needed while playing, the buffered frames stay to resume
+    //解码器画布只在播放时需要，已缓存的帧保留以便继续播放
+    [self.animatedImage releaseAnimatedImageDecoder];
+}
+
+- (BOOL)isAnimating {
+    if (!self.animatedImage) {
+        return [super isAnimating];
+    }
+    return self.displayLink && !self.displayLink.paused;
+}
+
+- (void)didMoveToWindow {
+    [super didMoveToWindow];
+    if (!self.animatedImage) {
+        return;
+    }
+    // Only play on screen
+    if (self.window) {
+        [self startAnimating];
+    }
+    else {
+        [self stopAnimating];
+    }
+}
+
+- (void)displayDidRefresh:(CADisplayLink *)displayLink {
+    SDAnimatedImage *animatedImage = self.animatedImage;
+    if (!animatedImage) {
+        return;
+    }
+    // targetTimestamp is iOS 10+: before it, the frame lasts duration * frameInterval
+    //targetTimestamp从iOS 10开始提供，之前的系统按duration * frameInterval计算
+    NSTimeInterval interval = 0;
+    if ([displayLink respondsToSelector:@selector(targetTimestamp)]) {
+        interval = displayLink.targetTimestamp - displayLink.timestamp;
+    }
+    if (interval <= 0) {
+        interval = displayLink.duration * MAX(displayLink.frameInterval, 1);
+    }
+    self.currentTime += interval;
+
+    NSTimeInterval currentDuration = [animatedImage animatedImageDurationAtIndex:self.currentFrameIndex];
+    if (self.currentTime >= currentDuration) {
+        NSUInteger nextIndex = (self.currentFrameIndex + 1) % animatedImage.animatedImageFrameCount;
+        UIImage *nextFrame = nil;
+        @synchronized (self.frameBuffer) {
+            nextFrame = self.frameBuffer[@(nextIndex)];
+        }
+        // When the next frame is still being decoded the current one stays on screen
+        //下一帧还没有解码完成时，继续显示当前帧
+        if (nextFrame) {
+            if (nextIndex == 0) {
+                self.currentLoop++;
+                if (animatedImage.animatedImageLoopCount > 0 && self.currentLoop >= animatedImage.animatedImageLoopCount) {
+                    [self stopAnimating];
+                    return;
+                }
+            }
+            self.currentFrameIndex = nextIndex;
+            self.currentFrame = nextFrame;
+            // Do not rush through the following frames to catch up after a wait
+            self.currentTime = MIN(self.currentTime - currentDuration, [animatedImage animatedImageDurationAtIndex:nextIndex]);
+            [self.layer setNeedsDisplay];
+        }
+    }
+    [self prefetchFrames];
+}
+
+#pragma mark - Frame buffer
+
+// The number of frames kept decoded, the displayed one included
+- (NSUInteger)maxBufferCount {
+    SDAnimatedImage *animatedImage = self.animatedImage;
+    NSUInteger frameCount = animatedImage.animatedImageFrameCount;
+    NSUInteger bytesPerFrame = CGImageGetBytesPerRow(animatedImage.CGImage) * CGImageGetHeight(animatedImage.CGImage);
+    NSUInteger maxBufferSize = self.maxBufferSize ?: (NSUInteger)MIN([NSProcessInfo processInfo].physicalMemory / 128, 16ull * 1024 * 1024);
+    NSUInteger count = bytesPerFrame > 0 ? maxBufferSize / bytesPerFrame : frameCount;
+    return MIN(frameCount, MAX((NSUInteger)2, count));
+}
+
+// Evicts the frames already played and decodes the next ones on the fetch queue, one batch at a time
+//移除已播放的帧，在后台队列中解码后面的帧
+- (void)prefetchFrames {
+    if (self.fetchQueue.operationCount > 0) {
+        return;
+    }
+    SDAnimatedImage *animatedImage = self.animatedImage;
+    NSUInteger frameCount = animatedImage.animatedImageFrameCount;
+    NSUInteger bufferCount = [self maxBufferCount];
+    NSMutableIndexSet *bufferedIndexes = [NSMutableIndexSet indexSet];
+    for (NSUInteger i = 0; i < bufferCount; i++) {
+        [bufferedIndexes addIndex:(self.currentFrameIndex + i) % frameCount];
+    }
+    NSMutableArray *missingIndexes = [NSMutableArray array];
+    @synchronized (self.frameBuffer) {
+        for (NSNumber *index in self.frameBuffer.allKeys) {
+            if (![bufferedIndexes containsIndex:index.unsignedIntegerValue]) {
+                [self.frameBuffer removeObjectForKey:index];
+            }
+        }
+        for (NSUInteger i = 1; i < bufferCount; i++) {
+            NSNumber *index = @((self.currentFrameIndex + i) % frameCount);
+            if (!self.frameBuffer[index]) {
+                [missingIndexes addObject:index];
+            }
+        }
+    }
+    if (missingIndexes.count == 0) {
+        return;
+    }
+
+    NSMutableDictionary *frameBuffer = self.frameBuffer;
+    NSBlockOperation *operation = [NSBlockOperation new];
+    __weak NSBlockOperation *weakOperation = operation;
+    [operation addExecutionBlock:^{
+        for (NSNumber *index in missingIndexes) {
+            if (weakOperation.isCancelled) {
+                return;
+            }
+            UIImage *frame = [animatedImage animatedImageFrameAtIndex:index.unsignedIntegerValue];
+            @synchronized (frameBuffer) {
+                if (frame && !weakOperation.isCancelled) {
+                    frameBuffer[index] = frame;
+                }
+            }
+        }
+    }];
+    [self.fetchQueue addOperation:operation];
+}
+
+- (void)didReceiveMemoryWarning:(NSNotification *)notification {
+    [_fetchQueue cancelAllOperations];
+    @synchronized (self.frameBuffer) {
+        // Keep the displayed frame only, the next ones are decoded again when needed
+        UIImage *currentFrame = self.frameBuffer[@(self.currentFrameIndex)];
+        [self.frameBuffer removeAllObjects];
+        if (currentFrame) {
+            self.frameBuffer[@(self.currentFrameIndex)] = currentFrame;
+        }
+    }
+}
+
+@end
@@ -34,6 +34,9 @@ typedef void(^SDWebImageQueryCompletedBlock)(UIImage *image, SDImageCacheType ca
 //查询缓存中是否有该图片后要回调查询结果的block
 typedef void(^SDWebImageCheckCacheCompletionBlock)(BOOL isInCache);
 
+//异步读取未完成的下载数据后回调的block
+typedef void(^SDWebImagePartialDataBlock)(NSData *data, NSString *validator);
+
 //异步的计算磁盘中缓存的大小结果回调的block
 typedef void(^SDWebImageCalculateSizeBlock)(NSUInteger fileCount, NSUInteger totalSize);
 
@@ -52,7 +55,8 @@ typedef void(^SDWebImageCalculateSizeBlock)(NSUInteger fileCount, NSUInteger tot
 @property (assign, nonatomic) BOOL shouldDecompressImages;
 
 /**
- * The maximum "total cost" of the in-memory image cache. The cost function is the number of pixels held in memory.
+ * The maximum "total cost" of the in-memory image cache. The cost function is the number of pixels held in memory,
+ * in 32 bit pixels: the 16 bit and 8 bit gray bitmaps of `SDWebImageContextPixelFormat` cost a half and a quarter.
  设置最大内存占用值
  */
 @property (assign, nonatomic) NSUInteger maxMemoryCost;
@@ -69,6 +73,20 @@ typedef void(^SDWebImageCalculateSizeBlock)(NSUInteger fileCount, NSUInteger tot
  */
 @property (assign, nonatomic) NSUInteger maxCacheSize;
 
+/**
+ * The maximum length of time to keep the partial data of an interrupted download, in seconds. Defaults to 1 day.
+ 未下载完成的数据最长保留时间，默认是1天
+ */
+@property (assign, nonatomic) NSInteger maxPartialDataAge;
+
+/**
+ * The maximum number of pixels an image read from the disk is decoded to, 0 for no limit (the default).
+ * The size is read from the header of the data before decoding: larger images are decoded downsampled to fit
+ * this budget, as with `SDWebImageContextThumbnailPixelSize`, instead of allocating their full size bitmap.
+ 从磁盘读取的图片解码后的最大像素数，0为不限制；超出时按头部信息直接缩小解码
+ */
+@property (assign, nonatomic) NSUInteger maxDecodedPixelCount;
+
 /**
  * Returns global shared cache instance
  *
@@ -127,6 +145,106 @@ typedef void(^SDWebImageCalculateSizeBlock)(NSUInteger fileCount, NSUInteger tot
  */
 - (void)storeImage:(UIImage *)image recalculateFromImage:(BOOL)recalculate imageData:(NSData *)imageData forKey:(NSString *)key toDisk:(BOOL)toDisk;
 
+/**
+ * Store an image produced for a context (e.g. a thumbnail). The image is kept in memory under the variant key of the
+ * context (see `SDTransformedCacheKeyForContext`), while the disk keeps the original image data under the key itself.
+ * Images produced by a transformer (see `SDWebImageContextTransformer`) are written to disk under their variant key.
+ *
+ * @param context The context the image was produced for, nil for the original image
+ 存储按上下文生成的图片（如缩略图）：内存中用变体key保存，磁盘中只保存原始数据
+ */
+- (void)storeImage:(UIImage *)image recalculateFromImage:(BOOL)recalculate imageData:(NSData *)imageData forKey:(NSString *)key context:(NSDictionary *)context toDisk:(BOOL)toDisk;
+
+/**
+ * Store the variants asked by the context (see `SDWebImageContextVariantPixelLengths`) of an image decoded for that
+ * context, into memory and optionally disk cache. The image is the largest variant, each smaller variant is
+ * downsampled from the next larger one, so the whole chain costs a single decode. Animated images have no variants
+ * and are stored as by `storeImage:recalculateFromImage:imageData:forKey:context:toDisk:`.
+ * The variants are scaled and encoded on the calling thread, which should be a decode pool worker.
+ *
+ * @param image     The largest variant, as decoded for the context
+ * @param imageData The original image data, stored on disk under the key itself if not nil
+ * @param key       The unique image cache key
+ * @param context   The context the image was decoded for
+ * @param toDisk    Store the variants to disk cache if YES
+ *
+ * @return The variant to display for the context
+ 一次解码生成多个尺寸的变体并缓存到内存和磁盘，返回适合该上下文的变体
+ */
+- (UIImage *)storeImageVariantsFromImage:(UIImage *)image imageData:(NSData *)imageData forKey:(NSString *)key context:(NSDictionary *)context toDisk:(BOOL)toDisk;
+
+/**
+ * Query the memory cache synchronously for the smallest variant at or above the size asked by the context,
+ * or the largest variant if none is large enough.
+ *
+ * @param key     The unique key used to store the wanted image
+ * @param context The context the image is wanted for, see `SDWebImageContextVariantPixelLengths`
+ 从内存中查找不小于请求尺寸的最小变体
+ */
+- (UIImage *)imageVariantFromMemoryCacheForKey:(NSString *)key context:(NSDictionary *)context;
+
+/**
+ * Store the encoded data of an image in the disk cache asynchronously, replacing any existing entry. Nothing is
+ * decoded and the memory cache is left unchanged.
+ *
+ * @param imageData The encoded image data, as downloaded
+ * @param key       The unique image cache key
+ 只把图片数据写入磁盘缓存：不解码，不写入内存缓存
+ */
+- (void)storeImageData:(NSData *)imageData forKey:(NSString *)key;
+
+/**
+ * Move a file holding the encoded image data into the disk cache at the given key, replacing any existing entry.
+ * The file should be on the same volume as the cache for the move to be atomic.
+ * This method blocks until the file was moved.
+ *
+ * @param path The path of the file, it doesn't exist anymore if the method succeeded
+ * @param key  The unique image cache key
+ *
+ * @return YES if the file is now in the disk cache
+ 将已经下载到文件中的图片数据移入磁盘缓存（同步执行）
+ */
+- (BOOL)storeImageDataFromFileAtPath:(NSString *)path forKey:(NSString *)key;
+
+/**
+ * Store the partially downloaded body of an image, so that a later download can resume it with an HTTP Range request.
+ * The data is written asynchronously to a temporary area of the disk cache, replacing any previous partial data for the key.
+ *
+ * @param data         The body bytes received so far
+ * @param validator    The validator (ETag or Last-Modified) of the response the bytes belong to
+ * @param expectedSize The full size of the body, 0 if unknown
+ * @param key          The unique image cache key
+ 保存下载了一部分的数据，下次下载时可以通过Range请求断点续传
+ */
+- (void)storePartialData:(NSData *)data validator:(NSString *)validator expectedSize:(NSUInteger)expectedSize forKey:(NSString *)key;
+
+/**
+ * Synchronously read the partial data stored for a key.
+ *
+ * @param key       The unique image cache key
+ * @param validator On return, the validator the partial data belongs to
+ *
+ * @return The partial body bytes, or nil if there are none
+ */
+- (NSData *)partialDataForKey:(NSString *)key validator:(NSString **)validator;
+
+/**
+ * Asynchronously read the partial data stored for a key. The block is called on the cache's IO queue, with nil data
+ * if there are none.
+ *
+ * @param key        The unique image cache key
+ * @param completion The block called with the partial body bytes and the validator they belong to
+ 异步读取未完成的下载数据，回调在缓存的IO队列上执行
+ */
+- (void)queryPartialDataForKey:(NSString *)key completion:(SDWebImagePartialDataBlock)completion;
+
+/**
+ * Remove the partial data stored for a key, if any.
+ *
+ * @param key The unique image cache key
+ */
+- (void)removePartialDataForKey:(NSString *)key;
+
 /**
  * Query the disk cache asynchronously.
  *
@@ -135,6 +253,18 @@ typedef void(^SDWebImageCalculateSizeBlock)(NSUInteger fileCount, NSUInteger tot
  */
 - (NSOperation *)queryDiskCacheForKey:(NSString *)key done:(SDWebImageQueryCompletedBlock)doneBlock;
 
+/**
+ * Query the cache asynchronously for the image produced for a context. The memory cache is searched with the variant
+ * key of the context and the original data read from disk is decoded for the context.
+ * With `SDWebImageContextVariantPixelLengths` the nearest variant is returned, the variants being generated from
+ * the original data on the first query. With `SDWebImageContextTransformer` only the transformed image is looked up.
+ *
+ * @param key     The unique key used to store the wanted image
+ * @param context The context the image is wanted for, nil for the original image
+ 按上下文查询缓存：内存中查变体key，磁盘中读取原始数据后按上下文解码
+ */
+- (NSOperation *)queryDiskCacheForKey:(NSString *)key context:(NSDictionary *)context done:(SDWebImageQueryCompletedBlock)doneBlock;
+
 /**
  * Query the memory cache synchronously.
  *
@@ -210,7 +340,7 @@ typedef void(^SDWebImageCalculateSizeBlock)(NSUInteger fileCount, NSUInteger tot
 - (void)clearDisk;
 
 /**
- * Remove all expired cached image from disk. Non-blocking method - returns immediately.
+ * Remove all expired cached image (and partial data older than `maxPartialDataAge`) from disk. Non-blocking method - returns immediately.
  * @param completionBlock An block that should be executed after cache expiration completes (optional)
  移除磁盘中所有过期的缓存，并且带了SDWebImageNoParamsBlock，该block会在过期图片被移除后执行
  */
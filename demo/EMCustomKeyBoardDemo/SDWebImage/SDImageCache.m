@@ -9,31 +9,25 @@
 #import "SDImageCache.h"
 #import "SDWebImageDecoder.h"
 #import "UIImage+MultiFormat.h"
+#import "NSData+ImageContentType.h"
+#import "SDWebImageCoder.h"
+#import "SDWebImageBitmapPool.h"
+#import "SDAnimatedImage.h"
+#import "SDWebImageTransformer.h"
+#import "SDWebImageDecodePool.h"
 #import <CommonCrypto/CommonDigest.h>
 
 //默认最大缓存时间是一周
 static const NSInteger kDefaultCacheMaxCacheAge = 60 * 60 * 24 * 7; // 1 week
-// PNG signature bytes and data (below)
-
-static unsigned char kPNGSignatureBytes[8] = {0x89, 0x50, 0x4E, 0x47, 0x0D, 0x0A, 0x1A, 0x0A};
-static NSData *kPNGSignatureData = nil;
-
-BOOL ImageDataHasPNGPreffix(NSData *data);
-
-// ImageDataHasPNGPreffix就是为了判断imageData前8个字节是不是符合PNG标志
-//用来判断图片是否是PNG格式图片的。其原理是：PNG图片很容易检测，因为它拥有一个独特的签名，PNG文件的前八字节经常包含如下（十进制）的数值137 80 78 71 13 10 26 10。（八进制：0x89, 0x50, 0x4E, 0x47, 0x0D, 0x0A, 0x1A, 0x0A）我们正可据此鉴别PNG文件。
-BOOL ImageDataHasPNGPreffix(NSData *data) {
-    NSUInteger pngSignatureLength = [kPNGSignatureData length];
-    if ([data length] >= pngSignatureLength) {
-        //subdataWithRange：截取data指定位置的子data
-        //Returns a new data object containing the data object's bytes that fall within the limits specified by a given range.
-        if ([[data subdataWithRange:NSMakeRange(0, pngSignatureLength)] isEqualToData:kPNGSignatureData]) {
-            return YES;
-        }
-    }
-
-    return NO;
-}
+//未下载完成的数据默认保留一天
+static const NSInteger kDefaultMaxPartialDataAge = 60 * 60 * 24; // 1 day
+// Name of the temporary area, inside the disk cache folder, holding the partial data of interrupted downloads
+static NSString *const kPartialDataDirectoryName = @"Partial";
+static NSString *const kPartialValidatorKey = @"validator";
+static NSString *const kPartialLengthKey = @"length";
+static NSString *const kPartialExpectedSizeKey = @"expectedSize";
+// Compression quality of the variants of JPEG images written to disk
+static const CGFloat kVariantJPEGCompressionQuality = 0.9;
 
 /**
  SDCacheCostForImage指向一个静态内联函数,其中FOUNDATION_STATIC_INLINE作为宏指向static inline
@@ -53,12 +47,25 @@ BOOL ImageDataHasPNGPreffix(NSData *data) {
  
  **/
 FOUNDATION_STATIC_INLINE NSUInteger SDCacheCostForImage(UIImage *image) {
-    return image.size.height * image.size.width * image.scale * image.scale;
+    // In 32 bit pixels, the length of the pooled buffer holding the bitmap: its row padding and size class rounding
+    // count, and 16 bit and 8 bit gray bitmaps cost a half and a quarter of their pixels
+    //以32位像素计，按位图所在缓冲区的实际大小（含行对齐和分级取整）计算；16位、8位灰度的位图相应更少
+    CGImageRef imageRef = image.CGImage;
+    NSUInteger cost = imageRef ? SDBitmapPoolBufferLength(CGImageGetBytesPerRow(imageRef) * CGImageGetHeight(imageRef)) / 4 : image.size.height * image.size.width * image.scale * image.scale;
+    if ([image isKindOfClass:[SDAnimatedImage class]]) {
+        // The encoded data and the decoder canvases of an animated image live as long as it does
+        //动画图片的压缩数据和解码器画布与图片同生命周期
+        cost += ((SDAnimatedImage *)image).animatedImageMemoryCost / 4;
+    }
+    return cost;
 }
 
 @interface SDImageCache ()
 
 @property (strong, nonatomic) NSCache *memCache;
+// key -> {SDVariantPixelLengthsKeyForContext -> pixel sizes of the variants (NSStringFromCGSize), largest first}: one
+// index per set of lengths asked for the key. Also written to disk next to the variants
+@property (strong, nonatomic) NSCache *variantIndexes;
 @property (strong, nonatomic) NSString *diskCachePath;
 @property (strong, nonatomic) NSMutableArray *customPaths;
 //一个队列属性
@@ -89,10 +96,6 @@ FOUNDATION_STATIC_INLINE NSUInteger SDCacheCostForImage(UIImage *image) {
     if ((self = [super init])) {
         NSString *fullNamespace = [@"com.hackemist.SDWebImageCache." stringByAppendingString:ns];
 
-        // initialise PNG signature data
-        //初始化PNG图片签名
-        kPNGSignatureData = [NSData dataWithBytes:kPNGSignatureBytes length:8];
-
         // Create IO serial queue
         //初始化队列，创建串行队列：
         _ioQueue = dispatch_queue_create("com.hackemist.SDWebImageCache", DISPATCH_QUEUE_SERIAL);
@@ -100,6 +103,7 @@ FOUNDATION_STATIC_INLINE NSUInteger SDCacheCostForImage(UIImage *image) {
         // Init default values
         //初始化最大缓存时长
         _maxCacheAge = kDefaultCacheMaxCacheAge;
+        _maxPartialDataAge = kDefaultMaxPartialDataAge;
 
         // Init the memory cache
         /**
@@ -115,6 +119,7 @@ FOUNDATION_STATIC_INLINE NSUInteger SDCacheCostForImage(UIImage *image) {
         _memCache = [[NSCache alloc] init];
         // _memCache.name 缓存的名称
         _memCache.name = fullNamespace;
+        _variantIndexes = [[NSCache alloc] init];
 
         // Init the disk cache
         //初始化磁盘缓存的路径（即保存在）~Library/Caches下创建了一个文件夹（com.hackemist.SDWebImageCache.default）
@@ -218,9 +223,25 @@ FOUNDATION_STATIC_INLINE NSUInteger SDCacheCostForImage(UIImage *image) {
 }
 
 - (void)storeImage:(UIImage *)image recalculateFromImage:(BOOL)recalculate imageData:(NSData *)imageData forKey:(NSString *)key toDisk:(BOOL)toDisk {
+    [self storeImage:image recalculateFromImage:recalculate imageData:imageData forKey:key context:nil toDisk:toDisk];
+}
+
+- (void)storeImage:(UIImage *)image recalculateFromImage:(BOOL)recalculate imageData:(NSData *)imageData forKey:(NSString *)key context:(NSDictionary *)context toDisk:(BOOL)toDisk {
     if (!image || !key) {
         return;
     }
+    NSString *memoryKey = SDTransformedCacheKeyForContext(key, context);
+    NSString *diskKey = key;
+    if (context[SDWebImageContextTransformer]) {
+        // Transforming again is expensive, keep the transformed bitmap on disk under its own key
+        //变换后的图片单独存入磁盘，避免重复变换
+        diskKey = memoryKey;
+    }
+    else if (toDisk && ![memoryKey isEqualToString:key] && (recalculate || !imageData)) {
+        // The disk only holds the original data, variants are decoded from it. Never replace it with the variant's bitmap
+        //磁盘中只保存原始数据，不能用缩略图等变体覆盖
+        toDisk = NO;
+    }
 
     /**
      写入缓存时、直接用图片url作为key
@@ -228,8 +249,8 @@ FOUNDATION_STATIC_INLINE NSUInteger SDCacheCostForImage(UIImage *image) {
      写入磁盘时、用url的MD5编码作为key。可以防止文件名过长
      **/
     NSUInteger cost = SDCacheCostForImage(image);
-    //写入内存缓存
-    [self.memCache setObject:image forKey:key cost:cost];
+    //写入内存缓存（不同上下文的图片用不同的key）
+    [self.memCache setObject:image forKey:memoryKey cost:cost];
 
     //如果需要进行磁盘缓存
     if (toDisk) {
@@ -246,41 +267,55 @@ FOUNDATION_STATIC_INLINE NSUInteger SDCacheCostForImage(UIImage *image) {
                 // 137 80 78 71 13 10 26 10
 
                 // We assume the image is PNG, in case the imageData is nil (i.e. if trying to save a UIImage directly),
-                // we will consider it PNG to avoid loosing the transparency
-                BOOL imageIsPng = YES;
+                // we will consider it PNG to avoid loosing the transparency, or GIF to keep the frames of an animation
+                SDImageFormat format = SDImageIsAnimated(image) ? SDImageFormatGIF : SDImageFormatPNG;
 
-                // But if we have an image data, we will look at the preffix
-                if (imageData && [imageData length] >= [kPNGSignatureData length]) {
-                    imageIsPng = ImageDataHasPNGPreffix(imageData);
+                // But if we have an image data, we will look at its signature
+                if (imageData) {
+                    format = [NSData sd_imageFormatForImageData:imageData];
                 }
 
                 /**
                  UIImageJPEGRepresentation函数需要两个参数:图片的引用和压缩系数.而UIImagePNGRepresentation只需要图片引用作为参数.通过在实际使用过程中,比较发现:UIImagePNGRepresentation(UIImage* image) 要比UIImageJPEGRepresentation(UIImage* image, 1.0)返回的图片数据量大很多
                  **/
-                if (imageIsPng) {
-                    
-                    data = UIImagePNGRepresentation(image);
-                }
-                else {
-                    data = UIImageJPEGRepresentation(image, (CGFloat)1.0);
+                // Encoded by the registered coders, as JPEG if none supports the format
+                //由注册的编解码器编码，都不支持该格式时编码为JPEG
+                SDWebImageCodersManager *coders = [SDWebImageCodersManager sharedManager];
+                if (![coders canEncodeToFormat:format]) {
+                    format = SDImageFormatJPEG;
                 }
+                data = [coders encodedDataWithImage:image format:format compressionQuality:(CGFloat)1.0];
 #else
                 data = [NSBitmapImageRep representationOfImageRepsInArray:image.representations usingType: NSJPEGFileType properties:nil];
 #endif
             }
 
-            if (data) {
-                if (![_fileManager fileExistsAtPath:_diskCachePath]) {
-                    //如果沙盒里没有缓存的文件夹，则创建一个文件夹
-                    [_fileManager createDirectoryAtPath:_diskCachePath withIntermediateDirectories:YES attributes:nil error:NULL];
-                }
-                
-                //创建文件
-                [_fileManager createFileAtPath:[self defaultCachePathForKey:key] contents:data attributes:nil];
-            }
+            [self writeImageData:data forKey:diskKey];
         });
     }
 }
+
+- (void)storeImageData:(NSData *)imageData forKey:(NSString *)key {
+    if (!imageData || !key) {
+        return;
+    }
+    dispatch_async(self.ioQueue, ^{
+        [self writeImageData:imageData forKey:key];
+    });
+}
+
+// Called on the ioQueue
+- (void)writeImageData:(NSData *)data forKey:(NSString *)key {
+    if (data) {
+        if (![_fileManager fileExistsAtPath:_diskCachePath]) {
+            //如果沙盒里没有缓存的文件夹，则创建一个文件夹
+            [_fileManager createDirectoryAtPath:_diskCachePath withIntermediateDirectories:YES attributes:nil error:NULL];
+        }
+
+        //创建文件
+        [_fileManager createFileAtPath:[self defaultCachePathForKey:key] contents:data attributes:nil];
+    }
+}
 /**
  为什么会死锁？
  如果在主线程中运用主队列同步，也就是把任务放到了主线程的队列中。
@@ -321,6 +356,330 @@ FOUNDATION_STATIC_INLINE NSUInteger SDCacheCostForImage(UIImage *image) {
     [self storeImage:image recalculateFromImage:YES imageData:nil forKey:key toDisk:toDisk];
 }
 
+//将下载到文件中的图片数据移入磁盘缓存
+- (BOOL)storeImageDataFromFileAtPath:(NSString *)path forKey:(NSString *)key {
+    if (!path || !key) {
+        return NO;
+    }
+    __block BOOL success = NO;
+    dispatch_sync(self.ioQueue, ^{
+        if (![_fileManager fileExistsAtPath:_diskCachePath]) {
+            [_fileManager createDirectoryAtPath:_diskCachePath withIntermediateDirectories:YES attributes:nil error:NULL];
+        }
+        NSString *cachePath = [self defaultCachePathForKey:key];
+        // rename(2) atomically replaces any existing entry, readers never see a half written file
+        if (rename(path.fileSystemRepresentation, cachePath.fileSystemRepresentation) == 0) {
+            success = YES;
+        }
+        else {
+            // e.g. the file is on another volume
+            [_fileManager removeItemAtPath:cachePath error:nil];
+            success = [_fileManager moveItemAtPath:path toPath:cachePath error:nil];
+        }
+    });
+    return success;
+}
+
+#pragma mark Variants
+
+- (NSString *)variantKeyForKey:(NSString *)key pixelSize:(CGSize)pixelSize {
+    return [key stringByAppendingFormat:@"-Variant(%.0fx%.0f)", pixelSize.width, pixelSize.height];
+}
+
+- (NSString *)variantIndexPathForKey:(NSString *)key {
+    return [[self defaultCachePathForKey:[key stringByAppendingString:@"-Variants"]] stringByAppendingPathExtension:@"plist"];
+}
+
+// The indexes of all the sets of variants of a key, read from disk if they are not in memory
+- (NSDictionary *)variantIndexesForKey:(NSString *)key {
+    NSDictionary *variantIndexes = [self.variantIndexes objectForKey:key];
+    if (!variantIndexes) {
+        // Written atomically on ioQueue, reading it from another thread is safe
+        variantIndexes = [NSDictionary dictionaryWithContentsOfFile:[self variantIndexPathForKey:key]];
+        if (variantIndexes.count > 0) {
+            [self.variantIndexes setObject:variantIndexes forKey:key];
+        }
+    }
+    return variantIndexes;
+}
+
+// The index of the variants generated for the lengths of the context. Another set of lengths has its own index, its
+// sizes are not the ones the context asked for
+//只使用与上下文同一组长度生成的变体索引
+- (NSArray *)variantIndexForKey:(NSString *)key context:(NSDictionary *)context {
+    NSString *lengthsKey = SDVariantPixelLengthsKeyForContext(context);
+    return lengthsKey ? [self variantIndexesForKey:key][lengthsKey] : nil;
+}
+
+// Variants keep the format of the original: a PNG stays lossless with its alpha, a JPEG stays a JPEG. The other
+// formats, which the coders may not encode, become PNG with alpha and JPEG without
+//变体沿用原图格式；其他格式有透明通道用PNG，否则用JPEG
+static SDImageFormat SDVariantImageFormat(SDImageFormat sourceFormat, BOOL hasAlpha) {
+    if (sourceFormat == SDImageFormatPNG || sourceFormat == SDImageFormatJPEG) {
+        return sourceFormat;
+    }
+    return hasAlpha ? SDImageFormatPNG : SDImageFormatJPEG;
+}
+
+// The format of the original data on disk, from its first bytes. Called on ioQueue
+- (SDImageFormat)diskImageFormatForKey:(NSString *)key {
+    NSFileHandle *fileHandle = [NSFileHandle fileHandleForReadingAtPath:[self defaultCachePathForKey:key]];
+    NSData *header = [fileHandle readDataOfLength:16];
+    [fileHandle closeFile];
+    return header.length > 0 ? [NSData sd_imageFormatForImageData:header] : SDImageFormatUndefined;
+}
+
+// The variants able to serve the context, best first: the smallest at or above the requested size, then the larger
+// ones in case it was evicted, the largest variant serving the requests larger than all of them
+//按优先顺序返回可用的变体：先是不小于请求尺寸的最小变体，然后依次是更大的变体
+- (NSArray *)variantSizes:(NSArray *)variantSizes forContext:(NSDictionary *)context {
+    if (variantSizes.count == 0) {
+        return nil;
+    }
+    NSMutableDictionary *requestContext = [context mutableCopy];
+    [requestContext removeObjectForKey:SDWebImageContextVariantPixelLengths];
+    CGSize requestedPixelSize = SDThumbnailPixelSizeForContext(CGSizeFromString(variantSizes.firstObject), requestContext);
+    if (requestedPixelSize.width <= 0 || requestedPixelSize.height <= 0) {
+        return @[variantSizes.firstObject];
+    }
+    NSMutableArray *candidates = [NSMutableArray array];
+    for (NSString *sizeString in variantSizes.reverseObjectEnumerator) {
+        CGSize pixelSize = CGSizeFromString(sizeString);
+        // Allow one pixel of rounding between the variant and the requested size
+        if (pixelSize.width + 1 >= requestedPixelSize.width && pixelSize.height + 1 >= requestedPixelSize.height) {
+            [candidates addObject:sizeString];
+        }
+    }
+    if (candidates.count == 0) {
+        [candidates addObject:variantSizes.firstObject];
+    }
+    return candidates;
+}
+
+- (UIImage *)storeImageVariantsFromImage:(UIImage *)image imageData:(NSData *)imageData forKey:(NSString *)key context:(NSDictionary *)context toDisk:(BOOL)toDisk {
+    SDImageFormat sourceFormat = imageData ? [NSData sd_imageFormatForImageData:imageData] : SDImageFormatUndefined;
+    return [self storeImageVariantsFromImage:image imageData:imageData sourceFormat:sourceFormat forKey:key context:context toDisk:toDisk];
+}
+
+// The variants are scaled and encoded on the calling thread, a decode pool worker: ioQueue only reads the format of
+// the original when it is not known and writes the files
+//变体在调用线程（解码池）中缩放和编码，ioQueue只负责读取原图格式和写文件
+- (UIImage *)storeImageVariantsFromImage:(UIImage *)image imageData:(NSData *)imageData sourceFormat:(SDImageFormat)sourceFormat forKey:(NSString *)key context:(NSDictionary *)context toDisk:(BOOL)toDisk {
+    NSArray *variantPixelLengths = context[SDWebImageContextVariantPixelLengths];
+    if (!image || !key) {
+        return image;
+    }
+    if (SDImageIsAnimated(image) || variantPixelLengths.count == 0) {
+        [self storeImage:image recalculateFromImage:NO imageData:imageData forKey:key context:context toDisk:toDisk];
+        return image;
+    }
+
+    CGSize largestPixelSize = CGSizeMake(CGImageGetWidth(image.CGImage), CGImageGetHeight(image.CGImage));
+    UIImageOrientation orientation = image.imageOrientation;
+    if (orientation == UIImageOrientationLeft || orientation == UIImageOrientationLeftMirrored ||
+        orientation == UIImageOrientationRight || orientation == UIImageOrientationRightMirrored) {
+        largestPixelSize = CGSizeMake(largestPixelSize.height, largestPixelSize.width);
+    }
+    CGFloat largestLength = MAX(largestPixelSize.width, largestPixelSize.height);
+    CGImageAlphaInfo alphaInfo = CGImageGetAlphaInfo(image.CGImage);
+    BOOL hasAlpha = !(alphaInfo == kCGImageAlphaNone || alphaInfo == kCGImageAlphaNoneSkipFirst || alphaInfo == kCGImageAlphaNoneSkipLast);
+    NSString *lengthsKey = SDVariantPixelLengthsKeyForContext(context);
+
+    // Largest first, each variant is downsampled from the previous one like a mipmap chain
+    //从大到小生成，每一级从上一级缩小得到
+    NSArray *descendingLengths = [[variantPixelLengths sortedArrayUsingSelector:@selector(compare:)] reverseObjectEnumerator].allObjects;
+    NSMutableArray *variantSizes = [NSMutableArray array];
+    NSMutableArray *variants = [NSMutableArray array];
+    UIImage *variant = image;
+    for (NSNumber *length in descendingLengths) {
+        CGFloat ratio = length.doubleValue / largestLength;
+        CGSize pixelSize = ratio >= 1 ? largestPixelSize : CGSizeMake(MAX(1, round(largestPixelSize.width * ratio)), MAX(1, round(largestPixelSize.height * ratio)));
+        NSString *sizeString = NSStringFromCGSize(pixelSize);
+        if ([variantSizes containsObject:sizeString]) {
+            // The lengths above the size of the image all give the image itself
+            continue;
+        }
+        variant = [UIImage scaledImageWithImage:variant pixelSize:pixelSize];
+        [variantSizes addObject:sizeString];
+        [variants addObject:variant];
+        [self.memCache setObject:variant forKey:[self variantKeyForKey:key pixelSize:pixelSize] cost:SDCacheCostForImage(variant)];
+    }
+    NSArray *variantIndex = [variantSizes copy];
+    @synchronized (self.variantIndexes) {
+        NSMutableDictionary *variantIndexes = [[self variantIndexesForKey:key] mutableCopy] ?: [NSMutableDictionary dictionary];
+        variantIndexes[lengthsKey] = variantIndex;
+        [self.variantIndexes setObject:[variantIndexes copy] forKey:key];
+    }
+
+    if (toDisk) {
+        if (sourceFormat == SDImageFormatUndefined && !imageData) {
+            __block SDImageFormat diskFormat = SDImageFormatUndefined;
+            dispatch_sync(self.ioQueue, ^{
+                diskFormat = [self diskImageFormatForKey:key];
+            });
+            sourceFormat = diskFormat;
+        }
+        SDImageFormat variantFormat = SDVariantImageFormat(sourceFormat, hasAlpha);
+        NSMutableArray *variantsData = [NSMutableArray arrayWithCapacity:variants.count];
+        for (UIImage *variantImage in variants) {
+            @autoreleasepool {
+                NSData *data = [[SDWebImageCodersManager sharedManager] encodedDataWithImage:variantImage format:variantFormat compressionQuality:kVariantJPEGCompressionQuality];
+                [variantsData addObject:data ?: [NSData data]];
+            }
+        }
+        dispatch_async(self.ioQueue, ^{
+            if (![_fileManager fileExistsAtPath:_diskCachePath]) {
+                [_fileManager createDirectoryAtPath:_diskCachePath withIntermediateDirectories:YES attributes:nil error:NULL];
+            }
+            if (imageData) {
+                [_fileManager createFileAtPath:[self defaultCachePathForKey:key] contents:imageData attributes:nil];
+            }
+            [variantsData enumerateObjectsUsingBlock:^(NSData *data, NSUInteger idx, BOOL *stop) {
+                NSString *variantKey = [self variantKeyForKey:key pixelSize:CGSizeFromString(variantIndex[idx])];
+                [_fileManager createFileAtPath:[self defaultCachePathForKey:variantKey] contents:data attributes:nil];
+            }];
+            // The index last, a reader never finds it before the variants it lists. The other sets of lengths keep
+            // their own entries
+            NSString *variantIndexPath = [self variantIndexPathForKey:key];
+            NSMutableDictionary *variantIndexes = [NSMutableDictionary dictionaryWithContentsOfFile:variantIndexPath] ?: [NSMutableDictionary dictionary];
+            variantIndexes[lengthsKey] = variantIndex;
+            [variantIndexes writeToFile:variantIndexPath atomically:YES];
+        });
+    }
+
+    NSString *bestSize = [self variantSizes:variantIndex forContext:context].firstObject;
+    return variants[[variantIndex indexOfObject:bestSize]];
+}
+
+- (UIImage *)imageVariantFromMemoryCacheForKey:(NSString *)key context:(NSDictionary *)context {
+    if (!key) {
+        return nil;
+    }
+    NSString *lengthsKey = SDVariantPixelLengthsKeyForContext(context);
+    NSArray *variantSizes = lengthsKey ? [self.variantIndexes objectForKey:key][lengthsKey] : nil;
+    for (NSString *sizeString in [self variantSizes:variantSizes forContext:context]) {
+        UIImage *image = [self imageFromMemoryCacheForKey:[self variantKeyForKey:key pixelSize:CGSizeFromString(sizeString)]];
+        if (image) {
+            return image;
+        }
+    }
+    return nil;
+}
+
+// Nearest variant in memory or on disk, nil if the variants were not generated yet
+- (UIImage *)diskImageVariantForKey:(NSString *)key context:(NSDictionary *)context {
+    for (NSString *sizeString in [self variantSizes:[self variantIndexForKey:key context:context] forContext:context]) {
+        NSString *variantKey = [self variantKeyForKey:key pixelSize:CGSizeFromString(sizeString)];
+        UIImage *image = [self imageFromMemoryCacheForKey:variantKey];
+        if (image) {
+            return image;
+        }
+        NSData *data = [self diskImageDataBySearchingAllPathsForKey:variantKey];
+        image = [self decodedDiskImageWithData:data key:key context:nil];
+        if (image) {
+            [self.memCache setObject:image forKey:variantKey cost:SDCacheCostForImage(image)];
+            return image;
+        }
+    }
+    return nil;
+}
+
+#pragma mark Partial data
+
+- (NSString *)partialDataPath {
+    return [self.diskCachePath stringByAppendingPathComponent:kPartialDataDirectoryName];
+}
+
+- (NSString *)partialDataPathForKey:(NSString *)key {
+    return [self cachePathForKey:key inPath:[self partialDataPath]];
+}
+
+- (NSString *)partialInfoPathForKey:(NSString *)key {
+    return [[self partialDataPathForKey:key] stringByAppendingPathExtension:@"plist"];
+}
+
+- (void)storePartialData:(NSData *)data validator:(NSString *)validator expectedSize:(NSUInteger)expectedSize forKey:(NSString *)key {
+    if (data.length == 0 || validator.length == 0 || !key) {
+        return;
+    }
+    dispatch_async(self.ioQueue, ^{
+        NSString *partialDataPath = [self partialDataPath];
+        if (![_fileManager fileExistsAtPath:partialDataPath]) {
+            [_fileManager createDirectoryAtPath:partialDataPath withIntermediateDirectories:YES attributes:nil error:NULL];
+        }
+        // Both files are written atomically, a reader checks the recorded length to detect a mismatched pair
+        //数据和描述信息分两个文件原子写入，读取时通过记录的长度判断两者是否匹配
+        NSDictionary *info = @{kPartialValidatorKey : validator,
+                               kPartialLengthKey : @(data.length),
+                               kPartialExpectedSizeKey : @(expectedSize)};
+        [data writeToFile:[self partialDataPathForKey:key] atomically:YES];
+        [info writeToFile:[self partialInfoPathForKey:key] atomically:YES];
+    });
+}
+
+- (NSData *)partialDataForKey:(NSString *)key validator:(NSString **)validator {
+    if (!key) {
+        return nil;
+    }
+    // Files are written atomically on ioQueue, reading them from another thread is safe
+    NSDictionary *info = [NSDictionary dictionaryWithContentsOfFile:[self partialInfoPathForKey:key]];
+    NSString *partialValidator = info[kPartialValidatorKey];
+    if (partialValidator.length == 0) {
+        return nil;
+    }
+    NSData *data = [NSData dataWithContentsOfFile:[self partialDataPathForKey:key]];
+    if (data.length == 0 || data.length != [info[kPartialLengthKey] unsignedIntegerValue]) {
+        return nil;
+    }
+    if (validator) {
+        *validator = partialValidator;
+    }
+    return data;
+}
+
+- (void)queryPartialDataForKey:(NSString *)key completion:(SDWebImagePartialDataBlock)completion {
+    if (!completion) {
+        return;
+    }
+    dispatch_async(self.ioQueue, ^{
+        NSString *validator = nil;
+        NSData *data = [self partialDataForKey:key validator:&validator];
+        completion(data, data ? validator : nil);
+    });
+}
+
+- (void)removePartialDataForKey:(NSString *)key {
+    if (!key) {
+        return;
+    }
+    dispatch_async(self.ioQueue, ^{
+        [_fileManager removeItemAtPath:[self partialDataPathForKey:key] error:nil];
+        [_fileManager removeItemAtPath:[self partialInfoPathForKey:key] error:nil];
+    });
+}
+
+// Must be called on ioQueue.
+//删除过期的未完成下载数据
+- (void)cleanExpiredPartialData {
+    NSURL *partialDataURL = [NSURL fileURLWithPath:[self partialDataPath] isDirectory:YES];
+    NSArray *resourceKeys = @[NSURLIsDirectoryKey, NSURLContentModificationDateKey];
+    NSDirectoryEnumerator *fileEnumerator = [_fileManager enumeratorAtURL:partialDataURL
+                                               includingPropertiesForKeys:resourceKeys
+                                                                  options:NSDirectoryEnumerationSkipsHiddenFiles
+                                                             errorHandler:NULL];
+    NSDate *expirationDate = [NSDate dateWithTimeIntervalSinceNow:-self.maxPartialDataAge];
+    for (NSURL *fileURL in fileEnumerator) {
+        NSDictionary *resourceValues = [fileURL resourceValuesForKeys:resourceKeys error:NULL];
+        if ([resourceValues[NSURLIsDirectoryKey] boolValue]) {
+            continue;
+        }
+        NSDate *modificationDate = resourceValues[NSURLContentModificationDateKey];
+        if ([[modificationDate laterDate:expirationDate] isEqualToDate:expirationDate]) {
+            [_fileManager removeItemAtURL:fileURL error:nil];
+        }
+    }
+}
+
 //判断磁盘缓存文件夹里是否有key对应的文件（在当前线程查）
 - (BOOL)diskImageExistsWithKey:(NSString *)key {
     BOOL exists = NO;
@@ -370,22 +729,27 @@ FOUNDATION_STATIC_INLINE NSUInteger SDCacheCostForImage(UIImage *image) {
     return diskImage;
 }
 
+// Decodes data read from the disk, downsampled when its header is larger than maxDecodedPixelCount
+//解码磁盘数据；头部尺寸超出maxDecodedPixelCount时直接缩小解码
+- (UIImage *)decodedDiskImageWithData:(NSData *)data key:(NSString *)key context:(NSDictionary *)context {
+    if (data && self.maxDecodedPixelCount > 0) {
+        context = SDContextFittingDecodeBudget(context, [NSData sd_imageHeaderForImageData:data], self.maxDecodedPixelCount, 0);
+    }
+    return [UIImage decodedImageWithData:data key:key context:context decompress:self.shouldDecompressImages];
+}
+
 //检查磁盘中是否有key对应的图片
 - (UIImage *)diskImageForKey:(NSString *)key {
+    return [self diskImageForKey:key context:nil];
+}
+
+- (UIImage *)diskImageForKey:(NSString *)key context:(NSDictionary *)context {
     NSData *data = [self diskImageDataBySearchingAllPathsForKey:key];
     if (data) {
-        ////通过data，获取首字节判断是什么类型的图片，然后将data转换成UIImage返回
-        UIImage *image = [UIImage sd_imageWithData:data];
-        
+        //通过data，获取首字节判断是什么类型的图片，按上下文解码成UIImage
         //防止url里面包含@"2x"、@"3x"等字符串，从而使图片size变大问题，处理图片
-        image = [self scaledImageForKey:key image:image];
-        
         //如果设置了解码图片就解码
-        if (self.shouldDecompressImages) {
-            //解码图片
-            image = [UIImage decodedImageWithImage:image];
-        }
-        return image;
+        return [self decodedDiskImageWithData:data key:key context:context];
     }
     else {
         return nil;
@@ -422,6 +786,10 @@ FOUNDATION_STATIC_INLINE NSUInteger SDCacheCostForImage(UIImage *image) {
 
 //查询磁盘中key对应的缓存图片，但是会先查询内存中是否有该图片，如果有就直接返回，没有再查询磁盘中
 - (NSOperation *)queryDiskCacheForKey:(NSString *)key done:(SDWebImageQueryCompletedBlock)doneBlock {
+    return [self queryDiskCacheForKey:key context:nil done:doneBlock];
+}
+
+- (NSOperation *)queryDiskCacheForKey:(NSString *)key context:(NSDictionary *)context done:(SDWebImageQueryCompletedBlock)doneBlock {
     if (!doneBlock) {
         return nil;
     }
@@ -432,7 +800,14 @@ FOUNDATION_STATIC_INLINE NSUInteger SDCacheCostForImage(UIImage *image) {
     }
 
     // First check the in-memory cache...
-    UIImage *image = [self imageFromMemoryCacheForKey:key];
+    BOOL isTransformed = context[SDWebImageContextTransformer] != nil;
+    BOOL hasVariants = !isTransformed && [context[SDWebImageContextVariantPixelLengths] count] > 0;
+    NSString *memoryKey = SDTransformedCacheKeyForContext(key, context);
+    UIImage *image = hasVariants ? [self imageVariantFromMemoryCacheForKey:key context:context] : nil;
+    if (!image) {
+        // Without variants (animated images have none) the image is cached under the key of the context
+        image = [self imageFromMemoryCacheForKey:memoryKey];
+    }
     if (image) {
         doneBlock(image, SDImageCacheTypeMemory);
         return nil;
@@ -445,11 +820,47 @@ FOUNDATION_STATIC_INLINE NSUInteger SDCacheCostForImage(UIImage *image) {
         }
 
         @autoreleasepool {
-            //检查磁盘中是否有key对应的图片
-            UIImage *diskImage = [self diskImageForKey:key];
-            if (diskImage) {
-                NSUInteger cost = SDCacheCostForImage(diskImage);
-                [self.memCache setObject:diskImage forKey:key cost:cost];
+            UIImage *diskImage = nil;
+            if (isTransformed) {
+                // The caller transforms the source image on a miss, see SDWebImageManager
+                //只查找变换后的图片，未命中时由调用方变换原图
+                NSData *data = [self diskImageDataBySearchingAllPathsForKey:memoryKey];
+                diskImage = [self decodedDiskImageWithData:data key:key context:nil];
+                if (diskImage) {
+                    [self.memCache setObject:diskImage forKey:memoryKey cost:SDCacheCostForImage(diskImage)];
+                }
+            }
+            else if (hasVariants) {
+                diskImage = [self diskImageVariantForKey:key context:context];
+                NSData *data = diskImage ? nil : [self diskImageDataBySearchingAllPathsForKey:key];
+                if (data) {
+                    // No variants yet: the original data is read here, decoded once and scaled into all the variants on
+                    // the decode pool, which holds the memory of the decode in its budget
+                    //还没有生成变体：在此读取原始数据，在解码池中解码一次并生成所有变体
+                    NSUInteger cost = [SDWebImageDecodePool estimatedDecodedSizeForData:data context:context];
+                    [[SDWebImageDecodePool sharedPool] addDecodeBlock:^{
+                        if (operation.isCancelled) {
+                            return;
+                        }
+                        UIImage *variant = nil;
+                        @autoreleasepool {
+                            UIImage *decodedImage = [self decodedDiskImageWithData:data key:key context:context];
+                            variant = [self storeImageVariantsFromImage:decodedImage imageData:nil sourceFormat:[NSData sd_imageFormatForImageData:data] forKey:key context:context toDisk:YES];
+                        }
+                        dispatch_async(dispatch_get_main_queue(), ^{
+                            doneBlock(variant, SDImageCacheTypeDisk);
+                        });
+                    } cost:cost priority:NSOperationQueuePriorityNormal];
+                    return;
+                }
+            }
+            else {
+                //检查磁盘中是否有key对应的图片
+                diskImage = [self diskImageForKey:key context:context];
+                if (diskImage) {
+                    NSUInteger cost = SDCacheCostForImage(diskImage);
+                    [self.memCache setObject:diskImage forKey:memoryKey cost:cost];
+                }
             }
 
             dispatch_async(dispatch_get_main_queue(), ^{
@@ -484,10 +895,28 @@ FOUNDATION_STATIC_INLINE NSUInteger SDCacheCostForImage(UIImage *image) {
     }
     
     [self.memCache removeObjectForKey:key];
+    //同时删除该key的所有变体
+    NSDictionary *variantIndexes;
+    @synchronized (self.variantIndexes) {
+        variantIndexes = [self.variantIndexes objectForKey:key];
+        [self.variantIndexes removeObjectForKey:key];
+    }
+    for (NSArray *variantSizes in variantIndexes.allValues) {
+        for (NSString *sizeString in variantSizes) {
+            [self.memCache removeObjectForKey:[self variantKeyForKey:key pixelSize:CGSizeFromString(sizeString)]];
+        }
+    }
     
     if (fromDisk) {
         dispatch_async(self.ioQueue, ^{
             [_fileManager removeItemAtPath:[self defaultCachePathForKey:key] error:nil];
+            NSString *variantIndexPath = [self variantIndexPathForKey:key];
+            for (NSArray *variantSizes in [NSDictionary dictionaryWithContentsOfFile:variantIndexPath].allValues) {
+                for (NSString *sizeString in variantSizes) {
+                    [_fileManager removeItemAtPath:[self defaultCachePathForKey:[self variantKeyForKey:key pixelSize:CGSizeFromString(sizeString)]] error:nil];
+                }
+            }
+            [_fileManager removeItemAtPath:variantIndexPath error:nil];
             
             if (completion) {
                 dispatch_async(dispatch_get_main_queue(), ^{
@@ -547,6 +976,8 @@ FOUNDATION_STATIC_INLINE NSUInteger SDCacheCostForImage(UIImage *image) {
 // 清理过期的缓存图片
 - (void)cleanDiskWithCompletionBlock:(SDWebImageNoParamsBlock)completionBlock {
     dispatch_async(self.ioQueue, ^{
+        [self cleanExpiredPartialData];
+
         NSURL *diskCacheURL = [NSURL fileURLWithPath:self.diskCachePath isDirectory:YES];
         NSArray *resourceKeys = @[NSURLIsDirectoryKey, NSURLContentModificationDateKey, NSURLTotalFileAllocatedSizeKey];
 
@@ -570,6 +1001,10 @@ FOUNDATION_STATIC_INLINE NSUInteger SDCacheCostForImage(UIImage *image) {
 
             // Skip directories.是文件夹则跳过
             if ([resourceValues[NSURLIsDirectoryKey] boolValue]) {
+                // Partial data has its own expiration, handled above
+                if ([fileURL.lastPathComponent isEqualToString:kPartialDataDirectoryName]) {
+                    [fileEnumerator skipDescendants];
+                }
                 continue;
             }
 
@@ -0,0 +1,66 @@
+/*
+ * This file is part of the SDWebImage package.
+ * (c) Olivier Poitrey <rs@dailymotion.com>
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#import <Foundation/Foundation.h>
+#import "SDWebImageCompat.h"
+
+/**
+ * A large still image decoded in horizontal strips into a temporary file, mapped read only, instead of a full size
+ * bitmap in memory. As a UIImage it is a preview downsampled from the same strips, so a plain UIImageView shows the
+ * preview and the memory cache only pays for it. A tiling view (e.g. backed by a CATiledLayer) draws the tiles it
+ * needs with `tileImageInPixelRect:`: the tiles share the mapped pixels without copying them, and the system pages
+ * them in and out like any clean file pages.
+ *
+ * Loads with `SDWebImageContextTiledImage` produce this class for still images larger than their preview.
+ 大图：按水平条带解码到映射的临时文件，本身作为UIImage是缩小的预览图；分块显示的视图按需读取原尺寸的分块
+ */
+@interface SDTiledImage : UIImage
+
+/**
+ * Creates a tiled image from data ImageIO decodes, with a preview at the thumbnail size of the context, or fitting
+ * 2048 pixels without one. Returns nil for animated images, and for images not larger than their preview.
+ *
+ * @param data    The encoded image data
+ * @param scale   The scale of the image
+ * @param context The context of the load, see `SDWebImageContextThumbnailPixelSize`
+ 动画图片、不大于预览尺寸的图片返回nil
+ */
+- (instancetype)initWithData:(NSData *)data scale:(CGFloat)scale context:(NSDictionary *)context;
+
+/**
+ * Creates a tiled image from a still image, decoding it in strips (see `SDDecodeImageInStrips`).
+ * Returns nil if the image could not be decoded or the temporary file could not be written.
+ *
+ * @param image            The image, created by ImageIO without `kCGImageSourceShouldCache` for the memory to stay bounded
+ * @param previewPixelSize The size in pixels the preview fits in, in the orientation the image is displayed
+ */
+- (instancetype)initWithImage:(UIImage *)image previewPixelSize:(CGSize)previewPixelSize;
+
+/**
+ * The same tiled image at another scale, sharing the mapped bitmap.
+ */
+- (instancetype)tiledImageWithScale:(CGFloat)scale;
+
+/**
+ * The size in pixels of the full resolution image, in the orientation it is displayed.
+ 原图的像素尺寸（显示方向）
+ */
+@property (assign, readonly, nonatomic) CGSize tiledPixelSize;
+
+/**
+ * A tile of the full resolution image, without copying its pixels. Thread safe, a CATiledLayer draws its tiles on
+ * background threads.
+ *
+ * @param pixelRect A rectangle of `tiledPixelSize`, in the orientation the image is displayed
+ *
+ * @return The tile, at the scale and in the orientation of the image, nil if the rectangle is outside the image
+ 原图中指定区域的分块（不拷贝像素，线程安全）
+ */
+- (UIImage *)tileImageInPixelRect:(CGRect)pixelRect;
+
+@end
@@ -0,0 +1,227 @@
+/*
+ * This file is part of the SDWebImage package.
+ * (c) Olivier Poitrey <rs@dailymotion.com>
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#import "SDTiledImage.h"
+#import "SDWebImageDecoder.h"
+#import "SDWebImageBitmapPool.h"
+#import "UIImage+MultiFormat.h"
+#import <ImageIO/ImageIO.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// The length in pixels of the longest side of the preview when the context has no thumbnail size
+static const CGFloat kSDTiledImageDefaultPreviewLength = 2048;
+
+static BOOL SDImageOrientationIsRotated(UIImageOrientation orientation) {
+    return orientation == UIImageOrientationLeft || orientation == UIImageOrientationLeftMirrored ||
+           orientation == UIImageOrientationRight || orientation == UIImageOrientationRightMirrored;
+}
+
+// Maps the pixels of the displayed image to the pixels of a bitmap of width x height stored in the given orientation
+//显示方向的像素坐标转换为位图（存储方向）的像素坐标
+static CGAffineTransform SDDisplayToBitmapTransform(UIImageOrientation orientation, CGFloat width, CGFloat height) {
+    switch (orientation) {
+        case UIImageOrientationUpMirrored:
+            return CGAffineTransformMake(-1, 0, 0, 1, width, 0);
+        case UIImageOrientationDown:
+            return CGAffineTransformMake(-1, 0, 0, -1, width, height);
+        case UIImageOrientationDownMirrored:
+            return CGAffineTransformMake(1, 0, 0, -1, 0, height);
+        case UIImageOrientationLeftMirrored:
+            return CGAffineTransformMake(0, 1, 1, 0, 0, 0);
+        case UIImageOrientationRight:
+            return CGAffineTransformMake(0, -1, 1, 0, 0, height);
+        case UIImageOrientationRightMirrored:
+            return CGAffineTransformMake(0, -1, -1, 0, width, height);
+        case UIImageOrientationLeft:
+            return CGAffineTransformMake(0, 1, -1, 0, width, 0);
+        default:
+            return CGAffineTransformIdentity;
+    }
+}
+
+static BOOL SDWriteAll(int fd, const uint8_t *bytes, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, bytes, length);
+        if (written < 0) {
+            return NO;
+        }
+        bytes += written;
+        length -= (size_t)written;
+    }
+    return YES;
+}
+
+// The tiles keep the mapped data alive
+static void SDTiledImageReleaseData(void *info, const void *data, size_t size) {
+    CFRelease(info);
+}
+
+@implementation SDTiledImage {
+    // The full resolution bitmap, premultiplied BGRA rows of _bitmapWidth * 4 bytes in the stored orientation
+    NSData *_bitmapData;
+    size_t _bitmapWidth;
+    size_t _bitmapHeight;
+}
+
+- (instancetype)initWithData:(NSData *)data scale:(CGFloat)scale context:(NSDictionary *)context {
+    if (!data || [NSData sd_imageHeaderForImageData:data].frameCount > 1) {
+        return nil;
+    }
+    CGImageSourceRef source = CGImageSourceCreateWithData((__bridge CFDataRef)data, NULL);
+    if (!source) {
+        return nil;
+    }
+    if (CGImageSourceGetCount(source) != 1) {
+        CFRelease(source);
+        return nil;
+    }
+    NSDictionary *properties = CFBridgingRelease(CGImageSourceCopyPropertiesAtIndex(source, 0, NULL));
+    int exifOrientation = [properties[(__bridge NSString *)kCGImagePropertyOrientation] intValue] ?: 1;
+    CGFloat pixelWidth = [properties[(__bridge NSString *)kCGImagePropertyPixelWidth] doubleValue];
+    CGFloat pixelHeight = [properties[(__bridge NSString *)kCGImagePropertyPixelHeight] doubleValue];
+    CGSize imagePixelSize = exifOrientation >= 5 ? CGSizeMake(pixelHeight, pixelWidth) : CGSizeMake(pixelWidth, pixelHeight);
+    CGSize previewPixelSize = SDThumbnailPixelSizeForContext(imagePixelSize, context);
+    if (previewPixelSize.width <= 0) {
+        CGFloat length = MAX(imagePixelSize.width, imagePixelSize.height);
+        if (context[SDWebImageContextThumbnailPixelSize] || context[SDWebImageContextVariantPixelLengths] || length <= kSDTiledImageDefaultPreviewLength) {
+            // Not larger than its preview, a plain decode does
+            CFRelease(source);
+            return nil;
+        }
+        CGFloat ratio = kSDTiledImageDefaultPreviewLength / length;
+        previewPixelSize = CGSizeMake(MAX(1, ceil(imagePixelSize.width * ratio)), MAX(1, ceil(imagePixelSize.height * ratio)));
+    }
+    // ImageIO does not keep the full bitmap, only one strip is decoded at a time
+    //ImageIO不缓存原尺寸的位图，每次只解码一个条带
+    NSDictionary *options = @{(__bridge NSString *)kCGImageSourceShouldCache : @NO};
+    CGImageRef imageRef = CGImageSourceCreateImageAtIndex(source, 0, (__bridge CFDictionaryRef)options);
+    CFRelease(source);
+    if (!imageRef) {
+        return nil;
+    }
+    UIImage *image = [UIImage imageWithCGImage:imageRef scale:scale orientation:[UIImage sd_exifOrientationToiOSOrientation:exifOrientation]];
+    CGImageRelease(imageRef);
+    return [self initWithImage:image previewPixelSize:previewPixelSize];
+}
+
+- (instancetype)initWithImage:(UIImage *)image previewPixelSize:(CGSize)previewPixelSize {
+    CGImageRef imageRef = image.CGImage;
+    if (!imageRef || SDImageIsAnimated(image) || previewPixelSize.width <= 0 || previewPixelSize.height <= 0) {
+        return nil;
+    }
+    size_t width = CGImageGetWidth(imageRef);
+    size_t height = CGImageGetHeight(imageRef);
+    UIImageOrientation orientation = image.imageOrientation;
+    // The preview is stored in the orientation of the bitmap, like the image
+    BOOL rotated = SDImageOrientationIsRotated(orientation);
+    CGFloat ratio = MIN(1, MIN(previewPixelSize.width / (rotated ? height : width), previewPixelSize.height / (rotated ? width : height)));
+    size_t previewWidth = MAX((size_t)1, (size_t)round(width * ratio));
+    size_t previewHeight = MAX((size_t)1, (size_t)round(height * ratio));
+
+    // The file is removed once mapped, the mapping keeps its pages until the image is released
+    //文件映射后立即删除，映射在图片释放前一直有效
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:[NSString stringWithFormat:@"SDTiledImage-%@", [NSUUID UUID].UUIDString]];
+    int fd = open(path.fileSystemRepresentation, O_WRONLY | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        return nil;
+    }
+    size_t rowLength = width * 4;
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+    CGBitmapInfo bitmapInfo = kCGBitmapByteOrder32Host | kCGImageAlphaPremultipliedFirst;
+    // One pass: each strip is written to the file at full resolution and drawn scaled into the preview
+    //一次解码：每个条带以原尺寸写入文件，同时缩小绘制到预览图
+    CGImageRef previewRef = [[SDWebImageBitmapPool sharedPool] newImageWithWidth:previewWidth height:previewHeight bitsPerComponent:8 bitmapInfo:bitmapInfo colorSpace:colorSpace filling:^BOOL(void *data, size_t bytesPerRow) {
+        CGContextRef context = CGBitmapContextCreate(data, previewWidth, previewHeight, 8, bytesPerRow, colorSpace, bitmapInfo);
+        if (!context) {
+            return NO;
+        }
+        BOOL decoded = SDDecodeImageInStrips(imageRef, SDDefaultStripByteCount, context, ^BOOL(const uint8_t *pixels, size_t stripBytesPerRow, NSRange rows) {
+            if (stripBytesPerRow == rowLength) {
+                return SDWriteAll(fd, pixels, rowLength * rows.length);
+            }
+            // Without the padding of the strip rows
+            for (NSUInteger y = 0; y < rows.length; y++) {
+                if (!SDWriteAll(fd, pixels + y * stripBytesPerRow, rowLength)) {
+                    return NO;
+                }
+            }
+            return YES;
+        });
+        CGContextRelease(context);
+        return decoded;
+    }];
+    CGColorSpaceRelease(colorSpace);
+    close(fd);
+    NSData *bitmapData = previewRef ? [NSData dataWithContentsOfFile:path options:NSDataReadingMappedAlways error:nil] : nil;
+    unlink(path.fileSystemRepresentation);
+    if (bitmapData.length != rowLength * height || !(self = [super initWithCGImage:previewRef scale:image.scale orientation:orientation])) {
+        CGImageRelease(previewRef);
+        return nil;
+    }
+    CGImageRelease(previewRef);
+    _bitmapData = bitmapData;
+    _bitmapWidth = width;
+    _bitmapHeight = height;
+    return self;
+}
+
+- (instancetype)tiledImageWithScale:(CGFloat)scale {
+    if (scale == self.scale || !_bitmapData) {
+        return self;
+    }
+    SDTiledImage *image = [[SDTiledImage alloc] initWithCGImage:self.CGImage scale:scale orientation:self.imageOrientation];
+    image->_bitmapData = _bitmapData;
+    image->_bitmapWidth = _bitmapWidth;
+    image->_bitmapHeight = _bitmapHeight;
+    return image;
+}
+
+- (CGSize)tiledPixelSize {
+    if (SDImageOrientationIsRotated(self.imageOrientation)) {
+        return CGSizeMake(_bitmapHeight, _bitmapWidth);
+    }
+    return CGSizeMake(_bitmapWidth, _bitmapHeight);
+}
+
+- (UIImage *)tileImageInPixelRect:(CGRect)pixelRect {
+    if (!_bitmapData) {
+        return nil;
+    }
+    CGSize tiledPixelSize = self.tiledPixelSize;
+    CGRect rect = CGRectIntegral(CGRectIntersection(pixelRect, (CGRect){CGPointZero, tiledPixelSize}));
+    if (CGRectIsEmpty(rect)) {
+        return nil;
+    }
+    CGRect bitmapRect = CGRectIntegral(CGRectApplyAffineTransform(rect, SDDisplayToBitmapTransform(self.imageOrientation, _bitmapWidth, _bitmapHeight)));
+    size_t x = (size_t)CGRectGetMinX(bitmapRect);
+    size_t y = (size_t)CGRectGetMinY(bitmapRect);
+    size_t width = MIN((size_t)CGRectGetWidth(bitmapRect), _bitmapWidth - x);
+    size_t height = MIN((size_t)CGRectGetHeight(bitmapRect), _bitmapHeight - y);
+    // The tile reads the rows of the mapped bitmap in place, only the pages it covers are read from the file
+    //分块直接引用映射的位图，只有它覆盖的页会从文件读入
+    size_t bytesPerRow = _bitmapWidth * 4;
+    const uint8_t *bytes = (const uint8_t *)_bitmapData.bytes + y * bytesPerRow + x * 4;
+    CGDataProviderRef provider = CGDataProviderCreateWithData((__bridge_retained void *)_bitmapData, bytes, (height - 1) * bytesPerRow + width * 4, SDTiledImageReleaseData);
+    if (!provider) {
+        CFRelease((__bridge CFTypeRef)_bitmapData);
+        return nil;
+    }
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+    CGImageRef tileRef = CGImageCreate(width, height, 8, 32, bytesPerRow, colorSpace, kCGBitmapByteOrder32Host | kCGImageAlphaPremultipliedFirst, provider, NULL, false, kCGRenderingIntentDefault);
+    CGColorSpaceRelease(colorSpace);
+    CGDataProviderRelease(provider);
+    if (!tileRef) {
+        return nil;
+    }
+    UIImage *tile = [UIImage imageWithCGImage:tileRef scale:self.scale orientation:self.imageOrientation];
+    CGImageRelease(tileRef);
+    return tile;
+}
+
+@end
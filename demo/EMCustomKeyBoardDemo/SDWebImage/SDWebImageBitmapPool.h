@@ -0,0 +1,135 @@
+/*
+ * This file is part of the SDWebImage package.
+ * (c) Olivier Poitrey <rs@dailymotion.com>
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#import <Foundation/Foundation.h>
+#import "SDWebImageCompat.h"
+
+/**
+ * SDWebImageBitmapPool recycles the pixel buffers of decoded images. Buffers are page aligned and grouped in size
+ * classes; a CGImage created by the pool draws directly into a buffer and hands the buffer back to the pool when it
+ * is released, instead of allocating, zero filling and copying a new bitmap for every decode.
+ *
+ * Only the idle buffers count towards `maxPooledBytes`, the buffers of living images belong to them. The idle buffers
+ * are freed on memory warnings.
+ 位图缓冲池：解码时复用按页对齐、按大小分级的像素缓冲区，图片释放时缓冲区回到池中
+ */
+@interface SDWebImageBitmapPool : NSObject
+
+/**
+ * The maximum number of bytes of idle buffers kept for reuse. Defaults to 1/64 of the physical memory, at most 32MB.
+ 池中空闲缓冲区的总大小上限
+ */
+@property (assign, nonatomic) NSUInteger maxPooledBytes;
+
+/**
+ * The number of bytes of idle buffers in the pool.
+ */
+@property (readonly, nonatomic) NSUInteger pooledBytes;
+
+/**
+ * The number of bytes of buffers in use by images created by the pool.
+ */
+@property (readonly, nonatomic) NSUInteger outstandingBytes;
+
+/**
+ * The number of buffers reused from the pool, and allocated because none of their size class was idle.
+ 复用次数与新分配次数，用于统计命中率
+ */
+@property (readonly, nonatomic) NSUInteger hitCount;
+@property (readonly, nonatomic) NSUInteger missCount;
+
+/**
+ * Returns the global bitmap pool
+ */
++ (SDWebImageBitmapPool *)sharedPool;
+
+/**
+ * Creates an image drawn into a pooled buffer. The content of the buffer is undefined when the drawing block is called:
+ * draw with kCGBlendModeCopy or clear it first.
+ *
+ * @param width            The width of the image in pixels
+ * @param height           The height of the image in pixels
+ * @param bitsPerComponent The bits per component, the pixels have 4 components
+ * @param bitmapInfo       The bitmap info, as for CGBitmapContextCreate
+ * @param colorSpace       The color space, device RGB if NULL
+ * @param drawBlock        Draws the image into the bitmap context
+ *
+ * @return A new CGImage the caller must release, NULL if the bitmap context could not be created
+ 在池中的缓冲区上绘制并生成CGImage（调用方负责释放）
+ */
+- (CGImageRef)newImageWithWidth:(size_t)width
+                         height:(size_t)height
+               bitsPerComponent:(size_t)bitsPerComponent
+                     bitmapInfo:(CGBitmapInfo)bitmapInfo
+                     colorSpace:(CGColorSpaceRef)colorSpace
+                        drawing:(void (^)(CGContextRef context))drawBlock CF_RETURNS_RETAINED;
+
+/**
+ * Same as `newImageWithWidth:height:bitsPerComponent:bitmapInfo:colorSpace:drawing:`, for pixels of any size, e.g.
+ * 16 bit RGB with 5 bits per component or 8 bit gray.
+ *
+ * @param bitsPerPixel The bits per pixel, including the unused bits
+ 任意像素大小的位图（如16位RGB、8位灰度）
+ */
+- (CGImageRef)newImageWithWidth:(size_t)width
+                         height:(size_t)height
+               bitsPerComponent:(size_t)bitsPerComponent
+                   bitsPerPixel:(size_t)bitsPerPixel
+                     bitmapInfo:(CGBitmapInfo)bitmapInfo
+                     colorSpace:(CGColorSpaceRef)colorSpace
+                        drawing:(void (^)(CGContextRef context))drawBlock CF_RETURNS_RETAINED;
+
+/**
+ * Creates an image from pixels written directly into a pooled buffer, by a decoder or a pixel conversion, without a
+ * bitmap context. The content of the buffer is undefined when the filling block is called.
+ *
+ * @param width            The width of the image in pixels
+ * @param height           The height of the image in pixels
+ * @param bitsPerComponent The bits per component, the pixels have 4 components
+ * @param bitmapInfo       The bitmap info of the pixels
+ * @param colorSpace       The color space, device RGB if NULL
+ * @param fillBlock        Writes the rows of pixels, `bytesPerRow` apart, returns NO if it failed
+ *
+ * @return A new CGImage the caller must release, NULL if the filling block failed
+ 直接向池中的缓冲区写入像素（解码器或像素格式转换）并生成CGImage（调用方负责释放）
+ */
+- (CGImageRef)newImageWithWidth:(size_t)width
+                         height:(size_t)height
+               bitsPerComponent:(size_t)bitsPerComponent
+                     bitmapInfo:(CGBitmapInfo)bitmapInfo
+                     colorSpace:(CGColorSpaceRef)colorSpace
+                        filling:(BOOL (^)(void *data, size_t bytesPerRow))fillBlock CF_RETURNS_RETAINED;
+
+/**
+ * Creates an image from a copy of 8 bit per component pixels, e.g. the canvas of an animation decoder that the next
+ * frame overwrites, in device RGB.
+ *
+ * @param pixels      The first row of pixels
+ * @param bytesPerRow The distance between the rows of `pixels`
+ 拷贝像素（如动画解码器的画布）到池中的缓冲区并生成CGImage（调用方负责释放）
+ */
+- (CGImageRef)newImageWithWidth:(size_t)width
+                         height:(size_t)height
+                     bitmapInfo:(CGBitmapInfo)bitmapInfo
+                  copyingPixels:(const void *)pixels
+                    bytesPerRow:(size_t)bytesPerRow CF_RETURNS_RETAINED;
+
+/**
+ * Free all the idle buffers.
+ 释放所有空闲缓冲区
+ */
+- (void)drain;
+
+@end
+
+/**
+ * Returns the length of the pooled buffer holding a bitmap of the given length: the size class it is rounded up to,
+ * less than an eighth above it. The memory cache charges images this length.
+ 位图实际占用的缓冲区大小（按大小分级取整后）
+ */
+extern size_t SDBitmapPoolBufferLength(size_t length);
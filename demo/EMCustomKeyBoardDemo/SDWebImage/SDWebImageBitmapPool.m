@@ -0,0 +1,294 @@
+/*
+ * This file is part of the SDWebImage package.
+ * (c) Olivier Poitrey <rs@dailymotion.com>
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#import "SDWebImageBitmapPool.h"
+#import <mach/mach.h>
+
+// Core Animation can use rows aligned on 64 bytes without copying them
+static const size_t kBytesPerRowAlignment = 64;
+
+// Rounds a length up to a size class: whole pages up to 16 pages, then eight classes per power of two (8 to 15 times
+// 2^n pages), so that a buffer wastes less than an eighth of its size
+//16页以内按整页取整，之后每个2的幂区间分8级，浪费不超过八分之一
+size_t SDBitmapPoolBufferLength(size_t length) {
+    size_t pageSize = vm_page_size;
+    size_t pages = MAX((size_t)1, (length + pageSize - 1) / pageSize);
+    size_t powerOfTwo = 1;
+    while (powerOfTwo <= pages / 2) {
+        powerOfTwo <<= 1;
+    }
+    size_t step = MAX((size_t)1, powerOfTwo / 8);
+    return (pages + step - 1) / step * step * pageSize;
+}
+
+@interface SDWebImageBitmapPool ()
+
+- (void)recycleBuffer:(void *)buffer length:(size_t)length;
+
+- (CGImageRef)newImageWithWidth:(size_t)width
+                         height:(size_t)height
+               bitsPerComponent:(size_t)bitsPerComponent
+                   bitsPerPixel:(size_t)bitsPerPixel
+                     bitmapInfo:(CGBitmapInfo)bitmapInfo
+                     colorSpace:(CGColorSpaceRef)colorSpace
+                        filling:(BOOL (^)(void *data, size_t bytesPerRow))fillBlock CF_RETURNS_RETAINED;
+
+@end
+
+// Called by Core Graphics when the last reference to the image data is released, on any thread
+static void SDBitmapPoolReleaseData(void *info, const void *data, size_t size) {
+    SDWebImageBitmapPool *pool = (__bridge_transfer SDWebImageBitmapPool *)info;
+    [pool recycleBuffer:(void *)data length:size];
+}
+
+@implementation SDWebImageBitmapPool {
+    NSMutableDictionary *_idleBuffers; // size class (NSNumber) -> NSMutableArray of NSValue (pointer)
+}
+
++ (SDWebImageBitmapPool *)sharedPool {
+    static dispatch_once_t once;
+    static id instance;
+    dispatch_once(&once, ^{
+        instance = [self new];
+    });
+    return instance;
+}
+
+- (id)init {
+    if ((self = [super init])) {
+        _idleBuffers = [NSMutableDictionary new];
+        _maxPooledBytes = (NSUInteger)MIN([NSProcessInfo processInfo].physicalMemory / 64, 32ull * 1024 * 1024);
+
+#if TARGET_OS_IPHONE
+        [[NSNotificationCenter defaultCenter] addObserver:self
+                                                 selector:@selector(drain)
+                                                     name:UIApplicationDidReceiveMemoryWarningNotification
+                                                   object:nil];
+#endif
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+    [self drain];
+}
+
+- (void)setMaxPooledBytes:(NSUInteger)maxPooledBytes {
+    @synchronized (self) {
+        _maxPooledBytes = maxPooledBytes;
+    }
+    [self trimToLimit];
+}
+
+- (NSUInteger)pooledBytes {
+    @synchronized (self) {
+        return _pooledBytes;
+    }
+}
+
+- (NSUInteger)outstandingBytes {
+    @synchronized (self) {
+        return _outstandingBytes;
+    }
+}
+
+- (NSUInteger)hitCount {
+    @synchronized (self) {
+        return _hitCount;
+    }
+}
+
+- (NSUInteger)missCount {
+    @synchronized (self) {
+        return _missCount;
+    }
+}
+
+- (void *)bufferWithLength:(size_t)length {
+    NSNumber *sizeClass = @(length);
+    @synchronized (self) {
+        NSMutableArray *buffers = _idleBuffers[sizeClass];
+        NSValue *bufferValue = buffers.lastObject;
+        if (bufferValue) {
+            [buffers removeLastObject];
+            _pooledBytes -= length;
+            _outstandingBytes += length;
+            _hitCount++;
+            return bufferValue.pointerValue;
+        }
+        _missCount++;
+    }
+    void *buffer = NULL;
+    if (posix_memalign(&buffer, vm_page_size, length) != 0) {
+        return NULL;
+    }
+    @synchronized (self) {
+        _outstandingBytes += length;
+    }
+    return buffer;
+}
+
+- (void)recycleBuffer:(void *)buffer length:(size_t)length {
+    if (!buffer) {
+        return;
+    }
+    BOOL keep = NO;
+    @synchronized (self) {
+        _outstandingBytes -= length;
+        if (_pooledBytes + length <= _maxPooledBytes) {
+            NSNumber *sizeClass = @(length);
+            NSMutableArray *buffers = _idleBuffers[sizeClass];
+            if (!buffers) {
+                buffers = [NSMutableArray new];
+                _idleBuffers[sizeClass] = buffers;
+            }
+            [buffers addObject:[NSValue valueWithPointer:buffer]];
+            _pooledBytes += length;
+            keep = YES;
+        }
+    }
+    if (!keep) {
+        free(buffer);
+    }
+}
+
+- (CGImageRef)newImageWithWidth:(size_t)width
+                         height:(size_t)height
+               bitsPerComponent:(size_t)bitsPerComponent
+                     bitmapInfo:(CGBitmapInfo)bitmapInfo
+                     colorSpace:(CGColorSpaceRef)colorSpace
+                        drawing:(void (^)(CGContextRef context))drawBlock {
+    return [self newImageWithWidth:width height:height bitsPerComponent:bitsPerComponent bitsPerPixel:bitsPerComponent * 4 bitmapInfo:bitmapInfo colorSpace:colorSpace drawing:drawBlock];
+}
+
+- (CGImageRef)newImageWithWidth:(size_t)width
+                         height:(size_t)height
+               bitsPerComponent:(size_t)bitsPerComponent
+                   bitsPerPixel:(size_t)bitsPerPixel
+                     bitmapInfo:(CGBitmapInfo)bitmapInfo
+                     colorSpace:(CGColorSpaceRef)colorSpace
+                        drawing:(void (^)(CGContextRef context))drawBlock {
+    CGColorSpaceRef deviceColorSpace = colorSpace ? NULL : CGColorSpaceCreateDeviceRGB();
+    CGColorSpaceRef contextColorSpace = colorSpace ?: deviceColorSpace;
+    CGImageRef imageRef = [self newImageWithWidth:width height:height bitsPerComponent:bitsPerComponent bitsPerPixel:bitsPerPixel bitmapInfo:bitmapInfo colorSpace:contextColorSpace filling:^BOOL(void *data, size_t bytesPerRow) {
+        CGContextRef context = CGBitmapContextCreate(data, width, height, bitsPerComponent, bytesPerRow, contextColorSpace, bitmapInfo);
+        if (!context) {
+            return NO;
+        }
+        if (drawBlock) {
+            drawBlock(context);
+        }
+        CGContextRelease(context);
+        return YES;
+    }];
+    if (deviceColorSpace) {
+        CGColorSpaceRelease(deviceColorSpace);
+    }
+    return imageRef;
+}
+
+- (CGImageRef)newImageWithWidth:(size_t)width
+                         height:(size_t)height
+               bitsPerComponent:(size_t)bitsPerComponent
+                     bitmapInfo:(CGBitmapInfo)bitmapInfo
+                     colorSpace:(CGColorSpaceRef)colorSpace
+                        filling:(BOOL (^)(void *data, size_t bytesPerRow))fillBlock {
+    return [self newImageWithWidth:width height:height bitsPerComponent:bitsPerComponent bitsPerPixel:bitsPerComponent * 4 bitmapInfo:bitmapInfo colorSpace:colorSpace filling:fillBlock];
+}
+
+- (CGImageRef)newImageWithWidth:(size_t)width
+                         height:(size_t)height
+               bitsPerComponent:(size_t)bitsPerComponent
+                   bitsPerPixel:(size_t)bitsPerPixel
+                     bitmapInfo:(CGBitmapInfo)bitmapInfo
+                     colorSpace:(CGColorSpaceRef)colorSpace
+                        filling:(BOOL (^)(void *data, size_t bytesPerRow))fillBlock {
+    if (width == 0 || height == 0 || bitsPerComponent == 0 || bitsPerPixel == 0 || !fillBlock) {
+        return NULL;
+    }
+    size_t bytesPerRow = (width * bitsPerPixel / 8 + kBytesPerRowAlignment - 1) / kBytesPerRowAlignment * kBytesPerRowAlignment;
+    size_t length = SDBitmapPoolBufferLength(bytesPerRow * height);
+    void *buffer = [self bufferWithLength:length];
+    if (!buffer) {
+        return NULL;
+    }
+
+    CGColorSpaceRef deviceColorSpace = colorSpace ? NULL : CGColorSpaceCreateDeviceRGB();
+    CGColorSpaceRef imageColorSpace = colorSpace ?: deviceColorSpace;
+    CGImageRef imageRef = NULL;
+    if (fillBlock(buffer, bytesPerRow)) {
+        // The image uses the buffer without copying it, and gives it back to the pool when it is released
+        //图片直接使用该缓冲区（不拷贝），图片释放时缓冲区回到池中
+        CGDataProviderRef provider = CGDataProviderCreateWithData((__bridge_retained void *)self, buffer, length, SDBitmapPoolReleaseData);
+        if (provider) {
+            imageRef = CGImageCreate(width, height, bitsPerComponent, bitsPerPixel, bytesPerRow, imageColorSpace, bitmapInfo, provider, NULL, false, kCGRenderingIntentDefault);
+            CGDataProviderRelease(provider);
+        }
+        else {
+            CFRelease((__bridge CFTypeRef)self);
+            [self recycleBuffer:buffer length:length];
+        }
+    }
+    else {
+        [self recycleBuffer:buffer length:length];
+    }
+    if (deviceColorSpace) {
+        CGColorSpaceRelease(deviceColorSpace);
+    }
+    return imageRef;
+}
+
+- (CGImageRef)newImageWithWidth:(size_t)width
+                         height:(size_t)height
+                     bitmapInfo:(CGBitmapInfo)bitmapInfo
+                  copyingPixels:(const void *)pixels
+                    bytesPerRow:(size_t)sourceBytesPerRow {
+    if (!pixels) {
+        return NULL;
+    }
+    return [self newImageWithWidth:width height:height bitsPerComponent:8 bitmapInfo:bitmapInfo colorSpace:NULL filling:^BOOL(void *data, size_t bytesPerRow) {
+        for (size_t y = 0; y < height; y++) {
+            memcpy((uint8_t *)data + y * bytesPerRow, (const uint8_t *)pixels + y * sourceBytesPerRow, width * 4);
+        }
+        return YES;
+    }];
+}
+
+- (void)drain {
+    NSArray *buffers = nil;
+    @synchronized (self) {
+        buffers = [[_idleBuffers allValues] valueForKeyPath:@"@unionOfArrays.self"];
+        [_idleBuffers removeAllObjects];
+        _pooledBytes = 0;
+    }
+    for (NSValue *bufferValue in buffers) {
+        free(bufferValue.pointerValue);
+    }
+}
+
+// Frees idle buffers, largest first, until they fit in maxPooledBytes
+- (void)trimToLimit {
+    NSMutableArray *buffersToFree = [NSMutableArray array];
+    @synchronized (self) {
+        NSArray *sizeClasses = [[_idleBuffers allKeys] sortedArrayUsingSelector:@selector(compare:)];
+        for (NSNumber *sizeClass in sizeClasses.reverseObjectEnumerator) {
+            NSMutableArray *buffers = _idleBuffers[sizeClass];
+            while (_pooledBytes > _maxPooledBytes && buffers.count > 0) {
+                [buffersToFree addObject:buffers.lastObject];
+                [buffers removeLastObject];
+                _pooledBytes -= sizeClass.unsignedIntegerValue;
+            }
+        }
+    }
+    for (NSValue *bufferValue in buffersToFree) {
+        free(bufferValue.pointerValue);
+    }
+}
+
+@end
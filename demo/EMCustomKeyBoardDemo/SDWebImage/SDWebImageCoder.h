@@ -0,0 +1,144 @@
+/*
+ * This file is part of the SDWebImage package.
+ * (c) Olivier Poitrey <rs@dailymotion.com>
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#import <Foundation/Foundation.h>
+#import "SDWebImageCompat.h"
+#import "NSData+ImageContentType.h"
+
+/**
+ * A coder decodes and encodes the images of some formats. The coders are registered in order in
+ * `SDWebImageCodersManager`, which the cache and the downloader (and so the prefetcher) use for every image:
+ * an app can add a faster or a new codec without changing them. Coders are called from several threads and must be
+ * thread safe.
+ 图片编解码器：按顺序注册到SDWebImageCodersManager中，缓存和下载器都通过它编解码图片；需要线程安全
+ */
+@protocol SDWebImageCoder <NSObject>
+
+/**
+ * Whether the coder decodes this data, from its first bytes. Called for every image, it should not parse the data.
+ 根据数据开头判断能否解码，不应解析整个数据
+ */
+- (BOOL)canDecodeFromData:(NSData *)data;
+
+/**
+ * Decode an image.
+ *
+ * @param data    The encoded image data
+ * @param context The context of the load: coders decode at the size of `SDWebImageContextThumbnailPixelSize` if they
+ *                can, and coders of animated formats return a `SDAnimatedImage` with `SDWebImageContextAnimatedImage`
+ *
+ * @return The image, nil if the data could not be decoded
+ */
+- (UIImage *)decodedImageWithData:(NSData *)data context:(NSDictionary *)context;
+
+/**
+ * Whether the coder encodes images to this format.
+ */
+- (BOOL)canEncodeToFormat:(SDImageFormat)format;
+
+/**
+ * Encode an image. Coders of animated formats encode all the frames of an animated image.
+ *
+ * @param image              The image to encode
+ * @param format             The format of the data
+ * @param compressionQuality From 0 to 1, for lossy formats
+ *
+ * @return The encoded data, nil if the image could not be encoded
+ */
+- (NSData *)encodedDataWithImage:(UIImage *)image format:(SDImageFormat)format compressionQuality:(CGFloat)compressionQuality;
+
+@end
+
+/**
+ * A coder showing images while they are downloaded, with `SDWebImageDownloaderProgressiveDownload`.
+ * The downloader creates a new instance of the class with `-init` for each download: an instance keeps the state of
+ * one incremental decode and is only called from one thread at a time.
+ 可以边下载边解码的编解码器：下载器为每次下载用-init创建一个新的实例，实例保存增量解码的状态
+ */
+@protocol SDWebImageProgressiveCoder <SDWebImageCoder>
+
+/**
+ * Whether the coder decodes this data incrementally, from its first bytes.
+ */
+- (BOOL)canIncrementallyDecodeFromData:(NSData *)data;
+
+/**
+ * Decode the data received so far.
+ *
+ * @param data     All the data received so far, the bytes already passed are unchanged
+ * @param finished Whether this is all the data
+ *
+ * @return The partial image, nil if there is nothing new to show
+ */
+- (UIImage *)incrementallyDecodedImageWithData:(NSData *)data finished:(BOOL)finished;
+
+@end
+
+/**
+ * The ordered registry of coders. An image is decoded by the first coder accepting its data, encoded by the first
+ * coder supporting the format. As a coder itself, the manager is used like any of them.
+ * By default: GIF, WebP (built with SD_WEBP), then ImageIO for all other data.
+ 编解码器的有序注册表：依次询问每个编解码器，由第一个支持的编解码器处理
+ */
+@interface SDWebImageCodersManager : NSObject <SDWebImageCoder>
+
++ (instancetype)sharedManager;
+
+/**
+ * The coders, in the order they are tried.
+ */
+@property (copy, nonatomic) NSArray *coders;
+
+/**
+ * Add a coder before the others, so that it takes precedence over the built-in coders.
+ 添加的编解码器排在最前面，优先于内置的编解码器
+ */
+- (void)addCoder:(id<SDWebImageCoder>)coder;
+
+- (void)removeCoder:(id<SDWebImageCoder>)coder;
+
+/**
+ * A new instance of the first progressive coder accepting the data, nil if none does.
+ */
+- (id<SDWebImageProgressiveCoder>)newProgressiveCoderForData:(NSData *)data;
+
+@end
+
+/**
+ * Decodes with ImageIO all the formats it supports, from the EXIF orientation and at the thumbnail size of the
+ * context. A progressive decode draws the rows received so far; it accepts any data and should be the last coder.
+ 用ImageIO解码所有它支持的格式，接受任何数据，应该放在最后
+ */
+@interface SDWebImageImageIOCoder : NSObject <SDWebImageProgressiveCoder>
+
++ (instancetype)sharedCoder;
+
+@end
+
+/**
+ * Decodes GIFs, see `sd_animatedGIFWithData:context:`. A progressive decode composites the frames with `SDGIFDecoder`
+ * and shows the last complete one. Encodes all the frames of an animated image.
+ GIF编解码器：边下载边用SDGIFDecoder合成帧，编码时写入动画的所有帧
+ */
+@interface SDWebImageGIFCoder : NSObject <SDWebImageProgressiveCoder>
+
++ (instancetype)sharedCoder;
+
+@end
+
+#ifdef SD_WEBP
+/**
+ * Decodes still WebPs with libwebp, see `sd_imageWithWebPData:context:`. Does not encode.
+ WebP解码器：只解码静态WebP，不支持编码
+ */
+@interface SDWebImageWebPCoder : NSObject <SDWebImageCoder>
+
++ (instancetype)sharedCoder;
+
+@end
+#endif
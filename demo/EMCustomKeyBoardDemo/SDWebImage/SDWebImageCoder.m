@@ -0,0 +1,436 @@
+/*
+ * This file is part of the SDWebImage package.
+ * (c) Olivier Poitrey <rs@dailymotion.com>
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#import "SDWebImageCoder.h"
+#import "SDWebImageBitmapPool.h"
+#import "SDAnimatedImage.h"
+#import "UIImage+MultiFormat.h"
+#import "UIImage+GIF.h"
+#import <ImageIO/ImageIO.h>
+
+#ifdef SD_WEBP
+#import "UIImage+WebP.h"
+#endif
+
+@implementation SDWebImageCodersManager {
+    NSArray *_coders;
+}
+
++ (instancetype)sharedManager {
+    static dispatch_once_t once;
+    static id instance;
+    dispatch_once(&once, ^{
+        instance = [self new];
+    });
+    return instance;
+}
+
+- (instancetype)init {
+    if ((self = [super init])) {
+        NSMutableArray *coders = [NSMutableArray arrayWithObject:[SDWebImageGIFCoder sharedCoder]];
+#ifdef SD_WEBP
+        [coders addObject:[SDWebImageWebPCoder sharedCoder]];
+#endif
+        [coders addObject:[SDWebImageImageIOCoder sharedCoder]];
+        _coders = [coders copy];
+    }
+    return self;
+}
+
+- (NSArray *)coders {
+    @synchronized (self) {
+        return _coders;
+    }
+}
+
+- (void)setCoders:(NSArray *)coders {
+    @synchronized (self) {
+        _coders = [coders copy];
+    }
+}
+
+- (void)addCoder:(id<SDWebImageCoder>)coder {
+    if (!coder) {
+        return;
+    }
+    @synchronized (self) {
+        _coders = [@[coder] arrayByAddingObjectsFromArray:_coders];
+    }
+}
+
+- (void)removeCoder:(id<SDWebImageCoder>)coder {
+    @synchronized (self) {
+        NSMutableArray *coders = [_coders mutableCopy];
+        [coders removeObjectIdenticalTo:coder];
+        _coders = [coders copy];
+    }
+}
+
+- (BOOL)canDecodeFromData:(NSData *)data {
+    for (id<SDWebImageCoder> coder in self.coders) {
+        if ([coder canDecodeFromData:data]) {
+            return YES;
+        }
+    }
+    return NO;
+}
+
+- (UIImage *)decodedImageWithData:(NSData *)data context:(NSDictionary *)context {
+    if (data.length == 0) {
+        return nil;
+    }
+    for (id<SDWebImageCoder> coder in self.coders) {
+        if ([coder canDecodeFromData:data]) {
+            return [coder decodedImageWithData:data context:context];
+        }
+    }
+    return nil;
+}
+
+- (BOOL)canEncodeToFormat:(SDImageFormat)format {
+    for (id<SDWebImageCoder> coder in self.coders) {
+        if ([coder canEncodeToFormat:format]) {
+            return YES;
+        }
+    }
+    return NO;
+}
+
+- (NSData *)encodedDataWithImage:(UIImage *)image format:(SDImageFormat)format compressionQuality:(CGFloat)compressionQuality {
+    if (!image) {
+        return nil;
+    }
+    for (id<SDWebImageCoder> coder in self.coders) {
+        if ([coder canEncodeToFormat:format]) {
+            return [coder encodedDataWithImage:image format:format compressionQuality:compressionQuality];
+        }
+    }
+    return nil;
+}
+
+- (id<SDWebImageProgressiveCoder>)newProgressiveCoderForData:(NSData *)data {
+    for (id<SDWebImageCoder> coder in self.coders) {
+        if ([coder conformsToProtocol:@protocol(SDWebImageProgressiveCoder)] && [(id<SDWebImageProgressiveCoder>)coder canIncrementallyDecodeFromData:data]) {
+            return [[coder class] new];
+        }
+        if ([coder canDecodeFromData:data]) {
+            // The coder decoding the complete image has no incremental decode
+            return nil;
+        }
+    }
+    return nil;
+}
+
+@end
+
+#pragma mark - ImageIO
+
+static CFStringRef SDImageIOTypeForFormat(SDImageFormat format) {
+    switch (format) {
+        case SDImageFormatJPEG:
+            return CFSTR("public.jpeg");
+        case SDImageFormatPNG:
+            return CFSTR("public.png");
+        case SDImageFormatTIFF:
+            return CFSTR("public.tiff");
+        case SDImageFormatHEIC:
+            return CFSTR("public.heic");
+        case SDImageFormatBMP:
+            return CFSTR("com.microsoft.bmp");
+        case SDImageFormatICO:
+            return CFSTR("com.microsoft.ico");
+        default:
+            return NULL;
+    }
+}
+
+static int SDEXIFOrientationForImageOrientation(UIImageOrientation orientation) {
+    switch (orientation) {
+        case UIImageOrientationUp:
+            return 1;
+        case UIImageOrientationUpMirrored:
+            return 2;
+        case UIImageOrientationDown:
+            return 3;
+        case UIImageOrientationDownMirrored:
+            return 4;
+        case UIImageOrientationLeftMirrored:
+            return 5;
+        case UIImageOrientationRight:
+            return 6;
+        case UIImageOrientationRightMirrored:
+            return 7;
+        case UIImageOrientationLeft:
+            return 8;
+    }
+    return 1;
+}
+
+@implementation SDWebImageImageIOCoder {
+    CGImageSourceRef _incrementalSource;
+    size_t _width, _height;
+    UIImageOrientation _orientation;
+}
+
++ (instancetype)sharedCoder {
+    static dispatch_once_t once;
+    static id instance;
+    dispatch_once(&once, ^{
+        instance = [self new];
+    });
+    return instance;
+}
+
+- (void)dealloc {
+    if (_incrementalSource) {
+        CFRelease(_incrementalSource);
+    }
+}
+
+- (BOOL)canDecodeFromData:(NSData *)data {
+    return data.length > 0;
+}
+
+- (UIImage *)decodedImageWithData:(NSData *)data context:(NSDictionary *)context {
+    return [UIImage sd_imageIOImageWithData:data context:context];
+}
+
+- (BOOL)canEncodeToFormat:(SDImageFormat)format {
+    static NSArray *destinationTypes;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        destinationTypes = CFBridgingRelease(CGImageDestinationCopyTypeIdentifiers());
+    });
+    CFStringRef type = SDImageIOTypeForFormat(format);
+    return type && [destinationTypes containsObject:(__bridge NSString *)type];
+}
+
+- (NSData *)encodedDataWithImage:(UIImage *)image format:(SDImageFormat)format compressionQuality:(CGFloat)compressionQuality {
+    if (format == SDImageFormatJPEG) {
+        return UIImageJPEGRepresentation(image, compressionQuality);
+    }
+    if (format == SDImageFormatPNG) {
+        return UIImagePNGRepresentation(image);
+    }
+    CFStringRef type = SDImageIOTypeForFormat(format);
+    if (!type || !image.CGImage) {
+        return nil;
+    }
+    NSMutableData *data = [NSMutableData data];
+    CGImageDestinationRef destination = CGImageDestinationCreateWithData((__bridge CFMutableDataRef)data, type, 1, NULL);
+    if (!destination) {
+        return nil;
+    }
+    NSDictionary *properties = @{(__bridge NSString *)kCGImageDestinationLossyCompressionQuality : @(compressionQuality),
+                                 (__bridge NSString *)kCGImagePropertyOrientation : @(SDEXIFOrientationForImageOrientation(image.imageOrientation))};
+    CGImageDestinationAddImage(destination, image.CGImage, (__bridge CFDictionaryRef)properties);
+    BOOL finalized = CGImageDestinationFinalize(destination);
+    CFRelease(destination);
+    return finalized ? data : nil;
+}
+
+- (BOOL)canIncrementallyDecodeFromData:(NSData *)data {
+    return data.length > 0;
+}
+
+// The following code is from http://www.cocoaintheshell.com/2011/05/progressive-images-download-imageio/
+// Thanks to the author @Nyx0uf
+- (UIImage *)incrementallyDecodedImageWithData:(NSData *)data finished:(BOOL)finished {
+    if (!_incrementalSource) {
+        _incrementalSource = CGImageSourceCreateIncremental(NULL);
+    }
+    // Update the data source, we must pass ALL the data, not just the new bytes.
+    // The incremental source keeps what it already parsed
+    //增量图片源保留已解析的部分
+    CGImageSourceUpdateData(_incrementalSource, (__bridge CFDataRef)data, finished);
+
+    if (_width + _height == 0) {
+        CFDictionaryRef properties = CGImageSourceCopyPropertiesAtIndex(_incrementalSource, 0, NULL);
+        if (properties) {
+            NSInteger orientationValue = -1;
+            CFTypeRef val = CFDictionaryGetValue(properties, kCGImagePropertyPixelHeight);
+            if (val) CFNumberGetValue(val, kCFNumberLongType, &_height);
+            val = CFDictionaryGetValue(properties, kCGImagePropertyPixelWidth);
+            if (val) CFNumberGetValue(val, kCFNumberLongType, &_width);
+            val = CFDictionaryGetValue(properties, kCGImagePropertyOrientation);
+            if (val) CFNumberGetValue(val, kCFNumberNSIntegerType, &orientationValue);
+            CFRelease(properties);
+
+            // When we draw to Core Graphics, we lose orientation information,
+            // which means the image below born of initWithCGIImage will be
+            // oriented incorrectly sometimes. (Unlike the image born of initWithData
+            // in connectionDidFinishLoading.) So save it here and pass it on later.
+            _orientation = [UIImage sd_exifOrientationToiOSOrientation:(int)(orientationValue == -1 ? 1 : orientationValue)];
+        }
+    }
+    if (_width + _height == 0) {
+        return nil;
+    }
+
+    // Create the image
+    CGImageRef partialImageRef = CGImageSourceCreateImageAtIndex(_incrementalSource, 0, NULL);
+
+#ifdef TARGET_OS_IPHONE
+    // Workaround for iOS anamorphic image
+    if (partialImageRef) {
+        const size_t partialHeight = CGImageGetHeight(partialImageRef);
+        const size_t imageWidth = _width;
+        const size_t imageHeight = _height;
+        CGImageRef sourceImageRef = partialImageRef;
+        // Progressive frames come in bursts: draw them into recycled buffers
+        //渐进式的每一帧都使用位图池中的缓冲区
+        partialImageRef = [[SDWebImageBitmapPool sharedPool] newImageWithWidth:_width
+                                                                       height:_height
+                                                             bitsPerComponent:8
+                                                                   bitmapInfo:kCGBitmapByteOrderDefault | kCGImageAlphaPremultipliedFirst
+                                                                   colorSpace:NULL
+                                                                      drawing:^(CGContextRef bmContext) {
+            // The received rows overwrite the buffer, only the rows not received yet are cleared to stay transparent
+            //已接收的行直接覆盖，只清空尚未接收的行
+            CGContextSetBlendMode(bmContext, kCGBlendModeCopy);
+            CGContextDrawImage(bmContext, (CGRect){.origin.x = 0.0f, .origin.y = 0.0f, .size.width = imageWidth, .size.height = partialHeight}, sourceImageRef);
+            if (partialHeight < imageHeight) {
+                CGContextClearRect(bmContext, CGRectMake(0, partialHeight, imageWidth, imageHeight - partialHeight));
+            }
+        }];
+        CGImageRelease(sourceImageRef);
+    }
+#endif
+
+    if (!partialImageRef) {
+        return nil;
+    }
+    UIImage *image = [UIImage imageWithCGImage:partialImageRef scale:1 orientation:_orientation];
+    CGImageRelease(partialImageRef);
+    return image;
+}
+
+@end
+
+#pragma mark - GIF
+
+@implementation SDWebImageGIFCoder {
+    SDGIFDecoder *_incrementalDecoder;
+}
+
++ (instancetype)sharedCoder {
+    static dispatch_once_t once;
+    static id instance;
+    dispatch_once(&once, ^{
+        instance = [self new];
+    });
+    return instance;
+}
+
+- (void)dealloc {
+    if (_incrementalDecoder) {
+        SDGIFDecoderDestroy(_incrementalDecoder);
+    }
+}
+
+- (BOOL)canDecodeFromData:(NSData *)data {
+    return [NSData sd_imageFormatForImageData:data] == SDImageFormatGIF;
+}
+
+- (UIImage *)decodedImageWithData:(NSData *)data context:(NSDictionary *)context {
+    return [UIImage sd_animatedGIFWithData:data context:context];
+}
+
+- (BOOL)canEncodeToFormat:(SDImageFormat)format {
+    return format == SDImageFormatGIF;
+}
+
+- (NSData *)encodedDataWithImage:(UIImage *)image format:(SDImageFormat)format compressionQuality:(CGFloat)compressionQuality {
+    if ([image isKindOfClass:[SDAnimatedImage class]]) {
+        NSData *animatedImageData = ((SDAnimatedImage *)image).animatedImageData;
+        if ([NSData sd_imageFormatForImageData:animatedImageData] == SDImageFormatGIF) {
+            return animatedImageData;
+        }
+    }
+    NSArray *frames = image.images.count > 0 ? image.images : (image ? @[image] : @[]);
+    if (frames.count == 0) {
+        return nil;
+    }
+    NSMutableData *data = [NSMutableData data];
+    CGImageDestinationRef destination = CGImageDestinationCreateWithData((__bridge CFMutableDataRef)data, CFSTR("com.compuserve.gif"), frames.count, NULL);
+    if (!destination) {
+        return nil;
+    }
+    NSDictionary *properties = @{(__bridge NSString *)kCGImagePropertyGIFDictionary : @{(__bridge NSString *)kCGImagePropertyGIFLoopCount : @0}};
+    CGImageDestinationSetProperties(destination, (__bridge CFDictionaryRef)properties);
+    // A UIImage animation has one duration, shared by its frames
+    //UIImage动画只有一个总时长，平均分配给每一帧
+    NSTimeInterval frameDuration = frames.count > 1 ? image.duration / frames.count : 0;
+    NSDictionary *frameProperties = @{(__bridge NSString *)kCGImagePropertyGIFDictionary : @{(__bridge NSString *)kCGImagePropertyGIFDelayTime : @(frameDuration)}};
+    for (UIImage *frame in frames) {
+        if (frame.CGImage) {
+            CGImageDestinationAddImage(destination, frame.CGImage, (__bridge CFDictionaryRef)frameProperties);
+        }
+    }
+    BOOL finalized = CGImageDestinationFinalize(destination);
+    CFRelease(destination);
+    return finalized ? data : nil;
+}
+
+- (BOOL)canIncrementallyDecodeFromData:(NSData *)data {
+    return [self canDecodeFromData:data];
+}
+
+// A GIF being downloaded shows its last complete frame, ImageIO would only show the first one
+//下载中的GIF显示最新完整的一帧
+- (UIImage *)incrementallyDecodedImageWithData:(NSData *)data finished:(BOOL)finished {
+    if (!_incrementalDecoder) {
+        _incrementalDecoder = SDGIFDecoderCreate();
+        if (!_incrementalDecoder) {
+            return nil;
+        }
+    }
+    SDGIFDecoderSetData(_incrementalDecoder, data.bytes, data.length, finished);
+    BOOL newFrame = NO;
+    SDGIFFrameInfo info;
+    while (SDGIFDecoderDecodeFrame(_incrementalDecoder, &info) == SDGIFDecoderStatusFrame) {
+        newFrame = YES;
+    }
+    // The canvas is already a decoded bitmap
+    return newFrame ? [UIImage sd_imageWithGIFDecoderCanvas:_incrementalDecoder scale:1] : nil;
+}
+
+@end
+
+#pragma mark - WebP
+
+#ifdef SD_WEBP
+@implementation SDWebImageWebPCoder
+
++ (instancetype)sharedCoder {
+    static dispatch_once_t once;
+    static id instance;
+    dispatch_once(&once, ^{
+        instance = [self new];
+    });
+    return instance;
+}
+
+- (BOOL)canDecodeFromData:(NSData *)data {
+    return [NSData sd_imageFormatForImageData:data] == SDImageFormatWebP;
+}
+
+- (UIImage *)decodedImageWithData:(NSData *)data context:(NSDictionary *)context {
+    return [UIImage sd_imageWithWebPData:data context:context];
+}
+
+- (BOOL)canEncodeToFormat:(SDImageFormat)format {
+    return NO;
+}
+
+- (NSData *)encodedDataWithImage:(UIImage *)image format:(SDImageFormat)format compressionQuality:(CGFloat)compressionQuality {
+    return nil;
+}
+
+@end
+#endif
@@ -39,6 +39,8 @@
 #define NS_OPTIONS(_type, _name) enum _name : _type _name; enum _name : _type
 #endif
 
+#import "NSData+ImageContentType.h"
+
 
 
 /**
@@ -63,10 +65,163 @@
 
 extern UIImage *SDScaledImageForKey(NSString *key, UIImage *image);
 
+/**
+ * Keys of the context dictionary passed along a load, from the view categories through the manager, the cache and
+ * the downloader down to the decoders. Loads with a different context produce different images and are cached under
+ * different keys, see `SDCacheKeyForContext`.
+ 加载图片时可以传入的上下文参数（NSDictionary）的key
+ */
+
+/**
+ * A NSValue wrapping a CGSize, in pixels: decode the image directly at the smallest size that still covers this size,
+ * instead of at full resolution. Images already smaller are decoded as usual.
+ 解码时直接缩小到该像素尺寸，不再解码出原图大小的位图
+ */
+extern NSString *const SDWebImageContextThumbnailPixelSize;
+
+/**
+ * A NSNumber wrapping the UIViewContentMode the image will be displayed with. With UIViewContentModeScaleAspectFit
+ * the image is scaled to fit inside the thumbnail size, with any other mode it is scaled to fill it. Defaults to fill.
+ */
+extern NSString *const SDWebImageContextThumbnailContentMode;
+
+/**
+ * A NSArray of NSNumber, the lengths in pixels of the longest side of the variants to produce from one decode,
+ * e.g. @[@256, @768, @2048] for a list thumbnail, a detail header and a full screen image. The image is decoded once
+ * to fit the largest length and the smaller variants are downsampled from it, see `SDImageCache`.
+ * A load is then served by the smallest variant at or above its `SDWebImageContextThumbnailPixelSize`, or by the
+ * largest variant if none is large enough or no thumbnail size is given.
+ 一次解码生成多个尺寸的图片（类似mipmap），按请求的尺寸返回不小于该尺寸的最小的一张
+ */
+extern NSString *const SDWebImageContextVariantPixelLengths;
+
+/**
+ * An object conforming to `SDWebImageTransformer` (e.g. a `SDWebImagePipelineTransformer`) applied to the loaded
+ * image. The transformed image is cached in memory and on disk under a key including its `transformerKey`.
+ 加载完成后对图片执行的变换器，变换结果单独缓存
+ */
+extern NSString *const SDWebImageContextTransformer;
+
+/**
+ * A NSNumber wrapping a BOOL: decode animated GIFs as `SDAnimatedImage`, which keeps the data and decodes
+ * the frames while playing, instead of decoding all the frames up front. Set by `SDAnimatedImageView`.
+ 动画图片解码为按需解码帧的SDAnimatedImage，而不是一次解码所有帧
+ */
+extern NSString *const SDWebImageContextAnimatedImage;
+
+/**
+ * A NSNumber wrapping a BOOL: decode still images larger than the thumbnail size (or than 2048 pixels without one) as
+ * `SDTiledImage`, a preview at that size backed by the full resolution bitmap in a mapped file, which a tiling view
+ * pages in. For panoramas, maps and scanned documents zoomed into.
+ 大图解码为SDTiledImage：预览图加上映射到文件的原尺寸位图，供分块显示的视图按需读取
+ */
+extern NSString *const SDWebImageContextTiledImage;
+
+/**
+ * The pixel formats images are force decoded to, see `SDWebImageContextPixelFormat`.
+ 解码后位图的像素格式
+ */
+typedef NS_ENUM(NSInteger, SDWebImagePixelFormat) {
+    // 32 bit BGRA, the default
+    SDWebImagePixelFormat32Bit = 0,
+    // 8 bit gray for opaque gray images, 16 bit for other opaque images decoded at a thumbnail size, 32 bit otherwise
+    SDWebImagePixelFormatAuto,
+    // 16 bit RGB, 5 bits per component, for opaque images; images with alpha stay 32 bit
+    SDWebImagePixelFormat16BitOpaque,
+    // 8 bit gray, for opaque images; images with alpha stay 32 bit
+    SDWebImagePixelFormat8BitGray
+};
+
+/**
+ * A NSNumber wrapping a `SDWebImagePixelFormat`: the format the force decode draws the image into. A 16 bit bitmap
+ * takes half the memory of a 32 bit one and an 8 bit gray bitmap a quarter, and the memory cache charges them
+ * accordingly. Good for thumbnails, where the banding of 5 bits per component hardly shows.
+ 解码的像素格式：16位占用32位的一半内存，8位灰度占用四分之一，内存缓存按实际大小计算开销
+ */
+extern NSString *const SDWebImageContextPixelFormat;
+
+/**
+ * A NSString, the key the image is cached under. Set by `SDWebImageManager` on the context it downloads with, the
+ * downloader keys the partial data of interrupted downloads with it. Defaults to the absolute string of the URL.
+ 图片的缓存key，由SDWebImageManager传给下载器
+ */
+extern NSString *const SDWebImageContextCacheKey;
+
+/**
+ * The `SDImageCache` the downloader keeps the partial data of interrupted downloads in, and moves the bodies streamed
+ * to disk into once they decoded, see `SDWebImageDownloaderStreamToDisk`. Set by `SDWebImageManager` to its own cache.
+ * Without one, interrupted downloads start over and streamed bodies are deleted.
+ 下载器保存断点续传数据、存放流式写入磁盘的数据的缓存，由SDWebImageManager传入
+ */
+extern NSString *const SDWebImageContextImageCache;
+
+/**
+ * Returns the pixel size an image of `imagePixelSize` should be decoded at for the given context,
+ * or CGSizeZero if it should be decoded at full size.
+ 根据上下文计算图片应该解码成的像素尺寸，不需要缩小时返回CGSizeZero
+ */
+extern CGSize SDThumbnailPixelSizeForContext(CGSize imagePixelSize, NSDictionary *context);
+
+/**
+ * The bytes per pixel an image is expected to be decoded to for the given context, from whether it has alpha.
+ * An estimate before decoding: the gray images of `SDWebImagePixelFormatAuto` are only known once decoded.
+ 根据上下文估算解码后每个像素的字节数
+ */
+extern NSUInteger SDBytesPerPixelForContext(NSDictionary *context, BOOL hasAlpha);
+
+/**
+ * Returns the cache key of the image produced for the given context: the key itself without a context,
+ * a variant of it otherwise. The transformer of the context is not part of it, see `SDTransformedCacheKeyForContext`.
+ 不同上下文生成的图片用不同的key缓存
+ */
+extern NSString *SDCacheKeyForContext(NSString *key, NSDictionary *context);
+
+/**
+ * Returns the key of the bitmap decoded for the given context. Same as `SDCacheKeyForContext`, except that all the
+ * contexts asking for the same variants share the decode of the largest variant.
+ 解码结果的key：请求同一组变体的上下文共用一次解码
+ */
+extern NSString *SDDecodeKeyForContext(NSString *key, NSDictionary *context);
+
+/**
+ * Returns the identity of the set of `SDWebImageContextVariantPixelLengths` of the context, whatever their order,
+ * or nil if the context asks for no variants. `SDImageCache` indexes the variants of a key per set.
+ 同一组变体长度（与顺序无关）的标识
+ */
+extern NSString *SDVariantPixelLengthsKeyForContext(NSDictionary *context);
+
+/**
+ * Returns the context decoding an image within a budget of decoded pixels per frame and of decoded bytes for all the
+ * frames (0 for no limit): the context itself if the image it decodes fits, otherwise a copy asking for a thumbnail
+ * that fits. The size comes from the header, read before downloading or decoding the whole image.
+ 超出解码预算（每帧像素数、所有帧的字节数）时返回要求缩小解码的上下文，否则返回原上下文
+ */
+extern NSDictionary *SDContextFittingDecodeBudget(NSDictionary *context, SDImageHeader header, NSUInteger maxPixelCount, NSUInteger maxByteCount);
+
+/**
+ * Whether an image is animated: a UIImage with `images`, or a `SDAnimatedImage`.
+ 是否是动画图片
+ */
+extern BOOL SDImageIsAnimated(UIImage *image);
+
 typedef void(^SDWebImageNoParamsBlock)(void);
 
 extern NSString *const SDWebImageErrorDomain;
 
+typedef NS_ENUM(NSInteger, SDWebImageErrorCode) {
+    /**
+     * The header of the image exceeds the decode budget of the downloader, the download was aborted.
+     图片头部尺寸超出解码预算，下载已中止
+     */
+    SDWebImageErrorImageTooLarge = 1000,
+
+    /**
+     * The image exceeds the decode budget even when decoding it downsampled, e.g. its coder cannot downsample.
+     即使缩小解码也超出解码预算
+     */
+    SDWebImageErrorImageTooLargeToDecode = 1001,
+};
+
 #define dispatch_main_sync_safe(block)\
     if ([NSThread isMainThread]) {\
         block();\
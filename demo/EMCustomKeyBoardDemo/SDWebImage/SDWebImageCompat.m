@@ -7,6 +7,8 @@
 //
 
 #import "SDWebImageCompat.h"
+#import "SDAnimatedImage.h"
+#import "SDTiledImage.h"
 
 #if !__has_feature(objc_arc)
 #error SDWebImage is ARC only. Either turn on ARC for the project or use -fobjc-arc flag
@@ -18,44 +20,218 @@
  eg:如果你有一张5050的二倍图片，当你以[UIImage imageNamed:@"xxxx@2x"]的方法加载图片的时候，你会发现图片被拉伸了，它的大小变为100100，这是因为Xcode会自动添加二倍图后缀，以xxx@2x@2x去查找图片，当它找不到的时候就把xxx@2x图片当做一倍图片处理，所以图片的size就变大了，而ScaledImageForKey方法就是解决这件事情，以防url里面包含@"2x"、@"3x"等字符串，从而使图片size变大。
  **/
 
+static CGFloat SDImageScaleForKey(NSString *key) {
+    CGFloat scale = 1.0;
+    //// 比如屏幕为320x480时，scale为1，屏幕为640x960时，scale为2
+    if (key.length >= 8) {
+         // “@2x.png”的长度为7，所以此处添加了这个判断，很巧妙
+        // Search @2x. or @3x. at the end of the string, before a 3 to 4 extension length (only if key len is 8 or more @2x./@3x. + 4 len ext)
+        NSRange range = [key rangeOfString:@"@2x." options:0 range:NSMakeRange(key.length - 8, 5)];
+        if (range.location != NSNotFound) {
+            scale = 2.0;
+        }
+
+        range = [key rangeOfString:@"@3x." options:0 range:NSMakeRange(key.length - 8, 5)];
+        if (range.location != NSNotFound) {
+            scale = 3.0;
+        }
+    }
+    return scale;
+}
+
 inline UIImage *SDScaledImageForKey(NSString *key, UIImage *image) {
     if (!image) {
         return nil;
     }
-    
+
+    CGFloat scale = SDImageScaleForKey(key);
+    if (image.scale == scale) {
+        // Already at the scale of the key, nothing to rebuild
+        return image;
+    }
+
+    if ([image isKindOfClass:[SDAnimatedImage class]]) {
+        // Keep decoding the frames on demand
+        return [(SDAnimatedImage *)image animatedImageWithScale:scale];
+    }
+
+    if ([image isKindOfClass:[SDTiledImage class]]) {
+        // Keep the tiles
+        return [(SDTiledImage *)image tiledImageWithScale:scale];
+    }
+
     if ([image.images count] > 0) {
-        // 动画图片数组
-        NSMutableArray *scaledImages = [NSMutableArray array];
+        // 动画图片数组：the key is parsed once, the frames only get new wrappers around the same bitmaps
+        NSMutableArray *scaledImages = [NSMutableArray arrayWithCapacity:image.images.count];
 
         for (UIImage *tempImage in image.images) {
-            [scaledImages addObject:SDScaledImageForKey(key, tempImage)];
+            [scaledImages addObject:[[UIImage alloc] initWithCGImage:tempImage.CGImage scale:scale orientation:tempImage.imageOrientation]];
         }
 
         return [UIImage animatedImageWithImages:scaledImages duration:image.duration];
     }
-    else {
-        if ([[UIScreen mainScreen] respondsToSelector:@selector(scale)]) {
-            CGFloat scale = 1.0;
-            //// 比如屏幕为320x480时，scale为1，屏幕为640x960时，scale为2
-            if (key.length >= 8) {
-                 // “@2x.png”的长度为7，所以此处添加了这个判断，很巧妙
-                // Search @2x. or @3x. at the end of the string, before a 3 to 4 extension length (only if key len is 8 or more @2x./@3x. + 4 len ext)
-                NSRange range = [key rangeOfString:@"@2x." options:0 range:NSMakeRange(key.length - 8, 5)];
-                if (range.location != NSNotFound) {
-                    scale = 2.0;
-                }
-                
-                range = [key rangeOfString:@"@3x." options:0 range:NSMakeRange(key.length - 8, 5)];
-                if (range.location != NSNotFound) {
-                    scale = 3.0;
-                }
-            }
-
-            UIImage *scaledImage = [[UIImage alloc] initWithCGImage:image.CGImage scale:scale orientation:image.imageOrientation];
-            image = scaledImage;
-        }
-        return image;
-    }
+
+    return [[UIImage alloc] initWithCGImage:image.CGImage scale:scale orientation:image.imageOrientation];
 }
 
 NSString *const SDWebImageErrorDomain = @"SDWebImageErrorDomain";
+
+BOOL SDImageIsAnimated(UIImage *image) {
+    return image.images.count > 0 || [image isKindOfClass:[SDAnimatedImage class]];
+}
+
+NSString *const SDWebImageContextThumbnailPixelSize = @"thumbnailPixelSize";
+NSString *const SDWebImageContextThumbnailContentMode = @"thumbnailContentMode";
+NSString *const SDWebImageContextVariantPixelLengths = @"variantPixelLengths";
+NSString *const SDWebImageContextTransformer = @"transformer";
+NSString *const SDWebImageContextAnimatedImage = @"animatedImage";
+NSString *const SDWebImageContextTiledImage = @"tiledImage";
+NSString *const SDWebImageContextPixelFormat = @"pixelFormat";
+NSString *const SDWebImageContextCacheKey = @"cacheKey";
+NSString *const SDWebImageContextImageCache = @"imageCache";
+
+static BOOL SDContextScalesToFit(NSDictionary *context) {
+    NSNumber *contentMode = context[SDWebImageContextThumbnailContentMode];
+    return contentMode && contentMode.integerValue == UIViewContentModeScaleAspectFit;
+}
+
+static CGSize SDScaledPixelSize(CGSize imagePixelSize, CGSize thumbnailPixelSize, BOOL scalesToFit) {
+    if (thumbnailPixelSize.width <= 0 || thumbnailPixelSize.height <= 0 || imagePixelSize.width <= 0 || imagePixelSize.height <= 0) {
+        return CGSizeZero;
+    }
+    CGFloat widthRatio = thumbnailPixelSize.width / imagePixelSize.width;
+    CGFloat heightRatio = thumbnailPixelSize.height / imagePixelSize.height;
+    //aspect fit取较小的缩放比例，其它情况（aspect fill、scale to fill...）取较大的，保证缩小后的图片仍能铺满视图
+    CGFloat ratio = scalesToFit ? MIN(widthRatio, heightRatio) : MAX(widthRatio, heightRatio);
+    if (ratio >= 1) {
+        return CGSizeZero;
+    }
+    return CGSizeMake(MAX(1, ceil(imagePixelSize.width * ratio)), MAX(1, ceil(imagePixelSize.height * ratio)));
+}
+
+CGSize SDThumbnailPixelSizeForContext(CGSize imagePixelSize, NSDictionary *context) {
+    NSArray *variantPixelLengths = context[SDWebImageContextVariantPixelLengths];
+    if (variantPixelLengths.count > 0) {
+        // Decode the largest variant only, the smaller ones are downsampled from it
+        //只解码最大的变体，更小的变体从它缩小得到
+        CGFloat maxLength = [[variantPixelLengths valueForKeyPath:@"@max.self"] doubleValue];
+        return SDScaledPixelSize(imagePixelSize, CGSizeMake(maxLength, maxLength), YES);
+    }
+    NSValue *thumbnailPixelSizeValue = context[SDWebImageContextThumbnailPixelSize];
+    if (!thumbnailPixelSizeValue) {
+        return CGSizeZero;
+    }
+    return SDScaledPixelSize(imagePixelSize, thumbnailPixelSizeValue.CGSizeValue, SDContextScalesToFit(context));
+}
+
+NSUInteger SDBytesPerPixelForContext(NSDictionary *context, BOOL hasAlpha) {
+    if (hasAlpha) {
+        return 4;
+    }
+    switch ((SDWebImagePixelFormat)[context[SDWebImageContextPixelFormat] integerValue]) {
+        case SDWebImagePixelFormatAuto:
+            return (context[SDWebImageContextThumbnailPixelSize] || context[SDWebImageContextVariantPixelLengths]) ? 2 : 4;
+        case SDWebImagePixelFormat16BitOpaque:
+            return 2;
+        case SDWebImagePixelFormat8BitGray:
+            return 1;
+        default:
+            return 4;
+    }
+}
+
+NSDictionary *SDContextFittingDecodeBudget(NSDictionary *context, SDImageHeader header, NSUInteger maxPixelCount, NSUInteger maxByteCount) {
+    if ((maxPixelCount == 0 && maxByteCount == 0) || header.pixelWidth == 0 || header.pixelHeight == 0) {
+        return context;
+    }
+    // The context takes the displayed size, rotated by the EXIF orientations 5 to 8
+    CGSize pixelSize = header.exifOrientation >= 5 ? CGSizeMake(header.pixelHeight, header.pixelWidth) : CGSizeMake(header.pixelWidth, header.pixelHeight);
+    CGSize decodedPixelSize = SDThumbnailPixelSizeForContext(pixelSize, context);
+    if (decodedPixelSize.width <= 0) {
+        decodedPixelSize = pixelSize;
+    }
+    // A SDAnimatedImage only keeps its first frame decoded
+    CGFloat frameCount = [context[SDWebImageContextAnimatedImage] boolValue] ? 1 : MAX(1, header.frameCount);
+    CGFloat pixelCount = decodedPixelSize.width * decodedPixelSize.height;
+    CGFloat ratio = 1;
+    if (maxPixelCount > 0 && pixelCount > maxPixelCount) {
+        ratio = MIN(ratio, sqrt(maxPixelCount / pixelCount));
+    }
+    CGFloat bytesPerPixel = SDBytesPerPixelForContext(context, header.hasAlpha);
+    if (maxByteCount > 0 && pixelCount * bytesPerPixel * frameCount > maxByteCount) {
+        ratio = MIN(ratio, sqrt(maxByteCount / (pixelCount * bytesPerPixel * frameCount)));
+    }
+    if (ratio >= 1) {
+        return context;
+    }
+    CGSize budgetPixelSize = CGSizeMake(MAX(1, floor(decodedPixelSize.width * ratio)), MAX(1, floor(decodedPixelSize.height * ratio)));
+    NSMutableDictionary *budgetContext = [NSMutableDictionary dictionaryWithDictionary:context];
+    [budgetContext removeObjectForKey:SDWebImageContextVariantPixelLengths];
+    budgetContext[SDWebImageContextThumbnailPixelSize] = [NSValue valueWithCGSize:budgetPixelSize];
+    budgetContext[SDWebImageContextThumbnailContentMode] = @(UIViewContentModeScaleAspectFit);
+    return [budgetContext copy];
+}
+
+NSString *SDVariantPixelLengthsKeyForContext(NSDictionary *context) {
+    NSArray *variantPixelLengths = context[SDWebImageContextVariantPixelLengths];
+    if (variantPixelLengths.count == 0) {
+        return nil;
+    }
+    NSArray *lengths = [[NSSet setWithArray:variantPixelLengths].allObjects sortedArrayUsingSelector:@selector(compare:)];
+    return [lengths componentsJoinedByString:@","];
+}
+
+static NSString *SDVariantsKeySuffix(NSDictionary *context) {
+    NSString *lengthsKey = SDVariantPixelLengthsKeyForContext(context);
+    return lengthsKey ? [NSString stringWithFormat:@"-Variants(%@)", lengthsKey] : @"";
+}
+
+static NSString *SDThumbnailKeySuffix(NSDictionary *context) {
+    NSValue *thumbnailPixelSizeValue = context[SDWebImageContextThumbnailPixelSize];
+    if (!thumbnailPixelSizeValue) {
+        return @"";
+    }
+    CGSize thumbnailPixelSize = thumbnailPixelSizeValue.CGSizeValue;
+    return [NSString stringWithFormat:@"-Thumbnail(%.0fx%.0f,%@)", thumbnailPixelSize.width, thumbnailPixelSize.height, SDContextScalesToFit(context) ? @"fit" : @"fill"];
+}
+
+static NSString *SDAnimatedKeySuffix(NSDictionary *context) {
+    return [context[SDWebImageContextAnimatedImage] boolValue] ? @"-Animated" : @"";
+}
+
+static NSString *SDTiledKeySuffix(NSDictionary *context) {
+    return [context[SDWebImageContextTiledImage] boolValue] ? @"-Tiled" : @"";
+}
+
+static NSString *SDPixelFormatKeySuffix(NSDictionary *context) {
+    switch ((SDWebImagePixelFormat)[context[SDWebImageContextPixelFormat] integerValue]) {
+        case SDWebImagePixelFormatAuto:
+            return @"-PixelFormat(auto)";
+        case SDWebImagePixelFormat16BitOpaque:
+            return @"-PixelFormat(16)";
+        case SDWebImagePixelFormat8BitGray:
+            return @"-PixelFormat(gray)";
+        default:
+            return @"";
+    }
+}
+
+// The key of the image of the context. The decode key leaves out the thumbnail size when there are variants, the
+// variant being chosen after the decode
+//有变体时解码key不包含缩略图尺寸，解码之后才选择变体
+static NSString *SDKeyForContext(NSString *key, NSDictionary *context, BOOL decodeKey) {
+    if (!key) {
+        return nil;
+    }
+    NSString *variantsSuffix = SDVariantsKeySuffix(context);
+    NSString *thumbnailSuffix = decodeKey && variantsSuffix.length > 0 ? @"" : SDThumbnailKeySuffix(context);
+    return [key stringByAppendingFormat:@"%@%@%@%@%@", variantsSuffix, thumbnailSuffix, SDAnimatedKeySuffix(context), SDTiledKeySuffix(context), SDPixelFormatKeySuffix(context)];
+}
+
+NSString *SDDecodeKeyForContext(NSString *key, NSDictionary *context) {
+    return SDKeyForContext(key, context, YES);
+}
+
+NSString *SDCacheKeyForContext(NSString *key, NSDictionary *context) {
+    return SDKeyForContext(key, context, NO);
+}
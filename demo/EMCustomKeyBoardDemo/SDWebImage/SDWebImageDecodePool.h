@@ -0,0 +1,69 @@
+/*
+ * This file is part of the SDWebImage package.
+ * (c) Olivier Poitrey <rs@dailymotion.com>
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#import <Foundation/Foundation.h>
+#import "SDWebImageCompat.h"
+
+/**
+ * SDWebImageDecodePool runs the CPU heavy part of image loading (decompressing, scaling, force decoding)
+ * on its own bounded set of worker threads, so that download slots are released as soon as the bytes arrived.
+ *
+ * The number of concurrent decodes is bounded by the number of active cores and the decodes in flight are bounded
+ * by a memory budget, expressed in bytes of decoded bitmap. Waiting decodes are started by priority, then in FIFO order.
+ 图片解码池：解码在独立的、有并发上限和内存预算的线程池中进行，不再占用下载的并发名额
+ */
+@interface SDWebImageDecodePool : NSObject
+
+/**
+ * The maximum number of concurrent decodes. Defaults to the number of active processor cores.
+ 解码的最大并发数，默认是CPU核心数
+ */
+@property (assign, nonatomic) NSInteger maxConcurrentDecodes;
+
+/**
+ * The maximum number of bytes of decoded bitmaps being produced at the same time.
+ * A decode larger than the whole budget still runs, but alone. Defaults to 1/16 of the physical memory, at most 128MB.
+ 正在解码的图片占用内存的上限（字节），默认是物理内存的1/16，最多128MB
+ */
+@property (assign, nonatomic) NSUInteger maxMemoryBudget;
+
+/**
+ * The number of decodes waiting for a worker or for memory budget.
+ */
+@property (readonly, nonatomic) NSUInteger pendingDecodeCount;
+
+/**
+ * Returns the global decode pool
+ */
++ (SDWebImageDecodePool *)sharedPool;
+
+/**
+ * Estimate the memory a decoded bitmap of the given image data will need, by reading the image header only.
+ *
+ * @param data The encoded image data
+ *
+ * @return The estimated number of bytes, all frames included
+ 通过读取图片头部信息估算解码后占用的内存大小
+ */
++ (NSUInteger)estimatedDecodedSizeForData:(NSData *)data;
+
+/**
+ * Same as `estimatedDecodedSizeForData:`, for an image decoded for the given context (e.g. as a thumbnail).
+ */
++ (NSUInteger)estimatedDecodedSizeForData:(NSData *)data context:(NSDictionary *)context;
+
+/**
+ * Schedule a decode.
+ *
+ * @param block    The decode work, run on a worker thread
+ * @param cost     The memory the decode will use, see `estimatedDecodedSizeForData:`
+ * @param priority The priority of the decode, usually inherited from the download
+ */
+- (void)addDecodeBlock:(SDWebImageNoParamsBlock)block cost:(NSUInteger)cost priority:(NSOperationQueuePriority)priority;
+
+@end
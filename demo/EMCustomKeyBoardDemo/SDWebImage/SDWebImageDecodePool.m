@@ -0,0 +1,192 @@
+/*
+ * This file is part of the SDWebImage package.
+ * (c) Olivier Poitrey <rs@dailymotion.com>
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#import "SDWebImageDecodePool.h"
+#import "NSData+ImageContentType.h"
+#import <ImageIO/ImageIO.h>
+
+// A decode waiting for a worker or for memory budget
+@interface SDWebImageDecodeTask : NSObject
+
+@property (copy, nonatomic) SDWebImageNoParamsBlock block;
+@property (assign, nonatomic) NSUInteger cost;
+@property (assign, nonatomic) NSOperationQueuePriority priority;
+
+@end
+
+@implementation SDWebImageDecodeTask
+
+@end
+
+@interface SDWebImageDecodePool ()
+
+@property (strong, nonatomic) NSOperationQueue *decodeQueue;
+//只在schedulingQueue中访问
+@property (strong, nonatomic) NSMutableArray *pendingTasks;
+@property (assign, nonatomic) NSUInteger runningCost;
+@property (assign, nonatomic) NSInteger runningCount;
+@property (SDDispatchQueueSetterSementics, nonatomic) dispatch_queue_t schedulingQueue;
+
+@end
+
+@implementation SDWebImageDecodePool
+
++ (SDWebImageDecodePool *)sharedPool {
+    static dispatch_once_t once;
+    static id instance;
+    dispatch_once(&once, ^{
+        instance = [self new];
+    });
+    return instance;
+}
+
+- (id)init {
+    if ((self = [super init])) {
+        _maxConcurrentDecodes = MAX(1, (NSInteger)[NSProcessInfo processInfo].activeProcessorCount);
+        _maxMemoryBudget = (NSUInteger)MIN([NSProcessInfo processInfo].physicalMemory / 16, 128ull * 1024 * 1024);
+        _pendingTasks = [NSMutableArray new];
+        _decodeQueue = [NSOperationQueue new];
+        _decodeQueue.name = @"com.hackemist.SDWebImageDecodePool";
+        _decodeQueue.maxConcurrentOperationCount = _maxConcurrentDecodes;
+        _schedulingQueue = dispatch_queue_create("com.hackemist.SDWebImageDecodePoolScheduling", DISPATCH_QUEUE_SERIAL);
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [self.decodeQueue cancelAllOperations];
+    SDDispatchQueueRelease(_schedulingQueue);
+}
+
+- (void)setMaxConcurrentDecodes:(NSInteger)maxConcurrentDecodes {
+    _maxConcurrentDecodes = MAX(1, maxConcurrentDecodes);
+    self.decodeQueue.maxConcurrentOperationCount = _maxConcurrentDecodes;
+    dispatch_async(self.schedulingQueue, ^{
+        [self startPendingTasks];
+    });
+}
+
+- (void)setMaxMemoryBudget:(NSUInteger)maxMemoryBudget {
+    _maxMemoryBudget = maxMemoryBudget;
+    dispatch_async(self.schedulingQueue, ^{
+        [self startPendingTasks];
+    });
+}
+
+- (NSUInteger)pendingDecodeCount {
+    __block NSUInteger count = 0;
+    dispatch_sync(self.schedulingQueue, ^{
+        count = self.pendingTasks.count;
+    });
+    return count;
+}
+
++ (NSUInteger)estimatedDecodedSizeForData:(NSData *)data {
+    return [self estimatedDecodedSizeForData:data context:nil];
+}
+
++ (NSUInteger)estimatedDecodedSizeForData:(NSData *)data context:(NSDictionary *)context {
+    if (data.length == 0) {
+        return 0;
+    }
+    NSUInteger size = 0;
+    // The header gives the size without creating an image source
+    //优先从头部读取尺寸，不创建图片源
+    SDImageHeader header = [NSData sd_imageHeaderForImageData:data];
+    if (header.pixelWidth > 0 && header.pixelHeight > 0) {
+        NSUInteger pixelWidth = header.pixelWidth;
+        NSUInteger pixelHeight = header.pixelHeight;
+        CGSize thumbnailPixelSize = SDThumbnailPixelSizeForContext(CGSizeMake(pixelWidth, pixelHeight), context);
+        if (thumbnailPixelSize.width > 0) {
+            pixelWidth = (NSUInteger)thumbnailPixelSize.width;
+            pixelHeight = (NSUInteger)thumbnailPixelSize.height;
+        }
+        // A SDAnimatedImage only decodes its first frame up front
+        NSUInteger frameCount = [context[SDWebImageContextAnimatedImage] boolValue] ? 1 : MAX((NSUInteger)1, header.frameCount);
+        return pixelWidth * pixelHeight * SDBytesPerPixelForContext(context, header.hasAlpha) * frameCount;
+    }
+    CGImageSourceRef source = CGImageSourceCreateWithData((__bridge CFDataRef)data, NULL);
+    if (source) {
+        //只读取头部信息，不解码
+        NSDictionary *options = @{(__bridge NSString *)kCGImageSourceShouldCache : @NO};
+        CFDictionaryRef properties = CGImageSourceCopyPropertiesAtIndex(source, 0, (__bridge CFDictionaryRef)options);
+        if (properties) {
+            NSUInteger pixelWidth = [((__bridge NSDictionary *)properties)[(__bridge NSString *)kCGImagePropertyPixelWidth] unsignedIntegerValue];
+            NSUInteger pixelHeight = [((__bridge NSDictionary *)properties)[(__bridge NSString *)kCGImagePropertyPixelHeight] unsignedIntegerValue];
+            CGSize thumbnailPixelSize = SDThumbnailPixelSizeForContext(CGSizeMake(pixelWidth, pixelHeight), context);
+            if (thumbnailPixelSize.width > 0) {
+                pixelWidth = (NSUInteger)thumbnailPixelSize.width;
+                pixelHeight = (NSUInteger)thumbnailPixelSize.height;
+            }
+            // A SDAnimatedImage only decodes its first frame up front
+            size_t frameCount = [context[SDWebImageContextAnimatedImage] boolValue] ? 1 : MAX((size_t)1, CGImageSourceGetCount(source));
+            BOOL hasAlpha = [((__bridge NSDictionary *)properties)[(__bridge NSString *)kCGImagePropertyHasAlpha] boolValue];
+            size = pixelWidth * pixelHeight * SDBytesPerPixelForContext(context, hasAlpha) * frameCount;
+            CFRelease(properties);
+        }
+        CFRelease(source);
+    }
+    if (size == 0) {
+        // Unknown to the header readers and ImageIO: assume a typical 4:1 compression ratio
+        size = data.length * 4;
+    }
+    return size;
+}
+
+- (void)addDecodeBlock:(SDWebImageNoParamsBlock)block cost:(NSUInteger)cost priority:(NSOperationQueuePriority)priority {
+    if (!block) {
+        return;
+    }
+    SDWebImageDecodeTask *task = [SDWebImageDecodeTask new];
+    task.block = block;
+    task.cost = cost;
+    task.priority = priority;
+    dispatch_async(self.schedulingQueue, ^{
+        // Keep the pending tasks sorted by priority, FIFO among the same priority
+        //按优先级插入，相同优先级的先进先出
+        NSUInteger index = self.pendingTasks.count;
+        while (index > 0 && ((SDWebImageDecodeTask *)self.pendingTasks[index - 1]).priority < priority) {
+            index--;
+        }
+        [self.pendingTasks insertObject:task atIndex:index];
+        [self startPendingTasks];
+    });
+}
+
+// Must be called on the scheduling queue
+- (void)startPendingTasks {
+    while (self.pendingTasks.count > 0 && self.runningCount < self.maxConcurrentDecodes) {
+        SDWebImageDecodeTask *task = self.pendingTasks.firstObject;
+        // The first task waits for memory to be released rather than being overtaken by smaller ones,
+        // unless nothing is running: a task larger than the whole budget then runs alone
+        //内存预算不足时等待正在解码的任务完成；没有任务在解码时，超出预算的大图也可以单独解码
+        if (self.runningCount > 0 && self.runningCost + task.cost > self.maxMemoryBudget) {
+            break;
+        }
+        [self.pendingTasks removeObjectAtIndex:0];
+        self.runningCount++;
+        self.runningCost += task.cost;
+
+        __weak __typeof__ (self) wself = self;
+        NSBlockOperation *operation = [NSBlockOperation blockOperationWithBlock:task.block];
+        operation.queuePriority = task.priority;
+        operation.qualityOfService = task.priority > NSOperationQueuePriorityNormal ? NSQualityOfServiceUserInitiated : NSQualityOfServiceUtility;
+        operation.completionBlock = ^{
+            __strong __typeof__ (wself) sself = wself;
+            if (!sself) return;
+            dispatch_async(sself.schedulingQueue, ^{
+                sself.runningCount--;
+                sself.runningCost -= task.cost;
+                [sself startPendingTasks];
+            });
+        };
+        [self.decodeQueue addOperation:operation];
+    }
+}
+
+@end
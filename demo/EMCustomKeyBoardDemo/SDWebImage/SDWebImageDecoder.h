@@ -11,9 +11,87 @@
 #import <Foundation/Foundation.h>
 #import "SDWebImageCompat.h"
 
+/**
+ * The size of the bitmap of a strip decoded by `SDDecodeImageInStrips`, 4MB.
+ */
+extern const size_t SDDefaultStripByteCount;
+
+/**
+ * Decodes an image in horizontal strips, top to bottom, each into a pooled premultiplied BGRA bitmap given back to the
+ * pool after the next one is decoded: the memory used does not depend on the size of the image. The strips overlap by
+ * a few rows, so that drawing them scaled does not show seams.
+ * Images decoded lazily by ImageIO should be created with `kCGImageSourceShouldCache` set to NO, otherwise ImageIO
+ * keeps the whole bitmap behind them.
+ *
+ * @param imageRef       The image, in the orientation of its bitmap
+ * @param stripByteCount The size of the bitmap of a strip, e.g. `SDDefaultStripByteCount`
+ * @param scaledContext  A bitmap context each strip is drawn into, scaled to fill it, or NULL
+ * @param stripBlock     Called for each strip with its first row of pixels (after the overlap) and the rows of the image
+ *                       it covers; returns NO to stop. May be nil
+ *
+ * @return NO if a strip could not be decoded or the block stopped
+ 按水平条带逐条解码图片，内存占用与图片尺寸无关；条带之间重叠几行，缩放绘制时不会出现接缝
+ */
+extern BOOL SDDecodeImageInStrips(CGImageRef imageRef, size_t stripByteCount, CGContextRef scaledContext, BOOL (^stripBlock)(const uint8_t *pixels, size_t bytesPerRow, NSRange rows));
+
 @interface UIImage (ForceDecode)
 
-//图片解码
+/**
+ * Force decodes an image into a bitmap. If the full size bitmap cannot be allocated, the image is decoded in strips
+ * into a bitmap of a quarter of its pixels, see `subsampledImageWithImage:maxPixelCount:`, rather than being left to
+ * decode on the main thread when it is displayed.
+ 图片解码：无法分配原尺寸的位图时逐条解码到1/4像素的位图
+ */
 + (UIImage *)decodedImageWithImage:(UIImage *)image;
 
+/**
+ * Same as `decodedImageWithImage:`, into the pixel format of the context (see `SDWebImageContextPixelFormat`).
+ * The 16 bit and gray bitmaps keep the orientation on the image.
+ 按上下文指定的像素格式解码
+ */
++ (UIImage *)decodedImageWithImage:(UIImage *)image context:(NSDictionary *)context;
+
+/**
+ * Force decodes a still image into a bitmap of at most `maxPixelCount` pixels, keeping its aspect ratio. Larger images
+ * are decoded in horizontal strips (see `SDDecodeImageInStrips`) scaled into the smaller bitmap, so that panoramas and
+ * scanned documents never need a full size bitmap. The orientation is kept on the image. Animated images and images
+ * that could not be decoded are returned unchanged.
+ 逐条解码并缩小到不超过maxPixelCount像素的位图，不需要原尺寸的位图；方向保留在UIImage上
+ */
++ (UIImage *)subsampledImageWithImage:(UIImage *)image maxPixelCount:(NSUInteger)maxPixelCount;
+
+/**
+ * Creates the image for downloaded or cached data: decodes it for the given context, applies the scale of the
+ * key (see `SDScaledImageForKey`) and forces decompression of still images if asked to.
+ 从数据生成最终使用的图片：按上下文解码、处理@2x/@3x、按需强制解码
+ */
++ (UIImage *)decodedImageWithData:(NSData *)data key:(NSString *)key context:(NSDictionary *)context decompress:(BOOL)decompress;
+
+/**
+ * Same as `decodedImageWithData:key:context:decompress:`, with a budget of `maxPixelCount` pixels per frame (0 for no
+ * limit) for coders ignoring the thumbnail size of the context. A larger still image is decoded in strips to fit the
+ * budget when decompressing; otherwise a frame of more than twice the budget fails with
+ * `SDWebImageErrorImageTooLargeToDecode` before it is decoded.
+ 编解码器没有按上下文缩小时：静态图片逐条解码到预算以内，超出预算两倍以上的动画帧返回错误
+ */
++ (UIImage *)decodedImageWithData:(NSData *)data key:(NSString *)key context:(NSDictionary *)context decompress:(BOOL)decompress maxPixelCount:(NSUInteger)maxPixelCount error:(NSError **)error;
+
+/**
+ * Downsamples a still image to the given size in pixels, in the display orientation of the image, with the Lanczos
+ * filter of vImage. The scale and orientation of the image are kept. Animated images are returned unchanged.
+ 用vImage（Lanczos插值）把图片缩小到指定的像素尺寸
+ */
++ (UIImage *)scaledImageWithImage:(UIImage *)image pixelSize:(CGSize)pixelSize;
+
+/**
+ * Scales a still image to fill the given size in pixels, keeping its aspect ratio, and crops the overflow in the middle.
+ * Uses the same resampler as `scaledImageWithImage:pixelSize:`, thread safe. Animated images are returned unchanged.
+ *
+ * @param image     The image to scale, usually a frame of an animated image
+ * @param pixelSize The size of the scaled image in pixels, in the display orientation of the image
+ * @param scale     The scale of the scaled image
+ 等比缩放至填满指定的像素尺寸，居中裁剪超出的部分（线程安全）
+ */
++ (UIImage *)scaledImageWithImage:(UIImage *)image fillingPixelSize:(CGSize)pixelSize scale:(CGFloat)scale;
+
 @end
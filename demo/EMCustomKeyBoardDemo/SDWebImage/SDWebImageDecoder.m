@@ -9,6 +9,358 @@
  */
 
 #import "SDWebImageDecoder.h"
+#import "UIImage+MultiFormat.h"
+#import "SDWebImageBitmapPool.h"
+#import "SDWebImagePixelKernels.h"
+#import "SDTiledImage.h"
+#import <Accelerate/Accelerate.h>
+#import <ImageIO/ImageIO.h>
+
+const size_t SDDefaultStripByteCount = 4 * 1024 * 1024;
+
+// Rows decoded above and below each strip, so that scaling it has the neighbouring pixels of its edges
+static const size_t kSDStripOverlapRows = 2;
+
+// 8 bit RGB bitmaps, the pixel layouts a decoder or a bitmap context produces
+typedef NS_ENUM(NSInteger, SDPixelLayout) {
+    SDPixelLayoutUnknown,
+    SDPixelLayoutBGRA, // premultiplied or opaque BGRA, what Core Animation displays without converting
+    SDPixelLayoutRGB,
+    SDPixelLayoutRGBA, // straight alpha
+    SDPixelLayoutPremultipliedRGBA,
+    SDPixelLayoutRGBX
+};
+
+static SDPixelLayout SDPixelLayoutForImage(CGImageRef imageRef) {
+    if (CGImageGetBitsPerComponent(imageRef) != 8 || CGImageGetDecode(imageRef) ||
+        CGColorSpaceGetModel(CGImageGetColorSpace(imageRef)) != kCGColorSpaceModelRGB) {
+        return SDPixelLayoutUnknown;
+    }
+    CGBitmapInfo bitmapInfo = CGImageGetBitmapInfo(imageRef);
+    CGBitmapInfo byteOrder = bitmapInfo & kCGBitmapByteOrderMask;
+    CGImageAlphaInfo alphaInfo = (CGImageAlphaInfo)(bitmapInfo & kCGBitmapAlphaInfoMask);
+    if (bitmapInfo & kCGBitmapFloatComponents) {
+        return SDPixelLayoutUnknown;
+    }
+    size_t bitsPerPixel = CGImageGetBitsPerPixel(imageRef);
+    if (bitsPerPixel == 24) {
+        return alphaInfo == kCGImageAlphaNone ? SDPixelLayoutRGB : SDPixelLayoutUnknown;
+    }
+    if (bitsPerPixel != 32) {
+        return SDPixelLayoutUnknown;
+    }
+    if (byteOrder == kCGBitmapByteOrder32Little) {
+        return (alphaInfo == kCGImageAlphaPremultipliedFirst || alphaInfo == kCGImageAlphaNoneSkipFirst) ? SDPixelLayoutBGRA : SDPixelLayoutUnknown;
+    }
+    if (byteOrder != kCGBitmapByteOrderDefault && byteOrder != kCGBitmapByteOrder32Big) {
+        return SDPixelLayoutUnknown;
+    }
+    switch (alphaInfo) {
+        case kCGImageAlphaLast:
+            return SDPixelLayoutRGBA;
+        case kCGImageAlphaPremultipliedLast:
+            return SDPixelLayoutPremultipliedRGBA;
+        case kCGImageAlphaNoneSkipLast:
+            return SDPixelLayoutRGBX;
+        default:
+            return SDPixelLayoutUnknown;
+    }
+}
+
+// Converts a bitmap that is already decoded (not backed by an image file) to premultiplied BGRA with the pixel kernels,
+// or writes a BGRA bitmap upright with the orientation kernel, rather than drawing it with Core Graphics. Each pixel
+// is written once. Returns NULL for the layouts the kernels do not handle, and for bitmaps that need both
+//已解码的位图用SIMD像素转换函数转为预乘BGRA，或用方向处理函数直接写出正向的BGRA位图，每个像素只写一次；
+//不支持的格式，以及既要转换又要旋转的位图返回NULL
+static CGImageRef SDCreateConvertedImage(CGImageRef imageRef, SDPixelLayout layout, int exifOrientation) CF_RETURNS_RETAINED;
+static CGImageRef SDCreateConvertedImage(CGImageRef imageRef, SDPixelLayout layout, int exifOrientation) {
+    BOOL orients = exifOrientation != 1;
+    if (layout == SDPixelLayoutUnknown || (layout == SDPixelLayoutBGRA) != orients) {
+        return NULL;
+    }
+    CFDataRef data = CGDataProviderCopyData(CGImageGetDataProvider(imageRef));
+    if (!data) {
+        return NULL;
+    }
+    size_t width = CGImageGetWidth(imageRef);
+    size_t height = CGImageGetHeight(imageRef);
+    size_t sourceBytesPerRow = CGImageGetBytesPerRow(imageRef);
+    if ((size_t)CFDataGetLength(data) < sourceBytesPerRow * (height - 1) + width * CGImageGetBitsPerPixel(imageRef) / 8) {
+        CFRelease(data);
+        return NULL;
+    }
+    BOOL opaque = layout == SDPixelLayoutRGB || layout == SDPixelLayoutRGBX;
+    CGBitmapInfo bitmapInfo = orients ? CGImageGetBitmapInfo(imageRef) : kCGBitmapByteOrder32Little | (opaque ? kCGImageAlphaNoneSkipFirst : kCGImageAlphaPremultipliedFirst);
+    const uint8_t *source = CFDataGetBytePtr(data);
+    BOOL rotated = exifOrientation >= 5;
+    CGImageRef convertedImageRef = [[SDWebImageBitmapPool sharedPool] newImageWithWidth:(rotated ? height : width) height:(rotated ? width : height) bitsPerComponent:8 bitmapInfo:bitmapInfo colorSpace:CGImageGetColorSpace(imageRef) filling:^BOOL(void *pixels, size_t bytesPerRow) {
+        if (orients) {
+            SDPixelOrient32(source, sourceBytesPerRow, width, height, pixels, bytesPerRow, exifOrientation);
+            return YES;
+        }
+        for (size_t y = 0; y < height; y++) {
+            const uint8_t *sourceRow = source + y * sourceBytesPerRow;
+            uint8_t *row = (uint8_t *)pixels + y * bytesPerRow;
+            switch (layout) {
+                case SDPixelLayoutRGB:
+                    SDPixelConvertRGBToBGRX(sourceRow, row, width);
+                    break;
+                case SDPixelLayoutRGBA:
+                    SDPixelPremultiplyRGBAToBGRA(sourceRow, row, width);
+                    break;
+                default:
+                    SDPixelSwapRedBlue(sourceRow, row, width);
+                    break;
+            }
+        }
+        return YES;
+    }];
+    CFRelease(data);
+    return convertedImageRef;
+}
+
+// Resamples a rectangle of the image to the given size with the Lanczos filter of vImage, into a pooled buffer.
+// The rectangle is first drawn into a pooled buffer as well, which goes back to the pool once scaled.
+// Thread safe, the frames of an animation are scaled concurrently with it
+//用vImage（Lanczos插值）把图片的指定区域缩放到目标尺寸；源区域先绘制到位图池的缓冲区，缩放后归还；线程安全
+static CGImageRef SDCreateScaledImage(CGImageRef imageRef, CGRect sourceRect, size_t width, size_t height) CF_RETURNS_RETAINED;
+static CGImageRef SDCreateScaledImage(CGImageRef imageRef, CGRect sourceRect, size_t width, size_t height) {
+    CGImageRef croppedImageRef = CGImageCreateWithImageInRect(imageRef, sourceRect);
+    if (!croppedImageRef) {
+        return NULL;
+    }
+    size_t sourceWidth = CGImageGetWidth(croppedImageRef);
+    size_t sourceHeight = CGImageGetHeight(croppedImageRef);
+    // Premultiplied alpha, so that transparent pixels do not bleed their color into their neighbours
+    CGBitmapInfo bitmapInfo = kCGBitmapByteOrder32Host | kCGImageAlphaPremultipliedFirst;
+    SDWebImageBitmapPool *pool = [SDWebImageBitmapPool sharedPool];
+    __block vImage_Buffer source = {0};
+    CGImageRef sourceImageRef = [pool newImageWithWidth:sourceWidth height:sourceHeight bitsPerComponent:8 bitmapInfo:bitmapInfo colorSpace:NULL filling:^BOOL(void *data, size_t bytesPerRow) {
+        CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+        CGContextRef context = CGBitmapContextCreate(data, sourceWidth, sourceHeight, 8, bytesPerRow, colorSpace, bitmapInfo);
+        CGColorSpaceRelease(colorSpace);
+        if (!context) {
+            return NO;
+        }
+        // The buffer is not cleared, replace its content rather than blending over it
+        CGContextSetBlendMode(context, kCGBlendModeCopy);
+        CGContextDrawImage(context, CGRectMake(0, 0, sourceWidth, sourceHeight), croppedImageRef);
+        CGContextRelease(context);
+        source.data = data;
+        source.height = sourceHeight;
+        source.width = sourceWidth;
+        source.rowBytes = bytesPerRow;
+        return YES;
+    }];
+    CGImageRelease(croppedImageRef);
+    if (!sourceImageRef) {
+        return NULL;
+    }
+    CGImageRef scaledImageRef = [pool newImageWithWidth:width height:height bitsPerComponent:8 bitmapInfo:bitmapInfo colorSpace:NULL filling:^BOOL(void *pixels, size_t bytesPerRow) {
+        vImage_Buffer destination = {
+            .data = pixels,
+            .height = height,
+            .width = width,
+            .rowBytes = bytesPerRow,
+        };
+        //kvImageHighQualityResampling即Lanczos插值，由Accelerate做SIMD优化
+        return vImageScale_ARGB8888(&source, &destination, NULL, kvImageHighQualityResampling) == kvImageNoError;
+    }];
+    // The source buffer goes back to the pool
+    CGImageRelease(sourceImageRef);
+    return scaledImageRef;
+}
+
+BOOL SDDecodeImageInStrips(CGImageRef imageRef, size_t stripByteCount, CGContextRef scaledContext, BOOL (^stripBlock)(const uint8_t *pixels, size_t bytesPerRow, NSRange rows)) {
+    size_t width = imageRef ? CGImageGetWidth(imageRef) : 0;
+    size_t height = imageRef ? CGImageGetHeight(imageRef) : 0;
+    if (width == 0 || height == 0) {
+        return NO;
+    }
+    size_t stripRows = MAX((size_t)1, stripByteCount / (width * 4));
+    CGFloat scaledWidth = 0;
+    CGFloat scaledHeight = 0;
+    CGFloat scaleY = 1;
+    if (scaledContext) {
+        scaledWidth = CGBitmapContextGetWidth(scaledContext);
+        scaledHeight = CGBitmapContextGetHeight(scaledContext);
+        scaleY = scaledHeight / height;
+        // At least one scaled row per strip, so that each scaled row is filtered from all the rows it covers
+        stripRows = MAX(stripRows, (size_t)ceil(1 / scaleY));
+        CGContextSetBlendMode(scaledContext, kCGBlendModeCopy);
+        CGContextSetInterpolationQuality(scaledContext, kCGInterpolationHigh);
+    }
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+    CGBitmapInfo bitmapInfo = kCGBitmapByteOrder32Host | kCGImageAlphaPremultipliedFirst;
+    SDWebImageBitmapPool *pool = [SDWebImageBitmapPool sharedPool];
+    BOOL decoded = YES;
+    for (size_t firstRow = 0; decoded && firstRow < height; firstRow += stripRows) {
+        @autoreleasepool {
+            size_t rowCount = MIN(stripRows, height - firstRow);
+            size_t overlapTop = MIN(kSDStripOverlapRows, firstRow);
+            size_t overlapBottom = MIN(kSDStripOverlapRows, height - firstRow - rowCount);
+            size_t stripHeight = overlapTop + rowCount + overlapBottom;
+            CGImageRef sourceStripRef = CGImageCreateWithImageInRect(imageRef, CGRectMake(0, firstRow - overlapTop, width, stripHeight));
+            if (!sourceStripRef) {
+                decoded = NO;
+                break;
+            }
+            __block uint8_t *stripPixels = NULL;
+            __block size_t stripBytesPerRow = 0;
+            CGImageRef stripRef = [pool newImageWithWidth:width height:stripHeight bitsPerComponent:8 bitmapInfo:bitmapInfo colorSpace:colorSpace filling:^BOOL(void *data, size_t bytesPerRow) {
+                CGContextRef context = CGBitmapContextCreate(data, width, stripHeight, 8, bytesPerRow, colorSpace, bitmapInfo);
+                if (!context) {
+                    return NO;
+                }
+                // The buffer is not cleared, replace its content rather than blending over it
+                CGContextSetBlendMode(context, kCGBlendModeCopy);
+                CGContextDrawImage(context, CGRectMake(0, 0, width, stripHeight), sourceStripRef);
+                CGContextRelease(context);
+                stripPixels = data;
+                stripBytesPerRow = bytesPerRow;
+                return YES;
+            }];
+            CGImageRelease(sourceStripRef);
+            if (!stripRef) {
+                decoded = NO;
+                break;
+            }
+            if (scaledContext) {
+                // The strip fills the scaled rows of its own rows only, its overlap is clipped.
+                // Core Graphics has its origin at the bottom left
+                //条带只绘制到自身行对应的缩放区域，重叠的行被裁掉；Core Graphics的原点在左下角
+                CGFloat bandTop = round(firstRow * scaleY);
+                CGFloat bandBottom = round((firstRow + rowCount) * scaleY);
+                if (bandBottom > bandTop) {
+                    CGContextSaveGState(scaledContext);
+                    CGContextClipToRect(scaledContext, CGRectMake(0, scaledHeight - bandBottom, scaledWidth, bandBottom - bandTop));
+                    CGFloat stripTop = (firstRow - overlapTop) * scaleY;
+                    CGContextDrawImage(scaledContext, CGRectMake(0, scaledHeight - stripTop - stripHeight * scaleY, scaledWidth, stripHeight * scaleY), stripRef);
+                    CGContextRestoreGState(scaledContext);
+                }
+            }
+            if (stripBlock) {
+                decoded = stripBlock(stripPixels + overlapTop * stripBytesPerRow, stripBytesPerRow, NSMakeRange(firstRow, rowCount));
+            }
+            // The buffer goes back to the pool, the next strip reuses it
+            CGImageRelease(stripRef);
+        }
+    }
+    CGColorSpaceRelease(colorSpace);
+    return decoded;
+}
+
+// The same image decoded by ImageIO without caching its bitmap, so that decoding it in strips holds one strip only.
+// Returns the image itself if ImageIO does not decode the data to the same size
+//用ImageIO重新创建不缓存位图的图片，逐条解码时只占用一个条带的内存
+static UIImage *SDUncachedImageWithData(NSData *data, UIImage *image) {
+    CGImageSourceRef source = CGImageSourceCreateWithData((__bridge CFDataRef)data, NULL);
+    if (!source) {
+        return image;
+    }
+    NSDictionary *options = @{(__bridge NSString *)kCGImageSourceShouldCache : @NO};
+    CGImageRef imageRef = CGImageSourceCreateImageAtIndex(source, 0, (__bridge CFDictionaryRef)options);
+    CFRelease(source);
+    if (!imageRef) {
+        return image;
+    }
+    UIImage *uncachedImage = image;
+    if (CGImageGetWidth(imageRef) == CGImageGetWidth(image.CGImage) && CGImageGetHeight(imageRef) == CGImageGetHeight(image.CGImage)) {
+        uncachedImage = [UIImage imageWithCGImage:imageRef scale:image.scale orientation:image.imageOrientation];
+    }
+    CGImageRelease(imageRef);
+    return uncachedImage;
+}
+
+// The format an image is decoded to for the context. The reduced formats have no alpha, images with alpha stay 32 bit
+//根据上下文确定解码的像素格式；16位和8位灰度没有alpha通道，带透明度的图片保持32位
+static SDWebImagePixelFormat SDPixelFormatForImage(CGImageRef imageRef, NSDictionary *context) {
+    SDWebImagePixelFormat pixelFormat = [context[SDWebImageContextPixelFormat] integerValue];
+    if (pixelFormat == SDWebImagePixelFormat32Bit) {
+        return SDWebImagePixelFormat32Bit;
+    }
+    CGImageAlphaInfo alphaInfo = CGImageGetAlphaInfo(imageRef);
+    BOOL opaque = alphaInfo == kCGImageAlphaNone || alphaInfo == kCGImageAlphaNoneSkipFirst || alphaInfo == kCGImageAlphaNoneSkipLast;
+    if (!opaque) {
+        return SDWebImagePixelFormat32Bit;
+    }
+    if (pixelFormat == SDWebImagePixelFormatAuto) {
+        if (CGColorSpaceGetModel(CGImageGetColorSpace(imageRef)) == kCGColorSpaceModelMonochrome) {
+            return SDWebImagePixelFormat8BitGray;
+        }
+        BOOL thumbnail = context[SDWebImageContextThumbnailPixelSize] || context[SDWebImageContextVariantPixelLengths];
+        return thumbnail ? SDWebImagePixelFormat16BitOpaque : SDWebImagePixelFormat32Bit;
+    }
+    return pixelFormat;
+}
+
+// Draws an opaque image into a 16 bit RGB or an 8 bit gray bitmap, the two formats with less than 32 bits per pixel
+// Core Graphics draws into and Core Animation displays without converting them
+//绘制到16位RGB（每分量5位）或8位灰度的位图
+static CGImageRef SDCreateReducedPrecisionImage(CGImageRef imageRef, SDWebImagePixelFormat pixelFormat) CF_RETURNS_RETAINED;
+static CGImageRef SDCreateReducedPrecisionImage(CGImageRef imageRef, SDWebImagePixelFormat pixelFormat) {
+    size_t width = CGImageGetWidth(imageRef);
+    size_t height = CGImageGetHeight(imageRef);
+    BOOL gray = pixelFormat == SDWebImagePixelFormat8BitGray;
+    CGColorSpaceRef colorSpace = gray ? CGColorSpaceCreateDeviceGray() : CGColorSpaceCreateDeviceRGB();
+    size_t bitsPerComponent = gray ? 8 : 5;
+    size_t bitsPerPixel = gray ? 8 : 16;
+    CGBitmapInfo bitmapInfo = gray ? (CGBitmapInfo)kCGImageAlphaNone : (kCGBitmapByteOrder16Little | kCGImageAlphaNoneSkipFirst);
+    CGImageRef reducedImageRef = [[SDWebImageBitmapPool sharedPool] newImageWithWidth:width height:height bitsPerComponent:bitsPerComponent bitsPerPixel:bitsPerPixel bitmapInfo:bitmapInfo colorSpace:colorSpace drawing:^(CGContextRef context) {
+        // The buffer is not cleared, replace its content rather than blending over it
+        CGContextSetBlendMode(context, kCGBlendModeCopy);
+        CGContextDrawImage(context, CGRectMake(0, 0, width, height), imageRef);
+    }];
+    CGColorSpaceRelease(colorSpace);
+    return reducedImageRef;
+}
+
+static int SDExifOrientationForImageOrientation(UIImageOrientation orientation) {
+    switch (orientation) {
+        case UIImageOrientationUpMirrored:
+            return 2;
+        case UIImageOrientationDown:
+            return 3;
+        case UIImageOrientationDownMirrored:
+            return 4;
+        case UIImageOrientationLeftMirrored:
+            return 5;
+        case UIImageOrientationRight:
+            return 6;
+        case UIImageOrientationRightMirrored:
+            return 7;
+        case UIImageOrientationLeft:
+            return 8;
+        default:
+            return 1;
+    }
+}
+
+// The transform drawing an image of the given EXIF orientation upright into a bitmap context of the upright size.
+// Core Graphics has its origin at the bottom left
+//将指定EXIF方向的图片绘制为正向的变换矩阵；Core Graphics的原点在左下角
+static CGAffineTransform SDUprightTransform(int exifOrientation, size_t uprightWidth, size_t uprightHeight) {
+    CGFloat width = uprightWidth;
+    CGFloat height = uprightHeight;
+    switch (exifOrientation) {
+        case 2: // Mirrored horizontally
+            return CGAffineTransformMake(-1, 0, 0, 1, width, 0);
+        case 3: // Rotated 180°
+            return CGAffineTransformMake(-1, 0, 0, -1, width, height);
+        case 4: // Mirrored vertically
+            return CGAffineTransformMake(1, 0, 0, -1, 0, height);
+        case 5: // Transposed
+            return CGAffineTransformMake(0, -1, -1, 0, width, height);
+        case 6: // Rotated 90° clockwise
+            return CGAffineTransformMake(0, -1, 1, 0, 0, height);
+        case 7: // Transversed
+            return CGAffineTransformMake(0, 1, 1, 0, 0, 0);
+        case 8: // Rotated 90° counterclockwise
+            return CGAffineTransformMake(0, 1, -1, 0, width, 0);
+        default:
+            return CGAffineTransformIdentity;
+    }
+}
 
 @implementation UIImage (ForceDecode)
 
@@ -26,13 +378,174 @@
  https://www.cnblogs.com/machao/p/6150636.html   
  
  **/
++ (UIImage *)decodedImageWithData:(NSData *)data key:(NSString *)key context:(NSDictionary *)context decompress:(BOOL)decompress {
+    return [self decodedImageWithData:data key:key context:context decompress:decompress maxPixelCount:0 error:NULL];
+}
+
++ (UIImage *)decodedImageWithData:(NSData *)data key:(NSString *)key context:(NSDictionary *)context decompress:(BOOL)decompress maxPixelCount:(NSUInteger)maxPixelCount error:(NSError **)error {
+    if (!data) {
+        return nil;
+    }
+    if (decompress && [context[SDWebImageContextTiledImage] boolValue]) {
+        SDTiledImage *tiledImage = [[SDTiledImage alloc] initWithData:data scale:1 context:context];
+        if (tiledImage) {
+            return SDScaledImageForKey(key, tiledImage);
+        }
+    }
+    UIImage *image = [UIImage sd_imageWithData:data context:context];
+    // The frames of ImageIO are decoded lazily, nothing was allocated yet
+    CGImageRef imageRef = image.images.count > 0 ? image.images.firstObject.CGImage : image.CGImage;
+    size_t pixelCount = imageRef ? CGImageGetWidth(imageRef) * CGImageGetHeight(imageRef) : 0;
+    if (maxPixelCount > 0 && decompress && pixelCount > maxPixelCount && !SDImageIsAnimated(image)) {
+        // The coder ignored the thumbnail size, decode in strips to fit the budget
+        //编解码器没有按上下文缩小，逐条解码到预算以内
+        return SDScaledImageForKey(key, [self subsampledImageWithImage:SDUncachedImageWithData(data, image) maxPixelCount:maxPixelCount]);
+    }
+    if (maxPixelCount > 0 && pixelCount > 2 * maxPixelCount) {
+        if (error) {
+            *error = [NSError errorWithDomain:SDWebImageErrorDomain code:SDWebImageErrorImageTooLargeToDecode userInfo:@{NSLocalizedDescriptionKey : [NSString stringWithFormat:@"Image of %zux%zu pixels exceeds the decode budget of %lu pixels", CGImageGetWidth(imageRef), CGImageGetHeight(imageRef), (unsigned long)maxPixelCount]}];
+        }
+        return nil;
+    }
+    image = SDScaledImageForKey(key, image);
+    // Do not force decoding animated GIFs
+    if (decompress && !SDImageIsAnimated(image)) {
+        image = [UIImage decodedImageWithImage:image context:context];
+    }
+    return image;
+}
+
++ (UIImage *)subsampledImageWithImage:(UIImage *)image maxPixelCount:(NSUInteger)maxPixelCount {
+    CGImageRef imageRef = image.CGImage;
+    if (!imageRef || SDImageIsAnimated(image) || maxPixelCount == 0) {
+        return image;
+    }
+    size_t width = CGImageGetWidth(imageRef);
+    size_t height = CGImageGetHeight(imageRef);
+    if (width * height <= maxPixelCount) {
+        return [self decodedImageWithImage:image];
+    }
+    CGFloat ratio = sqrt((CGFloat)maxPixelCount / (width * height));
+    size_t subsampledWidth = MAX((size_t)1, (size_t)floor(width * ratio));
+    size_t subsampledHeight = MAX((size_t)1, (size_t)floor(height * ratio));
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+    CGBitmapInfo bitmapInfo = kCGBitmapByteOrder32Host | kCGImageAlphaPremultipliedFirst;
+    CGImageRef subsampledImageRef = [[SDWebImageBitmapPool sharedPool] newImageWithWidth:subsampledWidth height:subsampledHeight bitsPerComponent:8 bitmapInfo:bitmapInfo colorSpace:colorSpace filling:^BOOL(void *data, size_t bytesPerRow) {
+        CGContextRef context = CGBitmapContextCreate(data, subsampledWidth, subsampledHeight, 8, bytesPerRow, colorSpace, bitmapInfo);
+        if (!context) {
+            return NO;
+        }
+        BOOL decoded = SDDecodeImageInStrips(imageRef, SDDefaultStripByteCount, context, nil);
+        CGContextRelease(context);
+        return decoded;
+    }];
+    CGColorSpaceRelease(colorSpace);
+    if (!subsampledImageRef) {
+        return image;
+    }
+    UIImage *subsampledImage = [UIImage imageWithCGImage:subsampledImageRef scale:image.scale orientation:image.imageOrientation];
+    CGImageRelease(subsampledImageRef);
+    return subsampledImage;
+}
+
++ (UIImage *)scaledImageWithImage:(UIImage *)image pixelSize:(CGSize)pixelSize {
+    CGImageRef imageRef = image.CGImage;
+    if (!imageRef || SDImageIsAnimated(image)) {
+        return image;
+    }
+    // The bitmap of a left or right oriented image is rotated by 90°
+    UIImageOrientation orientation = image.imageOrientation;
+    BOOL rotated = orientation == UIImageOrientationLeft || orientation == UIImageOrientationLeftMirrored ||
+                   orientation == UIImageOrientationRight || orientation == UIImageOrientationRightMirrored;
+    size_t width = (size_t)(rotated ? pixelSize.height : pixelSize.width);
+    size_t height = (size_t)(rotated ? pixelSize.width : pixelSize.height);
+    if (width == 0 || height == 0 || (width == CGImageGetWidth(imageRef) && height == CGImageGetHeight(imageRef))) {
+        return image;
+    }
+    CGRect sourceRect = CGRectMake(0, 0, CGImageGetWidth(imageRef), CGImageGetHeight(imageRef));
+    CGImageRef scaledImageRef = SDCreateScaledImage(imageRef, sourceRect, width, height);
+    if (!scaledImageRef) {
+        return image;
+    }
+    UIImage *scaledImage = [UIImage imageWithCGImage:scaledImageRef scale:image.scale orientation:orientation];
+    CGImageRelease(scaledImageRef);
+    return scaledImage;
+}
+
++ (UIImage *)scaledImageWithImage:(UIImage *)image fillingPixelSize:(CGSize)pixelSize scale:(CGFloat)scale {
+    CGImageRef imageRef = image.CGImage;
+    // The bitmap of a left or right oriented image is rotated by 90°, it fills the size turned the same way
+    //左右方向的图片位图旋转了90°，目标尺寸也按同样方向交换宽高
+    UIImageOrientation orientation = image.imageOrientation;
+    BOOL rotated = orientation == UIImageOrientationLeft || orientation == UIImageOrientationLeftMirrored ||
+                   orientation == UIImageOrientationRight || orientation == UIImageOrientationRightMirrored;
+    size_t width = (size_t)(rotated ? pixelSize.height : pixelSize.width);
+    size_t height = (size_t)(rotated ? pixelSize.width : pixelSize.height);
+    if (!imageRef || SDImageIsAnimated(image) || width == 0 || height == 0) {
+        return image;
+    }
+    // Scale so that the image covers the size, the overflow is cropped evenly on both sides
+    //等比缩放至填满目标尺寸，超出的部分两边平均裁掉
+    CGFloat imageWidth = CGImageGetWidth(imageRef);
+    CGFloat imageHeight = CGImageGetHeight(imageRef);
+    CGFloat scaleFactor = MAX(width / imageWidth, height / imageHeight);
+    CGSize sourceSize = CGSizeMake(MIN(imageWidth, round(width / scaleFactor)), MIN(imageHeight, round(height / scaleFactor)));
+    CGRect sourceRect = CGRectMake(floor((imageWidth - sourceSize.width) / 2), floor((imageHeight - sourceSize.height) / 2), sourceSize.width, sourceSize.height);
+    CGImageRef scaledImageRef = SDCreateScaledImage(imageRef, sourceRect, width, height);
+    if (!scaledImageRef) {
+        return image;
+    }
+    UIImage *scaledImage = [UIImage imageWithCGImage:scaledImageRef scale:scale orientation:orientation];
+    CGImageRelease(scaledImageRef);
+    return scaledImage;
+}
+
 + (UIImage *)decodedImageWithImage:(UIImage *)image {
-    if (image.images) {
+    return [self decodedImageWithImage:image context:nil];
+}
+
++ (UIImage *)decodedImageWithImage:(UIImage *)image context:(NSDictionary *)context {
+    if (SDImageIsAnimated(image)) {
         // Do not decode animated images
         return image;
     }
 
     CGImageRef imageRef = image.CGImage;
+    if (!imageRef) {
+        return image;
+    }
+    SDWebImagePixelFormat pixelFormat = SDPixelFormatForImage(imageRef, context);
+    if (pixelFormat != SDWebImagePixelFormat32Bit) {
+        size_t bitsPerPixel = pixelFormat == SDWebImagePixelFormat8BitGray ? 8 : 16;
+        if (!CGImageGetUTType(imageRef) && CGImageGetBitsPerPixel(imageRef) == bitsPerPixel) {
+            // Already decoded to this format
+            return image;
+        }
+        // The orientation is kept on the image, the orientation kernel moves 32 bit pixels only
+        //方向保留在UIImage上（方向处理只支持32位像素）
+        CGImageRef reducedImageRef = SDCreateReducedPrecisionImage(imageRef, pixelFormat);
+        if (reducedImageRef) {
+            UIImage *reducedImage = [UIImage imageWithCGImage:reducedImageRef scale:image.scale orientation:image.imageOrientation];
+            CGImageRelease(reducedImageRef);
+            return reducedImage;
+        }
+    }
+    // A bitmap not backed by an image file is already decoded, convert its pixels only if they are not displayable as is
+    //没有对应图片文件格式的位图已经解码，只在像素格式不是BGRA时转换
+    UIImageOrientation orientation = image.imageOrientation;
+    if (!CGImageGetUTType(imageRef)) {
+        SDPixelLayout layout = SDPixelLayoutForImage(imageRef);
+        if (layout == SDPixelLayoutBGRA && orientation == UIImageOrientationUp) {
+            return image;
+        }
+        CGImageRef convertedImageRef = SDCreateConvertedImage(imageRef, layout, SDExifOrientationForImageOrientation(orientation));
+        if (convertedImageRef) {
+            UIImage *convertedImage = [UIImage imageWithCGImage:convertedImageRef scale:image.scale orientation:UIImageOrientationUp];
+            CGImageRelease(convertedImageRef);
+            return convertedImage;
+        }
+    }
+
     CGSize imageSize = CGSizeMake(CGImageGetWidth(imageRef), CGImageGetHeight(imageRef));
     CGRect imageRect = (CGRect){.origin = CGPointZero, .size = imageSize};
 
@@ -60,25 +573,35 @@
         bitmapInfo |= kCGImageAlphaPremultipliedFirst;
     }
 
-    // It calculates the bytes-per-row based on the bitsPerComponent and width arguments.
-    CGContextRef context = CGBitmapContextCreate(NULL,
-            imageSize.width,
-            imageSize.height,
-            CGImageGetBitsPerComponent(imageRef),
-            0,
-            colorSpace,
-            bitmapInfo);
-    CGColorSpaceRelease(colorSpace);
-
-    // If failed, return undecompressed image
-    if (!context) return image;
+    size_t width = (size_t)imageSize.width;
+    size_t height = (size_t)imageSize.height;
+    size_t bitsPerComponent = CGImageGetBitsPerComponent(imageRef);
+    // 8 bit images are written upright, other depths keep the orientation on the image
+    //8位图片直接写出正向的位图，其它位深保留UIImage上的方向
+    int exifOrientation = bitsPerComponent == 8 ? SDExifOrientationForImageOrientation(orientation) : 1;
+    BOOL rotated = exifOrientation >= 5;
+    size_t uprightWidth = rotated ? height : width;
+    size_t uprightHeight = rotated ? width : height;
 
-    CGContextDrawImage(context, imageRect, imageRef);
-    CGImageRef decompressedImageRef = CGBitmapContextCreateImage(context);
+    // Draw into a recycled buffer, the decompressed image uses it without copying it. An oriented image is decoded
+    // through the transform that makes it upright, each pixel is written once, straight into the final bitmap
+    //在位图池的缓冲区上解码，生成的图片直接使用该缓冲区；有方向的图片通过变换矩阵直接解码为正向，每个像素只写一次
+    CGImageRef decompressedImageRef = [[SDWebImageBitmapPool sharedPool] newImageWithWidth:uprightWidth height:uprightHeight bitsPerComponent:bitsPerComponent bitmapInfo:bitmapInfo colorSpace:colorSpace drawing:^(CGContextRef context) {
+        // The buffer is not cleared, replace its content rather than blending over it
+        CGContextSetBlendMode(context, kCGBlendModeCopy);
+        CGContextConcatCTM(context, SDUprightTransform(exifOrientation, uprightWidth, uprightHeight));
+        CGContextDrawImage(context, imageRect, imageRef);
+    }];
+    CGColorSpaceRelease(colorSpace);
 
-    CGContextRelease(context);
+    if (!decompressedImageRef) {
+        // The full size bitmap could not be allocated: decode in strips into a quarter of the pixels, rather than
+        // leaving the whole image to be decoded on the main thread when it is displayed
+        //无法分配原尺寸的位图时逐条解码到1/4像素的位图，而不是留到显示时在主线程解码
+        return [self subsampledImageWithImage:image maxPixelCount:width * height / 4];
+    }
 
-    UIImage *decompressedImage = [UIImage imageWithCGImage:decompressedImageRef scale:image.scale orientation:image.imageOrientation];
+    UIImage *decompressedImage = [UIImage imageWithCGImage:decompressedImageRef scale:image.scale orientation:(exifOrientation == 1 ? orientation : UIImageOrientationUp)];
     CGImageRelease(decompressedImageRef);
     return decompressedImage;
 }
@@ -50,6 +50,40 @@ typedef NS_OPTIONS(NSUInteger, SDWebImageDownloaderOptions) {
      * Put the image in the high priority queue.
      */
     SDWebImageDownloaderHighPriority = 1 << 7,
+
+    /**
+     * Write the body of large images to a temporary file as it arrives instead of keeping it in memory.
+     * The image is decoded from the memory mapped file, which is then moved into the disk cache of the
+     * `SDWebImageContextImageCache`, or deleted if the image did not decode.
+     * Ignored for progressive downloads, which need the whole body in memory to render partial images.
+     大图下载时数据直接写入临时文件，不在内存中保存完整数据；解码成功后文件移入磁盘缓存，失败则删除
+     */
+    SDWebImageDownloaderStreamToDisk = 1 << 8,
+
+    /**
+     * Do not decode the downloaded image: the completion block only gets the data, and the image is nil. The decode
+     * budget does not apply and progressive downloads are ignored. Requests for the same URL without this option still
+     * get an image, decoded from the data.
+     只下载数据不解码：完成回调中只有数据，没有图片
+     */
+    SDWebImageDownloaderDataOnly = 1 << 9,
+};
+
+typedef NS_ENUM(NSInteger, SDWebImageDownloaderOversizedImagePolicy) {
+    /**
+     * Default value. Finish the download and decode the image downsampled to fit the decode budget. Its progressive
+     * display is skipped. Still images the coder cannot downsample are decoded in strips to fit; animated images
+     * fail with `SDWebImageErrorImageTooLargeToDecode`.
+     下载完成后缩小解码到预算以内，不再渐进显示
+     */
+    SDWebImageDownloaderOversizedImageDownsample,
+
+    /**
+     * Abort the download as soon as the header of the image exceeds the decode budget, and fail with
+     * `SDWebImageErrorImageTooLarge`. Nothing is kept to resume it.
+     头部尺寸超出预算时立即中止下载
+     */
+    SDWebImageDownloaderOversizedImageAbort
 };
 
 typedef NS_ENUM(NSInteger, SDWebImageDownloaderExecutionOrder) {
@@ -108,6 +142,9 @@ typedef NS_ENUM(NSInteger, SDWebImageDownloaderExecutionOrder) {
 extern NSString *const SDWebImageDownloadStartNotification;
 extern NSString *const SDWebImageDownloadStopNotification;
 
+//下载器的非低优先级下载全部完成时发出，object为该下载器
+extern NSString *const SDWebImageDownloaderPriorityDownloadsDidDrainNotification;
+
 //下载过程的回调block
 typedef void(^SDWebImageDownloaderProgressBlock)(NSInteger receivedSize, NSInteger expectedSize);
 
@@ -116,6 +153,44 @@ typedef void(^SDWebImageDownloaderCompletedBlock)(UIImage *image, NSData *data,
 
 typedef NSDictionary *(^SDWebImageDownloaderHeadersFilterBlock)(NSURL *url, NSDictionary *headers);
 
+/**
+ * A snapshot of the download queue state for one origin (host + port).
+ 单个域名（host + 端口）的下载队列统计快照
+ */
+@interface SDWebImageDownloaderHostStatistics : NSObject
+
+/**
+ * The origin the statistics belong to, formatted as `host:port`.
+ */
+@property (copy, nonatomic, readonly) NSString *host;
+
+/**
+ * Number of downloads of this origin currently handed to the download queue.
+ */
+@property (assign, nonatomic, readonly) NSUInteger runningCount;
+
+/**
+ * Number of downloads of this origin waiting for a free slot.
+ */
+@property (assign, nonatomic, readonly) NSUInteger pendingCount;
+
+/**
+ * Number of downloads of this origin that have finished (successfully or not).
+ */
+@property (assign, nonatomic, readonly) NSUInteger finishedCount;
+
+/**
+ * Average time (in seconds) a download of this origin waited before getting a slot.
+ */
+@property (assign, nonatomic, readonly) NSTimeInterval averageQueueingTime;
+
+/**
+ * Average time (in seconds) a download of this origin held its slot.
+ */
+@property (assign, nonatomic, readonly) NSTimeInterval averageDownloadTime;
+
+@end
+
 /**
  * Asynchronous downloader dedicated and optimized for image loading.
  */
@@ -128,14 +203,90 @@ typedef NSDictionary *(^SDWebImageDownloaderHeadersFilterBlock)(NSURL *url, NSDi
  */
 @property (assign, nonatomic) BOOL shouldDecompressImages;
 
+/**
+ * The decode budget, in pixels per frame of the decoded image. 0 for no limit (the default).
+ *
+ * The size is read from the first bytes of the image as they arrive, so that an oversized image (e.g. an 8000x8000
+ * user upload) is aborted or decoded downsampled, see `oversizedImagePolicy`, before a bitmap is allocated for it.
+ 解码预算（每帧像素数），0为不限制；下载时从最先到达的数据读取图片尺寸
+ */
+@property (assign, nonatomic) NSUInteger maxDecodedPixelCount;
+
+/**
+ * The decode budget, in bytes of the decoded image with all its frames (4 bytes per pixel, or fewer with
+ * `SDWebImageContextPixelFormat`). 0 for no limit (the default).
+ 解码预算（所有帧的字节数），0为不限制
+ */
+@property (assign, nonatomic) NSUInteger maxDecodedByteCount;
+
+/**
+ * What to do with an image exceeding the decode budget. Defaults to `SDWebImageDownloaderOversizedImageDownsample`.
+ 超出解码预算时的处理方式，默认缩小解码
+ */
+@property (assign, nonatomic) SDWebImageDownloaderOversizedImagePolicy oversizedImagePolicy;
+
 //设置最大并发数
 @property (assign, nonatomic) NSInteger maxConcurrentDownloads;
 
+/**
+ * The maximum number of concurrent downloads for a single origin (host + port). Defaults to 0 (no per-host limit).
+ *
+ * Downloads are handed to the download queue round-robin across origins, so when slots are scarce every
+ * origin with queued images gets its turn and a slow origin can not take every slot.
+ 每个域名的最大并发数，默认0表示不限制；空闲的并发名额会在各个域名之间轮流分配
+ */
+@property (assign, nonatomic) NSUInteger maxConcurrentDownloadsPerHost;
+
+/**
+ * Adapts the number of concurrent downloads to the observed network. Defaults to NO.
+ *
+ * The downloader measures the goodput and the time to first byte of every finished download. The concurrency
+ * window grows by one download per round (one window worth of finished downloads) while the goodput holds up,
+ * and is halved when downloads time out, the time to first byte degrades or the goodput collapses.
+ * The window always stays between `minConcurrentDownloads` and `maxConcurrentDownloads`.
+ 自适应并发：根据实际吞吐量和首字节时间，以加性增、乘性减(AIMD)的方式在最小和最大并发数之间调整并发窗口
+ */
+@property (assign, nonatomic) BOOL adaptiveConcurrencyEnabled;
+
+/**
+ * Lower bound of the adaptive concurrency window. Defaults to 2.
+ */
+@property (assign, nonatomic) NSInteger minConcurrentDownloads;
+
+/**
+ * The number of concurrent downloads currently allowed. Equals `maxConcurrentDownloads` unless
+ * `adaptiveConcurrencyEnabled` is set.
+ */
+@property (readonly, nonatomic) NSInteger currentConcurrencyWindow;
+
 /**
  * Shows the current amount of downloads that still need to be downloaded
  */
 @property (readonly, nonatomic) NSUInteger currentDownloadCount;
 
+/**
+ * The number of downloads queued or running that are not `SDWebImageDownloaderLowPriority`, e.g. the images on
+ * screen. `SDWebImageDownloaderPriorityDownloadsDidDrainNotification` is posted when it drops to 0.
+ 正在排队或下载中的非低优先级下载数
+ */
+@property (readonly, nonatomic) NSUInteger priorityDownloadCount;
+
+/**
+ * A downloader this one yields to: while it has priority downloads (see `priorityDownloadCount`), this downloader
+ * starts none of its queued downloads, and resumes when they drain. The downloads already running go on.
+ * The prefetcher's downloader yields to the shared downloader, so that prefetching never delays the visible images.
+ 让路的下载器：对方有非低优先级的下载时，本下载器不开始新的下载，对方的下载完成后自动恢复
+ */
+@property (weak, nonatomic) SDWebImageDownloader *foregroundDownloader;
+
+/**
+ * The average bandwidth of this downloader, in bytes per second. 0 for no cap (the default).
+ * The downloads are not throttled while they run: the start of the next download is delayed until the bytes
+ * received so far fit the cap.
+ 平均带宽上限（字节/秒），0为不限制；按已接收的字节数推迟下一个下载的开始
+ */
+@property (assign, nonatomic) NSUInteger maxBytesPerSecond;
+
 
 /**
  *  The timeout value (in seconds) for the download operation. Default: 15.0.
@@ -227,9 +378,32 @@ typedef NSDictionary *(^SDWebImageDownloaderHeadersFilterBlock)(NSURL *url, NSDi
                                         progress:(SDWebImageDownloaderProgressBlock)progressBlock
                                        completed:(SDWebImageDownloaderCompletedBlock)completedBlock;
 
+/**
+ * Same as `downloadImageWithURL:options:progress:completed:`, decoding the image for the given context
+ * (e.g. directly at a thumbnail size, see `SDWebImageContextThumbnailPixelSize`).
+ * Simultaneous requests for the same URL share a single download, each of them still gets an image decoded for its own context,
+ * on the decode pool. The image is decoded for the cache key in `SDWebImageContextCacheKey`, which `SDWebImageManager` sets.
+ *
+ * @param context The context to decode the image for, may be nil
+ 按上下文解码下载的图片；同一url的多个请求共享一次下载，但每个请求都会得到按自己的上下文解码的图片
+ */
+- (id <SDWebImageOperation>)downloadImageWithURL:(NSURL *)url
+                                         options:(SDWebImageDownloaderOptions)options
+                                         context:(NSDictionary *)context
+                                        progress:(SDWebImageDownloaderProgressBlock)progressBlock
+                                       completed:(SDWebImageDownloaderCompletedBlock)completedBlock;
+
 /**
  * Sets the download queue suspension state
  */
 - (void)setSuspended:(BOOL)suspended;
 
+/**
+ * Returns the queue statistics of every origin with queued or running downloads. An origin is forgotten, with its
+ * averages, once its last download finished.
+ *
+ * @return A dictionary mapping `host:port` strings to `SDWebImageDownloaderHostStatistics` snapshots
+ */
+- (NSDictionary *)hostStatistics;
+
 @end
@@ -8,24 +8,119 @@
 
 #import "SDWebImageDownloader.h"
 #import "SDWebImageDownloaderOperation.h"
+#import "SDWebImageDecoder.h"
+#import "SDWebImageDecodePool.h"
 #import <ImageIO/ImageIO.h>
+#import <stdatomic.h>
+
+NSString *const SDWebImageDownloaderPriorityDownloadsDidDrainNotification = @"SDWebImageDownloaderPriorityDownloadsDidDrainNotification";
+
+// Idle time a bandwidth capped downloader may catch up for, so that a pause does not turn into a burst
+static const NSTimeInterval kSDBandwidthBurstInterval = 1.0;
 
 static NSString *const kProgressCallbackKey = @"progress";
 static NSString *const kCompletedCallbackKey = @"completed";
+static NSString *const kContextCallbackKey = @"context";
+static NSString *const kOptionsCallbackKey = @"options";
+
+static void *SDWebImageDownloaderOperationFinishedContext = &SDWebImageDownloaderOperationFinishedContext;
+static void *SDWebImageDownloaderSchedulingQueueKey = &SDWebImageDownloaderSchedulingQueueKey;
+
+//用于区分不同源站的key，格式为host:port
+static NSString *SDHostKeyForURL(NSURL *url) {
+    NSString *host = url.host.lowercaseString ?: @"";
+    NSNumber *port = url.port;
+    if (!port) {
+        port = [url.scheme.lowercaseString isEqualToString:@"https"] ? @443 : @80;
+    }
+    return [NSString stringWithFormat:@"%@:%@", host, port];
+}
+
+@interface SDWebImageDownloaderHostStatistics ()
+
+@property (copy, nonatomic, readwrite) NSString *host;
+@property (assign, nonatomic, readwrite) NSUInteger runningCount;
+@property (assign, nonatomic, readwrite) NSUInteger pendingCount;
+@property (assign, nonatomic, readwrite) NSUInteger finishedCount;
+@property (assign, nonatomic, readwrite) NSTimeInterval averageQueueingTime;
+@property (assign, nonatomic, readwrite) NSTimeInterval averageDownloadTime;
+
+@end
+
+@implementation SDWebImageDownloaderHostStatistics
+
+- (NSString *)description {
+    return [NSString stringWithFormat:@"<%@: %p; host = %@; running = %lu; pending = %lu; finished = %lu; queueing = %.3fs; download = %.3fs>",
+            NSStringFromClass([self class]), self, self.host, (unsigned long)self.runningCount, (unsigned long)self.pendingCount,
+            (unsigned long)self.finishedCount, self.averageQueueingTime, self.averageDownloadTime];
+}
+
+@end
+
+// The operations of one origin that wait for a free slot, plus the bookkeeping used for the statistics.
+// Only accessed on the downloader's schedulingQueue.
+@interface SDWebImageDownloaderHostQueue : NSObject
+
+@property (copy, nonatomic) NSString *host;
+@property (strong, nonatomic) NSMutableArray *pendingOperations;
+@property (assign, nonatomic) NSUInteger runningCount;
+@property (assign, nonatomic) NSUInteger admittedCount;
+@property (assign, nonatomic) NSUInteger finishedCount;
+@property (assign, nonatomic) NSTimeInterval totalQueueingTime;
+@property (assign, nonatomic) NSTimeInterval totalDownloadTime;
+
+@end
+
+@implementation SDWebImageDownloaderHostQueue
+
+- (id)init {
+    if ((self = [super init])) {
+        _pendingOperations = [NSMutableArray new];
+    }
+    return self;
+}
+
+@end
 
 @interface SDWebImageDownloader ()
 
 @property (strong, nonatomic) NSOperationQueue *downloadQueue;
-@property (weak, nonatomic) NSOperation *lastAddedOperation;
 @property (assign, nonatomic) Class operationClass;
 @property (strong, nonatomic) NSMutableDictionary *URLCallbacks;
 @property (strong, nonatomic) NSMutableDictionary *HTTPHeaders;
 // This queue is used to serialize the handling of the network responses of all the download operation in a single queue
 @property (SDDispatchQueueSetterSementics, nonatomic) dispatch_queue_t barrierQueue;
 
+// Per-host scheduling state, only accessed on schedulingQueue
+// 按域名调度的状态，只在schedulingQueue上访问
+@property (SDDispatchQueueSetterSementics, nonatomic) dispatch_queue_t schedulingQueue;
+@property (strong, nonatomic) NSMutableDictionary *hostQueues;
+@property (strong, nonatomic) NSMutableArray *hostOrder;
+@property (assign, nonatomic) NSUInteger nextHostIndex;
+@property (assign, nonatomic) NSUInteger admittedCount;
+@property (strong, nonatomic) NSMapTable *admittedOperations;
+@property (strong, nonatomic) NSMapTable *operationTimestamps;
+// The queued and running operations which are not low priority
+@property (strong, nonatomic) NSHashTable *priorityOperations;
+// The time the bytes received so far take at maxBytesPerSecond, the next download starts once it has passed
+@property (assign, nonatomic) CFAbsoluteTime bandwidthClock;
+@property (assign, nonatomic) BOOL bandwidthSchedulingPending;
+
+// Adaptive concurrency state, only accessed on schedulingQueue
+// 自适应并发的状态，只在schedulingQueue上访问
+@property (assign, nonatomic) NSInteger concurrencyWindow;
+@property (assign, nonatomic) NSUInteger roundCompletedCount;
+@property (assign, nonatomic) NSUInteger roundReceivedSize;
+@property (assign, nonatomic) CFAbsoluteTime roundStartTime;
+@property (assign, nonatomic) double lastRoundGoodput;
+@property (assign, nonatomic) NSTimeInterval baseTimeToFirstByte;
+
 @end
 
-@implementation SDWebImageDownloader
+@implementation SDWebImageDownloader {
+    // Mirrors priorityOperations.count, read by the downloaders yielding to this one from their own queue
+    atomic_ulong _priorityDownloadCount;
+}
 
 + (void)initialize {
     // Bind SDNetworkActivityIndicator if available (download it here: http://github.com/rs/SDNetworkActivityIndicator )
@@ -72,13 +167,46 @@ static NSString *const kCompletedCallbackKey = @"completed";
         _HTTPHeaders = [NSMutableDictionary dictionaryWithObject:@"image/webp,image/*;q=0.8" forKey:@"Accept"];
         _barrierQueue = dispatch_queue_create("com.hackemist.SDWebImageDownloaderBarrierQueue", DISPATCH_QUEUE_CONCURRENT);
         _downloadTimeout = 15.0;//默认下载超时时长15秒
+        _maxConcurrentDownloadsPerHost = 0;
+        _minConcurrentDownloads = 2;
+        _concurrencyWindow = 2;
+        _schedulingQueue = dispatch_queue_create("com.hackemist.SDWebImageDownloaderSchedulingQueue", DISPATCH_QUEUE_SERIAL);
+        dispatch_queue_set_specific(_schedulingQueue, SDWebImageDownloaderSchedulingQueueKey, SDWebImageDownloaderSchedulingQueueKey, NULL);
+        _hostQueues = [NSMutableDictionary new];
+        _hostOrder = [NSMutableArray new];
+        _admittedOperations = [NSMapTable strongToStrongObjectsMapTable];
+        _operationTimestamps = [NSMapTable strongToStrongObjectsMapTable];
+        _priorityOperations = [[NSHashTable alloc] initWithOptions:NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPointerPersonality capacity:0];
+        atomic_init(&_priorityDownloadCount, 0);
     }
     return self;
 }
 
 - (void)dealloc {
-    [self.downloadQueue cancelAllOperations];
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+    // The scheduling state belongs to schedulingQueue. The last release may happen on it, e.g. at the end of a block,
+    // where a dispatch_sync would deadlock. The block must not retain the deallocating downloader
+    //调度状态只能在schedulingQueue上访问；最后一次释放可能就发生在该队列上，此时直接执行以免死锁
+    __unsafe_unretained SDWebImageDownloader *downloader = self;
+    NSDictionary *hostQueues = _hostQueues;
+    NSMapTable *admittedOperations = _admittedOperations;
+    dispatch_block_t cancelBlock = ^{
+        for (SDWebImageDownloaderHostQueue *hostQueue in hostQueues.allValues) {
+            [hostQueue.pendingOperations makeObjectsPerformSelector:@selector(cancel)];
+        }
+        for (NSOperation *operation in admittedOperations.keyEnumerator.allObjects) {
+            [operation removeObserver:downloader forKeyPath:@"isFinished" context:SDWebImageDownloaderOperationFinishedContext];
+        }
+    };
+    if (dispatch_get_specific(SDWebImageDownloaderSchedulingQueueKey)) {
+        cancelBlock();
+    }
+    else {
+        dispatch_sync(_schedulingQueue, cancelBlock);
+    }
+    [_downloadQueue cancelAllOperations];
     SDDispatchQueueRelease(_barrierQueue);
+    SDDispatchQueueRelease(_schedulingQueue);
 }
 
 //设置请求头
@@ -99,11 +227,74 @@ static NSString *const kCompletedCallbackKey = @"completed";
 //设置最大并发数
 - (void)setMaxConcurrentDownloads:(NSInteger)maxConcurrentDownloads {
     _downloadQueue.maxConcurrentOperationCount = maxConcurrentDownloads;
+    [self setNeedsScheduling];
+}
+
+- (void)setAdaptiveConcurrencyEnabled:(BOOL)adaptiveConcurrencyEnabled {
+    _adaptiveConcurrencyEnabled = adaptiveConcurrencyEnabled;
+    dispatch_async(self.schedulingQueue, ^{
+        // Start from the lower bound and let the additive increase find the right window
+        self.concurrencyWindow = [self minimumConcurrencyWindow];
+        [self resetConcurrencyRound];
+        self.lastRoundGoodput = 0;
+        [self scheduleOperations];
+    });
 }
 
-//获取当前并发数
+- (void)setForegroundDownloader:(SDWebImageDownloader *)foregroundDownloader {
+    if (_foregroundDownloader) {
+        [[NSNotificationCenter defaultCenter] removeObserver:self name:SDWebImageDownloaderPriorityDownloadsDidDrainNotification object:_foregroundDownloader];
+    }
+    _foregroundDownloader = foregroundDownloader;
+    if (foregroundDownloader) {
+        [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(foregroundDownloaderDidDrain:) name:SDWebImageDownloaderPriorityDownloadsDidDrainNotification object:foregroundDownloader];
+    }
+    [self setNeedsScheduling];
+}
+
+- (void)foregroundDownloaderDidDrain:(NSNotification *)notification {
+    [self setNeedsScheduling];
+}
+
+- (NSUInteger)priorityDownloadCount {
+    return atomic_load(&_priorityDownloadCount);
+}
+
+- (void)setMaxBytesPerSecond:(NSUInteger)maxBytesPerSecond {
+    _maxBytesPerSecond = maxBytesPerSecond;
+    [self setNeedsScheduling];
+}
+
+- (void)setMinConcurrentDownloads:(NSInteger)minConcurrentDownloads {
+    _minConcurrentDownloads = minConcurrentDownloads;
+    [self setNeedsScheduling];
+}
+
+- (NSInteger)currentConcurrencyWindow {
+    if (!self.adaptiveConcurrencyEnabled) {
+        return self.maxConcurrentDownloads;
+    }
+    __block NSInteger window = 0;
+    dispatch_sync(self.schedulingQueue, ^{
+        window = [self clampedConcurrencyWindow:self.concurrencyWindow];
+    });
+    return window;
+}
+
+- (void)setMaxConcurrentDownloadsPerHost:(NSUInteger)maxConcurrentDownloadsPerHost {
+    _maxConcurrentDownloadsPerHost = maxConcurrentDownloadsPerHost;
+    [self setNeedsScheduling];
+}
+
+//获取当前并发数（包括还在按域名排队、未进入downloadQueue的下载）
 - (NSUInteger)currentDownloadCount {
-    return _downloadQueue.operationCount;
+    __block NSUInteger pendingCount = 0;
+    dispatch_sync(self.schedulingQueue, ^{
+        for (SDWebImageDownloaderHostQueue *hostQueue in self.hostQueues.allValues) {
+            pendingCount += hostQueue.pendingOperations.count;
+        }
+    });
+    return _downloadQueue.operationCount + pendingCount;
 }
 
 //获取最大并发数
@@ -116,10 +307,18 @@ static NSString *const kCompletedCallbackKey = @"completed";
 }
 
 - (id <SDWebImageOperation>)downloadImageWithURL:(NSURL *)url options:(SDWebImageDownloaderOptions)options progress:(SDWebImageDownloaderProgressBlock)progressBlock completed:(SDWebImageDownloaderCompletedBlock)completedBlock {
+    return [self downloadImageWithURL:url options:options context:nil progress:progressBlock completed:completedBlock];
+}
+
+- (id <SDWebImageOperation>)downloadImageWithURL:(NSURL *)url options:(SDWebImageDownloaderOptions)options context:(NSDictionary *)context progress:(SDWebImageDownloaderProgressBlock)progressBlock completed:(SDWebImageDownloaderCompletedBlock)completedBlock {
     __block SDWebImageDownloaderOperation *operation;
     __weak __typeof(self)wself = self;
+    if (options & SDWebImageDownloaderDataOnly) {
+        // Nothing is decoded, there are no partial images to show
+        options &= ~SDWebImageDownloaderProgressiveDownload;
+    }
 
-    [self addProgressCallback:progressBlock andCompletedBlock:completedBlock forURL:url createCallback:^{
+    [self addProgressCallback:progressBlock andCompletedBlock:completedBlock context:context options:options forURL:url createCallback:^{
         NSTimeInterval timeoutInterval = wself.downloadTimeout;
         if (timeoutInterval == 0.0) {
             timeoutInterval = 15.0;
@@ -169,9 +368,35 @@ static NSString *const kCompletedCallbackKey = @"completed";
                                                                     [sself.URLCallbacks removeObjectForKey:url];
                                                                 }
                                                             });
+                                                            NSString *key = context[SDWebImageContextCacheKey] ?: url.absoluteString;
+                                                            NSString *variantKey = SDDecodeKeyForContext(key, context);
                                                             for (NSDictionary *callbacks in callbacksForURL) {
                                                                 SDWebImageDownloaderCompletedBlock callback = callbacks[kCompletedCallbackKey];
-                                                                if (callback) callback(image, data, error, finished);
+                                                                UIImage *callbackImage = image;
+                                                                NSDictionary *callbackContext = callbacks[kContextCallbackKey];
+                                                                SDWebImageDownloaderOptions callbackOptions = [callbacks[kOptionsCallbackKey] unsignedIntegerValue];
+                                                                if (callbackOptions & SDWebImageDownloaderDataOnly) {
+                                                                    callbackImage = nil;
+                                                                }
+                                                                else if (data && finished && !error && (image ? ![SDDecodeKeyForContext(key, callbackContext) isEqualToString:variantKey] : (options & SDWebImageDownloaderDataOnly))) {
+                                                                    // The image was decoded for the context of the request which started the download, or not at all,
+                                                                    // decode it for this one on the decode pool, like the first decode
+                                                                    //图片是按发起下载的请求的上下文解码的（或者没有解码），上下文不同的请求需要在解码池中重新解码
+                                                                    NSDictionary *decodeContext = SDContextFittingDecodeBudget(callbackContext, [NSData sd_imageHeaderForImageData:data], sself.maxDecodedPixelCount, sself.maxDecodedByteCount);
+                                                                    BOOL shouldDecompressImages = sself.shouldDecompressImages;
+                                                                    NSOperationQueuePriority priority = NSOperationQueuePriorityNormal;
+                                                                    if (callbackOptions & SDWebImageDownloaderHighPriority) {
+                                                                        priority = NSOperationQueuePriorityHigh;
+                                                                    } else if (callbackOptions & SDWebImageDownloaderLowPriority) {
+                                                                        priority = NSOperationQueuePriorityLow;
+                                                                    }
+                                                                    [[SDWebImageDecodePool sharedPool] addDecodeBlock:^{
+                                                                        UIImage *decodedImage = [UIImage decodedImageWithData:data key:key context:decodeContext decompress:shouldDecompressImages];
+                                                                        if (callback) callback(decodedImage, data, error, finished);
+                                                                    } cost:[SDWebImageDecodePool estimatedDecodedSizeForData:data context:decodeContext] priority:priority];
+                                                                    continue;
+                                                                }
+                                                                if (callback) callback(callbackImage, data, error, finished);
                                                             }
                                                         }
                                                         cancelled:^{
@@ -181,8 +406,16 @@ static NSString *const kCompletedCallbackKey = @"completed";
                                                                  //移除已经取消的url
                                                                 [sself.URLCallbacks removeObjectForKey:url];
                                                             });
+                                                            // A cancelled operation may still wait in its host queue, drop it and hand out its slot
+                                                            [sself setNeedsScheduling];
                                                         }];
         operation.shouldDecompressImages = wself.shouldDecompressImages;
+        operation.maxDecodedPixelCount = wself.maxDecodedPixelCount;
+        operation.maxDecodedByteCount = wself.maxDecodedByteCount;
+        operation.oversizedImagePolicy = wself.oversizedImagePolicy;
+        operation.context = context;
+        operation.imageCache = context[SDWebImageContextImageCache];
+        operation.cacheKey = context[SDWebImageContextCacheKey] ?: url.absoluteString;
         
         if (wself.username && wself.password) {
             operation.credential = [NSURLCredential credentialWithUser:wself.username password:wself.password persistence:NSURLCredentialPersistenceForSession];
@@ -207,20 +440,323 @@ static NSString *const kCompletedCallbackKey = @"completed";
             operation.queuePriority = NSOperationQueuePriorityLow;
         }
 
-        //将操作添加到队列开始下载
-        [wself.downloadQueue addOperation:operation];
-        if (wself.executionOrder == SDWebImageDownloaderLIFOExecutionOrder) {
-            // Emulate LIFO execution order by systematically adding new operations as last operation's dependency
-            //如果设置了SDWebImageDownloaderLIFOExecutionOrder，即先进先出，则添加依赖
-            [wself.lastAddedOperation addDependency:operation];
-            wself.lastAddedOperation = operation;
-        }
+        //将操作放入对应域名的等待队列，由调度器按域名轮流交给downloadQueue开始下载
+        [wself enqueueOperation:operation forURL:url options:options];
     }];
 
     return operation;
 }
 
-- (void)addProgressCallback:(SDWebImageDownloaderProgressBlock)progressBlock andCompletedBlock:(SDWebImageDownloaderCompletedBlock)completedBlock forURL:(NSURL *)url createCallback:(SDWebImageNoParamsBlock)createCallback {
+#pragma mark Per-host scheduling
+
+- (void)enqueueOperation:(NSOperation *)operation forURL:(NSURL *)url options:(SDWebImageDownloaderOptions)options {
+    NSString *hostKey = SDHostKeyForURL(url);
+    // LIFO order and high priority requests both go to the front of their host queue,
+    // this replaces the dependency chain previously used to emulate LIFO
+    //后进先出和高优先级的下载都插到该域名队列的最前面
+    BOOL toFront = (self.executionOrder == SDWebImageDownloaderLIFOExecutionOrder) || (options & SDWebImageDownloaderHighPriority);
+    dispatch_async(self.schedulingQueue, ^{
+        SDWebImageDownloaderHostQueue *hostQueue = self.hostQueues[hostKey];
+        if (!hostQueue) {
+            hostQueue = [SDWebImageDownloaderHostQueue new];
+            hostQueue.host = hostKey;
+            self.hostQueues[hostKey] = hostQueue;
+        }
+        if (toFront) {
+            [hostQueue.pendingOperations insertObject:operation atIndex:0];
+        } else {
+            [hostQueue.pendingOperations addObject:operation];
+        }
+        [self.operationTimestamps setObject:@(CFAbsoluteTimeGetCurrent()) forKey:operation];
+        if (!(options & SDWebImageDownloaderLowPriority)) {
+            [self.priorityOperations addObject:operation];
+            atomic_store(&_priorityDownloadCount, self.priorityOperations.count);
+        }
+        if (![self.hostOrder containsObject:hostKey]) {
+            [self.hostOrder addObject:hostKey];
+        }
+        [self scheduleOperations];
+    });
+}
+
+- (void)setNeedsScheduling {
+    dispatch_async(self.schedulingQueue, ^{
+        [self scheduleOperations];
+    });
+}
+
+// Must be called on schedulingQueue.
+// Hands free slots to the pending operations, visiting the hosts round-robin so that every origin gets its turn.
+//把空闲的并发名额按域名轮流分配给等待中的下载
+- (void)scheduleOperations {
+    // Cancelled operations still waiting for a slot no longer hold back the downloaders yielding to this one
+    //已取消、仍在排队的下载不再阻塞让路的下载器
+    for (NSOperation *operation in self.priorityOperations.allObjects) {
+        if (operation.isCancelled && ![self.admittedOperations objectForKey:operation]) {
+            [self removePriorityOperation:operation];
+        }
+    }
+    if (self.foregroundDownloader.priorityDownloadCount > 0) {
+        // Its drain notification schedules again
+        //等对方的下载完成后（收到通知）再调度
+        return;
+    }
+    if (self.maxBytesPerSecond > 0) {
+        CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+        if (self.bandwidthClock > now) {
+            [self scheduleOperationsAfterDelay:self.bandwidthClock - now];
+            return;
+        }
+    }
+    NSInteger limit = self.downloadQueue.maxConcurrentOperationCount;
+    if (self.adaptiveConcurrencyEnabled) {
+        limit = [self clampedConcurrencyWindow:self.concurrencyWindow];
+    }
+    NSUInteger perHostLimit = self.maxConcurrentDownloadsPerHost;
+
+    while (limit < 0 || self.admittedCount < (NSUInteger)limit) {
+        NSOperation *nextOperation = nil;
+        SDWebImageDownloaderHostQueue *nextHostQueue = nil;
+
+        NSUInteger hostCount = self.hostOrder.count;
+        for (NSUInteger i = 0; i < hostCount && !nextOperation; i++) {
+            NSUInteger index = (self.nextHostIndex + i) % hostCount;
+            SDWebImageDownloaderHostQueue *hostQueue = self.hostQueues[self.hostOrder[index]];
+            if (perHostLimit > 0 && hostQueue.runningCount >= perHostLimit) {
+                continue;
+            }
+            while (hostQueue.pendingOperations.count > 0) {
+                NSOperation *candidate = hostQueue.pendingOperations[0];
+                [hostQueue.pendingOperations removeObjectAtIndex:0];
+                if (candidate.isCancelled) {
+                    // Cancelled before getting a slot, the operation never starts
+                    [self.operationTimestamps removeObjectForKey:candidate];
+                    [self removePriorityOperation:candidate];
+                    continue;
+                }
+                nextOperation = candidate;
+                nextHostQueue = hostQueue;
+                self.nextHostIndex = index + 1;
+                break;
+            }
+        }
+
+        [self removeIdleHosts];
+        if (!nextOperation) {
+            break;
+        }
+        [self admitOperation:nextOperation fromHostQueue:nextHostQueue];
+    }
+}
+
+// Must be called on schedulingQueue.
+- (void)scheduleOperationsAfterDelay:(NSTimeInterval)delay {
+    if (self.bandwidthSchedulingPending) {
+        return;
+    }
+    self.bandwidthSchedulingPending = YES;
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), self.schedulingQueue, ^{
+        self.bandwidthSchedulingPending = NO;
+        [self scheduleOperations];
+    });
+}
+
+// Must be called on schedulingQueue.
+- (void)removePriorityOperation:(NSOperation *)operation {
+    if (![self.priorityOperations containsObject:operation]) {
+        return;
+    }
+    [self.priorityOperations removeObject:operation];
+    atomic_store(&_priorityDownloadCount, self.priorityOperations.count);
+    if (self.priorityOperations.count == 0) {
+        [[NSNotificationCenter defaultCenter] postNotificationName:SDWebImageDownloaderPriorityDownloadsDidDrainNotification object:self];
+    }
+}
+
+// Must be called on schedulingQueue.
+// Hosts without pending downloads leave the round-robin, and are forgotten once their last download finished
+//没有等待中的下载的域名移出轮询；最后一个下载结束后移除该域名的队列
+- (void)removeIdleHosts {
+    for (NSInteger index = (NSInteger)self.hostOrder.count - 1; index >= 0; index--) {
+        NSString *hostKey = self.hostOrder[(NSUInteger)index];
+        SDWebImageDownloaderHostQueue *hostQueue = self.hostQueues[hostKey];
+        if (hostQueue.pendingOperations.count == 0) {
+            if (hostQueue.runningCount == 0) {
+                [self.hostQueues removeObjectForKey:hostKey];
+            }
+            [self.hostOrder removeObjectAtIndex:(NSUInteger)index];
+            if ((NSUInteger)index < self.nextHostIndex) {
+                self.nextHostIndex--;
+            }
+        }
+    }
+    if (self.hostOrder.count == 0 || self.nextHostIndex >= self.hostOrder.count) {
+        self.nextHostIndex = 0;
+    }
+}
+
+// Must be called on schedulingQueue.
+- (void)admitOperation:(NSOperation *)operation fromHostQueue:(SDWebImageDownloaderHostQueue *)hostQueue {
+    CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+    NSNumber *enqueueTime = [self.operationTimestamps objectForKey:operation];
+    if (enqueueTime) {
+        hostQueue.totalQueueingTime += now - enqueueTime.doubleValue;
+    }
+    [self.operationTimestamps setObject:@(now) forKey:operation];
+
+    hostQueue.runningCount++;
+    hostQueue.admittedCount++;
+    self.admittedCount++;
+    [self.admittedOperations setObject:hostQueue forKey:operation];
+
+    [operation addObserver:self forKeyPath:@"isFinished" options:0 context:SDWebImageDownloaderOperationFinishedContext];
+    //将操作添加到队列开始下载
+    [self.downloadQueue addOperation:operation];
+}
+
+// Must be called on schedulingQueue.
+- (void)operationDidFinish:(NSOperation *)operation {
+    SDWebImageDownloaderHostQueue *hostQueue = [self.admittedOperations objectForKey:operation];
+    if (!hostQueue) {
+        return;
+    }
+    [operation removeObserver:self forKeyPath:@"isFinished" context:SDWebImageDownloaderOperationFinishedContext];
+    [self.admittedOperations removeObjectForKey:operation];
+
+    NSNumber *admitTime = [self.operationTimestamps objectForKey:operation];
+    if (admitTime) {
+        hostQueue.totalDownloadTime += CFAbsoluteTimeGetCurrent() - admitTime.doubleValue;
+    }
+    [self.operationTimestamps removeObjectForKey:operation];
+
+    hostQueue.runningCount--;
+    hostQueue.finishedCount++;
+    self.admittedCount--;
+    if (hostQueue.runningCount == 0 && hostQueue.pendingOperations.count == 0 && self.hostQueues[hostQueue.host] == hostQueue) {
+        // No longer in the round-robin, see removeIdleHosts
+        [self.hostQueues removeObjectForKey:hostQueue.host];
+    }
+    [self removePriorityOperation:operation];
+    if (self.maxBytesPerSecond > 0 && [operation isKindOfClass:[SDWebImageDownloaderOperation class]]) {
+        // Charge the bytes received to the bandwidth clock, idle time only counts up to the burst interval
+        //把接收的字节数计入带宽时钟，空闲时间最多抵扣一个突发间隔
+        CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+        self.bandwidthClock = MAX(self.bandwidthClock, now - kSDBandwidthBurstInterval) + (double)((SDWebImageDownloaderOperation *)operation).receivedSize / self.maxBytesPerSecond;
+    }
+    if (self.adaptiveConcurrencyEnabled && [operation isKindOfClass:[SDWebImageDownloaderOperation class]]) {
+        [self updateConcurrencyWindowWithOperation:(SDWebImageDownloaderOperation *)operation];
+    }
+    [self scheduleOperations];
+}
+
+#pragma mark Adaptive concurrency
+
+- (NSInteger)minimumConcurrencyWindow {
+    return MAX(1, self.minConcurrentDownloads);
+}
+
+- (NSInteger)maximumConcurrencyWindow {
+    NSInteger maximum = self.downloadQueue.maxConcurrentOperationCount;
+    if (maximum < 0) {
+        // NSOperationQueueDefaultMaxConcurrentOperationCount, use a sane upper bound for a single client
+        maximum = 16;
+    }
+    return MAX([self minimumConcurrencyWindow], maximum);
+}
+
+- (NSInteger)clampedConcurrencyWindow:(NSInteger)window {
+    return MIN([self maximumConcurrencyWindow], MAX([self minimumConcurrencyWindow], window));
+}
+
+// Must be called on schedulingQueue.
+- (void)resetConcurrencyRound {
+    self.roundCompletedCount = 0;
+    self.roundReceivedSize = 0;
+    self.roundStartTime = CFAbsoluteTimeGetCurrent();
+}
+
+// Must be called on schedulingQueue.
+// Additive increase once per round while the goodput holds up, multiplicative decrease on congestion signals.
+//每一轮吞吐量没有下降就把窗口加1；出现超时、首字节时间明显变长或吞吐量骤降时窗口减半
+- (void)updateConcurrencyWindowWithOperation:(SDWebImageDownloaderOperation *)operation {
+    NSError *error = operation.error;
+    if (!error && operation.isCancelled) {
+        // A cancellation says nothing about the network
+        return;
+    }
+
+    NSTimeInterval timeToFirstByte = operation.timeToFirstByte;
+    if (timeToFirstByte > 0) {
+        if (self.baseTimeToFirstByte == 0 || timeToFirstByte < self.baseTimeToFirstByte) {
+            self.baseTimeToFirstByte = timeToFirstByte;
+        }
+    }
+
+    NSTimeInterval timeout = self.downloadTimeout > 0 ? self.downloadTimeout : 15.0;
+    BOOL timedOut = [error.domain isEqualToString:NSURLErrorDomain] && error.code == NSURLErrorTimedOut;
+    // The response took both much longer than the best one seen and a sizeable part of the timeout: requests are queueing up
+    BOOL latencyInflated = timeToFirstByte > 0 && timeToFirstByte > 3 * self.baseTimeToFirstByte && timeToFirstByte > timeout / 4;
+    if (timedOut || latencyInflated) {
+        self.concurrencyWindow = [self clampedConcurrencyWindow:self.concurrencyWindow / 2];
+        // Let the minimum slowly forget old measurements so a changed network gets a new baseline
+        self.baseTimeToFirstByte *= 1.5;
+        self.lastRoundGoodput = 0;
+        [self resetConcurrencyRound];
+        return;
+    }
+    if (error) {
+        // HTTP errors and the like are not a congestion signal
+        return;
+    }
+
+    self.roundCompletedCount++;
+    self.roundReceivedSize += operation.receivedSize;
+    if (self.roundCompletedCount < (NSUInteger)[self clampedConcurrencyWindow:self.concurrencyWindow]) {
+        return;
+    }
+
+    NSTimeInterval elapsed = CFAbsoluteTimeGetCurrent() - self.roundStartTime;
+    double goodput = elapsed > 0 ? self.roundReceivedSize / elapsed : 0;
+    if (self.lastRoundGoodput > 0 && goodput < self.lastRoundGoodput * 0.5) {
+        self.concurrencyWindow = [self clampedConcurrencyWindow:self.concurrencyWindow / 2];
+    } else if (self.lastRoundGoodput == 0 || goodput >= self.lastRoundGoodput * 0.9) {
+        self.concurrencyWindow = [self clampedConcurrencyWindow:self.concurrencyWindow + 1];
+    }
+    self.lastRoundGoodput = goodput;
+    [self resetConcurrencyRound];
+}
+
+- (void)observeValueForKeyPath:(NSString *)keyPath ofObject:(id)object change:(NSDictionary *)change context:(void *)context {
+    if (context == SDWebImageDownloaderOperationFinishedContext) {
+        NSOperation *operation = object;
+        if (operation.isFinished) {
+            dispatch_async(self.schedulingQueue, ^{
+                [self operationDidFinish:operation];
+            });
+        }
+    } else {
+        [super observeValueForKeyPath:keyPath ofObject:object change:change context:context];
+    }
+}
+
+- (NSDictionary *)hostStatistics {
+    NSMutableDictionary *statistics = [NSMutableDictionary new];
+    dispatch_sync(self.schedulingQueue, ^{
+        for (SDWebImageDownloaderHostQueue *hostQueue in self.hostQueues.allValues) {
+            SDWebImageDownloaderHostStatistics *snapshot = [SDWebImageDownloaderHostStatistics new];
+            snapshot.host = hostQueue.host;
+            snapshot.runningCount = hostQueue.runningCount;
+            snapshot.pendingCount = hostQueue.pendingOperations.count;
+            snapshot.finishedCount = hostQueue.finishedCount;
+            snapshot.averageQueueingTime = hostQueue.admittedCount > 0 ? hostQueue.totalQueueingTime / hostQueue.admittedCount : 0;
+            snapshot.averageDownloadTime = hostQueue.finishedCount > 0 ? hostQueue.totalDownloadTime / hostQueue.finishedCount : 0;
+            statistics[hostQueue.host] = snapshot;
+        }
+    });
+    return [statistics copy];
+}
+
+- (void)addProgressCallback:(SDWebImageDownloaderProgressBlock)progressBlock andCompletedBlock:(SDWebImageDownloaderCompletedBlock)completedBlock context:(NSDictionary *)context options:(SDWebImageDownloaderOptions)options forURL:(NSURL *)url createCallback:(SDWebImageNoParamsBlock)createCallback {
     // The URL will be used as the key to the callbacks dictionary so it cannot be nil. If it is nil immediately call the completed block with no image or data.
     if (url == nil) {
         if (completedBlock != nil) {
@@ -249,6 +785,8 @@ static NSString *const kCompletedCallbackKey = @"completed";
         NSMutableDictionary *callbacks = [NSMutableDictionary new];
         if (progressBlock) callbacks[kProgressCallbackKey] = [progressBlock copy];
         if (completedBlock) callbacks[kCompletedCallbackKey] = [completedBlock copy];
+        if (context) callbacks[kContextCallbackKey] = [context copy];
+        callbacks[kOptionsCallbackKey] = @(options);
         [callbacksForURL addObject:callbacks];
         self.URLCallbacks[url] = callbacksForURL;
         /**
@@ -10,6 +10,8 @@
 #import "SDWebImageDownloader.h"
 #import "SDWebImageOperation.h"
 
+@class SDImageCache;
+
 extern NSString *const SDWebImageDownloadStartNotification;
 extern NSString *const SDWebImageDownloadReceiveResponseNotification;
 extern NSString *const SDWebImageDownloadStopNotification;
@@ -44,6 +46,28 @@ extern NSString *const SDWebImageDownloadFinishNotification;
  */
 @property (assign, nonatomic, readonly) SDWebImageDownloaderOptions options;
 
+/**
+ * The decode budget and what to do with an image exceeding it, see `SDWebImageDownloader`.
+ */
+@property (assign, nonatomic) NSUInteger maxDecodedPixelCount;
+@property (assign, nonatomic) NSUInteger maxDecodedByteCount;
+@property (assign, nonatomic) SDWebImageDownloaderOversizedImagePolicy oversizedImagePolicy;
+
+/**
+ * The context the downloaded image is decoded for, see `SDWebImageContextThumbnailPixelSize`.
+ 解码图片时使用的上下文
+ */
+@property (copy, nonatomic) NSDictionary *context;
+
+/**
+ * The cache the partial data of an interrupted download is kept in, so that a later download resumes it, and the
+ * body streamed to disk is moved into once it decoded, and the key they are kept under. Set by the downloader from
+ * `SDWebImageContextImageCache` and `SDWebImageContextCacheKey`. Without a cache the download is not resumed.
+ 保存断点续传数据和流式下载数据的缓存及其key，没有缓存时不断点续传
+ */
+@property (strong, nonatomic) SDImageCache *imageCache;
+@property (copy, nonatomic) NSString *cacheKey;
+
 /**
  * The expected size of data.
  总的需要下载的数据大小
@@ -55,6 +79,28 @@ extern NSString *const SDWebImageDownloadFinishNotification;
  */
 @property (strong, nonatomic) NSURLResponse *response;
 
+/**
+ * Time (in seconds) between the start of the connection and the arrival of the response. 0 until a response arrived.
+ 从开始连接到收到响应的时间
+ */
+@property (assign, nonatomic, readonly) NSTimeInterval timeToFirstByte;
+
+/**
+ * Time (in seconds) between the start of the connection and its end (success, failure or cancellation).
+ */
+@property (assign, nonatomic, readonly) NSTimeInterval transferDuration;
+
+/**
+ * The number of body bytes received so far.
+ 已经接收到的数据大小
+ */
+@property (assign, nonatomic, readonly) NSUInteger receivedSize;
+
+/**
+ * The error the operation failed with, if any.
+ */
+@property (strong, nonatomic, readonly) NSError *error;
+
 /**
  *  Initializes a `SDWebImageDownloaderOperation` object
  *
@@ -10,7 +10,9 @@
 #import "SDWebImageDecoder.h"
 #import "UIImage+MultiFormat.h"
 #import <ImageIO/ImageIO.h>
-#import "SDWebImageManager.h"
+#import "SDImageCache.h"
+#import "SDWebImageDecodePool.h"
+#import "SDWebImageCoder.h"
 
 //下载开始
 NSString *const SDWebImageDownloadStartNotification = @"SDWebImageDownloadStartNotification";
@@ -21,6 +23,29 @@ NSString *const SDWebImageDownloadStopNotification = @"SDWebImageDownloadStopNot
 //下载结束
 NSString *const SDWebImageDownloadFinishNotification = @"SDWebImageDownloadFinishNotification";
 
+// Interrupted downloads smaller than this are simply restarted, resuming them is not worth the extra request headers and disk write
+//小于该值的未完成数据不保存，直接重新下载
+static const NSUInteger kSDMinimumResumableDataLength = 32 * 1024;
+
+// With SDWebImageDownloaderStreamToDisk, bodies announced smaller than this are still kept in memory
+//小于该值的图片即使设置了SDWebImageDownloaderStreamToDisk也直接保存在内存中
+static const NSInteger kSDMinimumStreamedDataLength = 256 * 1024;
+
+// HTTP header names are case-insensitive, allHeaderFields keeps the case the server sent
+//HTTP头部字段名不区分大小写
+static NSString *SDHTTPHeaderValue(NSDictionary *headers, NSString *name) {
+    NSString *value = headers[name];
+    if (value) {
+        return value;
+    }
+    for (NSString *field in headers) {
+        if ([field caseInsensitiveCompare:name] == NSOrderedSame) {
+            return headers[field];
+        }
+    }
+    return nil;
+}
+
 @interface SDWebImageDownloaderOperation () <NSURLConnectionDataDelegate>
 
 @property (copy, nonatomic) SDWebImageDownloaderProgressBlock progressBlock;
@@ -34,6 +59,11 @@ NSString *const SDWebImageDownloadFinishNotification = @"SDWebImageDownloadFinis
 @property (strong, nonatomic) NSURLConnection *connection;
 @property (strong, atomic) NSThread *thread;
 
+@property (assign, nonatomic, readwrite) NSTimeInterval timeToFirstByte;
+@property (assign, nonatomic, readwrite) NSTimeInterval transferDuration;
+@property (assign, nonatomic, readwrite) NSUInteger receivedSize;
+@property (strong, nonatomic, readwrite) NSError *error;
+
 #if TARGET_OS_IPHONE && __IPHONE_OS_VERSION_MAX_ALLOWED >= __IPHONE_4_0
 @property (assign, nonatomic) UIBackgroundTaskIdentifier backgroundTaskId;
 #endif
@@ -41,9 +71,18 @@ NSString *const SDWebImageDownloadFinishNotification = @"SDWebImageDownloadFinis
 @end
 
 @implementation SDWebImageDownloaderOperation {
-    size_t width, height;
-    UIImageOrientation orientation;
     BOOL responseFromCached;
+    CFAbsoluteTime startTime;
+    NSData *resumeData;         // partial body of a previous attempt, sent as Range request
+    NSString *resumeValidator;  // the partial body's ETag / Last-Modified, sent as If-Range
+    NSString *responseValidator;
+    BOOL responseAcceptsRanges;
+    NSString *streamFilePath;       // temporary file the body is written to with SDWebImageDownloaderStreamToDisk
+    NSFileHandle *streamFileHandle;
+    id<SDWebImageProgressiveCoder> progressiveCoder; // decodes the data as it arrives, with SDWebImageDownloaderProgressiveDownload
+    BOOL progressiveCoderChecked;                    // the coders were asked, progressiveCoder may still be nil
+    NSMutableData *headerData;  // the first bytes of a body streamed to disk, until the header is read
+    BOOL headerChecked;         // the size of the image was compared to the decode budget, or could not be read
 }
 
 @synthesize executing = _executing;
@@ -113,20 +152,33 @@ NSString *const SDWebImageDownloadFinishNotification = @"SDWebImageDownloadFinis
 #endif
 
         self.executing = YES;
-        self.connection = [[NSURLConnection alloc] initWithRequest:self.request delegate:self startImmediately:NO];
+        startTime = CFAbsoluteTimeGetCurrent();
         self.thread = [NSThread currentThread];
     }
 
-    [self.connection start];
-
-    if (self.connection) {
-        if (self.progressBlock) {
-            self.progressBlock(0, NSURLResponseUnknownLength);
-        }
-        dispatch_async(dispatch_get_main_queue(), ^{
-            [[NSNotificationCenter defaultCenter] postNotificationName:SDWebImageDownloadStartNotification object:self];
-        });
+    // The partial data of an interrupted download is read by the cache on its IO queue, the connection starts on this
+    // thread once it arrived. Until then a port keeps the runloop running. A request for a specific range is not resumed
+    //断点续传的数据由缓存在IO队列上异步读取，读取完成后再在本线程开始连接；在此之前用一个port保持runloop运行
+    NSPort *waitingPort = nil;
+    if (self.imageCache && self.cacheKey && ![self.request valueForHTTPHeaderField:@"Range"]) {
+        waitingPort = [NSMachPort port];
+        [[NSRunLoop currentRunLoop] addPort:waitingPort forMode:NSDefaultRunLoopMode];
+        [self.imageCache queryPartialDataForKey:self.cacheKey completion:^(NSData *data, NSString *validator) {
+            @synchronized (self) {
+                // No thread once cancelled
+                if (self.thread) {
+                    resumeData = validator.length > 0 ? data : nil;
+                    resumeValidator = validator;
+                    [self performSelector:@selector(startConnection) onThread:self.thread withObject:nil waitUntilDone:NO];
+                }
+            }
+        }];
+    }
+    else {
+        [self startConnection];
+    }
 
+    if (!self.isFinished) {
         if (floor(NSFoundationVersionNumber) <= NSFoundationVersionNumber_iOS_5_1) {
             // Make sure to run the runloop in our background thread so it can process downloaded data
             // Note: we use a timeout to work around an issue with NSURLConnection cancel under iOS 5
@@ -141,11 +193,9 @@ NSString *const SDWebImageDownloadFinishNotification = @"SDWebImageDownloadFinis
             [self.connection cancel];
             [self connection:self.connection didFailWithError:[NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorTimedOut userInfo:@{NSURLErrorFailingURLErrorKey : self.request.URL}]];
         }
-    }else {
-        //Connection没有初始化
-        if (self.completedBlock) {
-            self.completedBlock(nil, nil, [NSError errorWithDomain:NSURLErrorDomain code:0 userInfo:@{NSLocalizedDescriptionKey : @"Connection can't be initialized"}], YES);
-        }
+    }
+    if (waitingPort) {
+        [[NSRunLoop currentRunLoop] removePort:waitingPort forMode:NSDefaultRunLoopMode];
     }
 
 #if TARGET_OS_IPHONE && __IPHONE_OS_VERSION_MAX_ALLOWED >= __IPHONE_4_0
@@ -156,6 +206,36 @@ NSString *const SDWebImageDownloadFinishNotification = @"SDWebImageDownloadFinis
 #endif
 }
 
+// Called on the operation's thread
+- (void)startConnection {
+    @synchronized (self) {
+        if (self.isFinished || self.isCancelled) {
+            return;
+        }
+        [self prepareResumeRequest];
+        self.connection = [[NSURLConnection alloc] initWithRequest:self.request delegate:self startImmediately:NO];
+    }
+
+    [self.connection start];
+
+    if (self.connection) {
+        if (self.progressBlock) {
+            self.progressBlock(0, NSURLResponseUnknownLength);
+        }
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [[NSNotificationCenter defaultCenter] postNotificationName:SDWebImageDownloadStartNotification object:self];
+        });
+    }else {
+        //Connection没有初始化
+        if (self.completedBlock) {
+            self.completedBlock(nil, nil, [NSError errorWithDomain:NSURLErrorDomain code:0 userInfo:@{NSLocalizedDescriptionKey : @"Connection can't be initialized"}], YES);
+        }
+        // Finish the operation, otherwise it would keep its download slot forever
+        [self done];
+        CFRunLoopStop(CFRunLoopGetCurrent());
+    }
+}
+
 - (void)cancel {
     @synchronized (self) {
         if (self.thread) {
@@ -173,12 +253,81 @@ NSString *const SDWebImageDownloadFinishNotification = @"SDWebImageDownloadFinis
     CFRunLoopStop(CFRunLoopGetCurrent());
 }
 
+#pragma mark Resumable downloads
+
+//如果有上次下载未完成的数据，则在请求头中加入Range/If-Range从断点继续下载
+- (void)prepareResumeRequest {
+    if (resumeData.length == 0 || resumeValidator.length == 0) {
+        resumeData = nil;
+        return;
+    }
+    NSMutableURLRequest *request = [self.request mutableCopy];
+    [request setValue:[NSString stringWithFormat:@"bytes=%lu-", (unsigned long)resumeData.length] forHTTPHeaderField:@"Range"];
+    // If the image changed on the server, If-Range makes it answer with the full new body instead of a range of it
+    [request setValue:resumeValidator forHTTPHeaderField:@"If-Range"];
+    _request = [request copy];
+}
+
+// A 206 that can't be appended to the partial data is not the whole image either: the partial data is dropped and the
+// image downloaded again without Range. A 206 to a request without Range fails the download
+//206响应不能接在断点数据后面时，丢弃断点数据并重新完整下载；未请求Range却返回206则下载失败
+- (void)rejectPartialResponse {
+    responseAcceptsRanges = NO;
+    [self.connection cancel];
+    if (resumeData) {
+        [self.imageCache removePartialDataForKey:self.cacheKey];
+        resumeData = nil;
+        NSMutableURLRequest *request = [self.request mutableCopy];
+        [request setValue:nil forHTTPHeaderField:@"Range"];
+        [request setValue:nil forHTTPHeaderField:@"If-Range"];
+        _request = [request copy];
+        [self startConnection];
+        return;
+    }
+    [self connection:self.connection didFailWithError:[NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorBadServerResponse userInfo:@{NSURLErrorFailingURLErrorKey : self.request.URL}]];
+}
+
+// Returns the start offset of a `Content-Range: bytes start-end/total` header, or NSNotFound
++ (NSUInteger)startOffsetOfContentRange:(NSString *)contentRange total:(NSUInteger *)total {
+    NSScanner *scanner = [NSScanner scannerWithString:contentRange ?: @""];
+    long long start = 0, end = 0, length = 0;
+    if (![scanner scanString:@"bytes" intoString:NULL] ||
+        ![scanner scanLongLong:&start] ||
+        ![scanner scanString:@"-" intoString:NULL] ||
+        ![scanner scanLongLong:&end] ||
+        ![scanner scanString:@"/" intoString:NULL]) {
+        return NSNotFound;
+    }
+    if (total) {
+        *total = [scanner scanLongLong:&length] ? (NSUInteger)length : 0;
+    }
+    return start >= 0 ? (NSUInteger)start : NSNotFound;
+}
+
+//下载失败或取消时，保存已经下载的数据，以便下次断点续传
+- (void)persistPartialDataIfNeeded {
+    NSData *data = self.imageData;
+    if (streamFileHandle) {
+        [streamFileHandle synchronizeFile];
+        data = [NSData dataWithContentsOfFile:streamFilePath options:NSDataReadingMappedIfSafe error:nil];
+    }
+    if (!responseAcceptsRanges || responseValidator.length == 0 || data.length < kSDMinimumResumableDataLength) {
+        return;
+    }
+    if (self.expectedSize > 0 && data.length >= (NSUInteger)self.expectedSize) {
+        return;
+    }
+    [self.imageCache storePartialData:[data copy] validator:responseValidator expectedSize:self.expectedSize forKey:self.cacheKey];
+}
+
 - (void)cancelInternal {
     if (self.isFinished) return;
+    [self persistPartialDataIfNeeded];
     [super cancel];
     if (self.cancelBlock) self.cancelBlock();
 
-    if (self.connection) {
+    if (self.connection || self.isExecuting) {
+        // Still waiting for the partial data when there is no connection
         [self.connection cancel];
         dispatch_async(dispatch_get_main_queue(), ^{
             [[NSNotificationCenter defaultCenter] postNotificationName:SDWebImageDownloadStopNotification object:self];
@@ -186,6 +335,9 @@ NSString *const SDWebImageDownloadFinishNotification = @"SDWebImageDownloadFinis
 
         // As we cancelled the connection, its callback won't be called and thus won't
         // maintain the isFinished and isExecuting flags.
+        if (startTime > 0 && self.transferDuration == 0) {
+            self.transferDuration = CFAbsoluteTimeGetCurrent() - startTime;
+        }
         if (self.isExecuting) self.executing = NO;
         if (!self.isFinished) self.finished = YES;
     }
@@ -194,6 +346,9 @@ NSString *const SDWebImageDownloadFinishNotification = @"SDWebImageDownloadFinis
 }
 
 - (void)done {
+    if (startTime > 0 && self.transferDuration == 0) {
+        self.transferDuration = CFAbsoluteTimeGetCurrent() - startTime;
+    }
     self.finished = YES;
     self.executing = NO;
     [self reset];
@@ -206,6 +361,85 @@ NSString *const SDWebImageDownloadFinishNotification = @"SDWebImageDownloadFinis
     self.connection = nil;
     self.imageData = nil;
     self.thread = nil;
+    [self closeStreamFile];
+    [self resetProgressiveCoder];
+}
+
+- (void)dealloc {
+    [self resetProgressiveCoder];
+}
+
+#pragma mark Streaming to disk
+
+- (BOOL)shouldStreamToDiskWithExpectedSize:(NSInteger)expectedSize {
+    if (!(self.options & SDWebImageDownloaderStreamToDisk) || self.options & SDWebImageDownloaderProgressiveDownload) {
+        return NO;
+    }
+    // An unknown length may well be a large image
+    return expectedSize == 0 || expectedSize >= kSDMinimumStreamedDataLength;
+}
+
+//创建临时文件，下载的数据写入该文件
+- (BOOL)openStreamFile {
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:[NSString stringWithFormat:@"SDWebImage-%@", [NSUUID UUID].UUIDString]];
+    if (![[NSFileManager defaultManager] createFileAtPath:path contents:nil attributes:nil]) {
+        return NO;
+    }
+    NSFileHandle *fileHandle = [NSFileHandle fileHandleForWritingAtPath:path];
+    if (!fileHandle) {
+        [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+        return NO;
+    }
+    streamFilePath = path;
+    streamFileHandle = fileHandle;
+    return YES;
+}
+
+- (BOOL)writeStreamData:(NSData *)data {
+    @try {
+        [streamFileHandle writeData:data];
+    }
+    @catch (NSException *exception) {
+        // e.g. the disk is full
+        return NO;
+    }
+    return YES;
+}
+
+// Closes the temporary file and removes it if it wasn't handed over by -detachStreamFile
+- (void)closeStreamFile {
+    if (!streamFilePath) {
+        return;
+    }
+    [streamFileHandle closeFile];
+    streamFileHandle = nil;
+    [[NSFileManager defaultManager] removeItemAtPath:streamFilePath error:nil];
+    streamFilePath = nil;
+}
+
+// Closes the temporary file and hands it over to the caller, who moves it into the cache or deletes it
+//下载完成后关闭临时文件并交给调用方：解码成功后移入磁盘缓存，否则删除
+- (NSString *)detachStreamFile {
+    [streamFileHandle closeFile];
+    streamFileHandle = nil;
+    NSString *path = streamFilePath;
+    streamFilePath = nil;
+    return path;
+}
+
+// Moves a body streamed to disk into the disk cache once it decoded, deletes it otherwise.
+// A mapped NSData of the file stays valid either way
++ (void)finishStreamedFileAtPath:(NSString *)path decoded:(BOOL)decoded imageCache:(SDImageCache *)imageCache key:(NSString *)key {
+    if (!path) {
+        return;
+    }
+    if (!decoded || !key || ![imageCache storeImageDataFromFileAtPath:path forKey:key]) {
+        [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+    }
+}
+
+- (NSUInteger)downloadedLength {
+    return streamFileHandle ? (NSUInteger)streamFileHandle.offsetInFile : self.imageData.length;
 }
 
 - (void)setFinished:(BOOL)finished {
@@ -227,16 +461,62 @@ NSString *const SDWebImageDownloadFinishNotification = @"SDWebImageDownloadFinis
 #pragma mark NSURLConnection (delegate)
 
 - (void)connection:(NSURLConnection *)connection didReceiveResponse:(NSURLResponse *)response {
-    
+    self.timeToFirstByte = CFAbsoluteTimeGetCurrent() - startTime;
+
     //'304 Not Modified' is an exceptional one
     if (![response respondsToSelector:@selector(statusCode)] || ([((NSHTTPURLResponse *)response) statusCode] < 400 && [((NSHTTPURLResponse *)response) statusCode] != 304)) {
         NSInteger expected = response.expectedContentLength > 0 ? (NSInteger)response.expectedContentLength : 0;
+        NSData *resumedData = nil;
+
+        if ([response isKindOfClass:[NSHTTPURLResponse class]]) {
+            NSHTTPURLResponse *HTTPResponse = (NSHTTPURLResponse *)response;
+            NSDictionary *headers = HTTPResponse.allHeaderFields;
+            // Only strong validators are allowed in If-Range
+            NSString *ETag = SDHTTPHeaderValue(headers, @"ETag");
+            responseValidator = (ETag.length > 0 && ![ETag hasPrefix:@"W/"]) ? ETag : SDHTTPHeaderValue(headers, @"Last-Modified");
+            responseAcceptsRanges = ![[SDHTTPHeaderValue(headers, @"Accept-Ranges") lowercaseString] isEqualToString:@"none"];
+
+            if (HTTPResponse.statusCode == 206 && resumeData) {
+                NSUInteger total = 0;
+                NSUInteger start = [[self class] startOffsetOfContentRange:SDHTTPHeaderValue(headers, @"Content-Range") total:&total];
+                if (start == resumeData.length) {
+                    //服务器返回了剩余部分，接着上次的数据继续下载
+                    resumedData = resumeData;
+                    expected = total > 0 ? (NSInteger)total : (NSInteger)resumeData.length + expected;
+                    responseValidator = responseValidator ?: resumeValidator;
+                    responseAcceptsRanges = YES;
+                }
+            }
+            // A range that does not continue the partial data, or that was never asked for
+            if (HTTPResponse.statusCode == 206 && !resumedData && (resumeData || ![self.request valueForHTTPHeaderField:@"Range"])) {
+                [self rejectPartialResponse];
+                return;
+            }
+        }
+        if (resumeData && !resumedData) {
+            // The server ignored the range and sent the whole (possibly changed) image, the old partial data is useless
+            [self.imageCache removePartialDataForKey:self.cacheKey];
+        }
+        resumeData = nil;
+
         self.expectedSize = expected;
         if (self.progressBlock) {
-            self.progressBlock(0, expected);
+            self.progressBlock(resumedData.length, expected);
         }
 
-        self.imageData = [[NSMutableData alloc] initWithCapacity:expected];
+        if ([self shouldStreamToDiskWithExpectedSize:expected] && [self openStreamFile] && (!resumedData || [self writeStreamData:resumedData])) {
+            self.imageData = nil;
+        }
+        else {
+            [self closeStreamFile];
+            [self resetProgressiveCoder];
+            self.imageData = [[NSMutableData alloc] initWithCapacity:expected];
+            if (resumedData) {
+                [self.imageData appendData:resumedData];
+            }
+        }
+        headerChecked = NO;
+        headerData = self.imageData ? nil : [[resumedData subdataWithRange:NSMakeRange(0, MIN(resumedData.length, SDImageHeaderMaxLength))] mutableCopy] ?: [NSMutableData data];
         self.response = response;
         dispatch_async(dispatch_get_main_queue(), ^{
             [[NSNotificationCenter defaultCenter] postNotificationName:SDWebImageDownloadReceiveResponseNotification object:self];
@@ -247,6 +527,11 @@ NSString *const SDWebImageDownloadFinishNotification = @"SDWebImageDownloadFinis
         
         //This is the case when server returns '304 Not Modified'. It means that remote image is not changed.
         //In case of 304 we need just cancel the operation and return cached image from the cache.
+        if (resumeData) {
+            // e.g. '416 Range Not Satisfiable', start from scratch next time
+            [self.imageCache removePartialDataForKey:self.cacheKey];
+            resumeData = nil;
+        }
         if (code == 304) {
             [self cancelInternal];
         } else {
@@ -256,8 +541,9 @@ NSString *const SDWebImageDownloadFinishNotification = @"SDWebImageDownloadFinis
             [[NSNotificationCenter defaultCenter] postNotificationName:SDWebImageDownloadStopNotification object:self];
         });
 
+        self.error = [NSError errorWithDomain:NSURLErrorDomain code:[((NSHTTPURLResponse *)response) statusCode] userInfo:nil];
         if (self.completedBlock) {
-            self.completedBlock(nil, nil, [NSError errorWithDomain:NSURLErrorDomain code:[((NSHTTPURLResponse *)response) statusCode] userInfo:nil], YES);
+            self.completedBlock(nil, nil, self.error, YES);
         }
         CFRunLoopStop(CFRunLoopGetCurrent());
         [self done];
@@ -265,110 +551,128 @@ NSString *const SDWebImageDownloadFinishNotification = @"SDWebImageDownloadFinis
 }
 
 - (void)connection:(NSURLConnection *)connection didReceiveData:(NSData *)data {
-    [self.imageData appendData:data];
+    if (streamFileHandle) {
+        if (![self writeStreamData:data]) {
+            [self.connection cancel];
+            [self connection:self.connection didFailWithError:[NSError errorWithDomain:NSCocoaErrorDomain code:NSFileWriteOutOfSpaceError userInfo:@{NSFilePathErrorKey : streamFilePath}]];
+            return;
+        }
+    }
+    else {
+        [self.imageData appendData:data];
+    }
+    self.receivedSize += data.length;
+
+    if (!headerChecked && !(self.options & SDWebImageDownloaderDataOnly) && (self.maxDecodedPixelCount > 0 || self.maxDecodedByteCount > 0) && ![self checkDecodeBudgetWithData:data]) {
+        return;
+    }
 
     if ((self.options & SDWebImageDownloaderProgressiveDownload) && self.expectedSize > 0 && self.completedBlock) {
-        // The following code is from http://www.cocoaintheshell.com/2011/05/progressive-images-download-imageio/
-        // Thanks to the author @Nyx0uf
-
-        // Get the total bytes downloaded
-        const NSInteger totalSize = self.imageData.length;
-
-        // Update the data source, we must pass ALL the data, not just the new bytes
-        CGImageSourceRef imageSource = CGImageSourceCreateWithData((__bridge CFDataRef)self.imageData, NULL);
-
-        if (width + height == 0) {
-            CFDictionaryRef properties = CGImageSourceCopyPropertiesAtIndex(imageSource, 0, NULL);
-            if (properties) {
-                NSInteger orientationValue = -1;
-                CFTypeRef val = CFDictionaryGetValue(properties, kCGImagePropertyPixelHeight);
-                if (val) CFNumberGetValue(val, kCFNumberLongType, &height);
-                val = CFDictionaryGetValue(properties, kCGImagePropertyPixelWidth);
-                if (val) CFNumberGetValue(val, kCFNumberLongType, &width);
-                val = CFDictionaryGetValue(properties, kCGImagePropertyOrientation);
-                if (val) CFNumberGetValue(val, kCFNumberNSIntegerType, &orientationValue);
-                CFRelease(properties);
-
-                // When we draw to Core Graphics, we lose orientation information,
-                // which means the image below born of initWithCGIImage will be
-                // oriented incorrectly sometimes. (Unlike the image born of initWithData
-                // in connectionDidFinishLoading.) So save it here and pass it on later.
-                orientation = [[self class] orientationFromPropertyValue:(orientationValue == -1 ? 1 : orientationValue)];
-            }
+        [self updateProgressiveImage];
+    }
+
+    if (self.progressBlock) {
+        self.progressBlock([self downloadedLength], self.expectedSize);
+    }
+}
 
+#pragma mark Decode budget
+
+// Reads the size of the image from the first bytes received, instead of discovering it when decoding the whole body.
+// An oversized image is aborted right away, or is decoded downsampled once complete and skips its progressive display.
+// Returns NO if the download was aborted
+//从最先收到的数据读取图片尺寸：超出解码预算时立即中止下载，或者下载完成后缩小解码
+- (BOOL)checkDecodeBudgetWithData:(NSData *)data {
+    NSData *bytes = self.imageData;
+    if (!bytes) {
+        // Streamed to disk: only the first bytes are kept in memory
+        if (headerData.length < SDImageHeaderMaxLength) {
+            [headerData appendData:data];
+        }
+        bytes = headerData;
+    }
+    SDImageHeader header = [NSData sd_imageHeaderForImageData:bytes];
+    if (header.pixelWidth == 0 || header.pixelHeight == 0) {
+        // An unknown format, or no size where it usually is: the complete data is checked before decoding
+        if ((bytes.length >= 12 && header.format == SDImageFormatUndefined) || bytes.length >= SDImageHeaderMaxLength) {
+            headerChecked = YES;
+            headerData = nil;
         }
+        return YES;
+    }
+    headerChecked = YES;
+    headerData = nil;
+    NSDictionary *context = self.context;
+    if (SDContextFittingDecodeBudget(context, header, self.maxDecodedPixelCount, self.maxDecodedByteCount) == context) {
+        return YES;
+    }
+    if (self.oversizedImagePolicy == SDWebImageDownloaderOversizedImageDownsample) {
+        // A partial image would be decoded at full size for every chunk
+        @synchronized (self) {
+            progressiveCoder = nil;
+            progressiveCoderChecked = YES;
+        }
+        return YES;
+    }
+    // The partial data of an image that will never be decoded is not kept to resume it
+    responseAcceptsRanges = NO;
+    if (resumeData) {
+        [self.imageCache removePartialDataForKey:self.cacheKey];
+        resumeData = nil;
+    }
+    [self.connection cancel];
+    [self connection:self.connection didFailWithError:[self imageTooLargeErrorWithHeader:header]];
+    return NO;
+}
 
-        if (width + height > 0 && totalSize < self.expectedSize) {
-            // Create the image
-            CGImageRef partialImageRef = CGImageSourceCreateImageAtIndex(imageSource, 0, NULL);
+- (NSError *)imageTooLargeErrorWithHeader:(SDImageHeader)header {
+    NSString *description = [NSString stringWithFormat:@"Image of %lux%lu pixels exceeds the decode budget", (unsigned long)header.pixelWidth, (unsigned long)header.pixelHeight];
+    return [NSError errorWithDomain:SDWebImageErrorDomain code:SDWebImageErrorImageTooLarge userInfo:@{NSLocalizedDescriptionKey : description, NSURLErrorFailingURLErrorKey : self.request.URL}];
+}
 
-#ifdef TARGET_OS_IPHONE
-            // Workaround for iOS anamorphic image
-            if (partialImageRef) {
-                const size_t partialHeight = CGImageGetHeight(partialImageRef);
-                CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
-                CGContextRef bmContext = CGBitmapContextCreate(NULL, width, height, 8, width * 4, colorSpace, kCGBitmapByteOrderDefault | kCGImageAlphaPremultipliedFirst);
-                CGColorSpaceRelease(colorSpace);
-                if (bmContext) {
-                    CGContextDrawImage(bmContext, (CGRect){.origin.x = 0.0f, .origin.y = 0.0f, .size.width = width, .size.height = partialHeight}, partialImageRef);
-                    CGImageRelease(partialImageRef);
-                    partialImageRef = CGBitmapContextCreateImage(bmContext);
-                    CGContextRelease(bmContext);
-                }
-                else {
-                    CGImageRelease(partialImageRef);
-                    partialImageRef = nil;
-                }
-            }
-#endif
+#pragma mark Progressive download
 
-            if (partialImageRef) {
-                UIImage *image = [UIImage imageWithCGImage:partialImageRef scale:1 orientation:orientation];
-                NSString *key = [[SDWebImageManager sharedManager] cacheKeyForURL:self.request.URL];
-                UIImage *scaledImage = [self scaledImageForKey:key image:image];
-                if (self.shouldDecompressImages) {
-                    image = [UIImage decodedImageWithImage:scaledImage];
-                }
-                else {
-                    image = scaledImage;
-                }
-                CGImageRelease(partialImageRef);
-                dispatch_main_sync_safe(^{
-                    if (self.completedBlock) {
-                        self.completedBlock(image, nil, nil, NO);
-                    }
-                });
+// The data received so far is decoded by a new instance of the progressive coder of its format, which keeps its state
+// between the chunks of data: the GIF coder only decodes the new bytes
+//由该格式的渐进式编解码器的新实例解码已收到的数据，实例在多次调用之间保留解码状态
+- (void)updateProgressiveImage {
+    NSData *imageData = self.imageData;
+    // The complete image is decoded when the download finishes
+    if ((NSInteger)imageData.length >= self.expectedSize) {
+        return;
+    }
+    UIImage *image = nil;
+    // cancel may reset the coder from another thread
+    @synchronized (self) {
+        if (!progressiveCoderChecked) {
+            // Wait for the signature of the format
+            if (imageData.length < 12) {
+                return;
             }
+            progressiveCoder = [[SDWebImageCodersManager sharedManager] newProgressiveCoderForData:imageData];
+            progressiveCoderChecked = YES;
         }
-
-        CFRelease(imageSource);
+        image = [progressiveCoder incrementallyDecodedImageWithData:imageData finished:NO];
     }
+    [self showProgressiveImage:image];
+}
 
-    if (self.progressBlock) {
-        self.progressBlock(self.imageData.length, self.expectedSize);
+- (void)showProgressiveImage:(UIImage *)image {
+    if (!image) {
+        return;
     }
+    image = [self scaledImageForKey:self.cacheKey image:image];
+    dispatch_main_sync_safe(^{
+        if (self.completedBlock) {
+            self.completedBlock(image, nil, nil, NO);
+        }
+    });
 }
 
-+ (UIImageOrientation)orientationFromPropertyValue:(NSInteger)value {
-    switch (value) {
-        case 1:
-            return UIImageOrientationUp;
-        case 3:
-            return UIImageOrientationDown;
-        case 8:
-            return UIImageOrientationLeft;
-        case 6:
-            return UIImageOrientationRight;
-        case 2:
-            return UIImageOrientationUpMirrored;
-        case 4:
-            return UIImageOrientationDownMirrored;
-        case 5:
-            return UIImageOrientationLeftMirrored;
-        case 7:
-            return UIImageOrientationRightMirrored;
-        default:
-            return UIImageOrientationUp;
+- (void)resetProgressiveCoder {
+    @synchronized (self) {
+        progressiveCoder = nil;
+        progressiveCoderChecked = NO;
     }
 }
 
@@ -391,36 +695,88 @@ NSString *const SDWebImageDownloadFinishNotification = @"SDWebImageDownloadFinis
     if (![[NSURLCache sharedURLCache] cachedResponseForRequest:_request]) {
         responseFromCached = NO;
     }
+
+    if ([self.request valueForHTTPHeaderField:@"If-Range"]) {
+        // The resumed download completed, its partial data is no longer needed
+        [self.imageCache removePartialDataForKey:self.cacheKey];
+    }
     
-    if (completionBlock) {
-        if (self.options & SDWebImageDownloaderIgnoreCachedResponse && responseFromCached) {
-            completionBlock(nil, nil, nil, YES);
-        } else if (self.imageData) {
-            UIImage *image = [UIImage sd_imageWithData:self.imageData];
-            NSString *key = [[SDWebImageManager sharedManager] cacheKeyForURL:self.request.URL];
-            image = [self scaledImageForKey:key image:image];
-            
-            // Do not force decoding animated GIFs
-            if (!image.images) {
-                if (self.shouldDecompressImages) {
-                    image = [UIImage decodedImageWithImage:image];
-                }
-            }
-            if (CGSizeEqualToSize(image.size, CGSizeZero)) {
-                completionBlock(nil, nil, [NSError errorWithDomain:SDWebImageErrorDomain code:0 userInfo:@{NSLocalizedDescriptionKey : @"Downloaded image has 0 pixels"}], YES);
-            }
-            else {
-                completionBlock(image, self.imageData, nil, YES);
-            }
-        } else {
-            completionBlock(nil, nil, [NSError errorWithDomain:SDWebImageErrorDomain code:0 userInfo:@{NSLocalizedDescriptionKey : @"Image data is nil"}], YES);
-        }
+    if (!completionBlock) {
+        self.completionBlock = nil;
+        [self done];
+        return;
     }
+    if (self.options & SDWebImageDownloaderIgnoreCachedResponse && responseFromCached) {
+        completionBlock(nil, nil, nil, YES);
+        self.completionBlock = nil;
+        [self done];
+        return;
+    }
+
+    // The bytes are here: release the download slot right away and decode on the decode pool,
+    // so decoding neither holds a network slot nor competes with other decodes beyond the pool's bounds
+    //数据已经下载完成，先结束下载操作释放下载名额，再到解码池中解码
+    NSString *streamedFilePath = [self detachStreamFile];
+    NSData *imageData = streamedFilePath ? [NSData dataWithContentsOfFile:streamedFilePath options:NSDataReadingMappedIfSafe error:nil] : self.imageData;
+    NSString *key = self.cacheKey;
+    SDImageCache *imageCache = self.imageCache;
+    BOOL shouldDecompressImages = self.shouldDecompressImages;
+    NSDictionary *context = self.context;
+    NSOperationQueuePriority priority = self.queuePriority;
+    NSUInteger maxDecodedPixelCount = self.maxDecodedPixelCount;
+    NSUInteger maxDecodedByteCount = self.maxDecodedByteCount;
+    SDWebImageDownloaderOversizedImagePolicy oversizedImagePolicy = self.oversizedImagePolicy;
     self.completionBlock = nil;
     [self done];
+
+    Class operationClass = [self class];
+    if (!imageData) {
+        [operationClass finishStreamedFileAtPath:streamedFilePath decoded:NO imageCache:imageCache key:key];
+        completionBlock(nil, nil, [NSError errorWithDomain:SDWebImageErrorDomain code:0 userInfo:@{NSLocalizedDescriptionKey : @"Image data is nil"}], YES);
+        return;
+    }
+    if (self.options & SDWebImageDownloaderDataOnly) {
+        //只需要数据，不解码
+        [operationClass finishStreamedFileAtPath:streamedFilePath decoded:YES imageCache:imageCache key:key];
+        completionBlock(nil, imageData, nil, YES);
+        return;
+    }
+    // The complete data has all the frames, and the size if it was not in the first bytes
+    NSDictionary *decodeContext = context;
+    NSUInteger maxPixelCount = 0;
+    if (maxDecodedPixelCount > 0 || maxDecodedByteCount > 0) {
+        SDImageHeader header = [NSData sd_imageHeaderForImageData:imageData];
+        decodeContext = SDContextFittingDecodeBudget(context, header, maxDecodedPixelCount, maxDecodedByteCount);
+        if (decodeContext != context) {
+            if (oversizedImagePolicy == SDWebImageDownloaderOversizedImageAbort) {
+                [operationClass finishStreamedFileAtPath:streamedFilePath decoded:NO imageCache:imageCache key:key];
+                completionBlock(nil, nil, [self imageTooLargeErrorWithHeader:header], YES);
+                return;
+            }
+            CGSize budgetPixelSize = [decodeContext[SDWebImageContextThumbnailPixelSize] CGSizeValue];
+            maxPixelCount = (NSUInteger)(budgetPixelSize.width * budgetPixelSize.height);
+        }
+    }
+    [[SDWebImageDecodePool sharedPool] addDecodeBlock:^{
+        NSError *error = nil;
+        UIImage *image = [UIImage decodedImageWithData:imageData key:key context:decodeContext decompress:shouldDecompressImages maxPixelCount:maxPixelCount error:&error];
+        BOOL decoded = !error && !CGSizeEqualToSize(image.size, CGSizeZero);
+        [operationClass finishStreamedFileAtPath:streamedFilePath decoded:decoded imageCache:imageCache key:key];
+        if (error) {
+            completionBlock(nil, nil, error, YES);
+        }
+        else if (CGSizeEqualToSize(image.size, CGSizeZero)) {
+            completionBlock(nil, nil, [NSError errorWithDomain:SDWebImageErrorDomain code:0 userInfo:@{NSLocalizedDescriptionKey : @"Downloaded image has 0 pixels"}], YES);
+        }
+        else {
+            completionBlock(image, imageData, nil, YES);
+        }
+    } cost:[SDWebImageDecodePool estimatedDecodedSizeForData:imageData context:decodeContext] priority:priority];
 }
 
 - (void)connection:(NSURLConnection *)connection didFailWithError:(NSError *)error {
+    self.error = error;
+    [self persistPartialDataIfNeeded];
     @synchronized(self) {
         CFRunLoopStop(CFRunLoopGetCurrent());
         self.thread = nil;
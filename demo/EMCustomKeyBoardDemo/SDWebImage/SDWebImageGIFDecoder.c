@@ -0,0 +1,742 @@
+/*
+ * This file is part of the SDWebImage package.
+ * (c) Olivier Poitrey <rs@dailymotion.com>
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#include "SDWebImageGIFDecoder.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define SD_GIF_NEON 1
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#define SD_GIF_SSE2 1
+#include <emmintrin.h>
+#if defined(__SSSE3__)
+#define SD_GIF_SSSE3 1
+#include <tmmintrin.h>
+#endif
+#endif
+// 64 byte table lookups: vqtbl4q_u8 is AArch64 only, _mm_shuffle_epi8 SSSE3
+#if (SD_GIF_NEON && defined(__aarch64__)) || SD_GIF_SSSE3
+#define SD_GIF_TABLE_LOOKUP 1
+#endif
+
+#define SD_GIF_MAX_CODES 4096
+// Larger canvases are rejected, their size would overflow the index arithmetic
+#define SD_GIF_MAX_PIXELS (1u << 28)
+
+typedef enum {
+    SDGIFStateHeader,
+    SDGIFStateBlock,
+    SDGIFStateExtension,
+    SDGIFStateImageDescriptor,
+    SDGIFStateImageData,
+    SDGIFStateFinished,
+    SDGIFStateError
+} SDGIFState;
+
+struct SDGIFDecoder {
+    const uint8_t *data;
+    size_t length;
+    size_t offset;
+    int final;
+    SDGIFState state;
+
+    size_t width;
+    size_t height;
+    uint8_t *canvas;
+    uint32_t globalPalette[256];
+    int hasGlobalPalette;
+    int loopCount;
+    size_t frameCount;
+
+    // Extension being read
+    uint8_t extensionLabel;
+    size_t extensionBlockIndex;
+    int netscapeExtension;
+
+    // Graphic control extension, applies to the next frame
+    uint32_t delay;
+    int disposal;
+    int transparentIndex;
+
+    // Frame being decoded
+    uint32_t frameX, frameY, frameWidth, frameHeight;
+    int interlaced;
+    uint32_t palette[256];
+    uint8_t *indexes;
+    size_t indexesCapacity;
+    size_t pixelCount;
+    size_t subBlockRemaining;
+
+    // Disposal of the previous frame, applied before the next one is drawn
+    int previousDisposal;
+    uint32_t previousX, previousY, previousWidth, previousHeight;
+    uint8_t *savedCanvas;
+    size_t savedCanvasCapacity;
+    // The length of the rectangle saved for the frame disposed to previous, 0 if it could not be saved
+    size_t savedLength;
+
+    // LZW state, kept between sub-blocks and between calls
+    int minCodeSize;
+    int codeSize;
+    int clearCode;
+    int nextCode;
+    int previousCode;
+    int lzwFinished;
+    uint32_t bits;
+    int bitCount;
+    uint16_t prefix[SD_GIF_MAX_CODES];
+    uint8_t suffix[SD_GIF_MAX_CODES];
+    uint8_t first[SD_GIF_MAX_CODES];
+    uint16_t codeLength[SD_GIF_MAX_CODES];
+};
+
+static inline uint16_t SDGIFReadUInt16(const uint8_t *bytes) {
+    return (uint16_t)(bytes[0] | (bytes[1] << 8));
+}
+
+static void SDGIFReadPalette(const uint8_t *bytes, size_t colorCount, uint32_t *palette) {
+    // Colors missing from a small palette are opaque black
+    for (size_t i = 0; i < 256; i++) {
+        palette[i] = 0xff000000u;
+    }
+    for (size_t i = 0; i < colorCount; i++) {
+        const uint8_t *rgb = bytes + i * 3;
+        palette[i] = 0xff000000u | ((uint32_t)rgb[0] << 16) | ((uint32_t)rgb[1] << 8) | rgb[2];
+    }
+}
+
+// MARK: - Palette expansion
+
+#if SD_GIF_TABLE_LOOKUP
+// Byte k of pixel p is byte 4 * index + k of the palette: the offsets of the 16 indexes, each repeated for the 4 bytes of its pixel
+static const uint8_t SDGIFPixelSpread[64] = {
+    0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+    4, 4, 4, 4, 5, 5, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7,
+    8, 8, 8, 8, 9, 9, 9, 9, 10, 10, 10, 10, 11, 11, 11, 11,
+    12, 12, 12, 12, 13, 13, 13, 13, 14, 14, 14, 14, 15, 15, 15, 15
+};
+static const uint8_t SDGIFPixelBytes[16] = {0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3};
+#endif
+
+#if SD_GIF_NEON
+#if SD_GIF_TABLE_LOOKUP
+// The colors of 16 indexes below 16, looked up in the first 64 bytes of the palette
+static inline void SDGIFLookupSmallPaletteNEON(uint8x16_t indexes, uint8x16x4_t table, uint32x4_t colors[4]) {
+    uint8x16_t offsets = vshlq_n_u8(indexes, 2);
+    uint8x16_t bytes = vld1q_u8(SDGIFPixelBytes);
+    for (int q = 0; q < 4; q++) {
+        uint8x16_t spread = vaddq_u8(vqtbl1q_u8(offsets, vld1q_u8(SDGIFPixelSpread + q * 16)), bytes);
+        colors[q] = vreinterpretq_u32_u8(vqtbl4q_u8(table, spread));
+    }
+}
+#endif
+
+// Writes 16 colors, keeping the pixels where the byte mask is set
+static inline void SDGIFBlendNEON(uint32_t *dst, const uint32x4_t colors[4], uint8x16_t mask) {
+    int8x16_t signedMask = vreinterpretq_s8_u8(mask);
+    int16x8_t low = vmovl_s8(vget_low_s8(signedMask));
+    int16x8_t high = vmovl_s8(vget_high_s8(signedMask));
+    int16x4_t quarters[4] = {vget_low_s16(low), vget_high_s16(low), vget_low_s16(high), vget_high_s16(high)};
+    for (int q = 0; q < 4; q++) {
+        uint32x4_t keep = vreinterpretq_u32_s32(vmovl_s16(quarters[q]));
+        vst1q_u32(dst + q * 4, vbslq_u32(keep, vld1q_u32(dst + q * 4), colors[q]));
+    }
+}
+#elif SD_GIF_SSE2
+#if SD_GIF_SSSE3
+// The colors of 16 indexes below 16: each 16 byte quarter of the palette is shuffled and kept where the offset points into it
+static inline void SDGIFLookupSmallPaletteSSSE3(__m128i indexes, const __m128i table[4], __m128i colors[4]) {
+    // The indexes are below 16, shifting 16 bit lanes does not carry between bytes
+    __m128i offsets = _mm_slli_epi16(indexes, 2);
+    __m128i bytes = _mm_loadu_si128((const __m128i *)SDGIFPixelBytes);
+    for (int q = 0; q < 4; q++) {
+        __m128i spread = _mm_add_epi8(_mm_shuffle_epi8(offsets, _mm_loadu_si128((const __m128i *)(SDGIFPixelSpread + q * 16))), bytes);
+        __m128i quarter = _mm_and_si128(_mm_srli_epi16(spread, 4), _mm_set1_epi8(0x0f));
+        __m128i color = _mm_setzero_si128();
+        for (int t = 0; t < 4; t++) {
+            color = _mm_or_si128(color, _mm_and_si128(_mm_shuffle_epi8(table[t], spread), _mm_cmpeq_epi8(quarter, _mm_set1_epi8((char)t))));
+        }
+        colors[q] = color;
+    }
+}
+#endif
+
+// Writes 16 colors, keeping the pixels where the byte mask is set
+static inline void SDGIFBlendSSE2(uint32_t *dst, const __m128i colors[4], __m128i mask) {
+    __m128i low = _mm_unpacklo_epi8(mask, mask);
+    __m128i high = _mm_unpackhi_epi8(mask, mask);
+    __m128i keeps[4] = {_mm_unpacklo_epi16(low, low), _mm_unpackhi_epi16(low, low), _mm_unpacklo_epi16(high, high), _mm_unpackhi_epi16(high, high)};
+    for (int q = 0; q < 4; q++) {
+        __m128i *pixels = (__m128i *)(void *)(dst + q * 4);
+        _mm_storeu_si128(pixels, _mm_or_si128(_mm_and_si128(keeps[q], _mm_loadu_si128(pixels)), _mm_andnot_si128(keeps[q], colors[q])));
+    }
+}
+#endif
+
+void SDGIFExpandPaletteRow(const uint8_t *indexes, size_t count, const uint32_t *palette, int transparentIndex, uint32_t *dst) {
+    size_t i = 0;
+    // The lookup stays one load per pixel, there is no gather in NEON or SSE2; the transparency mask and the blend take
+    // 16 pixels at a time. Runs of indexes below 16 are looked up with table instructions instead
+    //查表仍是逐像素，透明遮罩和混合每次处理16个像素；索引都小于16时用查表指令
+#if SD_GIF_NEON || SD_GIF_SSE2
+    uint32_t gathered[16];
+    int hasTransparent = transparentIndex >= 0 && transparentIndex <= 255;
+#endif
+#if SD_GIF_NEON
+    uint8x16_t transparent = vdupq_n_u8(hasTransparent ? (uint8_t)transparentIndex : 0);
+    uint8x16_t opaque = vdupq_n_u8(hasTransparent ? 0 : 0xff);
+#if SD_GIF_TABLE_LOOKUP
+    const uint8_t *paletteBytes = (const uint8_t *)palette;
+    uint8x16x4_t table = {{vld1q_u8(paletteBytes), vld1q_u8(paletteBytes + 16), vld1q_u8(paletteBytes + 32), vld1q_u8(paletteBytes + 48)}};
+#endif
+    for (; i + 16 <= count; i += 16) {
+        uint8x16_t block = vld1q_u8(indexes + i);
+        uint32x4_t colors[4];
+#if SD_GIF_TABLE_LOOKUP
+        if (vmaxvq_u8(block) < 16) {
+            SDGIFLookupSmallPaletteNEON(block, table, colors);
+        }
+        else
+#endif
+        {
+            for (int k = 0; k < 16; k++) {
+                gathered[k] = palette[indexes[i + k]];
+            }
+            for (int q = 0; q < 4; q++) {
+                colors[q] = vld1q_u32(gathered + q * 4);
+            }
+        }
+        SDGIFBlendNEON(dst + i, colors, vbicq_u8(vceqq_u8(block, transparent), opaque));
+    }
+#elif SD_GIF_SSE2
+    __m128i transparent = _mm_set1_epi8(hasTransparent ? (char)transparentIndex : 0);
+    __m128i opaque = _mm_set1_epi8(hasTransparent ? 0 : (char)0xff);
+#if SD_GIF_SSSE3
+    __m128i table[4];
+    for (int t = 0; t < 4; t++) {
+        table[t] = _mm_loadu_si128((const __m128i *)(const void *)(palette + t * 4));
+    }
+#endif
+    for (; i + 16 <= count; i += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i *)(indexes + i));
+        __m128i colors[4];
+#if SD_GIF_SSSE3
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(block, _mm_set1_epi8((char)0xf0)), _mm_setzero_si128())) == 0xffff) {
+            SDGIFLookupSmallPaletteSSSE3(block, table, colors);
+        }
+        else
+#endif
+        {
+            for (int k = 0; k < 16; k++) {
+                gathered[k] = palette[indexes[i + k]];
+            }
+            for (int q = 0; q < 4; q++) {
+                colors[q] = _mm_loadu_si128((const __m128i *)(const void *)(gathered + q * 4));
+            }
+        }
+        SDGIFBlendSSE2(dst + i, colors, _mm_andnot_si128(opaque, _mm_cmpeq_epi8(block, transparent)));
+    }
+#endif
+    for (; i < count; i++) {
+        uint8_t index = indexes[i];
+        if (index != transparentIndex) {
+            dst[i] = palette[index];
+        }
+    }
+}
+
+// MARK: - Canvas
+
+// Clips a frame rectangle to the canvas, returns 0 if nothing is left
+static int SDGIFClipRect(const SDGIFDecoder *decoder, uint32_t x, uint32_t y, uint32_t *width, uint32_t *height) {
+    if (x >= decoder->width || y >= decoder->height) {
+        return 0;
+    }
+    if (*width > decoder->width - x) {
+        *width = (uint32_t)(decoder->width - x);
+    }
+    if (*height > decoder->height - y) {
+        *height = (uint32_t)(decoder->height - y);
+    }
+    return *width > 0 && *height > 0;
+}
+
+static void SDGIFDisposePreviousFrame(SDGIFDecoder *decoder) {
+    uint32_t width = decoder->previousWidth, height = decoder->previousHeight;
+    if (decoder->previousDisposal < 2 || !SDGIFClipRect(decoder, decoder->previousX, decoder->previousY, &width, &height)) {
+        return;
+    }
+    size_t bytesPerRow = decoder->width * 4;
+    for (uint32_t row = 0; row < height; row++) {
+        uint8_t *dst = decoder->canvas + (decoder->previousY + row) * bytesPerRow + decoder->previousX * 4;
+        if (decoder->previousDisposal == 2) {
+            // Restore to background: transparent, as browsers do
+            memset(dst, 0, width * 4);
+        }
+        else if (decoder->savedLength == (size_t)width * height * 4) {
+            // Only a rectangle saved whole is restored, the canvas is left as it is otherwise
+            //只恢复完整保存的区域，否则保持画布原样
+            memcpy(dst, decoder->savedCanvas + row * width * 4, width * 4);
+        }
+    }
+}
+
+// The row of the canvas of a row of the frame in decode order
+static uint32_t SDGIFFrameRow(uint32_t decodeRow, uint32_t height, int interlaced) {
+    if (!interlaced) {
+        return decodeRow;
+    }
+    // Interlaced passes: every 8th row from 0, every 8th from 4, every 4th from 2, every 2nd from 1
+    //隔行扫描的4遍：从0开始每8行，从4开始每8行，从2开始每4行，从1开始每2行
+    uint32_t pass1 = (height + 7) / 8;
+    uint32_t pass2 = (height + 3) / 8;
+    uint32_t pass3 = (height + 1) / 4;
+    if (decodeRow < pass1) {
+        return decodeRow * 8;
+    }
+    decodeRow -= pass1;
+    if (decodeRow < pass2) {
+        return decodeRow * 8 + 4;
+    }
+    decodeRow -= pass2;
+    if (decodeRow < pass3) {
+        return decodeRow * 4 + 2;
+    }
+    decodeRow -= pass3;
+    return decodeRow * 2 + 1;
+}
+
+static void SDGIFCompositeFrame(SDGIFDecoder *decoder) {
+    SDGIFDisposePreviousFrame(decoder);
+
+    uint32_t width = decoder->frameWidth, height = decoder->frameHeight;
+    int visible = SDGIFClipRect(decoder, decoder->frameX, decoder->frameY, &width, &height);
+    size_t bytesPerRow = decoder->width * 4;
+    decoder->savedLength = 0;
+    if (visible && decoder->disposal == 3) {
+        // Restore to previous: keep what the frame covers
+        size_t savedLength = (size_t)width * height * 4;
+        if (savedLength > decoder->savedCanvasCapacity) {
+            uint8_t *savedCanvas = realloc(decoder->savedCanvas, savedLength);
+            if (savedCanvas) {
+                decoder->savedCanvas = savedCanvas;
+                decoder->savedCanvasCapacity = savedLength;
+            }
+        }
+        if (decoder->savedCanvasCapacity >= savedLength) {
+            for (uint32_t row = 0; row < height; row++) {
+                memcpy(decoder->savedCanvas + row * width * 4, decoder->canvas + (decoder->frameY + row) * bytesPerRow + decoder->frameX * 4, width * 4);
+            }
+            decoder->savedLength = savedLength;
+        }
+    }
+
+    if (visible) {
+        // Only the pixels decoded are drawn, a truncated frame leaves the rest of the canvas as it was
+        //只绘制已解码的像素，数据不完整的帧其余部分保持画布原样
+        size_t decodedRows = decoder->pixelCount / decoder->frameWidth;
+        size_t lastRowPixels = decoder->pixelCount % decoder->frameWidth;
+        for (uint32_t decodeRow = 0; decodeRow < decoder->frameHeight && decodeRow <= decodedRows; decodeRow++) {
+            size_t count = decodeRow < decodedRows ? width : (lastRowPixels < width ? lastRowPixels : width);
+            uint32_t row = SDGIFFrameRow(decodeRow, decoder->frameHeight, decoder->interlaced);
+            if (count == 0 || row >= height) {
+                continue;
+            }
+            uint32_t *dst = (uint32_t *)(void *)(decoder->canvas + (decoder->frameY + row) * bytesPerRow + decoder->frameX * 4);
+            SDGIFExpandPaletteRow(decoder->indexes + (size_t)decodeRow * decoder->frameWidth, count, decoder->palette, decoder->transparentIndex, dst);
+        }
+    }
+
+    decoder->previousDisposal = decoder->disposal;
+    decoder->previousX = decoder->frameX;
+    decoder->previousY = decoder->frameY;
+    decoder->previousWidth = decoder->frameWidth;
+    decoder->previousHeight = decoder->frameHeight;
+}
+
+// MARK: - LZW
+
+static void SDGIFResetCodes(SDGIFDecoder *decoder) {
+    decoder->codeSize = decoder->minCodeSize + 1;
+    decoder->nextCode = decoder->clearCode + 2;
+    decoder->previousCode = -1;
+}
+
+static void SDGIFStartLZW(SDGIFDecoder *decoder, int minCodeSize) {
+    decoder->minCodeSize = minCodeSize;
+    decoder->clearCode = 1 << minCodeSize;
+    decoder->lzwFinished = 0;
+    decoder->bits = 0;
+    decoder->bitCount = 0;
+    for (int code = 0; code < decoder->clearCode; code++) {
+        decoder->prefix[code] = 0;
+        decoder->suffix[code] = (uint8_t)code;
+        decoder->first[code] = (uint8_t)code;
+        decoder->codeLength[code] = 1;
+    }
+    SDGIFResetCodes(decoder);
+}
+
+// Writes the string of a code at the current pixel, backwards from its last byte along the prefixes
+static void SDGIFOutputCode(SDGIFDecoder *decoder, int code) {
+    size_t total = (size_t)decoder->frameWidth * decoder->frameHeight;
+    size_t start = decoder->pixelCount;
+    size_t end = start + decoder->codeLength[code];
+    if (start >= total) {
+        return;
+    }
+    for (size_t position = end; position > start; ) {
+        position--;
+        if (position < total) {
+            decoder->indexes[position] = decoder->suffix[code];
+        }
+        code = decoder->prefix[code];
+    }
+    decoder->pixelCount = end < total ? end : total;
+}
+
+static void SDGIFDecodeLZW(SDGIFDecoder *decoder, const uint8_t *bytes, size_t length) {
+    int eoiCode = decoder->clearCode + 1;
+    for (size_t i = 0; i < length && !decoder->lzwFinished; i++) {
+        decoder->bits |= (uint32_t)bytes[i] << decoder->bitCount;
+        decoder->bitCount += 8;
+        while (decoder->bitCount >= decoder->codeSize) {
+            int code = (int)(decoder->bits & ((1u << decoder->codeSize) - 1));
+            decoder->bits >>= decoder->codeSize;
+            decoder->bitCount -= decoder->codeSize;
+
+            if (code == decoder->clearCode) {
+                SDGIFResetCodes(decoder);
+                continue;
+            }
+            if (code == eoiCode) {
+                decoder->lzwFinished = 1;
+                break;
+            }
+            if (decoder->previousCode < 0) {
+                if (code >= decoder->clearCode) {
+                    decoder->lzwFinished = 1;
+                    break;
+                }
+                SDGIFOutputCode(decoder, code);
+                decoder->previousCode = code;
+                continue;
+            }
+            if (code > decoder->nextCode || (code == decoder->nextCode && decoder->nextCode >= SD_GIF_MAX_CODES)) {
+                // Corrupted stream, keep what was decoded
+                decoder->lzwFinished = 1;
+                break;
+            }
+            if (decoder->nextCode < SD_GIF_MAX_CODES) {
+                // A new string: the previous one and the first byte of the current one, which is the first byte of
+                // the previous one for the code being defined (KwKwK)
+                int previous = decoder->previousCode;
+                int next = decoder->nextCode;
+                decoder->prefix[next] = (uint16_t)previous;
+                decoder->suffix[next] = code == next ? decoder->first[previous] : decoder->first[code];
+                decoder->first[next] = decoder->first[previous];
+                decoder->codeLength[next] = (uint16_t)(decoder->codeLength[previous] + 1);
+                decoder->nextCode++;
+                if (decoder->nextCode == (1 << decoder->codeSize) && decoder->codeSize < 12) {
+                    decoder->codeSize++;
+                }
+            }
+            SDGIFOutputCode(decoder, code);
+            decoder->previousCode = code;
+        }
+    }
+}
+
+// MARK: - Parser
+
+SDGIFDecoder *SDGIFDecoderCreate(void) {
+    SDGIFDecoder *decoder = calloc(1, sizeof(SDGIFDecoder));
+    if (decoder) {
+        decoder->loopCount = -1;
+        decoder->transparentIndex = -1;
+    }
+    return decoder;
+}
+
+void SDGIFDecoderDestroy(SDGIFDecoder *decoder) {
+    if (!decoder) {
+        return;
+    }
+    free(decoder->canvas);
+    free(decoder->indexes);
+    free(decoder->savedCanvas);
+    free(decoder);
+}
+
+void SDGIFDecoderSetData(SDGIFDecoder *decoder, const uint8_t *bytes, size_t length, int final) {
+    decoder->data = bytes;
+    decoder->length = length < decoder->offset ? decoder->offset : length;
+    decoder->final = final;
+}
+
+void SDGIFDecoderRewind(SDGIFDecoder *decoder) {
+    decoder->offset = 0;
+    decoder->state = SDGIFStateHeader;
+    decoder->frameCount = 0;
+    decoder->previousDisposal = 0;
+    decoder->savedLength = 0;
+    decoder->delay = 0;
+    decoder->disposal = 0;
+    decoder->transparentIndex = -1;
+}
+
+size_t SDGIFDecoderGetWidth(const SDGIFDecoder *decoder) {
+    return decoder->width;
+}
+
+size_t SDGIFDecoderGetHeight(const SDGIFDecoder *decoder) {
+    return decoder->height;
+}
+
+int SDGIFDecoderGetLoopCount(const SDGIFDecoder *decoder) {
+    return decoder->loopCount;
+}
+
+const uint8_t *SDGIFDecoderGetCanvas(const SDGIFDecoder *decoder) {
+    return decoder->canvas;
+}
+
+static SDGIFDecoderStatus SDGIFFail(SDGIFDecoder *decoder) {
+    // Corruption after some frames ends the animation rather than discarding it
+    //已经解码出帧之后的错误视为动画结束
+    decoder->state = decoder->frameCount > 0 ? SDGIFStateFinished : SDGIFStateError;
+    return decoder->frameCount > 0 ? SDGIFDecoderStatusFinished : SDGIFDecoderStatusError;
+}
+
+// A final data that runs out ends the file where it stops
+static SDGIFDecoderStatus SDGIFNeedsData(SDGIFDecoder *decoder) {
+    return decoder->final ? SDGIFFail(decoder) : SDGIFDecoderStatusNeedsData;
+}
+
+static int SDGIFReadHeader(SDGIFDecoder *decoder) {
+    const uint8_t *bytes = decoder->data + decoder->offset;
+    size_t available = decoder->length - decoder->offset;
+    if (available < 13) {
+        return 0;
+    }
+    if (memcmp(bytes, "GIF87a", 6) != 0 && memcmp(bytes, "GIF89a", 6) != 0) {
+        return -1;
+    }
+    size_t width = SDGIFReadUInt16(bytes + 6);
+    size_t height = SDGIFReadUInt16(bytes + 8);
+    uint8_t flags = bytes[10];
+    size_t paletteLength = (flags & 0x80) ? 3u << ((flags & 0x07) + 1) : 0;
+    if (available < 13 + paletteLength) {
+        return 0;
+    }
+    if (width == 0 || height == 0 || width * height > SD_GIF_MAX_PIXELS) {
+        return -1;
+    }
+    if (!decoder->canvas || decoder->width != width || decoder->height != height) {
+        free(decoder->canvas);
+        decoder->canvas = malloc(width * height * 4);
+        if (!decoder->canvas) {
+            return -1;
+        }
+        decoder->width = width;
+        decoder->height = height;
+    }
+    memset(decoder->canvas, 0, width * height * 4);
+    decoder->hasGlobalPalette = paletteLength > 0;
+    SDGIFReadPalette(bytes + 13, paletteLength / 3, decoder->globalPalette);
+    decoder->offset += 13 + paletteLength;
+    return 1;
+}
+
+static int SDGIFReadImageDescriptor(SDGIFDecoder *decoder) {
+    const uint8_t *bytes = decoder->data + decoder->offset;
+    size_t available = decoder->length - decoder->offset;
+    // Separator, rectangle, flags, then the local palette and the LZW minimum code size
+    if (available < 10) {
+        return 0;
+    }
+    uint8_t flags = bytes[9];
+    size_t paletteLength = (flags & 0x80) ? 3u << ((flags & 0x07) + 1) : 0;
+    if (available < 10 + paletteLength + 1) {
+        return 0;
+    }
+    int minCodeSize = bytes[10 + paletteLength];
+    if (minCodeSize < 2 || minCodeSize > 11) {
+        return -1;
+    }
+    decoder->frameX = SDGIFReadUInt16(bytes + 1);
+    decoder->frameY = SDGIFReadUInt16(bytes + 3);
+    decoder->frameWidth = SDGIFReadUInt16(bytes + 5);
+    decoder->frameHeight = SDGIFReadUInt16(bytes + 7);
+    decoder->interlaced = (flags & 0x40) != 0;
+    if (paletteLength > 0) {
+        SDGIFReadPalette(bytes + 10, paletteLength / 3, decoder->palette);
+    }
+    else {
+        memcpy(decoder->palette, decoder->globalPalette, sizeof(decoder->palette));
+    }
+    size_t pixelCount = (size_t)decoder->frameWidth * decoder->frameHeight;
+    if (pixelCount > decoder->indexesCapacity) {
+        uint8_t *indexes = realloc(decoder->indexes, pixelCount);
+        if (!indexes) {
+            return -1;
+        }
+        decoder->indexes = indexes;
+        decoder->indexesCapacity = pixelCount;
+    }
+    decoder->pixelCount = 0;
+    decoder->subBlockRemaining = 0;
+    SDGIFStartLZW(decoder, minCodeSize);
+    decoder->offset += 10 + paletteLength + 1;
+    return 1;
+}
+
+// Reads the sub-blocks of an extension, one at a time. Returns 0 when more data is needed, 1 at the terminator
+static int SDGIFReadExtension(SDGIFDecoder *decoder) {
+    while (decoder->offset < decoder->length) {
+        const uint8_t *bytes = decoder->data + decoder->offset;
+        size_t blockLength = bytes[0];
+        if (blockLength == 0) {
+            decoder->offset++;
+            return 1;
+        }
+        if (decoder->length - decoder->offset < 1 + blockLength) {
+            return 0;
+        }
+        const uint8_t *block = bytes + 1;
+        if (decoder->extensionLabel == 0xf9 && decoder->extensionBlockIndex == 0 && blockLength >= 4) {
+            // Graphic control extension
+            decoder->disposal = (block[0] >> 2) & 0x07;
+            if (decoder->disposal > 3) {
+                decoder->disposal = 0;
+            }
+            decoder->delay = SDGIFReadUInt16(block + 1);
+            decoder->transparentIndex = (block[0] & 0x01) ? block[3] : -1;
+        }
+        else if (decoder->extensionLabel == 0xff && decoder->extensionBlockIndex == 0) {
+            decoder->netscapeExtension = blockLength == 11 && (memcmp(block, "NETSCAPE2.0", 11) == 0 || memcmp(block, "ANIMEXTS1.0", 11) == 0);
+        }
+        else if (decoder->extensionLabel == 0xff && decoder->netscapeExtension && blockLength >= 3 && block[0] == 1) {
+            decoder->loopCount = SDGIFReadUInt16(block + 1);
+        }
+        decoder->extensionBlockIndex++;
+        decoder->offset += 1 + blockLength;
+    }
+    return 0;
+}
+
+SDGIFDecoderStatus SDGIFDecoderDecodeFrame(SDGIFDecoder *decoder, SDGIFFrameInfo *info) {
+    if (!decoder->data) {
+        return SDGIFNeedsData(decoder);
+    }
+    for (;;) {
+        switch (decoder->state) {
+            case SDGIFStateHeader: {
+                int result = SDGIFReadHeader(decoder);
+                if (result < 0) {
+                    return SDGIFFail(decoder);
+                }
+                if (result == 0) {
+                    return SDGIFNeedsData(decoder);
+                }
+                decoder->state = SDGIFStateBlock;
+                break;
+            }
+            case SDGIFStateBlock: {
+                if (decoder->offset >= decoder->length) {
+                    return SDGIFNeedsData(decoder);
+                }
+                uint8_t introducer = decoder->data[decoder->offset];
+                if (introducer == 0x2c) {
+                    decoder->state = SDGIFStateImageDescriptor;
+                }
+                else if (introducer == 0x21) {
+                    if (decoder->length - decoder->offset < 2) {
+                        return SDGIFNeedsData(decoder);
+                    }
+                    decoder->extensionLabel = decoder->data[decoder->offset + 1];
+                    decoder->extensionBlockIndex = 0;
+                    decoder->netscapeExtension = 0;
+                    decoder->offset += 2;
+                    decoder->state = SDGIFStateExtension;
+                }
+                else if (introducer == 0x3b) {
+                    decoder->state = SDGIFStateFinished;
+                }
+                else {
+                    return SDGIFFail(decoder);
+                }
+                break;
+            }
+            case SDGIFStateExtension:
+                if (!SDGIFReadExtension(decoder)) {
+                    return SDGIFNeedsData(decoder);
+                }
+                decoder->state = SDGIFStateBlock;
+                break;
+            case SDGIFStateImageDescriptor: {
+                int result = SDGIFReadImageDescriptor(decoder);
+                if (result < 0) {
+                    return SDGIFFail(decoder);
+                }
+                if (result == 0) {
+                    return SDGIFNeedsData(decoder);
+                }
+                decoder->state = SDGIFStateImageData;
+                break;
+            }
+            case SDGIFStateImageData: {
+                // Sub-blocks are consumed as far as the data goes, a sub-block may be split between two calls
+                //尽量消费已有的数据，一个子块可能分多次到达
+                int terminated = 0;
+                while (!terminated && decoder->offset < decoder->length) {
+                    if (decoder->subBlockRemaining == 0) {
+                        size_t blockLength = decoder->data[decoder->offset++];
+                        if (blockLength == 0) {
+                            terminated = 1;
+                        }
+                        decoder->subBlockRemaining = blockLength;
+                        continue;
+                    }
+                    size_t available = decoder->length - decoder->offset;
+                    size_t consumed = available < decoder->subBlockRemaining ? available : decoder->subBlockRemaining;
+                    SDGIFDecodeLZW(decoder, decoder->data + decoder->offset, consumed);
+                    decoder->offset += consumed;
+                    decoder->subBlockRemaining -= consumed;
+                }
+                if (!terminated && !decoder->final) {
+                    return SDGIFNeedsData(decoder);
+                }
+                SDGIFCompositeFrame(decoder);
+                if (info) {
+                    info->index = decoder->frameCount;
+                    info->delayCentiseconds = decoder->delay;
+                    info->x = decoder->frameX;
+                    info->y = decoder->frameY;
+                    info->width = decoder->frameWidth;
+                    info->height = decoder->frameHeight;
+                    info->disposal = decoder->disposal;
+                    info->transparent = decoder->transparentIndex >= 0;
+                }
+                decoder->frameCount++;
+                // The graphic control extension only applies to the frame following it
+                decoder->delay = 0;
+                decoder->disposal = 0;
+                decoder->transparentIndex = -1;
+                decoder->state = terminated ? SDGIFStateBlock : SDGIFStateFinished;
+                return SDGIFDecoderStatusFrame;
+            }
+            case SDGIFStateFinished:
+                return SDGIFDecoderStatusFinished;
+            case SDGIFStateError:
+                return SDGIFDecoderStatusError;
+        }
+    }
+}
@@ -0,0 +1,93 @@
+/*
+ * This file is part of the SDWebImage package.
+ * (c) Olivier Poitrey <rs@dailymotion.com>
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef SDWebImageGIFDecoder_h
+#define SDWebImageGIFDecoder_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A streaming GIF decoder in portable C. Frames are decoded in order onto a persistent canvas of premultiplied BGRA
+ * pixels (kCGBitmapByteOrder32Little | kCGImageAlphaPremultipliedFirst), applying the disposal of the previous frame,
+ * so each frame costs one LZW decode and one composite of its own rectangle.
+ *
+ * The decoder does not copy the data: pass all the bytes received so far to `SDGIFDecoderSetData`, as they arrive,
+ * and decode the frames that are complete. The LZW state is kept between calls, a frame may span several calls.
+ * A decoder is not thread safe.
+ 流式GIF解码器（C实现）：按顺序把每一帧合成到持续存在的预乘BGRA画布上并处理disposal；
+ 数据可以分多次传入，不拷贝数据，LZW状态在多次调用之间保留
+ */
+typedef struct SDGIFDecoder SDGIFDecoder;
+
+typedef enum {
+    SDGIFDecoderStatusNeedsData,  // all the data was consumed, the next frame is not complete yet
+    SDGIFDecoderStatusFrame,      // a frame was composited onto the canvas
+    SDGIFDecoderStatusFinished,   // the trailer was reached, there are no more frames
+    SDGIFDecoderStatusError       // the data is not a GIF, or is corrupted before the first frame
+} SDGIFDecoderStatus;
+
+typedef struct {
+    size_t index;                // the index of the frame, from 0
+    uint32_t delayCentiseconds;  // the delay of the frame, as written in the file
+    uint32_t x, y, width, height; // the rectangle of the frame on the canvas, not clipped
+    int disposal;                // the GIF disposal method, 0 to 3
+    int transparent;             // whether the frame has a transparent color
+} SDGIFFrameInfo;
+
+extern SDGIFDecoder *SDGIFDecoderCreate(void);
+extern void SDGIFDecoderDestroy(SDGIFDecoder *decoder);
+
+/**
+ * Sets the data received so far. The bytes already passed must be unchanged, only new bytes may be appended.
+ * The bytes must stay valid until the next call to the decoder. When `final` is set no more data will come, as in
+ * `CGImageSourceUpdateData`: a truncated last frame is composited with the pixels decoded so far.
+ */
+extern void SDGIFDecoderSetData(SDGIFDecoder *decoder, const uint8_t *bytes, size_t length, int final);
+
+/**
+ * Decodes until the next frame is composited onto the canvas, or until the data runs out.
+ */
+extern SDGIFDecoderStatus SDGIFDecoderDecodeFrame(SDGIFDecoder *decoder, SDGIFFrameInfo *info);
+
+/**
+ * Starts again at the first frame with a transparent canvas, e.g. when an animation loops.
+ */
+extern void SDGIFDecoderRewind(SDGIFDecoder *decoder);
+
+/**
+ * The size of the canvas, 0 until the header is decoded.
+ */
+extern size_t SDGIFDecoderGetWidth(const SDGIFDecoder *decoder);
+extern size_t SDGIFDecoderGetHeight(const SDGIFDecoder *decoder);
+
+/**
+ * The loop count of the NETSCAPE2.0 extension (0 for forever), -1 if it was not found yet.
+ */
+extern int SDGIFDecoderGetLoopCount(const SDGIFDecoder *decoder);
+
+/**
+ * The canvas, `width * 4` bytes per row, NULL until the header is decoded. It is updated in place by each frame.
+ */
+extern const uint8_t *SDGIFDecoderGetCanvas(const SDGIFDecoder *decoder);
+
+/**
+ * Expands palette indexes to 32 bit pixels, leaving the pixels of the transparent index (-1 for none) unchanged.
+ * `palette` has 256 colors. The transparency mask and the blend are NEON / SSE2 code, 16 pixels at a time.
+ */
+extern void SDGIFExpandPaletteRow(const uint8_t *indexes, size_t count, const uint32_t *palette, int transparentIndex, uint32_t *dst);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SDWebImageGIFDecoder_h */
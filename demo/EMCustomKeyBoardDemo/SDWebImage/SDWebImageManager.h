@@ -10,6 +10,7 @@
 #import "SDWebImageOperation.h"
 #import "SDWebImageDownloader.h"
 #import "SDImageCache.h"
+#import "SDWebImageTransformer.h"
 
 //加载图片相关设置的枚举
 typedef NS_OPTIONS(NSUInteger, SDWebImageOptions) {
@@ -78,11 +79,36 @@ typedef NS_OPTIONS(NSUInteger, SDWebImageOptions) {
     SDWebImageDelayPlaceholder = 1 << 9,
 
     /**
-     * We usually don't call transformDownloadedImage delegate method on animated images,
-     * as most transformation code would mangle it.
+     * We usually don't call transformDownloadedImage delegate method (nor the transformer of the context)
+     * on animated images, as most transformation code would mangle it.
      * Use this flag to transform them anyway.
      */
     SDWebImageTransformAnimatedImage = 1 << 10,
+
+    /**
+     * Stream the body of large images directly into the disk cache instead of holding it in memory,
+     * so the memory used by a download doesn't grow with the image size.
+     * Ignored with `SDWebImageCacheMemoryOnly` and `SDWebImageRefreshCached`.
+     大图边下载边写入磁盘缓存，减少下载时的内存占用
+     */
+    SDWebImageStreamToDisk = 1 << 11,
+
+    /**
+     * Decode the image directly at the size of the view it is loaded into (its bounds times the screen scale),
+     * taking the view's content mode into account, instead of at full resolution. Used by the view categories,
+     * see `SDWebImageContextThumbnailPixelSize`.
+     按视图大小直接解码出缩小的图片，适合缩略图列表
+     */
+    SDWebImageThumbnailToViewSize = 1 << 12,
+
+    /**
+     * Only make sure the encoded data of the image is in the disk cache, for prefetching: an image already on disk is
+     * not read, and a downloaded image is neither decoded nor cached in memory. The completion block gets no image,
+     * with `SDImageCacheTypeDisk` once the data is in the disk cache. `SDWebImageCacheMemoryOnly` and the context
+     * are ignored.
+     只保证图片数据在磁盘缓存中（用于预下载）：已缓存的不读取，下载的不解码也不缓存到内存；完成回调中没有图片
+     */
+    SDWebImageCacheDataOnly = 1 << 13,
 };
 
 //加载完成的block
@@ -114,6 +140,7 @@ typedef NSString *(^SDWebImageCacheKeyFilterBlock)(NSURL *url);
 /**
  * Allows to transform the image immediately after it has been downloaded and just before to cache it on disk and memory.
  * NOTE: This method is called from a global queue in order to not to block the main thread.
+ * NOTE: Not called for loads with a `SDWebImageContextTransformer`, whose transformed images are cached under their own key.
  *
  * @param imageManager The current `SDWebImageManager`
  * @param image        The image to transform
@@ -155,6 +182,15 @@ SDWebImageManager *manager = [SDWebImageManager sharedManager];
 @property (strong, nonatomic, readonly) SDImageCache *imageCache;
 @property (strong, nonatomic, readonly) SDWebImageDownloader *imageDownloader;
 
+/**
+ * Creates a manager with its own cache or downloader, e.g. the prefetcher's downloader yielding to the shared one.
+ *
+ * @param cache      The image cache, `createCache` if nil
+ * @param downloader The image downloader, the shared downloader if nil
+ 使用指定的缓存和下载器创建manager（如预下载使用独立的下载器）
+ */
+- (instancetype)initWithCache:(SDImageCache *)cache downloader:(SDWebImageDownloader *)downloader;
+
 /**
  * The cache filter is a block used each time SDWebImageManager need to convert an URL into a cache key. This can
  * be used to remove dynamic part of an image URL.
@@ -173,6 +209,40 @@ SDWebImageManager *manager = [SDWebImageManager sharedManager];
  */
 @property (nonatomic, copy) SDWebImageCacheKeyFilterBlock cacheKeyFilter;
 
+/**
+ * The number of times a download failing with a transient error (network error, timeout, HTTP 408, 429 or 5xx) is
+ * retried before the failure is reported. Retries are delayed with an exponential backoff with jitter.
+ * Defaults to 2. Set to 0 to disable retrying.
+ 下载遇到临时性错误时的重试次数，默认是2
+ */
+@property (assign, nonatomic) NSUInteger maxRetryCount;
+
+/**
+ * The base delay of the retry backoff, in seconds. The n-th retry waits a random time between
+ * half and all of `retryBaseDelay * 2^n`, capped at `retryMaxDelay`. Defaults to 0.5.
+ */
+@property (assign, nonatomic) NSTimeInterval retryBaseDelay;
+
+/**
+ * The maximum delay before a retry, in seconds. Defaults to 8.
+ */
+@property (assign, nonatomic) NSTimeInterval retryMaxDelay;
+
+/**
+ * How long a failed URL stays blacklisted, in seconds. Once expired the URL is downloaded again
+ * even without `SDWebImageRetryFailed`. Defaults to 1 hour, 0 means forever.
+ * A blacklisted URL is still served from the cache, and any successful load of it lifts the blacklisting.
+ 下载失败的url在黑名单中保留的时间，默认是1小时
+ */
+@property (assign, nonatomic) NSTimeInterval failedURLTimeToLive;
+
+/**
+ * The maximum number of blacklisted URLs. The least recently used ones are evicted first.
+ * Defaults to 512, 0 means no limit.
+ 黑名单最多保存的url个数，默认是512
+ */
+@property (assign, nonatomic) NSUInteger maxFailedURLCount;
+
 /**
  * Returns global SDWebImageManager instance.
  *
@@ -207,6 +277,21 @@ SDWebImageManager *manager = [SDWebImageManager sharedManager];
                                         progress:(SDWebImageDownloaderProgressBlock)progressBlock
                                        completed:(SDWebImageCompletionWithFinishedBlock)completedBlock;
 
+/**
+ * Same as `downloadImageWithURL:options:progress:completed:`, producing the image for the given context,
+ * e.g. decoded directly at a thumbnail size with `SDWebImageContextThumbnailPixelSize`.
+ * Images produced for a context are cached in memory under a variant of the URL's cache key, while the disk cache
+ * keeps the original data, so every variant of an image is decoded from a single download.
+ *
+ * @param context The context to produce the image for, may be nil
+ 按上下文（如缩略图尺寸）生成图片，不同上下文的图片在内存中分开缓存，磁盘中只保存一份原始数据
+ */
+- (id <SDWebImageOperation>)downloadImageWithURL:(NSURL *)url
+                                         options:(SDWebImageOptions)options
+                                         context:(NSDictionary *)context
+                                        progress:(SDWebImageDownloaderProgressBlock)progressBlock
+                                       completed:(SDWebImageCompletionWithFinishedBlock)completedBlock;
+
 /**
  * Saves image to cache for given URL
  *
@@ -7,7 +7,9 @@
  */
 
 #import "SDWebImageManager.h"
+#import "SDWebImageDecodePool.h"
 #import <objc/message.h>
+#import <stdatomic.h>
 
 @interface SDWebImageCombinedOperation : NSObject <SDWebImageOperation>
 
@@ -17,12 +19,281 @@
 
 @end
 
+typedef NS_ENUM(NSInteger, SDWebImageFailureKind) {
+    SDWebImageFailureKindCancelled,  // the download was cancelled, nothing to do
+    SDWebImageFailureKindTransient,  // may succeed later: network errors, timeouts, 408, 429 and 5xx
+    SDWebImageFailureKindPermanent   // will fail again: other 4xx, undecodable data...
+};
+
+// Errors reported by the downloader for HTTP responses >= 400 carry the status code in NSURLErrorDomain
+static BOOL SDErrorIsHTTPStatus(NSError *error) {
+    return [error.domain isEqualToString:NSURLErrorDomain] && error.code >= 400 && error.code < 600;
+}
+
+//对下载错误进行分类：取消、临时性错误（可重试）、永久性错误
+static SDWebImageFailureKind SDFailureKindForError(NSError *error) {
+    if (SDErrorIsHTTPStatus(error)) {
+        NSInteger statusCode = error.code;
+        if (statusCode == 408 || statusCode == 429 || statusCode >= 500) {
+            return SDWebImageFailureKindTransient;
+        }
+        return SDWebImageFailureKindPermanent;
+    }
+    if ([error.domain isEqualToString:NSURLErrorDomain]) {
+        switch (error.code) {
+            case NSURLErrorCancelled:
+                return SDWebImageFailureKindCancelled;
+            case NSURLErrorTimedOut:
+            case NSURLErrorNotConnectedToInternet:
+            case NSURLErrorNetworkConnectionLost:
+            case NSURLErrorCannotFindHost:
+            case NSURLErrorCannotConnectToHost:
+            case NSURLErrorDNSLookupFailed:
+            case NSURLErrorInternationalRoamingOff:
+            case NSURLErrorCallIsActive:
+            case NSURLErrorDataNotAllowed:
+                return SDWebImageFailureKindTransient;
+            default:
+                break;
+        }
+    }
+    return SDWebImageFailureKindPermanent;
+}
+
+// A bounded set of failed URLs. Entries expire after `timeToLive` seconds and the least recently used
+// entry is evicted when more than `countLimit` URLs failed.
+//有容量上限的失败url黑名单，条目有过期时间，超出上限时淘汰最近最少使用的条目
+@interface SDWebImageFailedURLCache : NSObject
+
+@property (assign, nonatomic) NSTimeInterval timeToLive;
+@property (assign, nonatomic) NSUInteger countLimit;
+
+- (BOOL)containsURL:(NSURL *)url;
+- (void)addURL:(NSURL *)url;
+- (void)removeURL:(NSURL *)url;
+
+@end
+
+@implementation SDWebImageFailedURLCache {
+    NSMutableDictionary *_expirationDates; // url -> NSDate
+    NSMutableOrderedSet *_usageOrder;      // least recently used first
+}
+
+- (id)init {
+    if ((self = [super init])) {
+        _expirationDates = [NSMutableDictionary new];
+        _usageOrder = [NSMutableOrderedSet new];
+        _timeToLive = 60 * 60; // 1 hour
+        _countLimit = 512;
+    }
+    return self;
+}
+
+- (BOOL)containsURL:(NSURL *)url {
+    if (!url) {
+        return NO;
+    }
+    @synchronized (self) {
+        NSDate *expirationDate = _expirationDates[url];
+        if (!expirationDate) {
+            return NO;
+        }
+        if (self.timeToLive > 0 && [expirationDate timeIntervalSinceNow] <= 0) {
+            [_expirationDates removeObjectForKey:url];
+            [_usageOrder removeObject:url];
+            return NO;
+        }
+        [_usageOrder removeObject:url];
+        [_usageOrder addObject:url];
+        return YES;
+    }
+}
+
+- (void)addURL:(NSURL *)url {
+    if (!url) {
+        return;
+    }
+    @synchronized (self) {
+        _expirationDates[url] = self.timeToLive > 0 ? [NSDate dateWithTimeIntervalSinceNow:self.timeToLive] : [NSDate distantFuture];
+        [_usageOrder removeObject:url];
+        [_usageOrder addObject:url];
+        [self evictIfNeeded];
+    }
+}
+
+- (void)removeURL:(NSURL *)url {
+    if (!url) {
+        return;
+    }
+    @synchronized (self) {
+        [_expirationDates removeObjectForKey:url];
+        [_usageOrder removeObject:url];
+    }
+}
+
+- (void)setCountLimit:(NSUInteger)countLimit {
+    @synchronized (self) {
+        _countLimit = countLimit;
+        [self evictIfNeeded];
+    }
+}
+
+// Must be called inside @synchronized (self)
+- (void)evictIfNeeded {
+    while (self.countLimit > 0 && _usageOrder.count > self.countLimit) {
+        NSURL *leastRecentlyUsedURL = _usageOrder.firstObject;
+        [_usageOrder removeObjectAtIndex:0];
+        [_expirationDates removeObjectForKey:leastRecentlyUsedURL];
+    }
+}
+
+@end
+
+// Tracks the running operations in identity hash sets split into shards, each with its own lock, so that adding
+// and removing an operation is O(1) and concurrent completions rarely contend for the same lock
+//正在运行的operation集合：按对象地址分片的哈希表，每个分片单独加锁，增删都是O(1)
+@interface SDWebImageOperationRegistry : NSObject
+
+@property (readonly, nonatomic) NSUInteger count;
+
+- (void)addOperation:(id)operation;
+- (void)removeOperation:(id)operation;
+// Removes and returns all the operations
+- (NSArray *)removeAllOperations;
+
+@end
+
+static const NSUInteger kSDOperationRegistryShardCount = 16;
+
+@implementation SDWebImageOperationRegistry {
+    NSHashTable *_shards[kSDOperationRegistryShardCount];
+    atomic_ulong _count;
+}
+
+- (id)init {
+    if ((self = [super init])) {
+        for (NSUInteger i = 0; i < kSDOperationRegistryShardCount; i++) {
+            // Object pointer personality: hash and compare by identity, never call -hash / -isEqual:
+            _shards[i] = [[NSHashTable alloc] initWithOptions:NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPointerPersonality capacity:0];
+        }
+        atomic_init(&_count, 0);
+    }
+    return self;
+}
+
+- (NSHashTable *)shardForOperation:(id)operation {
+    // The low bits of an object address are always 0 because of the allocation alignment
+    return _shards[((uintptr_t)(__bridge void *)operation >> 4) % kSDOperationRegistryShardCount];
+}
+
+- (void)addOperation:(id)operation {
+    if (!operation) {
+        return;
+    }
+    NSHashTable *shard = [self shardForOperation:operation];
+    @synchronized (shard) {
+        if (![shard containsObject:operation]) {
+            [shard addObject:operation];
+            atomic_fetch_add(&_count, 1);
+        }
+    }
+}
+
+- (void)removeOperation:(id)operation {
+    if (!operation) {
+        return;
+    }
+    NSHashTable *shard = [self shardForOperation:operation];
+    @synchronized (shard) {
+        if ([shard containsObject:operation]) {
+            [shard removeObject:operation];
+            atomic_fetch_sub(&_count, 1);
+        }
+    }
+}
+
+- (NSArray *)removeAllOperations {
+    NSMutableArray *operations = [NSMutableArray new];
+    for (NSUInteger i = 0; i < kSDOperationRegistryShardCount; i++) {
+        NSHashTable *shard = _shards[i];
+        @synchronized (shard) {
+            NSArray *shardOperations = shard.allObjects;
+            [shard removeAllObjects];
+            atomic_fetch_sub(&_count, shardOperations.count);
+            [operations addObjectsFromArray:shardOperations];
+        }
+    }
+    return operations;
+}
+
+- (NSUInteger)count {
+    return (NSUInteger)atomic_load(&_count);
+}
+
+@end
+
+// A disk cache query shared by all the loads of the same key requested while it runs
+//同一个key正在进行中的缓存查询，查询期间对同一个key的请求都挂在这里，共享一次磁盘读取和解码
+@interface SDWebImageCacheQuery : NSObject
+
+@property (strong, nonatomic) NSOperation *cacheOperation;
+@property (strong, nonatomic) NSMutableArray *tokens;
+
+@end
+
+@implementation SDWebImageCacheQuery
+
+- (id)init {
+    if ((self = [super init])) {
+        _tokens = [NSMutableArray new];
+    }
+    return self;
+}
+
+@end
+
+// What a single caller gets back from a coalesced cache query, cancelling it only detaches this caller
+//返回给每个调用者的operation，取消时只移除该调用者，所有调用者都取消后才取消真正的查询
+@interface SDWebImageCacheQueryToken : NSOperation
+
+@property (copy, nonatomic) SDWebImageQueryCompletedBlock doneBlock;
+@property (copy, nonatomic) SDWebImageNoParamsBlock cancelHandler;
+
+@end
+
+@implementation SDWebImageCacheQueryToken
+
+- (void)cancel {
+    if (self.isCancelled) {
+        return;
+    }
+    [super cancel];
+    SDWebImageNoParamsBlock cancelHandler = self.cancelHandler;
+    self.cancelHandler = nil;
+    if (cancelHandler) {
+        cancelHandler();
+    }
+}
+
+@end
+
+// The context of the image a transformer is applied to
+static NSDictionary *SDSourceContextForContext(NSDictionary *context) {
+    if (!context[SDWebImageContextTransformer]) {
+        return context;
+    }
+    NSMutableDictionary *sourceContext = [context mutableCopy];
+    [sourceContext removeObjectForKey:SDWebImageContextTransformer];
+    return [sourceContext copy];
+}
+
 @interface SDWebImageManager ()
 
 @property (strong, nonatomic, readwrite) SDImageCache *imageCache;
 @property (strong, nonatomic, readwrite) SDWebImageDownloader *imageDownloader;
-@property (strong, nonatomic) NSMutableSet *failedURLs;
-@property (strong, nonatomic) NSMutableArray *runningOperations;
+@property (strong, nonatomic) SDWebImageFailedURLCache *failedURLs;
+@property (strong, nonatomic) SDWebImageOperationRegistry *runningOperations;
+@property (strong, nonatomic) NSMutableDictionary *runningCacheQueries;
 
 @end
 
@@ -38,11 +309,19 @@
 }
 
 - (id)init {
+    return [self initWithCache:nil downloader:nil];
+}
+
+- (instancetype)initWithCache:(SDImageCache *)cache downloader:(SDWebImageDownloader *)downloader {
     if ((self = [super init])) {
-        _imageCache = [self createCache];
-        _imageDownloader = [SDWebImageDownloader sharedDownloader];
-        _failedURLs = [NSMutableSet new];
-        _runningOperations = [NSMutableArray new];
+        _imageCache = cache ?: [self createCache];
+        _imageDownloader = downloader ?: [SDWebImageDownloader sharedDownloader];
+        _failedURLs = [SDWebImageFailedURLCache new];
+        _maxRetryCount = 2;
+        _retryBaseDelay = 0.5;
+        _retryMaxDelay = 8.0;
+        _runningOperations = [SDWebImageOperationRegistry new];
+        _runningCacheQueries = [NSMutableDictionary new];
     }
     return self;
 }
@@ -133,9 +412,17 @@
     }];
 }
 
+- (id <SDWebImageOperation>)downloadImageWithURL:(NSURL *)url
+                                         options:(SDWebImageOptions)options
+                                        progress:(SDWebImageDownloaderProgressBlock)progressBlock
+                                       completed:(SDWebImageCompletionWithFinishedBlock)completedBlock {
+    return [self downloadImageWithURL:url options:options context:nil progress:progressBlock completed:completedBlock];
+}
+
 //重要方法
 - (id <SDWebImageOperation>)downloadImageWithURL:(NSURL *)url
                                          options:(SDWebImageOptions)options
+                                         context:(NSDictionary *)context
                                         progress:(SDWebImageDownloaderProgressBlock)progressBlock
                                        completed:(SDWebImageCompletionWithFinishedBlock)completedBlock {
     // 断言
@@ -177,32 +464,25 @@
 
     /**
      @synchronized是OC中一种方便地创建互斥锁的方式--它可以防止不同线程在同一时间执行区块的代码
-     self.failedURLs是一个NSSet类型的集合,里面存放的都是下载失败的图片的url,failedURLs不是NSArray类型的原因是:
+     self.failedURLs是下载失败的图片url的黑名单，内部用哈希表(NSDictionary)存放url,不用NSArray的原因是:
       在搜索一个个元素的时候NSSet比NSArray效率高,主要是它用到了一个算法hash(散列,哈希) ,比如你要存储A,一个hash算法直接就能找到A应该存储的位置;同样当你要访问A的时候,一个hash过程就能找到A存储的位置,对于NSArray,若想知道A到底在不在数组中,则需要遍历整个数据,显然效率较低了
      并且NSSet里面不含有重复的元素,同一个下载失败的url只会存在一个
      注：1.NSArray是有序的集合，NSSet是无序的集合。
         2.NSSet存储的所有对象只能有唯一一个，不能重复。
         3.NSSet集合是一种哈希表，运用散列算法，查找集合中的元素比数组速度更快，但是它没有顺序。
      **/
-    BOOL isFailedUrl = NO;//是否是下载失败过的url
-    @synchronized (self.failedURLs) {
-        //self.failedURLs里面存放的都是下载失败的图片的url
-        isFailedUrl = [self.failedURLs containsObject:url];
-    }
+    //self.failedURLs里面存放的都是下载失败的图片的url（过期的条目会被自动移除）
+    //下载失败过的url仍然先查询缓存（其他加载可能已经成功并缓存了该图片），只是不再下载，见shouldRefuseDownloadForURL:options:
 
-    //如果url不存在那么直接返回一个block,如果url存在那么继续
-    //SDWebImageRetryFailed:失败url会重新尝试下载
-    //如果url为空，或者该url是一个之前下载失败过的url,但是又没有设置SDWebImageRetryFailed，则
-    //执行completedBlock，返回错误，并且return该operation
-    if (!url || (!(options & SDWebImageRetryFailed) && isFailedUrl)) {
+    //如果url为空，执行completedBlock，返回错误，并且return该operation
+    if (!url) {
         dispatch_main_sync_safe(^{
-            NSError *error = [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorFileDoesNotExist userInfo:nil];
-            completedBlock(nil, error, SDImageCacheTypeNone, YES, url);
+            completedBlock(nil, [self failedURLError], SDImageCacheTypeNone, YES, url);
         });
         return operation;
     }
 
-    //创建一个互斥线程锁来保护把operation加入到self.runningOperations的数组里面
+    //把operation加入到self.runningOperations中（内部按分片加锁，下面是@synchronized的说明）
     
     /**
       NSLock *_lock;
@@ -225,18 +505,19 @@
      你也可以在任何Objective-C的对象上使用@synchronized。因此，同样的我们也可以像下面的例子里一样，使用@synchronized(_elements)来代替@synchronized(self)，这两者的效果是一致的。
    @synchronized的代码块和前面例子中的[ _lock unlock]、[ _lock unlock]的作用相同作用效果。你可以把它理解成把self当作一个NSLock来对self进行加锁。在运行{后的代码前获取锁，并在运行}后的其他代码前释放这个锁。这非常的方便，因为这意味着你永远不会忘了调用unlock
      **/
-    @synchronized (self.runningOperations) {
-        [self.runningOperations addObject:operation];
-    }
+    [self.runningOperations addOperation:operation];
     //获取image的url对应的key,[self cacheKeyForURL:url]是获取一个完整的url
     NSString *key = [self cacheKeyForURL:url];
 
+    if (options & SDWebImageCacheDataOnly) {
+        [self cacheDataForOperation:operation url:url key:key options:options progress:progressBlock completed:completedBlock];
+        return operation;
+    }
+
     //self.imageCache对象已经在当前类的init方法中实例化了
-    operation.cacheOperation = [self.imageCache queryDiskCacheForKey:key done:^(UIImage *image, SDImageCacheType cacheType) {
+    operation.cacheOperation = [self queryTransformedCacheForKey:key context:context options:options done:^(UIImage *image, SDImageCacheType cacheType) {
         if (operation.isCancelled) {
-            @synchronized (self.runningOperations) {
-                [self.runningOperations removeObject:operation];
-            }
+            [self.runningOperations removeOperation:operation];
 
             return;
         }
@@ -248,6 +529,20 @@
              (![self.delegate respondsToSelector:@selector(imageManager:shouldDownloadImageForURL:)] || [self.delegate imageManager:self shouldDownloadImageForURL:url])：即代理没有实现该方法（该方法默认是YES）或者返回的是YES,都表明需求下载图片
              **/
             //下面进入下载过程
+            if (image) {
+                //另一个加载已经成功缓存了该图片，黑名单条目不再有效
+                [self.failedURLs removeURL:url];
+            }
+            else if ([self shouldRefuseDownloadForURL:url options:options]) {
+                //下载失败过的url，又没有设置SDWebImageRetryFailed，返回错误
+                dispatch_main_sync_safe(^{
+                    if (!weakOperation.isCancelled) {
+                        completedBlock(nil, [self failedURLError], SDImageCacheTypeNone, YES, url);
+                    }
+                });
+                [self.runningOperations removeOperation:operation];
+                return;
+            }
             if (image && options & SDWebImageRefreshCached) {
                 //有图片，但是设置了SDWebImageRefreshCached,回调image（completedBlock(image, nil, cacheType, YES, url);），但是继续往下执行下载更新该图片的操作
                 dispatch_main_sync_safe(^{
@@ -258,113 +553,16 @@
             }
 
             // download if no image or requested to refresh anyway, and download allowed by delegate
-            SDWebImageDownloaderOptions downloaderOptions = 0;
-            if (options & SDWebImageLowPriority) downloaderOptions |= SDWebImageDownloaderLowPriority;
-            if (options & SDWebImageProgressiveDownload) downloaderOptions |= SDWebImageDownloaderProgressiveDownload;
-            if (options & SDWebImageRefreshCached) downloaderOptions |= SDWebImageDownloaderUseNSURLCache;
-            if (options & SDWebImageContinueInBackground) downloaderOptions |= SDWebImageDownloaderContinueInBackground;
-            if (options & SDWebImageHandleCookies) downloaderOptions |= SDWebImageDownloaderHandleCookies;
-            if (options & SDWebImageAllowInvalidSSLCertificates) downloaderOptions |= SDWebImageDownloaderAllowInvalidSSLCertificates;
-            if (options & SDWebImageHighPriority) downloaderOptions |= SDWebImageDownloaderHighPriority;
-            if (image && options & SDWebImageRefreshCached) {
-                // force progressive off if image already cached but forced refreshing
-                downloaderOptions &= ~SDWebImageDownloaderProgressiveDownload;
-                // ignore image read from NSURLCache if image if cached but force refreshing
-                downloaderOptions |= SDWebImageDownloaderIgnoreCachedResponse;
-            }
-            id <SDWebImageOperation> subOperation = [self.imageDownloader downloadImageWithURL:url options:downloaderOptions progress:progressBlock completed:^(UIImage *downloadedImage, NSData *data, NSError *error, BOOL finished) {
-                if (weakOperation.isCancelled) {
-                    // Do nothing if the operation was cancelled
-                    // See #699 for more details
-                    // if we would call the completedBlock, there could be a race condition between this block and another completedBlock for the same object, so if this one is called second, we will overwrite the new data
-                }else if (error) {
-                    dispatch_main_sync_safe(^{
-                        if (!weakOperation.isCancelled) {
-                            //不是操作取消了
-                            completedBlock(nil, error, SDImageCacheTypeNone, finished, url);
-                        }
-                    });
-                    //判断是否需要将该url加入黑名单
-                    if (error.code != NSURLErrorNotConnectedToInternet && error.code != NSURLErrorCancelled && error.code != NSURLErrorTimedOut) {
-                        //如果错误不是1.未连接到网络或者2.当异步加载取消或者3.超时这三种时则属于失败的url,会被加入failedURLs数组黑名单，下次不会再下载
-                        @synchronized (self.failedURLs) {
-                            [self.failedURLs addObject:url];
-                        }
-                    }
-                }else {
-                    //到此，已经下载没有出错
-                    
-                    //判断是否需要缓存到磁盘
-                    BOOL cacheOnDisk = !(options & SDWebImageCacheMemoryOnly);
-
-                    if (options & SDWebImageRefreshCached && image && !downloadedImage) {
-                        //如果有缓存图片，切设置了SDWebImageRefreshCached，且有新下载的图片
-                        //表示刷新了NSURLCache
-                        // Image refresh hit the NSURLCache cache, do not call the completion block
-                    }else if (downloadedImage && (!downloadedImage.images || (options & SDWebImageTransformAnimatedImage)) && [self.delegate respondsToSelector:@selector(imageManager:transformDownloadedImage:withURL:)]) {
-                        //  允许在对下载的图片进行缓存之前进行调整图片，返回一个UIImage
-                        dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_HIGH, 0), ^{
-                            //获得调整后的图片
-                            UIImage *transformedImage = [self.delegate imageManager:self transformDownloadedImage:downloadedImage withURL:url];
-
-                            if (transformedImage && finished) {
-                                //将调整后的图片进行缓存
-                                BOOL imageWasTransformed = ![transformedImage isEqual:downloadedImage];
-                                [self.imageCache storeImage:transformedImage recalculateFromImage:imageWasTransformed imageData:data forKey:key toDisk:cacheOnDisk];
-                            }
-
-                            dispatch_main_sync_safe(^{
-                                if (!weakOperation.isCancelled) {
-                                    //回调调整后的图片
-                                    completedBlock(transformedImage, nil, SDImageCacheTypeNone, finished, url);
-                                }
-                            });
-                        });
-                        
-                    }else {
-                        if (downloadedImage && finished) {
-                            //将下载的图片downloadedImage进行缓存
-                            [self.imageCache storeImage:downloadedImage recalculateFromImage:NO imageData:data forKey:key toDisk:cacheOnDisk];
-                        }
-
-                        dispatch_main_sync_safe(^{
-                            if (!weakOperation.isCancelled) {
-                                //完成回调
-                                completedBlock(downloadedImage, nil, SDImageCacheTypeNone, finished, url);
-                            }
-                        });
-                    }
-                }
-
-                if (finished) {
-                    //下载完成了，将operation操作移除
-                    @synchronized (self.runningOperations) {
-                        [self.runningOperations removeObject:operation];
-                    }
-                }
-            }];
-            operation.cancelBlock = ^{
-                //取消下载
-                [subOperation cancel];
-                
-                @synchronized (self.runningOperations) {
-                     //下载取消，将operation操作移除
-                    [self.runningOperations removeObject:weakOperation];
-                }
-            };
-            //==================================================================
-            
-            
+            [self downloadImageForOperation:operation url:url key:key options:options context:context cachedImage:image attempt:0 progress:progressBlock completed:completedBlock];
         }else if (image) {
             //有缓存图片
+            [self.failedURLs removeURL:url];
             dispatch_main_sync_safe(^{
                 if (!weakOperation.isCancelled) {
                     completedBlock(image, nil, cacheType, YES, url);
                 }
             });
-            @synchronized (self.runningOperations) {
-                [self.runningOperations removeObject:operation];
-            }
+            [self.runningOperations removeOperation:operation];
         }else {
             // Image not in cache and download disallowed by delegate
             //没有缓存图片，且不允许下载该图片，回调nil
@@ -373,15 +571,401 @@
                     completedBlock(nil, nil, SDImageCacheTypeNone, YES, url);
                 }
             });
-            @synchronized (self.runningOperations) {
-                [self.runningOperations removeObject:operation];
-            }
+            [self.runningOperations removeOperation:operation];
         }
     }];
 
     return operation;
 }
 
+// Same as -[SDImageCache queryDiskCacheForKey:context:done:], but queries of a key already being read from disk
+// wait for that read instead of issuing their own, so identical images in a grid are read and decoded once.
+// Queries for different contexts of the same key produce different images and are not coalesced.
+//查询缓存：同一个key（及上下文）已经有查询在进行时，不再重复读取磁盘和解码，而是等待该查询的结果
+- (NSOperation *)queryCacheForKey:(NSString *)key context:(NSDictionary *)context done:(SDWebImageQueryCompletedBlock)doneBlock {
+    if (!key) {
+        return [self.imageCache queryDiskCacheForKey:key context:context done:doneBlock];
+    }
+    NSString *variantKey = SDTransformedCacheKeyForContext(key, context);
+    // Memory hits are answered synchronously, no need to coalesce them
+    UIImage *image = [self.imageCache imageFromMemoryCacheForKey:variantKey];
+    if (image) {
+        doneBlock(image, SDImageCacheTypeMemory);
+        return nil;
+    }
+
+    SDWebImageCacheQueryToken *token = [SDWebImageCacheQueryToken new];
+    token.doneBlock = doneBlock;
+    SDWebImageCacheQuery *query = nil;
+    BOOL shouldStartQuery = NO;
+    @synchronized (self.runningCacheQueries) {
+        query = self.runningCacheQueries[variantKey];
+        if (!query) {
+            query = [SDWebImageCacheQuery new];
+            self.runningCacheQueries[variantKey] = query;
+            shouldStartQuery = YES;
+        }
+        [query.tokens addObject:token];
+    }
+
+    __weak SDWebImageCacheQueryToken *weakToken = token;
+    token.cancelHandler = ^{
+        NSOperation *cacheOperation = nil;
+        @synchronized (self.runningCacheQueries) {
+            [query.tokens removeObjectIdenticalTo:weakToken];
+            if (query.tokens.count == 0) {
+                //所有调用者都取消了，取消磁盘查询
+                if (self.runningCacheQueries[variantKey] == query) {
+                    [self.runningCacheQueries removeObjectForKey:variantKey];
+                }
+                cacheOperation = query.cacheOperation;
+            }
+        }
+        [cacheOperation cancel];
+    };
+
+    if (shouldStartQuery) {
+        NSOperation *cacheOperation = [self.imageCache queryDiskCacheForKey:key context:context done:^(UIImage *diskImage, SDImageCacheType cacheType) {
+            NSArray *tokens = nil;
+            @synchronized (self.runningCacheQueries) {
+                tokens = [query.tokens copy];
+                [query.tokens removeAllObjects];
+                if (self.runningCacheQueries[variantKey] == query) {
+                    [self.runningCacheQueries removeObjectForKey:variantKey];
+                }
+            }
+            //将同一次查询的结果分发给所有的调用者
+            for (SDWebImageCacheQueryToken *waitingToken in tokens) {
+                if (!waitingToken.isCancelled) {
+                    waitingToken.doneBlock(diskImage, cacheType);
+                }
+                waitingToken.doneBlock = nil;
+                waitingToken.cancelHandler = nil;
+            }
+        }];
+        BOOL everyoneCancelled = NO;
+        @synchronized (self.runningCacheQueries) {
+            query.cacheOperation = cacheOperation;
+            everyoneCancelled = query.tokens.count == 0 && self.runningCacheQueries[variantKey] != query;
+        }
+        if (everyoneCancelled) {
+            [cacheOperation cancel];
+        }
+    }
+    return token;
+}
+
+// Queries the transformed image of the context. On a miss the source image is queried instead, then transformed
+// and cached, so that each image is transformed once rather than on every memory cache miss.
+//查询变换后的图片；未命中时查询原图，变换后缓存
+- (NSOperation *)queryTransformedCacheForKey:(NSString *)key context:(NSDictionary *)context options:(SDWebImageOptions)options done:(SDWebImageQueryCompletedBlock)doneBlock {
+    if (!key || !context[SDWebImageContextTransformer]) {
+        return [self queryCacheForKey:key context:context done:doneBlock];
+    }
+    SDWebImageCacheQueryToken *token = [SDWebImageCacheQueryToken new];
+    __weak SDWebImageCacheQueryToken *weakToken = token;
+    __block NSOperation *currentOperation = nil;
+    token.cancelHandler = ^{
+        NSOperation *operationToCancel = nil;
+        @synchronized (weakToken) {
+            operationToCancel = currentOperation;
+        }
+        [operationToCancel cancel];
+    };
+
+    // The done blocks are not retained by the token, they can hold it strongly
+    NSOperation *transformedOperation = [self queryCacheForKey:key context:context done:^(UIImage *image, SDImageCacheType cacheType) {
+        if (image || token.isCancelled) {
+            doneBlock(image, cacheType);
+            return;
+        }
+        NSOperation *sourceOperation = [self queryCacheForKey:key context:SDSourceContextForContext(context) done:^(UIImage *sourceImage, SDImageCacheType sourceCacheType) {
+            if (!sourceImage || token.isCancelled) {
+                doneBlock(nil, SDImageCacheTypeNone);
+                return;
+            }
+            [self transformImage:sourceImage forKey:key context:context options:options toDisk:!(options & SDWebImageCacheMemoryOnly) completed:^(UIImage *transformedImage) {
+                dispatch_main_async_safe(^{
+                    doneBlock(transformedImage, sourceCacheType);
+                });
+            }];
+        }];
+        @synchronized (token) {
+            currentOperation = sourceOperation;
+        }
+    }];
+    @synchronized (token) {
+        if (!currentOperation) {
+            currentOperation = transformedOperation;
+        }
+    }
+    return token;
+}
+
+// Runs the transformer of the context on the decode pool and caches the transformed image under the key of the context
+//在解码池中执行上下文中的变换器，并把结果缓存到内存和磁盘
+- (void)transformImage:(UIImage *)image forKey:(NSString *)key context:(NSDictionary *)context options:(SDWebImageOptions)options toDisk:(BOOL)toDisk completed:(void (^)(UIImage *transformedImage))completedBlock {
+    id <SDWebImageTransformer> transformer = context[SDWebImageContextTransformer];
+    if (!transformer || (SDImageIsAnimated(image) && !(options & SDWebImageTransformAnimatedImage))) {
+        completedBlock(image);
+        return;
+    }
+    NSOperationQueuePriority priority = NSOperationQueuePriorityNormal;
+    if (options & SDWebImageHighPriority) {
+        priority = NSOperationQueuePriorityHigh;
+    } else if (options & SDWebImageLowPriority) {
+        priority = NSOperationQueuePriorityLow;
+    }
+    NSUInteger cost = (NSUInteger)(image.size.width * image.scale * image.size.height * image.scale * 4);
+    [[SDWebImageDecodePool sharedPool] addDecodeBlock:^{
+        UIImage *transformedImage = [transformer transformedImageWithImage:image forKey:key];
+        if (transformedImage) {
+            [self.imageCache storeImage:transformedImage recalculateFromImage:YES imageData:nil forKey:key context:context toDisk:toDisk];
+        }
+        completedBlock(transformedImage);
+    } cost:cost priority:priority];
+}
+
+// Makes sure the data of the image is in the disk cache: for a cached image only the existence of the file is checked,
+// a downloaded image is stored as is
+//只保证图片数据在磁盘缓存中：已缓存的只检查文件是否存在，下载的数据不解码直接写入磁盘
+- (void)cacheDataForOperation:(SDWebImageCombinedOperation *)operation
+                          url:(NSURL *)url
+                          key:(NSString *)key
+                      options:(SDWebImageOptions)options
+                     progress:(SDWebImageDownloaderProgressBlock)progressBlock
+                    completed:(SDWebImageCompletionWithFinishedBlock)completedBlock {
+    [self.imageCache diskImageExistsWithKey:key completion:^(BOOL isInCache) {
+        if (operation.isCancelled) {
+            [self.runningOperations removeOperation:operation];
+            return;
+        }
+        if (isInCache) {
+            [self.failedURLs removeURL:url];
+        }
+        if (isInCache && !(options & SDWebImageRefreshCached)) {
+            completedBlock(nil, nil, SDImageCacheTypeDisk, YES, url);
+            [self.runningOperations removeOperation:operation];
+        }
+        else if (!isInCache && [self shouldRefuseDownloadForURL:url options:options]) {
+            completedBlock(nil, [self failedURLError], SDImageCacheTypeNone, YES, url);
+            [self.runningOperations removeOperation:operation];
+        }
+        else if (![self.delegate respondsToSelector:@selector(imageManager:shouldDownloadImageForURL:)] || [self.delegate imageManager:self shouldDownloadImageForURL:url]) {
+            [self downloadImageForOperation:operation url:url key:key options:options context:nil cachedImage:nil attempt:0 progress:progressBlock completed:completedBlock];
+        }
+        else {
+            completedBlock(nil, nil, SDImageCacheTypeNone, YES, url);
+            [self.runningOperations removeOperation:operation];
+        }
+    }];
+}
+
+//下载图片，失败时根据错误类型决定是否按指数退避重试、是否加入黑名单
+- (void)downloadImageForOperation:(SDWebImageCombinedOperation *)operation
+                              url:(NSURL *)url
+                              key:(NSString *)key
+                          options:(SDWebImageOptions)options
+                          context:(NSDictionary *)context
+                      cachedImage:(UIImage *)image
+                          attempt:(NSUInteger)attempt
+                         progress:(SDWebImageDownloaderProgressBlock)progressBlock
+                        completed:(SDWebImageCompletionWithFinishedBlock)completedBlock {
+    __weak SDWebImageCombinedOperation *weakOperation = operation;
+
+    SDWebImageDownloaderOptions downloaderOptions = 0;
+    if (options & SDWebImageLowPriority) downloaderOptions |= SDWebImageDownloaderLowPriority;
+    if (options & SDWebImageProgressiveDownload) downloaderOptions |= SDWebImageDownloaderProgressiveDownload;
+    if (options & SDWebImageRefreshCached) downloaderOptions |= SDWebImageDownloaderUseNSURLCache;
+    if (options & SDWebImageContinueInBackground) downloaderOptions |= SDWebImageDownloaderContinueInBackground;
+    if (options & SDWebImageHandleCookies) downloaderOptions |= SDWebImageDownloaderHandleCookies;
+    if (options & SDWebImageAllowInvalidSSLCertificates) downloaderOptions |= SDWebImageDownloaderAllowInvalidSSLCertificates;
+    if (options & SDWebImageHighPriority) downloaderOptions |= SDWebImageDownloaderHighPriority;
+    if (options & SDWebImageStreamToDisk && !(options & (SDWebImageCacheMemoryOnly | SDWebImageRefreshCached))) downloaderOptions |= SDWebImageDownloaderStreamToDisk;
+    if (options & SDWebImageCacheDataOnly) downloaderOptions |= SDWebImageDownloaderDataOnly;
+    if (image && options & SDWebImageRefreshCached) {
+        // force progressive off if image already cached but forced refreshing
+        downloaderOptions &= ~SDWebImageDownloaderProgressiveDownload;
+        // ignore image read from NSURLCache if image if cached but force refreshing
+        downloaderOptions |= SDWebImageDownloaderIgnoreCachedResponse;
+    }
+    // The downloader keeps the partial data of interrupted downloads in this manager's cache, under this manager's key
+    //下载器使用本管理器的缓存和key保存断点续传数据
+    NSMutableDictionary *downloadContext = [NSMutableDictionary dictionaryWithDictionary:context];
+    downloadContext[SDWebImageContextCacheKey] = key;
+    downloadContext[SDWebImageContextImageCache] = self.imageCache;
+    id <SDWebImageOperation> subOperation = [self.imageDownloader downloadImageWithURL:url options:downloaderOptions context:downloadContext progress:progressBlock completed:^(UIImage *downloadedImage, NSData *data, NSError *error, BOOL finished) {
+        if (weakOperation.isCancelled) {
+            // Do nothing if the operation was cancelled
+            // See #699 for more details
+            // if we would call the completedBlock, there could be a race condition between this block and another completedBlock for the same object, so if this one is called second, we will overwrite the new data
+        }else if (error) {
+            SDWebImageFailureKind failureKind = SDFailureKindForError(error);
+            if (failureKind == SDWebImageFailureKindTransient && attempt < self.maxRetryCount) {
+                //临时性错误（网络错误、超时、408/429/5xx），按指数退避延迟后重试，暂不回调
+                NSTimeInterval delay = [self retryDelayForAttempt:attempt];
+                dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+                    if (weakOperation.isCancelled) {
+                        return;
+                    }
+                    [self downloadImageForOperation:operation url:url key:key options:options context:context cachedImage:image attempt:attempt + 1 progress:progressBlock completed:completedBlock];
+                });
+                return;
+            }
+
+            dispatch_main_sync_safe(^{
+                if (!weakOperation.isCancelled) {
+                    //不是操作取消了
+                    completedBlock(nil, error, SDImageCacheTypeNone, finished, url);
+                }
+            });
+            //判断是否需要将该url加入黑名单
+            //永久性错误（如404、图片解码失败）以及本次加载重试用尽的服务器错误加入黑名单，黑名单条目过期后会自动移除；断网、超时等网络错误不加入黑名单
+            //重试期间同一url的其他加载可能已经成功，此时图片已在缓存中，不加入黑名单
+            BOOL blacklisted = failureKind == SDWebImageFailureKindPermanent || (failureKind == SDWebImageFailureKindTransient && SDErrorIsHTTPStatus(error) && attempt >= self.maxRetryCount);
+            if (blacklisted && ![self isImageCachedForKey:key]) {
+                [self.failedURLs addURL:url];
+            }
+        }else {
+            //到此，已经下载没有出错
+
+            //判断是否需要缓存到磁盘
+            BOOL cacheOnDisk = !(options & SDWebImageCacheMemoryOnly);
+
+            if (options & SDWebImageRefreshCached && image && !downloadedImage) {
+                //如果有缓存图片，切设置了SDWebImageRefreshCached，且有新下载的图片
+                //表示刷新了NSURLCache
+                // Image refresh hit the NSURLCache cache, do not call the completion block
+            }else if (options & SDWebImageCacheDataOnly) {
+                //只缓存数据到磁盘，数据已经在下载时写入磁盘缓存的不再重复写入
+                SDImageCacheType cacheType = SDImageCacheTypeNone;
+                if (data && finished) {
+                    if (!(downloaderOptions & SDWebImageDownloaderStreamToDisk && [self.imageCache diskImageExistsWithKey:key])) {
+                        [self.imageCache storeImageData:data forKey:key];
+                    }
+                    cacheType = SDImageCacheTypeDisk;
+                }
+                dispatch_main_sync_safe(^{
+                    if (!weakOperation.isCancelled) {
+                        completedBlock(nil, nil, cacheType, finished, url);
+                    }
+                });
+            }else if (downloadedImage && (!SDImageIsAnimated(downloadedImage) || (options & SDWebImageTransformAnimatedImage)) && !context[SDWebImageContextTransformer] && [self.delegate respondsToSelector:@selector(imageManager:transformDownloadedImage:withURL:)]) {
+                //  允许在对下载的图片进行缓存之前进行调整图片，返回一个UIImage
+                dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_HIGH, 0), ^{
+                    //获得调整后的图片
+                    UIImage *transformedImage = [self.delegate imageManager:self transformDownloadedImage:downloadedImage withURL:url];
+
+                    if (transformedImage && finished) {
+                        //将调整后的图片进行缓存
+                        BOOL imageWasTransformed = ![transformedImage isEqual:downloadedImage];
+                        [self.imageCache storeImage:transformedImage recalculateFromImage:imageWasTransformed imageData:data forKey:key context:context toDisk:cacheOnDisk];
+                    }
+
+                    dispatch_main_sync_safe(^{
+                        if (!weakOperation.isCancelled) {
+                            //回调调整后的图片
+                            completedBlock(transformedImage, nil, SDImageCacheTypeNone, finished, url);
+                        }
+                    });
+                });
+
+            }else {
+                BOOL dataOnDisk = NO;
+                if (downloaderOptions & SDWebImageDownloaderStreamToDisk && cacheOnDisk && [self.imageCache diskImageExistsWithKey:key]) {
+                    // The downloader already moved the body into the disk cache, only keep the image in memory
+                    //数据已经在下载时写入了磁盘缓存，只需缓存到内存
+                    dataOnDisk = YES;
+                }
+                //原图按不带变换器的上下文缓存
+                NSDictionary *sourceContext = SDSourceContextForContext(context);
+                if (downloadedImage && finished && [context[SDWebImageContextVariantPixelLengths] count] > 0) {
+                    //一次解码生成所有尺寸的变体并缓存，回调适合当前上下文的变体
+                    downloadedImage = [self.imageCache storeImageVariantsFromImage:downloadedImage imageData:dataOnDisk ? nil : data forKey:key context:sourceContext toDisk:cacheOnDisk];
+                }
+                else if (downloadedImage && finished) {
+                    //将下载的图片downloadedImage进行缓存
+                    [self.imageCache storeImage:downloadedImage recalculateFromImage:NO imageData:data forKey:key context:sourceContext toDisk:cacheOnDisk && !dataOnDisk];
+                }
+
+                if (downloadedImage && finished && context[SDWebImageContextTransformer]) {
+                    //在解码池中变换图片，缓存后再回调
+                    [self transformImage:downloadedImage forKey:key context:context options:options toDisk:cacheOnDisk completed:^(UIImage *transformedImage) {
+                        dispatch_main_sync_safe(^{
+                            if (!weakOperation.isCancelled) {
+                                completedBlock(transformedImage, nil, SDImageCacheTypeNone, finished, url);
+                            }
+                        });
+                    }];
+                }
+                else {
+                    dispatch_main_sync_safe(^{
+                        if (!weakOperation.isCancelled) {
+                            //完成回调
+                            completedBlock(downloadedImage, nil, SDImageCacheTypeNone, finished, url);
+                        }
+                    });
+                }
+            }
+            if (finished) {
+                //下载成功，之前的失败记录不再有效
+                [self.failedURLs removeURL:url];
+            }
+        }
+
+        if (finished) {
+            //下载完成了，将operation操作移除
+            [self.runningOperations removeOperation:operation];
+        }
+    }];
+    operation.cancelBlock = ^{
+        //取消下载
+        [subOperation cancel];
+
+        //下载取消，将operation操作移除
+        [self.runningOperations removeOperation:weakOperation];
+    };
+}
+
+// A blacklisted URL is still looked up in the cache, only its download is refused
+- (BOOL)shouldRefuseDownloadForURL:(NSURL *)url options:(SDWebImageOptions)options {
+    return !(options & SDWebImageRetryFailed) && [self.failedURLs containsURL:url];
+}
+
+- (NSError *)failedURLError {
+    return [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorFileDoesNotExist userInfo:nil];
+}
+
+// Whether another load of the key succeeded, in memory or on disk
+- (BOOL)isImageCachedForKey:(NSString *)key {
+    return key && ([self.imageCache imageFromMemoryCacheForKey:key] || [self.imageCache diskImageExistsWithKey:key]);
+}
+
+// Exponential backoff with jitter: a random delay in [d/2, d] where d = base * 2^attempt, capped at retryMaxDelay
+//带随机抖动的指数退避，避免大量失败的请求在同一时刻一起重试
+- (NSTimeInterval)retryDelayForAttempt:(NSUInteger)attempt {
+    NSTimeInterval delay = self.retryBaseDelay * pow(2.0, (double)attempt);
+    delay = MIN(delay, self.retryMaxDelay);
+    double jitter = 0.5 + 0.5 * ((double)arc4random_uniform(UINT32_MAX) / (double)UINT32_MAX);
+    return MAX(0, delay * jitter);
+}
+
+- (void)setFailedURLTimeToLive:(NSTimeInterval)failedURLTimeToLive {
+    self.failedURLs.timeToLive = failedURLTimeToLive;
+}
+
+- (NSTimeInterval)failedURLTimeToLive {
+    return self.failedURLs.timeToLive;
+}
+
+- (void)setMaxFailedURLCount:(NSUInteger)maxFailedURLCount {
+    self.failedURLs.countLimit = maxFailedURLCount;
+}
+
+- (NSUInteger)maxFailedURLCount {
+    return self.failedURLs.countLimit;
+}
+
 - (void)saveImageToCache:(UIImage *)image forURL:(NSURL *)url {
     if (image && url) {
         NSString *key = [self cacheKeyForURL:url];
@@ -391,11 +975,9 @@
 
 //取消下载操作
 - (void)cancelAll {
-    @synchronized (self.runningOperations) {
-        NSArray *copiedOperations = [self.runningOperations copy];
-        [copiedOperations makeObjectsPerformSelector:@selector(cancel)];
-        [self.runningOperations removeObjectsInArray:copiedOperations];
-    }
+    // Cancel outside of the registry locks, cancel blocks remove their operation from the registry
+    NSArray *operations = [self.runningOperations removeAllOperations];
+    [operations makeObjectsPerformSelector:@selector(cancel)];
 }
 
 - (BOOL)isRunning {
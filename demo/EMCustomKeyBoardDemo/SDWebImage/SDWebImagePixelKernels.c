@@ -0,0 +1,353 @@
+/*
+ * This file is part of the SDWebImage package.
+ * (c) Olivier Poitrey <rs@dailymotion.com>
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#include "SDWebImagePixelKernels.h"
+#include <pthread.h>
+#include <string.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define SD_PIXEL_NEON 1
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#define SD_PIXEL_SSE2 1
+#include <emmintrin.h>
+#if defined(__SSSE3__)
+#define SD_PIXEL_SSSE3 1
+#include <tmmintrin.h>
+#endif
+#endif
+
+// x * y / 255, rounded, exact for 8 bit x and y
+//8位乘法后除以255并四舍五入，结果精确
+static inline uint8_t SDPixelMultiply(uint32_t x, uint32_t y) {
+    uint32_t t = x * y + 128;
+    return (uint8_t)((t + (t >> 8)) >> 8);
+}
+
+// MARK: - RGB to BGRX
+
+void SDPixelConvertRGBToBGRX(const uint8_t *src, uint8_t *dst, size_t count) {
+    size_t i = 0;
+#if SD_PIXEL_NEON
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x3_t rgb = vld3q_u8(src + i * 3);
+        uint8x16x4_t bgrx;
+        bgrx.val[0] = rgb.val[2];
+        bgrx.val[1] = rgb.val[1];
+        bgrx.val[2] = rgb.val[0];
+        bgrx.val[3] = vdupq_n_u8(0xff);
+        vst4q_u8(dst + i * 4, bgrx);
+    }
+#elif SD_PIXEL_SSSE3
+    const __m128i shuffle = _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+    const __m128i opaque = _mm_set1_epi32((int)0xff000000);
+    // 4 pixels per iteration from a 16 bytes load, the last 4 bytes belong to the next pixels: keep 2 pixels of margin
+    //每次读16字节转换4个像素，末尾需要留出2个像素避免越界读取
+    for (; i + 6 <= count; i += 4) {
+        __m128i rgb = _mm_loadu_si128((const __m128i *)(src + i * 3));
+        __m128i bgrx = _mm_or_si128(_mm_shuffle_epi8(rgb, shuffle), opaque);
+        _mm_storeu_si128((__m128i *)(dst + i * 4), bgrx);
+    }
+#endif
+    for (; i < count; i++) {
+        const uint8_t *s = src + i * 3;
+        uint8_t *d = dst + i * 4;
+        d[0] = s[2];
+        d[1] = s[1];
+        d[2] = s[0];
+        d[3] = 0xff;
+    }
+}
+
+// MARK: - RGBA <-> BGRA
+
+void SDPixelSwapRedBlue(const uint8_t *src, uint8_t *dst, size_t count) {
+    size_t i = 0;
+#if SD_PIXEL_NEON
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x4_t pixels = vld4q_u8(src + i * 4);
+        uint8x16_t red = pixels.val[0];
+        pixels.val[0] = pixels.val[2];
+        pixels.val[2] = red;
+        vst4q_u8(dst + i * 4, pixels);
+    }
+#elif SD_PIXEL_SSSE3
+    const __m128i shuffle = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    for (; i + 4 <= count; i += 4) {
+        __m128i pixels = _mm_loadu_si128((const __m128i *)(src + i * 4));
+        _mm_storeu_si128((__m128i *)(dst + i * 4), _mm_shuffle_epi8(pixels, shuffle));
+    }
+#endif
+    for (; i < count; i++) {
+        const uint8_t *s = src + i * 4;
+        uint8_t *d = dst + i * 4;
+        uint8_t red = s[0];
+        d[0] = s[2];
+        d[1] = s[1];
+        d[2] = red;
+        d[3] = s[3];
+    }
+}
+
+// MARK: - Premultiply
+
+#if SD_PIXEL_NEON
+// Same rounding as SDPixelMultiply: vrshrq gives (p + 128) >> 8, vraddhn adds it to p, adds 128 and keeps the high byte
+static inline uint8x16_t SDPixelMultiplyNEON(uint8x16_t color, uint8x16_t alpha) {
+    uint16x8_t low = vmull_u8(vget_low_u8(color), vget_low_u8(alpha));
+    uint16x8_t high = vmull_u8(vget_high_u8(color), vget_high_u8(alpha));
+    return vcombine_u8(vraddhn_u16(low, vrshrq_n_u16(low, 8)), vraddhn_u16(high, vrshrq_n_u16(high, 8)));
+}
+#elif SD_PIXEL_SSE2
+static inline __m128i SDPixelDivide255SSE2(__m128i product) {
+    __m128i t = _mm_add_epi16(product, _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+// Premultiplies 4 pixels, the alpha being the fourth byte
+static inline __m128i SDPixelPremultiplySSE2(__m128i pixels) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i alphaMask = _mm_set1_epi32((int)0xff000000);
+    __m128i low = _mm_unpacklo_epi8(pixels, zero);
+    __m128i high = _mm_unpackhi_epi8(pixels, zero);
+    // Broadcast the alpha of each pixel to its 4 lanes
+    //将每个像素的alpha复制到4个通道
+    __m128i lowAlpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(low, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    __m128i highAlpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(high, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    low = SDPixelDivide255SSE2(_mm_mullo_epi16(low, lowAlpha));
+    high = SDPixelDivide255SSE2(_mm_mullo_epi16(high, highAlpha));
+    __m128i premultiplied = _mm_packus_epi16(low, high);
+    // Keep the original alpha
+    return _mm_or_si128(_mm_andnot_si128(alphaMask, premultiplied), _mm_and_si128(alphaMask, pixels));
+}
+#endif
+
+void SDPixelPremultiply(const uint8_t *src, uint8_t *dst, size_t count) {
+    size_t i = 0;
+#if SD_PIXEL_NEON
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x4_t pixels = vld4q_u8(src + i * 4);
+        pixels.val[0] = SDPixelMultiplyNEON(pixels.val[0], pixels.val[3]);
+        pixels.val[1] = SDPixelMultiplyNEON(pixels.val[1], pixels.val[3]);
+        pixels.val[2] = SDPixelMultiplyNEON(pixels.val[2], pixels.val[3]);
+        vst4q_u8(dst + i * 4, pixels);
+    }
+#elif SD_PIXEL_SSE2
+    for (; i + 4 <= count; i += 4) {
+        __m128i pixels = _mm_loadu_si128((const __m128i *)(src + i * 4));
+        _mm_storeu_si128((__m128i *)(dst + i * 4), SDPixelPremultiplySSE2(pixels));
+    }
+#endif
+    for (; i < count; i++) {
+        const uint8_t *s = src + i * 4;
+        uint8_t *d = dst + i * 4;
+        uint8_t alpha = s[3];
+        d[0] = SDPixelMultiply(s[0], alpha);
+        d[1] = SDPixelMultiply(s[1], alpha);
+        d[2] = SDPixelMultiply(s[2], alpha);
+        d[3] = alpha;
+    }
+}
+
+void SDPixelPremultiplyRGBAToBGRA(const uint8_t *src, uint8_t *dst, size_t count) {
+    size_t i = 0;
+#if SD_PIXEL_NEON
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x4_t pixels = vld4q_u8(src + i * 4);
+        uint8x16x4_t premultiplied;
+        premultiplied.val[0] = SDPixelMultiplyNEON(pixels.val[2], pixels.val[3]);
+        premultiplied.val[1] = SDPixelMultiplyNEON(pixels.val[1], pixels.val[3]);
+        premultiplied.val[2] = SDPixelMultiplyNEON(pixels.val[0], pixels.val[3]);
+        premultiplied.val[3] = pixels.val[3];
+        vst4q_u8(dst + i * 4, premultiplied);
+    }
+#elif SD_PIXEL_SSSE3
+    const __m128i shuffle = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    for (; i + 4 <= count; i += 4) {
+        __m128i pixels = _mm_loadu_si128((const __m128i *)(src + i * 4));
+        _mm_storeu_si128((__m128i *)(dst + i * 4), _mm_shuffle_epi8(SDPixelPremultiplySSE2(pixels), shuffle));
+    }
+#endif
+    for (; i < count; i++) {
+        const uint8_t *s = src + i * 4;
+        uint8_t *d = dst + i * 4;
+        uint8_t red = s[0];
+        uint8_t alpha = s[3];
+        d[0] = SDPixelMultiply(s[2], alpha);
+        d[1] = SDPixelMultiply(s[1], alpha);
+        d[2] = SDPixelMultiply(red, alpha);
+        d[3] = alpha;
+    }
+}
+
+// MARK: - Unpremultiply
+
+// Reciprocals in 32.32 fixed point, rounded up: (n * table[alpha]) >> 32 == n / alpha for all n < 2^16, so the
+// division by alpha is exact. There is no 8 bit division in NEON or SSE, the lookup per pixel keeps this kernel scalar
+//定点数倒数表，避免逐像素除法且结果精确；NEON/SSE没有8位除法，此函数保持标量实现
+static uint64_t SDPixelUnpremultiplyTable[256];
+static pthread_once_t SDPixelUnpremultiplyTableOnce = PTHREAD_ONCE_INIT;
+
+static void SDPixelInitUnpremultiplyTable(void) {
+    SDPixelUnpremultiplyTable[0] = 0;
+    for (uint64_t alpha = 1; alpha < 256; alpha++) {
+        SDPixelUnpremultiplyTable[alpha] = ((1ull << 32) + alpha - 1) / alpha;
+    }
+}
+
+// color * 255 / alpha, rounded and clamped for colors that are not premultiplied
+static inline uint8_t SDPixelDivide(uint32_t color, uint32_t alpha) {
+    uint64_t value = ((uint64_t)(color * 255 + alpha / 2) * SDPixelUnpremultiplyTable[alpha]) >> 32;
+    return value > 255 ? 255 : (uint8_t)value;
+}
+
+void SDPixelUnpremultiply(const uint8_t *src, uint8_t *dst, size_t count) {
+    pthread_once(&SDPixelUnpremultiplyTableOnce, SDPixelInitUnpremultiplyTable);
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t *s = src + i * 4;
+        uint8_t *d = dst + i * 4;
+        uint8_t alpha = s[3];
+        if (alpha == 255) {
+            if (d != s) {
+                memcpy(d, s, 4);
+            }
+            continue;
+        }
+        d[0] = SDPixelDivide(s[0], alpha);
+        d[1] = SDPixelDivide(s[1], alpha);
+        d[2] = SDPixelDivide(s[2], alpha);
+        d[3] = alpha;
+    }
+}
+
+// MARK: - Orientation
+
+static inline void SDPixelCopy32(uint8_t *dst, const uint8_t *src) {
+    memcpy(dst, src, 4);
+}
+
+#if SD_PIXEL_NEON
+static inline uint32x4_t SDPixelReverseNEON(uint32x4_t v) {
+    v = vrev64q_u32(v);
+    return vcombine_u32(vget_high_u32(v), vget_low_u32(v));
+}
+#elif SD_PIXEL_SSE2
+static inline __m128i SDPixelReverseSSE2(__m128i v) {
+    return _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+}
+#endif
+
+void SDPixelOrient32(const uint8_t *src, size_t srcBytesPerRow, size_t width, size_t height,
+                     uint8_t *dst, size_t dstBytesPerRow, int exifOrientation) {
+    // The destination of the source pixel (x, y) is dst + origin + x * xStep + y * yStep
+    //源像素(x, y)写入dst + origin + x * xStep + y * yStep
+    const ptrdiff_t pixel = 4;
+    const ptrdiff_t row = (ptrdiff_t)dstBytesPerRow;
+    const ptrdiff_t w = (ptrdiff_t)width;
+    const ptrdiff_t h = (ptrdiff_t)height;
+    ptrdiff_t origin = 0, xStep = pixel, yStep = row;
+    switch (exifOrientation) {
+        case 2: origin = (w - 1) * pixel; xStep = -pixel; yStep = row; break;
+        case 3: origin = (h - 1) * row + (w - 1) * pixel; xStep = -pixel; yStep = -row; break;
+        case 4: origin = (h - 1) * row; xStep = pixel; yStep = -row; break;
+        case 5: origin = 0; xStep = row; yStep = pixel; break;
+        case 6: origin = (h - 1) * pixel; xStep = row; yStep = -pixel; break;
+        case 7: origin = (w - 1) * row + (h - 1) * pixel; xStep = -row; yStep = -pixel; break;
+        case 8: origin = (w - 1) * row; xStep = -row; yStep = pixel; break;
+        default: break;
+    }
+    uint8_t *base = dst + origin;
+    const int transposed = exifOrientation >= 5 && exifOrientation <= 8;
+    if (!transposed) {
+        // Rows stay rows, possibly reversed
+        for (ptrdiff_t y = 0; y < h; y++) {
+            const uint8_t *s = src + y * (ptrdiff_t)srcBytesPerRow;
+            uint8_t *d = base + y * yStep;
+            if (xStep == pixel) {
+                memcpy(d, s, width * 4);
+                continue;
+            }
+            ptrdiff_t x = 0;
+#if SD_PIXEL_NEON
+            for (; x + 4 <= w; x += 4) {
+                uint32x4_t v = vld1q_u32((const uint32_t *)(const void *)(s + x * pixel));
+                vst1q_u32((uint32_t *)(void *)(d - (x + 3) * pixel), SDPixelReverseNEON(v));
+            }
+#elif SD_PIXEL_SSE2
+            for (; x + 4 <= w; x += 4) {
+                __m128i v = _mm_loadu_si128((const __m128i *)(s + x * pixel));
+                _mm_storeu_si128((__m128i *)(d - (x + 3) * pixel), SDPixelReverseSSE2(v));
+            }
+#endif
+            for (; x < w; x++) {
+                SDPixelCopy32(d - x * pixel, s + x * pixel);
+            }
+        }
+        return;
+    }
+
+    // Rows become columns: transpose 4x4 blocks in registers, a source column is a destination row
+    //行列互换：在寄存器中转置4x4的块，源图的一列写为目标图的一行
+    ptrdiff_t blockWidth = 0, blockHeight = 0;
+#if SD_PIXEL_NEON || SD_PIXEL_SSE2
+    blockWidth = w & ~(ptrdiff_t)3;
+    blockHeight = h & ~(ptrdiff_t)3;
+    for (ptrdiff_t y = 0; y < blockHeight; y += 4) {
+        const uint8_t *s = src + y * (ptrdiff_t)srcBytesPerRow;
+        // Where the 4 source rows start in each destination row, the pixels of a column are consecutive
+        uint8_t *d = base + (yStep > 0 ? y * yStep : (y + 3) * yStep);
+        for (ptrdiff_t x = 0; x < blockWidth; x += 4) {
+#if SD_PIXEL_NEON
+            uint32x4_t r0 = vld1q_u32((const uint32_t *)(const void *)(s + x * pixel));
+            uint32x4_t r1 = vld1q_u32((const uint32_t *)(const void *)(s + srcBytesPerRow + x * pixel));
+            uint32x4_t r2 = vld1q_u32((const uint32_t *)(const void *)(s + 2 * srcBytesPerRow + x * pixel));
+            uint32x4_t r3 = vld1q_u32((const uint32_t *)(const void *)(s + 3 * srcBytesPerRow + x * pixel));
+            uint32x4x2_t p = vtrnq_u32(r0, r1);
+            uint32x4x2_t q = vtrnq_u32(r2, r3);
+            uint32x4_t c[4] = {
+                vcombine_u32(vget_low_u32(p.val[0]), vget_low_u32(q.val[0])),
+                vcombine_u32(vget_low_u32(p.val[1]), vget_low_u32(q.val[1])),
+                vcombine_u32(vget_high_u32(p.val[0]), vget_high_u32(q.val[0])),
+                vcombine_u32(vget_high_u32(p.val[1]), vget_high_u32(q.val[1])),
+            };
+            for (int j = 0; j < 4; j++) {
+                uint32x4_t column = yStep > 0 ? c[j] : SDPixelReverseNEON(c[j]);
+                vst1q_u32((uint32_t *)(void *)(d + (x + j) * xStep), column);
+            }
+#else
+            __m128i r0 = _mm_loadu_si128((const __m128i *)(s + x * pixel));
+            __m128i r1 = _mm_loadu_si128((const __m128i *)(s + srcBytesPerRow + x * pixel));
+            __m128i r2 = _mm_loadu_si128((const __m128i *)(s + 2 * srcBytesPerRow + x * pixel));
+            __m128i r3 = _mm_loadu_si128((const __m128i *)(s + 3 * srcBytesPerRow + x * pixel));
+            __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+            __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+            __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+            __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+            __m128i c[4] = {
+                _mm_unpacklo_epi64(t0, t1),
+                _mm_unpackhi_epi64(t0, t1),
+                _mm_unpacklo_epi64(t2, t3),
+                _mm_unpackhi_epi64(t2, t3),
+            };
+            for (int j = 0; j < 4; j++) {
+                __m128i column = yStep > 0 ? c[j] : SDPixelReverseSSE2(c[j]);
+                _mm_storeu_si128((__m128i *)(d + (x + j) * xStep), column);
+            }
+#endif
+        }
+    }
+#endif
+    // The right and bottom edges that do not fill a block
+    for (ptrdiff_t y = 0; y < h; y++) {
+        const uint8_t *s = src + y * (ptrdiff_t)srcBytesPerRow;
+        uint8_t *d = base + y * yStep;
+        for (ptrdiff_t x = (y < blockHeight ? blockWidth : 0); x < w; x++) {
+            SDPixelCopy32(d + x * xStep, s + x * pixel);
+        }
+    }
+}
@@ -0,0 +1,68 @@
+/*
+ * This file is part of the SDWebImage package.
+ * (c) Olivier Poitrey <rs@dailymotion.com>
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef SDWebImagePixelKernels_h
+#define SDWebImagePixelKernels_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Pixel format conversions between the layouts produced by decoders and the layout Core Animation displays without
+ * converting: premultiplied BGRA in memory, i.e. kCGBitmapByteOrder32Little | kCGImageAlphaPremultipliedFirst
+ * (kCGImageAlphaNoneSkipFirst for opaque images).
+ *
+ * The kernels use NEON on ARM and SSE on Intel (SSSE3 for the byte shuffles), with scalar fallbacks.
+ * `count` is a number of pixels. The 4 bytes per pixel kernels may convert in place (src == dst).
+ 像素格式转换，输出iOS显示时不需要再转换的预乘BGRA格式；ARM上用NEON，Intel上用SSE，其它平台用标量实现
+ */
+
+/**
+ * Packed 24 bit RGB to 32 bit BGRX, X being 255.
+ */
+extern void SDPixelConvertRGBToBGRX(const uint8_t *src, uint8_t *dst, size_t count);
+
+/**
+ * Swaps the first and third byte of each pixel: RGBA to BGRA and back.
+ */
+extern void SDPixelSwapRedBlue(const uint8_t *src, uint8_t *dst, size_t count);
+
+/**
+ * Multiplies the color of each pixel by its alpha, the alpha being the fourth byte (RGBA or BGRA).
+ */
+extern void SDPixelPremultiply(const uint8_t *src, uint8_t *dst, size_t count);
+
+/**
+ * Divides the color of each pixel by its alpha, the alpha being the fourth byte (RGBA or BGRA).
+ * Scalar only, with a table of reciprocals instead of divisions.
+ */
+extern void SDPixelUnpremultiply(const uint8_t *src, uint8_t *dst, size_t count);
+
+/**
+ * Straight alpha RGBA to premultiplied BGRA, in one pass.
+ */
+extern void SDPixelPremultiplyRGBAToBGRA(const uint8_t *src, uint8_t *dst, size_t count);
+
+/**
+ * Copies a bitmap of 32 bit pixels, whatever their layout, applying an EXIF orientation (1 to 8) so that the copy is
+ * upright. For orientations 5 to 8 the image is rotated by 90°: the destination is `height` pixels wide and `width`
+ * pixels high. Rotations use 4x4 block transposes. The source and destination must not overlap.
+ 按EXIF方向（1到8）旋转/镜像复制32位像素的位图，结果为正向；5到8旋转90°，宽高互换
+ */
+extern void SDPixelOrient32(const uint8_t *src, size_t srcBytesPerRow, size_t width, size_t height,
+                            uint8_t *dst, size_t dstBytesPerRow, int exifOrientation);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SDWebImagePixelKernels_h */
@@ -41,7 +41,9 @@ typedef void(^SDWebImagePrefetcherProgressBlock)(NSUInteger noOfFinishedUrls, NS
 typedef void(^SDWebImagePrefetcherCompletionBlock)(NSUInteger noOfFinishedUrls, NSUInteger noOfSkippedUrls);
 
 /**
- * Prefetch some URLs in the cache for future use. Images are downloaded in low priority.
+ * Prefetch some URLs in the cache for future use. Images are downloaded in low priority, by a downloader of the
+ * prefetcher's own which yields to the shared downloader: no prefetch starts while visible images are loading.
+ 预下载使用独立的下载器，共享下载器加载可见图片时不开始新的预下载
  */
 @interface SDWebImagePrefetcher : NSObject
 
@@ -51,12 +53,21 @@ typedef void(^SDWebImagePrefetcherCompletionBlock)(NSUInteger noOfFinishedUrls,
 @property (strong, nonatomic, readonly) SDWebImageManager *manager;
 
 /**
- * Maximum number of URLs to prefetch at the same time. Defaults to 3.
+ * Maximum number of URLs to prefetch at the same time. Defaults to 3. Only the prefetcher's downloader is affected.
  */
 @property (nonatomic, assign) NSUInteger maxConcurrentDownloads;
 
+/**
+ * The average bandwidth of prefetching, in bytes per second. Defaults to 0, no cap.
+ 预下载的平均带宽上限（字节/秒），默认0不限制
+ */
+@property (nonatomic, assign) NSUInteger maxBytesPerSecond;
+
 /**
  * SDWebImageOptions for prefetcher. Defaults to SDWebImageLowPriority.
+ * Add `SDWebImageCacheDataOnly` to only fill the disk cache: prefetched images are then neither decoded nor cached in
+ * memory, where they would evict the images on screen, and images already on disk only cost a file existence check.
+ 加上SDWebImageCacheDataOnly时只预下载数据到磁盘缓存，不解码也不占用内存缓存
  */
 @property (nonatomic, assign) SDWebImageOptions options;
 
@@ -38,7 +38,12 @@
 
 - (id)init {
     if ((self = [super init])) {
-        _manager = [SDWebImageManager new];
+        // A downloader of its own: its concurrency does not change the shared downloader's, and it waits while the
+        // shared downloader loads the visible images
+        //独立的下载器：并发数不影响共享的下载器，共享下载器加载可见图片时暂停
+        SDWebImageDownloader *downloader = [SDWebImageDownloader new];
+        downloader.foregroundDownloader = [SDWebImageDownloader sharedDownloader];
+        _manager = [[SDWebImageManager alloc] initWithCache:nil downloader:downloader];
         _options = SDWebImageLowPriority;
         _prefetcherQueue = dispatch_get_main_queue();
         self.maxConcurrentDownloads = 3;
@@ -55,6 +60,14 @@
     return self.manager.imageDownloader.maxConcurrentDownloads;
 }
 
+- (void)setMaxBytesPerSecond:(NSUInteger)maxBytesPerSecond {
+    self.manager.imageDownloader.maxBytesPerSecond = maxBytesPerSecond;
+}
+
+- (NSUInteger)maxBytesPerSecond {
+    return self.manager.imageDownloader.maxBytesPerSecond;
+}
+
 //批量图片下载
 - (void)startPrefetchingAtIndex:(NSUInteger)index {
     if (index >= self.prefetchURLs.count) return;
@@ -63,7 +76,9 @@
         if (!finished) return;
         self.finishedCount++;
 
-        if (image) {
+        // With SDWebImageCacheDataOnly there is no image, only the data on disk
+        //只缓存数据时没有图片，数据在磁盘缓存中即为成功
+        if (image || (self.options & SDWebImageCacheDataOnly && !error && cacheType == SDImageCacheTypeDisk)) {
             if (self.progressBlock) {
                 self.progressBlock(self.finishedCount,[self.prefetchURLs count]);
             }
@@ -0,0 +1,109 @@
+/*
+ * This file is part of the SDWebImage package.
+ * (c) Olivier Poitrey <rs@dailymotion.com>
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#import <Foundation/Foundation.h>
+#import "SDWebImageCompat.h"
+
+/**
+ * A transformer turns a loaded image into the image to display, e.g. a rounded avatar. It is passed per load with
+ * `SDWebImageContextTransformer`: the transformed image is cached in memory and on disk under a key derived from
+ * the `transformerKey`, so that the transformation runs once per image rather than on every memory cache miss.
+ * Transformers run on the decode pool and must be thread safe.
+ 图片变换器：按请求传入，变换结果以变换器的标识区分缓存到内存和磁盘，在解码池中执行
+ */
+@protocol SDWebImageTransformer <NSObject>
+
+/**
+ * A stable identifier of the transformation, two transformers with the same key must produce the same image.
+ 变换器的标识，标识相同的变换器必须生成相同的图片
+ */
+@property (readonly, nonatomic) NSString *transformerKey;
+
+/**
+ * Transform an image.
+ *
+ * @param image The image to transform
+ * @param key   The cache key of the image
+ *
+ * @return The transformed image, nil if it could not be transformed
+ */
+- (UIImage *)transformedImageWithImage:(UIImage *)image forKey:(NSString *)key;
+
+@end
+
+/**
+ * Returns the cache key of the image produced for the given context once transformed: the `SDCacheKeyForContext` of
+ * the key followed by the `transformerKey` of its `SDWebImageContextTransformer`, if any.
+ 变换后图片的缓存key：在上下文key后追加变换器的标识
+ */
+extern NSString *SDTransformedCacheKeyForContext(NSString *key, NSDictionary *context);
+
+/**
+ * Applies several transformers in order, e.g. resize, then round the corners.
+ 按顺序依次执行多个变换器
+ */
+@interface SDWebImagePipelineTransformer : NSObject <SDWebImageTransformer>
+
+@property (copy, readonly, nonatomic) NSArray *transformers;
+
++ (instancetype)transformerWithTransformers:(NSArray *)transformers;
+
+@end
+
+/**
+ * Resizes an image to a size in points. UIViewContentModeScaleAspectFit keeps the whole image inside the size,
+ * UIViewContentModeScaleAspectFill fills the size and crops the center, any other mode stretches the image.
+ 缩放图片到指定尺寸（point）
+ */
+@interface SDWebImageResizingTransformer : NSObject <SDWebImageTransformer>
+
+@property (assign, readonly, nonatomic) CGSize size;
+@property (assign, readonly, nonatomic) UIViewContentMode contentMode;
+
++ (instancetype)transformerWithSize:(CGSize)size contentMode:(UIViewContentMode)contentMode;
+
+@end
+
+/**
+ * Crops an image to a rectangle in points.
+ 裁剪图片（point）
+ */
+@interface SDWebImageCroppingTransformer : NSObject <SDWebImageTransformer>
+
+@property (assign, readonly, nonatomic) CGRect rect;
+
++ (instancetype)transformerWithRect:(CGRect)rect;
+
+@end
+
+/**
+ * Rounds the corners of an image, with an optional border. A corner radius of half the shortest side gives a circle.
+ 圆角，可带边框
+ */
+@interface SDWebImageRoundCornerTransformer : NSObject <SDWebImageTransformer>
+
+@property (assign, readonly, nonatomic) CGFloat cornerRadius;
+@property (assign, readonly, nonatomic) UIRectCorner corners;
+@property (assign, readonly, nonatomic) CGFloat borderWidth;
+@property (strong, readonly, nonatomic) UIColor *borderColor;
+
++ (instancetype)transformerWithRadius:(CGFloat)cornerRadius corners:(UIRectCorner)corners borderWidth:(CGFloat)borderWidth borderColor:(UIColor *)borderColor;
+
+@end
+
+/**
+ * Blurs an image, the radius is in points.
+ 高斯模糊（三次box模糊近似）
+ */
+@interface SDWebImageBlurTransformer : NSObject <SDWebImageTransformer>
+
+@property (assign, readonly, nonatomic) CGFloat blurRadius;
+
++ (instancetype)transformerWithRadius:(CGFloat)blurRadius;
+
+@end
@@ -0,0 +1,247 @@
+/*
+ * This file is part of the SDWebImage package.
+ * (c) Olivier Poitrey <rs@dailymotion.com>
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#import "SDWebImageTransformer.h"
+#import <Accelerate/Accelerate.h>
+
+NSString *SDTransformedCacheKeyForContext(NSString *key, NSDictionary *context) {
+    NSString *cacheKey = SDCacheKeyForContext(key, context);
+    id <SDWebImageTransformer> transformer = context[SDWebImageContextTransformer];
+    if (!cacheKey || !transformer) {
+        return cacheKey;
+    }
+    return [cacheKey stringByAppendingFormat:@"-Transformed(%@)", transformer.transformerKey];
+}
+
+static BOOL SDImageIsOpaque(UIImage *image) {
+    CGImageAlphaInfo alphaInfo = CGImageGetAlphaInfo(image.CGImage);
+    return alphaInfo == kCGImageAlphaNone || alphaInfo == kCGImageAlphaNoneSkipFirst || alphaInfo == kCGImageAlphaNoneSkipLast;
+}
+
+// Draws into a new bitmap of the given size in points, at the scale of the image.
+// UIGraphicsBeginImageContextWithOptions is thread safe since iOS 4, transformers run on the decode pool
+//在新的位图上绘制，线程安全，可以在解码池中执行
+static UIImage *SDDrawnImage(UIImage *image, CGSize size, BOOL opaque, SDWebImageNoParamsBlock drawBlock) {
+    if (size.width <= 0 || size.height <= 0) {
+        return nil;
+    }
+    UIGraphicsBeginImageContextWithOptions(size, opaque, image.scale);
+    drawBlock();
+    UIImage *drawnImage = UIGraphicsGetImageFromCurrentImageContext();
+    UIGraphicsEndImageContext();
+    return drawnImage;
+}
+
+static NSString *SDHexStringForColor(UIColor *color) {
+    CGFloat red = 0, green = 0, blue = 0, alpha = 0;
+    if (![color getRed:&red green:&green blue:&blue alpha:&alpha]) {
+        CGFloat white = 0;
+        [color getWhite:&white alpha:&alpha];
+        red = green = blue = white;
+    }
+    return [NSString stringWithFormat:@"%02x%02x%02x%02x", (int)round(red * 255), (int)round(green * 255), (int)round(blue * 255), (int)round(alpha * 255)];
+}
+
+@implementation SDWebImagePipelineTransformer
+
++ (instancetype)transformerWithTransformers:(NSArray *)transformers {
+    SDWebImagePipelineTransformer *transformer = [self new];
+    transformer->_transformers = [transformers copy];
+    return transformer;
+}
+
+- (NSString *)transformerKey {
+    return [[self.transformers valueForKey:@"transformerKey"] componentsJoinedByString:@"-"];
+}
+
+- (UIImage *)transformedImageWithImage:(UIImage *)image forKey:(NSString *)key {
+    for (id <SDWebImageTransformer> transformer in self.transformers) {
+        if (!image) {
+            break;
+        }
+        image = [transformer transformedImageWithImage:image forKey:key];
+    }
+    return image;
+}
+
+@end
+
+@implementation SDWebImageResizingTransformer
+
++ (instancetype)transformerWithSize:(CGSize)size contentMode:(UIViewContentMode)contentMode {
+    SDWebImageResizingTransformer *transformer = [self new];
+    transformer->_size = size;
+    transformer->_contentMode = contentMode;
+    return transformer;
+}
+
+- (NSString *)transformerKey {
+    return [NSString stringWithFormat:@"SDWebImageResizingTransformer(%@,%ld)", NSStringFromCGSize(self.size), (long)self.contentMode];
+}
+
+- (UIImage *)transformedImageWithImage:(UIImage *)image forKey:(NSString *)key {
+    CGSize imageSize = image.size;
+    if (!image || imageSize.width <= 0 || imageSize.height <= 0 || self.size.width <= 0 || self.size.height <= 0) {
+        return image;
+    }
+    CGFloat widthRatio = self.size.width / imageSize.width;
+    CGFloat heightRatio = self.size.height / imageSize.height;
+    CGSize canvasSize = self.size;
+    CGRect drawRect = (CGRect){.origin = CGPointZero, .size = self.size};
+    if (self.contentMode == UIViewContentModeScaleAspectFit) {
+        CGFloat ratio = MIN(widthRatio, heightRatio);
+        canvasSize = CGSizeMake(imageSize.width * ratio, imageSize.height * ratio);
+        drawRect.size = canvasSize;
+    }
+    else if (self.contentMode == UIViewContentModeScaleAspectFill) {
+        //铺满并居中裁剪
+        CGFloat ratio = MAX(widthRatio, heightRatio);
+        CGSize drawSize = CGSizeMake(imageSize.width * ratio, imageSize.height * ratio);
+        drawRect = CGRectMake((self.size.width - drawSize.width) / 2, (self.size.height - drawSize.height) / 2, drawSize.width, drawSize.height);
+    }
+    return SDDrawnImage(image, canvasSize, SDImageIsOpaque(image), ^{
+        [image drawInRect:drawRect];
+    });
+}
+
+@end
+
+@implementation SDWebImageCroppingTransformer
+
++ (instancetype)transformerWithRect:(CGRect)rect {
+    SDWebImageCroppingTransformer *transformer = [self new];
+    transformer->_rect = rect;
+    return transformer;
+}
+
+- (NSString *)transformerKey {
+    return [NSString stringWithFormat:@"SDWebImageCroppingTransformer(%@)", NSStringFromCGRect(self.rect)];
+}
+
+- (UIImage *)transformedImageWithImage:(UIImage *)image forKey:(NSString *)key {
+    if (!image) {
+        return nil;
+    }
+    CGRect rect = CGRectIntersection(self.rect, (CGRect){.origin = CGPointZero, .size = image.size});
+    if (CGRectIsEmpty(rect)) {
+        return nil;
+    }
+    return SDDrawnImage(image, rect.size, SDImageIsOpaque(image), ^{
+        [image drawAtPoint:CGPointMake(-rect.origin.x, -rect.origin.y)];
+    });
+}
+
+@end
+
+@implementation SDWebImageRoundCornerTransformer
+
++ (instancetype)transformerWithRadius:(CGFloat)cornerRadius corners:(UIRectCorner)corners borderWidth:(CGFloat)borderWidth borderColor:(UIColor *)borderColor {
+    SDWebImageRoundCornerTransformer *transformer = [self new];
+    transformer->_cornerRadius = cornerRadius;
+    transformer->_corners = corners;
+    transformer->_borderWidth = borderWidth;
+    transformer->_borderColor = borderColor;
+    return transformer;
+}
+
+- (NSString *)transformerKey {
+    return [NSString stringWithFormat:@"SDWebImageRoundCornerTransformer(%g,%lu,%g,%@)", self.cornerRadius, (unsigned long)self.corners, self.borderWidth, self.borderColor ? SDHexStringForColor(self.borderColor) : @"none"];
+}
+
+- (UIImage *)transformedImageWithImage:(UIImage *)image forKey:(NSString *)key {
+    if (!image) {
+        return nil;
+    }
+    CGRect bounds = (CGRect){.origin = CGPointZero, .size = image.size};
+    // The rounded corners are transparent, the result is never opaque
+    return SDDrawnImage(image, image.size, NO, ^{
+        CGSize cornerRadii = CGSizeMake(self.cornerRadius, self.cornerRadius);
+        [[UIBezierPath bezierPathWithRoundedRect:bounds byRoundingCorners:self.corners cornerRadii:cornerRadii] addClip];
+        [image drawInRect:bounds];
+        if (self.borderWidth > 0 && self.borderColor) {
+            // Stroke inside the image: inset the path by half the line width
+            //边框画在图片内部：路径向内缩进线宽的一半
+            CGFloat inset = self.borderWidth / 2;
+            CGFloat borderRadius = MAX(0, self.cornerRadius - inset);
+            UIBezierPath *borderPath = [UIBezierPath bezierPathWithRoundedRect:CGRectInset(bounds, inset, inset) byRoundingCorners:self.corners cornerRadii:CGSizeMake(borderRadius, borderRadius)];
+            borderPath.lineWidth = self.borderWidth;
+            [self.borderColor setStroke];
+            [borderPath stroke];
+        }
+    });
+}
+
+@end
+
+@implementation SDWebImageBlurTransformer
+
++ (instancetype)transformerWithRadius:(CGFloat)blurRadius {
+    SDWebImageBlurTransformer *transformer = [self new];
+    transformer->_blurRadius = blurRadius;
+    return transformer;
+}
+
+- (NSString *)transformerKey {
+    return [NSString stringWithFormat:@"SDWebImageBlurTransformer(%g)", self.blurRadius];
+}
+
+- (UIImage *)transformedImageWithImage:(UIImage *)image forKey:(NSString *)key {
+    CGImageRef imageRef = image.CGImage;
+    if (!imageRef || SDImageIsAnimated(image) || self.blurRadius <= 0) {
+        return image;
+    }
+    // Three successive box blurs approximate a gaussian blur, the box size is derived from the standard deviation
+    // as in the SVG specification of feGaussianBlur
+    //三次box模糊近似高斯模糊，box大小按SVG feGaussianBlur规范由标准差计算
+    CGFloat deviation = self.blurRadius * image.scale;
+    uint32_t boxSize = (uint32_t)floor(deviation * 3 * sqrt(2 * M_PI) / 4 + 0.5);
+    boxSize |= 1; // vImage needs an odd kernel size
+    if (boxSize < 3) {
+        return image;
+    }
+
+    vImage_CGImageFormat format = {
+        .bitsPerComponent = 8,
+        .bitsPerPixel = 32,
+        .colorSpace = NULL,
+        .bitmapInfo = kCGBitmapByteOrder32Host | kCGImageAlphaPremultipliedFirst,
+        .version = 0,
+        .decode = NULL,
+        .renderingIntent = kCGRenderingIntentDefault,
+    };
+    vImage_Buffer buffer;
+    if (vImageBuffer_InitWithCGImage(&buffer, &format, NULL, imageRef, kvImageNoFlags) != kvImageNoError) {
+        return image;
+    }
+    vImage_Buffer scratch;
+    if (vImageBuffer_Init(&scratch, buffer.height, buffer.width, format.bitsPerPixel, kvImageNoFlags) != kvImageNoError) {
+        free(buffer.data);
+        return image;
+    }
+    vImage_Error error = vImageBoxConvolve_ARGB8888(&buffer, &scratch, NULL, 0, 0, boxSize, boxSize, NULL, kvImageEdgeExtend);
+    if (error == kvImageNoError) {
+        error = vImageBoxConvolve_ARGB8888(&scratch, &buffer, NULL, 0, 0, boxSize, boxSize, NULL, kvImageEdgeExtend);
+    }
+    if (error == kvImageNoError) {
+        error = vImageBoxConvolve_ARGB8888(&buffer, &scratch, NULL, 0, 0, boxSize, boxSize, NULL, kvImageEdgeExtend);
+    }
+    CGImageRef blurredImageRef = NULL;
+    if (error == kvImageNoError) {
+        blurredImageRef = vImageCreateCGImageFromBuffer(&scratch, &format, NULL, NULL, kvImageNoFlags, &error);
+    }
+    free(buffer.data);
+    free(scratch.data);
+    if (!blurredImageRef) {
+        return image;
+    }
+    UIImage *blurredImage = [UIImage imageWithCGImage:blurredImageRef scale:image.scale orientation:image.imageOrientation];
+    CGImageRelease(blurredImageRef);
+    return blurredImage;
+}
+
+@end
@@ -108,6 +108,15 @@
  */
 - (void)sd_setImageWithURL:(NSURL *)url forState:(UIControlState)state placeholderImage:(UIImage *)placeholder options:(SDWebImageOptions)options completed:(SDWebImageCompletionBlock)completedBlock;
 
+/**
+ * Set the imageView `image` with an `url`, placeholder, custom options and a context.
+ *
+ * @param context The context to produce the image for, see `SDWebImageContextThumbnailPixelSize`. With
+ *                `SDWebImageThumbnailToViewSize` the image is decoded to fit the size of the button.
+ * @see sd_setImageWithURL:forState:placeholderImage:options:completed:
+ */
+- (void)sd_setImageWithURL:(NSURL *)url forState:(UIControlState)state placeholderImage:(UIImage *)placeholder options:(SDWebImageOptions)options context:(NSDictionary *)context completed:(SDWebImageCompletionBlock)completedBlock;
+
 /**
  * Set the backgroundImageView `image` with an `url`.
  *
@@ -189,6 +198,15 @@
  */
 - (void)sd_setBackgroundImageWithURL:(NSURL *)url forState:(UIControlState)state placeholderImage:(UIImage *)placeholder options:(SDWebImageOptions)options completed:(SDWebImageCompletionBlock)completedBlock;
 
+/**
+ * Set the backgroundImageView `image` with an `url`, placeholder, custom options and a context.
+ *
+ * @param context The context to produce the image for, see `SDWebImageContextThumbnailPixelSize`. With
+ *                `SDWebImageThumbnailToViewSize` the image is decoded to fill the size of the button.
+ * @see sd_setBackgroundImageWithURL:forState:placeholderImage:options:completed:
+ */
+- (void)sd_setBackgroundImageWithURL:(NSURL *)url forState:(UIControlState)state placeholderImage:(UIImage *)placeholder options:(SDWebImageOptions)options context:(NSDictionary *)context completed:(SDWebImageCompletionBlock)completedBlock;
+
 /**
  * Cancel the current image download
  */
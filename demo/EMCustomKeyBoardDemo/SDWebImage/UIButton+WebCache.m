@@ -49,6 +49,10 @@ static char imageURLStorageKey;
 }
 
 - (void)sd_setImageWithURL:(NSURL *)url forState:(UIControlState)state placeholderImage:(UIImage *)placeholder options:(SDWebImageOptions)options completed:(SDWebImageCompletionBlock)completedBlock {
+    [self sd_setImageWithURL:url forState:state placeholderImage:placeholder options:options context:nil completed:completedBlock];
+}
+
+- (void)sd_setImageWithURL:(NSURL *)url forState:(UIControlState)state placeholderImage:(UIImage *)placeholder options:(SDWebImageOptions)options context:(NSDictionary *)context completed:(SDWebImageCompletionBlock)completedBlock {
 
     [self setImage:placeholder forState:state];
     [self sd_cancelImageLoadForState:state];
@@ -68,8 +72,10 @@ static char imageURLStorageKey;
     
     self.imageURLStorage[@(state)] = url;
 
+    // The button displays its image at its intrinsic size, make the whole image fit in the button
+    context = [self sd_contextWithContext:context options:options contentMode:UIViewContentModeScaleAspectFit];
     __weak __typeof(self)wself = self;
-    id <SDWebImageOperation> operation = [SDWebImageManager.sharedManager downloadImageWithURL:url options:options progress:nil completed:^(UIImage *image, NSError *error, SDImageCacheType cacheType, BOOL finished, NSURL *imageURL) {
+    id <SDWebImageOperation> operation = [SDWebImageManager.sharedManager downloadImageWithURL:url options:options context:context progress:nil completed:^(UIImage *image, NSError *error, SDImageCacheType cacheType, BOOL finished, NSURL *imageURL) {
         if (!wself) return;
         dispatch_main_sync_safe(^{
             __strong UIButton *sself = wself;
@@ -106,13 +112,19 @@ static char imageURLStorageKey;
 }
 
 - (void)sd_setBackgroundImageWithURL:(NSURL *)url forState:(UIControlState)state placeholderImage:(UIImage *)placeholder options:(SDWebImageOptions)options completed:(SDWebImageCompletionBlock)completedBlock {
+    [self sd_setBackgroundImageWithURL:url forState:state placeholderImage:placeholder options:options context:nil completed:completedBlock];
+}
+
+- (void)sd_setBackgroundImageWithURL:(NSURL *)url forState:(UIControlState)state placeholderImage:(UIImage *)placeholder options:(SDWebImageOptions)options context:(NSDictionary *)context completed:(SDWebImageCompletionBlock)completedBlock {
     [self sd_cancelImageLoadForState:state];
 
     [self setBackgroundImage:placeholder forState:state];
 
     if (url) {
+        // The background image is stretched to the bounds of the button
+        context = [self sd_contextWithContext:context options:options contentMode:UIViewContentModeScaleToFill];
         __weak __typeof(self)wself = self;
-        id <SDWebImageOperation> operation = [SDWebImageManager.sharedManager downloadImageWithURL:url options:options progress:nil completed:^(UIImage *image, NSError *error, SDImageCacheType cacheType, BOOL finished, NSURL *imageURL) {
+        id <SDWebImageOperation> operation = [SDWebImageManager.sharedManager downloadImageWithURL:url options:options context:context progress:nil completed:^(UIImage *image, NSError *error, SDImageCacheType cacheType, BOOL finished, NSURL *imageURL) {
             if (!wself) return;
             dispatch_main_sync_safe(^{
                 __strong UIButton *sself = wself;
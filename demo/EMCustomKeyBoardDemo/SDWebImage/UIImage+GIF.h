@@ -7,6 +7,8 @@
 //
 
 #import <UIKit/UIKit.h>
+#import <ImageIO/ImageIO.h>
+#import "SDWebImageGIFDecoder.h"
 
 @interface UIImage (GIF)
 
@@ -14,6 +16,24 @@
 
 + (UIImage *)sd_animatedGIFWithData:(NSData *)data;
 
+// Decodes every frame directly at the size requested by SDWebImageContextThumbnailPixelSize, if any.
+// With SDWebImageContextAnimatedImage an animated GIF is a SDAnimatedImage, decoding its frames on demand
+//按上下文中的尺寸解码每一帧；上下文要求时返回按需解码的SDAnimatedImage
++ (UIImage *)sd_animatedGIFWithData:(NSData *)data context:(NSDictionary *)context;
+
+// Scales every frame to fill the size in points at the screen scale, cropping the overflow in the middle. The frames are
+// scaled in parallel; the frames of a SDAnimatedImage are scaled as they are decoded
+//缩放并居中裁剪每一帧：普通动画图片并行缩放所有帧，SDAnimatedImage在解码每一帧时缩放
 - (UIImage *)sd_animatedImageByScalingAndCroppingToSize:(CGSize)size;
 
+// The duration of a frame in seconds, 100ms for the frames that specify 10ms or less
++ (float)sd_frameDurationAtIndex:(NSUInteger)index source:(CGImageSourceRef)source;
+
+// Returns the options creating per-frame thumbnails for the context, nil if the frames should be decoded at full size
++ (NSDictionary *)sd_thumbnailOptionsForSource:(CGImageSourceRef)source context:(NSDictionary *)context;
+
+// A copy of the canvas of a GIF decoder, i.e. the last frame it composited, in a pooled bitmap. nil before the header
+//GIF解码器当前画布（最近合成的一帧）的拷贝
++ (UIImage *)sd_imageWithGIFDecoderCanvas:(SDGIFDecoder *)decoder scale:(CGFloat)scale;
+
 @end
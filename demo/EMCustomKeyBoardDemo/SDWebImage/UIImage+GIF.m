@@ -8,22 +8,50 @@
 
 #import "UIImage+GIF.h"
 #import <ImageIO/ImageIO.h>
+#import "SDWebImageCompat.h"
+#import "SDAnimatedImage.h"
+#import "SDWebImageBitmapPool.h"
+#import "SDWebImageDecoder.h"
 
 @implementation UIImage (GIF)
 
 + (UIImage *)sd_animatedGIFWithData:(NSData *)data {
+    return [self sd_animatedGIFWithData:data context:nil];
+}
+
++ (UIImage *)sd_animatedGIFWithData:(NSData *)data context:(NSDictionary *)context {
     if (!data) {
         return nil;
     }
 
+    if ([context[SDWebImageContextAnimatedImage] boolValue]) {
+        // Keep the data and decode the frames while playing, memory no longer grows with the number of frames
+        //保留压缩数据，播放时按需解码，内存不再随帧数增长
+        UIImage *animatedImage = [[SDAnimatedImage alloc] initWithData:data scale:1 context:context];
+        if (animatedImage) {
+            return animatedImage;
+        }
+    }
+
     CGImageSourceRef source = CGImageSourceCreateWithData((__bridge CFDataRef)data, NULL);
 
     size_t count = CGImageSourceGetCount(source);
 
+    // The frames of a GIF share the logical screen size, so one thumbnail size fits all of them
+    //GIF的每一帧尺寸相同，按第一帧计算缩略图大小
+    NSDictionary *thumbnailOptions = [self sd_thumbnailOptionsForSource:source context:context];
+
     UIImage *animatedImage;
 
     if (count <= 1) {
-        animatedImage = [[UIImage alloc] initWithData:data];
+        CGImageRef image = thumbnailOptions ? CGImageSourceCreateThumbnailAtIndex(source, 0, (__bridge CFDictionaryRef)thumbnailOptions) : NULL;
+        if (image) {
+            animatedImage = [UIImage imageWithCGImage:image];
+            CGImageRelease(image);
+        }
+        else {
+            animatedImage = [[UIImage alloc] initWithData:data];
+        }
     }
     else {
         NSMutableArray *images = [NSMutableArray array];
@@ -31,7 +59,10 @@
         NSTimeInterval duration = 0.0f;
 
         for (size_t i = 0; i < count; i++) {
-            CGImageRef image = CGImageSourceCreateImageAtIndex(source, i, NULL);
+            CGImageRef image = thumbnailOptions ? CGImageSourceCreateThumbnailAtIndex(source, i, (__bridge CFDictionaryRef)thumbnailOptions) : CGImageSourceCreateImageAtIndex(source, i, NULL);
+            if (!image) {
+                continue;
+            }
 
             duration += [self sd_frameDurationAtIndex:i source:source];
 
@@ -52,6 +83,43 @@
     return animatedImage;
 }
 
++ (NSDictionary *)sd_thumbnailOptionsForSource:(CGImageSourceRef)source context:(NSDictionary *)context {
+    if (!source || !context[SDWebImageContextThumbnailPixelSize]) {
+        return nil;
+    }
+    CFDictionaryRef properties = CGImageSourceCopyPropertiesAtIndex(source, 0, NULL);
+    if (!properties) {
+        return nil;
+    }
+    CGFloat pixelWidth = [((__bridge NSDictionary *)properties)[(__bridge NSString *)kCGImagePropertyPixelWidth] doubleValue];
+    CGFloat pixelHeight = [((__bridge NSDictionary *)properties)[(__bridge NSString *)kCGImagePropertyPixelHeight] doubleValue];
+    CFRelease(properties);
+    CGSize thumbnailPixelSize = SDThumbnailPixelSizeForContext(CGSizeMake(pixelWidth, pixelHeight), context);
+    if (thumbnailPixelSize.width <= 0) {
+        return nil;
+    }
+    return @{(__bridge NSString *)kCGImageSourceCreateThumbnailFromImageAlways : @YES,
+             (__bridge NSString *)kCGImageSourceThumbnailMaxPixelSize : @(MAX(thumbnailPixelSize.width, thumbnailPixelSize.height)),
+             (__bridge NSString *)kCGImageSourceShouldCacheImmediately : @YES};
+}
+
++ (UIImage *)sd_imageWithGIFDecoderCanvas:(SDGIFDecoder *)decoder scale:(CGFloat)scale {
+    const uint8_t *canvas = SDGIFDecoderGetCanvas(decoder);
+    size_t width = SDGIFDecoderGetWidth(decoder);
+    size_t height = SDGIFDecoderGetHeight(decoder);
+    if (!canvas) {
+        return nil;
+    }
+    // The canvas is already premultiplied BGRA, the rows are copied as they are
+    CGImageRef imageRef = [[SDWebImageBitmapPool sharedPool] newImageWithWidth:width height:height bitmapInfo:kCGBitmapByteOrder32Little | kCGImageAlphaPremultipliedFirst copyingPixels:canvas bytesPerRow:width * 4];
+    if (!imageRef) {
+        return nil;
+    }
+    UIImage *image = [UIImage imageWithCGImage:imageRef scale:scale orientation:UIImageOrientationUp];
+    CGImageRelease(imageRef);
+    return image;
+}
+
 + (float)sd_frameDurationAtIndex:(NSUInteger)index source:(CGImageSourceRef)source {
     float frameDuration = 0.1f;
     CFDictionaryRef cfFrameProperties = CGImageSourceCopyPropertiesAtIndex(source, index, nil);
@@ -123,34 +191,45 @@
         return self;
     }
 
-    CGSize scaledSize = size;
-    CGPoint thumbnailPoint = CGPointZero;
-
-    CGFloat widthFactor = size.width / self.size.width;
-    CGFloat heightFactor = size.height / self.size.height;
-    CGFloat scaleFactor = (widthFactor > heightFactor) ? widthFactor : heightFactor;
-    scaledSize.width = self.size.width * scaleFactor;
-    scaledSize.height = self.size.height * scaleFactor;
+    CGFloat scale = [UIScreen mainScreen].scale;
+    CGSize pixelSize = CGSizeMake(round(size.width * scale), round(size.height * scale));
 
-    if (widthFactor > heightFactor) {
-        thumbnailPoint.y = (size.height - scaledSize.height) * 0.5;
-    }
-    else if (widthFactor < heightFactor) {
-        thumbnailPoint.x = (size.width - scaledSize.width) * 0.5;
+    if ([self isKindOfClass:[SDAnimatedImage class]]) {
+        // The frames are scaled one by one as they are decoded
+        //按需解码的动画图片在解码每一帧时缩放
+        return [(SDAnimatedImage *)self animatedImageByScalingAndCroppingToPixelSize:pixelSize scale:scale];
     }
 
-    NSMutableArray *scaledImages = [NSMutableArray array];
-
-    UIGraphicsBeginImageContextWithOptions(size, NO, 0.0);
+    NSArray *images = self.images ?: @[self];
+    // A GIF frame lasting several display intervals may be repeated, it is only scaled once
+    //重复出现的帧只缩放一次
+    NSMutableDictionary *scaledImagesByFrame = [NSMutableDictionary dictionary];
+    NSMutableArray *uniqueImages = [NSMutableArray arrayWithCapacity:images.count];
+    for (UIImage *image in images) {
+        NSValue *frameKey = [NSValue valueWithNonretainedObject:image];
+        if (!scaledImagesByFrame[frameKey]) {
+            scaledImagesByFrame[frameKey] = [NSNull null];
+            [uniqueImages addObject:image];
+        }
+    }
 
-    for (UIImage *image in self.images) {
-        [image drawInRect:CGRectMake(thumbnailPoint.x, thumbnailPoint.y, scaledSize.width, scaledSize.height)];
-        UIImage *newImage = UIGraphicsGetImageFromCurrentImageContext();
+    // The frames are independent: scale them across cores with the shared resampler
+    //各帧互不依赖，在多个核心上并行缩放
+    dispatch_apply(uniqueImages.count, dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^(size_t index) {
+        UIImage *image = uniqueImages[index];
+        UIImage *scaledImage = [UIImage scaledImageWithImage:image fillingPixelSize:pixelSize scale:scale];
+        @synchronized (scaledImagesByFrame) {
+            scaledImagesByFrame[[NSValue valueWithNonretainedObject:image]] = scaledImage;
+        }
+    });
 
-        [scaledImages addObject:newImage];
+    if (!self.images) {
+        return scaledImagesByFrame[[NSValue valueWithNonretainedObject:self]];
+    }
+    NSMutableArray *scaledImages = [NSMutableArray arrayWithCapacity:images.count];
+    for (UIImage *image in images) {
+        [scaledImages addObject:scaledImagesByFrame[[NSValue valueWithNonretainedObject:image]]];
     }
-
-    UIGraphicsEndImageContext();
 
     return [UIImage animatedImageWithImages:scaledImages duration:self.duration];
 }
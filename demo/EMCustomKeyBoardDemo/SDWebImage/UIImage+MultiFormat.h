@@ -10,6 +10,25 @@
 
 @interface UIImage (MultiFormat)
 
+/**
+ * Decodes an image with the first coder of `SDWebImageCodersManager` accepting the data.
+ 由SDWebImageCodersManager中第一个支持该数据的编解码器解码
+ */
 + (UIImage *)sd_imageWithData:(NSData *)data;
 
+/**
+ * Same as `sd_imageWithData:`, but decodes the image directly at the size requested by
+ * `SDWebImageContextThumbnailPixelSize` if the context has one.
+ 按上下文中的尺寸直接解码出缩小后的图片
+ */
++ (UIImage *)sd_imageWithData:(NSData *)data context:(NSDictionary *)context;
+
+/**
+ * Decodes an image with ImageIO, from the EXIF orientation and at the thumbnail size of the context.
+ * Used by `SDWebImageImageIOCoder`.
+ */
++ (UIImage *)sd_imageIOImageWithData:(NSData *)data context:(NSDictionary *)context;
+
++ (UIImageOrientation)sd_exifOrientationToiOSOrientation:(int)exifOrientation;
+
 @end
@@ -7,74 +7,72 @@
 //
 
 #import "UIImage+MultiFormat.h"
-#import "UIImage+GIF.h"
-#import "NSData+ImageContentType.h"
+#import "SDWebImageCoder.h"
+#import "SDWebImageCompat.h"
 #import <ImageIO/ImageIO.h>
 
-#ifdef SD_WEBP
-#import "UIImage+WebP.h"
-#endif
-
 @implementation UIImage (MultiFormat)
 
 //通过data，获取首字节判断是什么类型的图片，然后将data转换成UIImage返回
 + (UIImage *)sd_imageWithData:(NSData *)data {
-    UIImage *image;
-    //获得图片类型
-    NSString *imageContentType = [NSData sd_contentTypeForImageData:data];
-    //根据类型加载图片
-    if ([imageContentType isEqualToString:@"image/gif"]) {
-        image = [UIImage sd_animatedGIFWithData:data];
-    }
-#ifdef SD_WEBP
-    else if ([imageContentType isEqualToString:@"image/webp"])
-    {
-        image = [UIImage sd_imageWithWebPData:data];
-    }
-#endif
-    else {
-        //不是gif和webp格式的图片
+    return [self sd_imageWithData:data context:nil];
+}
+
++ (UIImage *)sd_imageWithData:(NSData *)data context:(NSDictionary *)context {
+    //按顺序询问注册的编解码器，由第一个支持该数据的编解码器解码
+    UIImage *image = [[SDWebImageCodersManager sharedManager] decodedImageWithData:data context:context];
+    if (!image && data) {
         image = [[UIImage alloc] initWithData:data];
-        //获取该图片的方向属性orientation
-        UIImageOrientation orientation = [self sd_imageOrientationFromImageData:data];
-        if (orientation != UIImageOrientationUp) {
-            //如果不是向上的，还需要再次生成图片
-            image = [UIImage imageWithCGImage:image.CGImage
-                                        scale:image.scale
-                                  orientation:orientation];
-        }
     }
-
-
     return image;
 }
 
-/**
- 可交换图像文件格式常被简称为Exif（Exchangeable image file format），是专门为数码相机的照片设定的，可以记录数码照片的属性信息和拍摄数据… Exif可以附加于JPEG、TIFF、RIFF等文件之中.
- EXIF涵盖的各种信息之中，其中有一个叫做Orientation (rotation)的标签，用于记录图像的方向
- **/
-+(UIImageOrientation)sd_imageOrientationFromImageData:(NSData *)imageData {
-    UIImageOrientation result = UIImageOrientationUp;
-    CGImageSourceRef imageSource = CGImageSourceCreateWithData((__bridge CFDataRef)imageData, NULL);
-    if (imageSource) {
-        CFDictionaryRef properties = CGImageSourceCopyPropertiesAtIndex(imageSource, 0, NULL);
-        if (properties) {
-            CFTypeRef val;
-            int exifOrientation;
-            //通过kCGImagePropertyOrientation这个key获取属性集合properties里的Orientation属性
-            val = CFDictionaryGetValue(properties, kCGImagePropertyOrientation);
-            if (val) {
-                CFNumberGetValue(val, kCFNumberIntType, &exifOrientation);
-                //将EXIF image的方向转换成iOS的方向
-                result = [self sd_exifOrientationToiOSOrientation:exifOrientation];
-            } // else - if it's not set it remains at up
-            CFRelease((CFTypeRef) properties);
-        } else {
-            
+// Decodes an image with ImageIO from a single image source: the EXIF orientation comes from the same properties as
+// the pixel size, the data is parsed once. If the context asks for a thumbnail smaller than the image, it is decoded
+// straight from the encoded data and the full size bitmap is never created.
+//只创建一次图片源，方向与尺寸从同一份属性中读取；需要缩略图时直接从数据解码出缩略图，不会生成原图大小的位图
++ (UIImage *)sd_imageIOImageWithData:(NSData *)data context:(NSDictionary *)context {
+    if (!data) {
+        return nil;
+    }
+    CGImageSourceRef imageSource = CGImageSourceCreateWithData((__bridge CFDataRef)data, NULL);
+    if (!imageSource) {
+        return [[UIImage alloc] initWithData:data];
+    }
+    UIImage *image = nil;
+    NSDictionary *properties = CFBridgingRelease(CGImageSourceCopyPropertiesAtIndex(imageSource, 0, NULL));
+    //获取该图片的方向属性orientation，没有时为向上
+    int exifOrientation = [properties[(__bridge NSString *)kCGImagePropertyOrientation] intValue] ?: 1;
+    if (context[SDWebImageContextThumbnailPixelSize]) {
+        CGFloat pixelWidth = [properties[(__bridge NSString *)kCGImagePropertyPixelWidth] doubleValue];
+        CGFloat pixelHeight = [properties[(__bridge NSString *)kCGImagePropertyPixelHeight] doubleValue];
+        // EXIF orientations 5 to 8 are rotated by 90°, the displayed width is the stored height
+        CGSize imagePixelSize = exifOrientation >= 5 ? CGSizeMake(pixelHeight, pixelWidth) : CGSizeMake(pixelWidth, pixelHeight);
+        CGSize thumbnailPixelSize = SDThumbnailPixelSizeForContext(imagePixelSize, context);
+        if (thumbnailPixelSize.width > 0) {
+            NSDictionary *options = @{(__bridge NSString *)kCGImageSourceCreateThumbnailFromImageAlways : @YES,
+                                      (__bridge NSString *)kCGImageSourceThumbnailMaxPixelSize : @(MAX(thumbnailPixelSize.width, thumbnailPixelSize.height)),
+                                      // Applies the EXIF orientation, the thumbnail is always up
+                                      (__bridge NSString *)kCGImageSourceCreateThumbnailWithTransform : @YES,
+                                      (__bridge NSString *)kCGImageSourceShouldCacheImmediately : @YES};
+            CGImageRef imageRef = CGImageSourceCreateThumbnailAtIndex(imageSource, 0, (__bridge CFDictionaryRef)options);
+            if (imageRef) {
+                image = [UIImage imageWithCGImage:imageRef];
+                CGImageRelease(imageRef);
+            }
         }
-        CFRelease(imageSource);
     }
-    return result;
+    if (!image) {
+        // The orientation is kept on the image, the force decode writes the bitmap upright
+        //方向保存在UIImage上，强制解码时直接写出正向的位图
+        CGImageRef imageRef = CGImageSourceCreateImageAtIndex(imageSource, 0, NULL);
+        if (imageRef) {
+            image = [UIImage imageWithCGImage:imageRef scale:1 orientation:[self sd_exifOrientationToiOSOrientation:exifOrientation]];
+            CGImageRelease(imageRef);
+        }
+    }
+    CFRelease(imageSource);
+    return image;
 }
 
 //将EXIF image的方向转换成iOS的方向UIImageOrientation
@@ -125,86 +123,4 @@
     return orientation;
 }
 
-//补充：
-//调整图片方向方法
-+ (UIImage *)fixOrientation:(UIImageOrientation)orientation withImage:(UIImage *)image {
-    
-    // No-op if the orientation is already correct
-    if (orientation == UIImageOrientationUp) return image;
-    
-    // We need to calculate the proper transformation to make the image upright.
-    // We do it in 2 steps: Rotate if Left/Right/Down, and then flip if Mirrored.
-    CGAffineTransform transform = CGAffineTransformIdentity;
-    
-    switch (orientation) {
-        case UIImageOrientationDown:
-        case UIImageOrientationDownMirrored:
-            transform = CGAffineTransformTranslate(transform, image.size.width, image.size.height);
-            transform = CGAffineTransformRotate(transform, M_PI);
-            break;
-            
-        case UIImageOrientationLeft:
-        case UIImageOrientationLeftMirrored:
-            transform = CGAffineTransformTranslate(transform, image.size.width, 0);
-            transform = CGAffineTransformRotate(transform, M_PI_2);
-            break;
-            
-        case UIImageOrientationRight:
-        case UIImageOrientationRightMirrored:
-            transform = CGAffineTransformTranslate(transform, 0, image.size.height);
-            transform = CGAffineTransformRotate(transform, -M_PI_2);
-            break;
-        case UIImageOrientationUp:
-        case UIImageOrientationUpMirrored:
-            break;
-    }
-    
-    switch (orientation) {
-        case UIImageOrientationUpMirrored:
-        case UIImageOrientationDownMirrored:
-            transform = CGAffineTransformTranslate(transform, image.size.width, 0);
-            transform = CGAffineTransformScale(transform, -1, 1);
-            break;
-            
-        case UIImageOrientationLeftMirrored:
-        case UIImageOrientationRightMirrored:
-            transform = CGAffineTransformTranslate(transform, image.size.height, 0);
-            transform = CGAffineTransformScale(transform, -1, 1);
-            break;
-        case UIImageOrientationUp:
-        case UIImageOrientationDown:
-        case UIImageOrientationLeft:
-        case UIImageOrientationRight:
-            break;
-    }
-    
-    // Now we draw the underlying CGImage into a new context, applying the transform
-    // calculated above.
-    CGContextRef ctx = CGBitmapContextCreate(NULL, image.size.width, image.size.height,
-                                             CGImageGetBitsPerComponent(image.CGImage), 0,
-                                             CGImageGetColorSpace(image.CGImage),
-                                             CGImageGetBitmapInfo(image.CGImage));
-    CGContextConcatCTM(ctx, transform);
-    switch (orientation) {
-        case UIImageOrientationLeft:
-        case UIImageOrientationLeftMirrored:
-        case UIImageOrientationRight:
-        case UIImageOrientationRightMirrored:
-            // Grr...
-            CGContextDrawImage(ctx, CGRectMake(0,0,image.size.height,image.size.width), image.CGImage);
-            break;
-            
-        default:
-            CGContextDrawImage(ctx, CGRectMake(0,0,image.size.width,image.size.height), image.CGImage);
-            break;
-    }
-    
-    // And now we just create a new UIImage from the drawing context
-    CGImageRef cgimg = CGBitmapContextCreateImage(ctx);
-    UIImage *img = [UIImage imageWithCGImage:cgimg];
-    CGContextRelease(ctx);
-    CGImageRelease(cgimg);
-    return img;
-}
-
 @end
@@ -19,8 +19,14 @@ void VP8DspInitNEON(void);
 
 @interface UIImage (WebP)
 
+// Still images only: WebPDecode returns nil for an animated WebP, whose frames need libwebpdemux
+//只解码静态WebP，动图WebP需要libwebpdemux，返回nil
 + (UIImage *)sd_imageWithWebPData:(NSData *)data;
 
+// Lets libwebp scale while decoding to the size requested by SDWebImageContextThumbnailPixelSize, if any
+//解码时由libwebp直接缩放到上下文中要求的尺寸
++ (UIImage *)sd_imageWithWebPData:(NSData *)data context:(NSDictionary *)context;
+
 @end
 
 #endif
@@ -9,17 +9,17 @@
 #ifdef SD_WEBP
 #import "UIImage+WebP.h"
 #import "webp/decode.h"
-
-// Callback for CGDataProviderRelease
-static void FreeImageData(void *info, const void *data, size_t size)
-{
-    free((void *)data);
-}
+#import "SDWebImageCompat.h"
+#import "SDWebImageBitmapPool.h"
 
 @implementation UIImage (WebP)
 
 + (UIImage *)sd_imageWithWebPData:(NSData *)data {
-    WebPDecoderConfig config;
+    return [self sd_imageWithWebPData:data context:nil];
+}
+
++ (UIImage *)sd_imageWithWebPData:(NSData *)data context:(NSDictionary *)context {
+    __block WebPDecoderConfig config;
     if (!WebPInitDecoderConfig(&config)) {
         return nil;
     }
@@ -28,32 +28,37 @@ static void FreeImageData(void *info, const void *data, size_t size)
         return nil;
     }
 
-    config.output.colorspace = config.input.has_alpha ? MODE_rgbA : MODE_RGB;
+    // Decode to premultiplied BGRA, the layout displayed without conversion (kCGBitmapByteOrder32Little, alpha first).
+    // libwebp premultiplies while it writes the rows, no second pass over the bitmap
+    //解码为预乘的BGRA，即iOS显示时不需要再转换的格式；libwebp输出时即完成预乘
+    config.output.colorspace = MODE_bgrA;
     config.options.use_threads = 1;
 
-    // Decode the WebP image data into a RGBA value array.
-    if (WebPDecode(data.bytes, data.length, &config) != VP8_STATUS_OK) {
-        return nil;
-    }
-
     int width = config.input.width;
     int height = config.input.height;
-    if (config.options.use_scaling) {
-        width = config.options.scaled_width;
-        height = config.options.scaled_height;
+    CGSize thumbnailPixelSize = SDThumbnailPixelSizeForContext(CGSizeMake(width, height), context);
+    if (thumbnailPixelSize.width > 0) {
+        config.options.use_scaling = 1;
+        config.options.scaled_width = width = (int)thumbnailPixelSize.width;
+        config.options.scaled_height = height = (int)thumbnailPixelSize.height;
     }
 
-    // Construct a UIImage from the decoded RGBA value array.
-    CGDataProviderRef provider =
-    CGDataProviderCreateWithData(NULL, config.output.u.RGBA.rgba, config.output.u.RGBA.size, FreeImageData);
-    CGColorSpaceRef colorSpaceRef = CGColorSpaceCreateDeviceRGB();
-    CGBitmapInfo bitmapInfo = config.input.has_alpha ? kCGBitmapByteOrder32Big | kCGImageAlphaPremultipliedLast : 0;
-    size_t components = config.input.has_alpha ? 4 : 3;
-    CGColorRenderingIntent renderingIntent = kCGRenderingIntentDefault;
-    CGImageRef imageRef = CGImageCreate(width, height, 8, components * 8, components * width, colorSpaceRef, bitmapInfo, provider, NULL, NO, renderingIntent);
+    BOOL hasAlpha = config.input.has_alpha;
+    CGBitmapInfo bitmapInfo = kCGBitmapByteOrder32Little | (hasAlpha ? kCGImageAlphaPremultipliedFirst : kCGImageAlphaNoneSkipFirst);
 
-    CGColorSpaceRelease(colorSpaceRef);
-    CGDataProviderRelease(provider);
+    // Decode straight into a pooled buffer, the image uses it without copying: the buffer is the decoded bitmap
+    //直接解码到位图池的缓冲区，图片不拷贝直接使用，无需再强制解码
+    CGImageRef imageRef = [[SDWebImageBitmapPool sharedPool] newImageWithWidth:width height:height bitsPerComponent:8 bitmapInfo:bitmapInfo colorSpace:NULL filling:^BOOL(void *pixels, size_t bytesPerRow) {
+        config.output.is_external_memory = 1;
+        config.output.u.RGBA.rgba = pixels;
+        config.output.u.RGBA.stride = (int)bytesPerRow;
+        config.output.u.RGBA.size = bytesPerRow * height;
+        return WebPDecode(data.bytes, data.length, &config) == VP8_STATUS_OK;
+    }];
+    WebPFreeDecBuffer(&config.output);
+    if (!imageRef) {
+        return nil;
+    }
 
     UIImage *image = [[UIImage alloc] initWithCGImage:imageRef];
     CGImageRelease(imageRef);
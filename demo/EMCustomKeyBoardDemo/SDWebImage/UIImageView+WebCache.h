@@ -148,6 +148,16 @@
  */
 - (void)sd_setImageWithURL:(NSURL *)url placeholderImage:(UIImage *)placeholder options:(SDWebImageOptions)options progress:(SDWebImageDownloaderProgressBlock)progressBlock completed:(SDWebImageCompletionBlock)completedBlock;
 
+/**
+ * Set the imageView `image` with an `url`, placeholder, custom options and a context.
+ *
+ * @param context        The context to produce the image for, e.g. `SDWebImageContextThumbnailPixelSize` to decode it
+ *                       directly at a reduced size. With `SDWebImageThumbnailToViewSize` the size of the view and
+ *                       its content mode are used when the context has no thumbnail size.
+ * @see sd_setImageWithURL:placeholderImage:options:progress:completed:
+ */
+- (void)sd_setImageWithURL:(NSURL *)url placeholderImage:(UIImage *)placeholder options:(SDWebImageOptions)options context:(NSDictionary *)context progress:(SDWebImageDownloaderProgressBlock)progressBlock completed:(SDWebImageCompletionBlock)completedBlock;
+
 /**
  * Set the imageView `image` with an `url` and a optionaly placeholder image.
  *
@@ -34,6 +34,19 @@
  */
 - (void)sd_removeImageLoadOperationWithKey:(NSString *)key;
 
+/**
+ *  Returns the context to load an image into the view with. With `SDWebImageThumbnailToViewSize` the view's size in pixels
+ *  and the given content mode are added, unless the context already has a thumbnail size or the view has no size yet.
+ *
+ *  @param context     the context given by the caller, may be nil
+ *  @param options     the options of the load
+ *  @param contentMode the content mode the image will be displayed with
+ *
+ *  @return the context to pass to SDWebImageManager
+ 设置了SDWebImageThumbnailToViewSize时，在上下文中加入视图的像素尺寸和显示模式
+ */
+- (NSDictionary *)sd_contextWithContext:(NSDictionary *)context options:(SDWebImageOptions)options contentMode:(UIViewContentMode)contentMode;
+
 @end
 
 //UIView+WebCacheOperation这个分类提供了三个方法,用于操作绑定关系
@@ -33,6 +33,24 @@ static char loadOperationKey;
     [operationDictionary setObject:operation forKey:key];
 }
 
+- (NSDictionary *)sd_contextWithContext:(NSDictionary *)context options:(SDWebImageOptions)options contentMode:(UIViewContentMode)contentMode {
+    if (!(options & SDWebImageThumbnailToViewSize) || context[SDWebImageContextThumbnailPixelSize]) {
+        return context;
+    }
+    CGFloat scale = self.window ? self.window.screen.scale : [UIScreen mainScreen].scale;
+    CGSize pixelSize = CGSizeMake(ceil(CGRectGetWidth(self.bounds) * scale), ceil(CGRectGetHeight(self.bounds) * scale));
+    if (pixelSize.width <= 0 || pixelSize.height <= 0) {
+        // Not laid out yet, decode at full size rather than guessing
+        return context;
+    }
+    NSMutableDictionary *mutableContext = context ? [context mutableCopy] : [NSMutableDictionary dictionary];
+    mutableContext[SDWebImageContextThumbnailPixelSize] = [NSValue valueWithCGSize:pixelSize];
+    if (!mutableContext[SDWebImageContextThumbnailContentMode]) {
+        mutableContext[SDWebImageContextThumbnailContentMode] = @(contentMode);
+    }
+    return [mutableContext copy];
+}
+
 //取消当期视图的所有操作
 - (void)sd_cancelImageLoadOperationWithKey:(NSString *)key {
     NSMutableDictionary *operationDictionary = [self operationDictionary];
@@ -0,0 +1,79 @@
+/*
+ * This file is part of the SDWebImage package.
+ * (c) Olivier Poitrey <rs@dailymotion.com>
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#import <Foundation/Foundation.h>
+#import <UIKit/UIKit.h>
+
+/**
+ * A request received by `SDTestHTTPServer`.
+ */
+@interface SDTestHTTPRequest : NSObject
+
+@property (copy, nonatomic, readonly) NSString *method;
+@property (copy, nonatomic, readonly) NSString *path;
+// Header names are lowercased
+@property (copy, nonatomic, readonly) NSDictionary *headers;
+// The number of requests the server received before this one
+@property (assign, nonatomic, readonly) NSUInteger index;
+
+@end
+
+/**
+ * The response the handler of `SDTestHTTPServer` sends. The server always adds Content-Length and closes the
+ * connection after the body.
+ */
+@interface SDTestHTTPResponse : NSObject
+
++ (instancetype)responseWithStatusCode:(NSInteger)statusCode body:(NSData *)body;
+
+@property (assign, nonatomic) NSInteger statusCode;
+@property (copy, nonatomic) NSData *body;
+@property (strong, nonatomic, readonly) NSMutableDictionary *headers;
+// Waited before the response is sent
+@property (assign, nonatomic) NSTimeInterval delay;
+// The body is written in chunks of this length with `chunkDelay` between them, 0 for all at once
+@property (assign, nonatomic) NSUInteger chunkLength;
+@property (assign, nonatomic) NSTimeInterval chunkDelay;
+// The connection is closed after this many bytes of the body, as if it dropped, 0 to send the whole body
+@property (assign, nonatomic) NSUInteger closesAfterLength;
+
+@end
+
+typedef SDTestHTTPResponse *(^SDTestHTTPHandler)(SDTestHTTPRequest *request);
+
+/**
+ * A minimal HTTP/1.1 server on the loopback interface, on a port chosen by the system, for the tests of the
+ * downloader. Each connection is handled on a global queue, the handler may be called concurrently.
+ 测试用的本地HTTP服务器：监听127.0.0.1上系统分配的端口
+ */
+@interface SDTestHTTPServer : NSObject
+
+- (instancetype)initWithHandler:(SDTestHTTPHandler)handler;
+
+- (BOOL)start;
+- (void)stop;
+
+@property (assign, nonatomic, readonly) uint16_t port;
+
+- (NSURL *)URLForPath:(NSString *)path;
+
+@property (assign, nonatomic, readonly) NSUInteger requestCount;
+// The most requests handled at the same time, from the request received to the last byte of the body sent
+@property (assign, nonatomic, readonly) NSUInteger maxConcurrentRequests;
+// The body bytes written, counting the requests the client closed early
+@property (assign, nonatomic, readonly) NSUInteger bodyBytesSent;
+// The time each request was received, in order
+@property (copy, nonatomic, readonly) NSArray *requestDates;
+
+@end
+
+/**
+ * PNG data of a gray image whose pixels are generated as it is encoded, so that very large images are cheap to create.
+ * A flat image compresses to almost nothing, a noisy one hardly compresses.
+ */
+extern NSData *SDTestPNGImageData(size_t width, size_t height, BOOL noise);
@@ -0,0 +1,260 @@
+/*
+ * This file is part of the SDWebImage package.
+ * (c) Olivier Poitrey <rs@dailymotion.com>
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#import "SDTestHTTPServer.h"
+#import <ImageIO/ImageIO.h>
+#import <MobileCoreServices/MobileCoreServices.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+@interface SDTestHTTPRequest ()
+
+@property (copy, nonatomic, readwrite) NSString *method;
+@property (copy, nonatomic, readwrite) NSString *path;
+@property (copy, nonatomic, readwrite) NSDictionary *headers;
+@property (assign, nonatomic, readwrite) NSUInteger index;
+
+@end
+
+@implementation SDTestHTTPRequest
+
+@end
+
+@implementation SDTestHTTPResponse
+
++ (instancetype)responseWithStatusCode:(NSInteger)statusCode body:(NSData *)body {
+    SDTestHTTPResponse *response = [self new];
+    response.statusCode = statusCode;
+    response.body = body;
+    return response;
+}
+
+- (id)init {
+    if ((self = [super init])) {
+        _headers = [NSMutableDictionary new];
+    }
+    return self;
+}
+
+@end
+
+@interface SDTestHTTPServer ()
+
+@property (copy, nonatomic) SDTestHTTPHandler handler;
+@property (assign, nonatomic, readwrite) uint16_t port;
+@property (assign, nonatomic, readwrite) NSUInteger requestCount;
+@property (assign, nonatomic, readwrite) NSUInteger maxConcurrentRequests;
+@property (assign, nonatomic, readwrite) NSUInteger bodyBytesSent;
+@property (assign, nonatomic) NSUInteger activeRequests;
+@property (strong, nonatomic) NSMutableArray *receivedDates;
+@property (strong, nonatomic) dispatch_source_t acceptSource;
+
+@end
+
+// Writes all the bytes, returns NO once the client closed the connection
+static BOOL SDTestWriteAll(int fd, const void *bytes, size_t length) {
+    const uint8_t *position = bytes;
+    while (length > 0) {
+        ssize_t written = write(fd, position, length);
+        if (written <= 0) {
+            return NO;
+        }
+        position += written;
+        length -= (size_t)written;
+    }
+    return YES;
+}
+
+@implementation SDTestHTTPServer
+
+- (instancetype)initWithHandler:(SDTestHTTPHandler)handler {
+    if ((self = [super init])) {
+        _handler = [handler copy];
+        _receivedDates = [NSMutableArray new];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [self stop];
+}
+
+- (BOOL)start {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return NO;
+    }
+    int yes = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_len = sizeof(address);
+    address.sin_family = AF_INET;
+    address.sin_port = 0;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    if (bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(fd, 16) != 0 || getsockname(fd, (struct sockaddr *)&address, &length) != 0) {
+        close(fd);
+        return NO;
+    }
+    self.port = ntohs(address.sin_port);
+
+    __weak SDTestHTTPServer *weakSelf = self;
+    dispatch_source_t acceptSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_READ, (uintptr_t)fd, 0, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0));
+    dispatch_source_set_event_handler(acceptSource, ^{
+        int client = accept(fd, NULL, NULL);
+        if (client < 0) {
+            return;
+        }
+        int noSigPipe = 1;
+        setsockopt(client, SOL_SOCKET, SO_NOSIGPIPE, &noSigPipe, sizeof(noSigPipe));
+        dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+            SDTestHTTPServer *server = weakSelf;
+            if (server) {
+                [server handleConnection:client];
+            }
+            close(client);
+        });
+    });
+    dispatch_source_set_cancel_handler(acceptSource, ^{
+        close(fd);
+    });
+    self.acceptSource = acceptSource;
+    dispatch_resume(acceptSource);
+    return YES;
+}
+
+- (void)stop {
+    if (self.acceptSource) {
+        dispatch_source_cancel(self.acceptSource);
+        self.acceptSource = nil;
+    }
+}
+
+- (NSURL *)URLForPath:(NSString *)path {
+    return [NSURL URLWithString:[NSString stringWithFormat:@"http://127.0.0.1:%u%@", self.port, path]];
+}
+
+- (NSArray *)requestDates {
+    @synchronized (self) {
+        return [self.receivedDates copy];
+    }
+}
+
+- (SDTestHTTPRequest *)readRequestFromConnection:(int)fd {
+    NSMutableData *buffer = [NSMutableData new];
+    NSData *terminator = [@"\r\n\r\n" dataUsingEncoding:NSASCIIStringEncoding];
+    NSRange end = NSMakeRange(NSNotFound, 0);
+    while (end.location == NSNotFound) {
+        uint8_t bytes[4096];
+        ssize_t count = read(fd, bytes, sizeof(bytes));
+        if (count <= 0) {
+            return nil;
+        }
+        [buffer appendBytes:bytes length:(NSUInteger)count];
+        end = [buffer rangeOfData:terminator options:0 range:NSMakeRange(0, buffer.length)];
+    }
+    NSString *head = [[NSString alloc] initWithData:[buffer subdataWithRange:NSMakeRange(0, end.location)] encoding:NSISOLatin1StringEncoding];
+    NSArray *lines = [head componentsSeparatedByString:@"\r\n"];
+    NSArray *requestLine = [lines.firstObject componentsSeparatedByString:@" "];
+    if (requestLine.count < 2) {
+        return nil;
+    }
+    NSMutableDictionary *headers = [NSMutableDictionary new];
+    for (NSString *line in [lines subarrayWithRange:NSMakeRange(1, lines.count - 1)]) {
+        NSRange colon = [line rangeOfString:@":"];
+        if (colon.location != NSNotFound) {
+            NSString *name = [line substringToIndex:colon.location].lowercaseString;
+            headers[name] = [[line substringFromIndex:colon.location + 1] stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
+        }
+    }
+    SDTestHTTPRequest *request = [SDTestHTTPRequest new];
+    request.method = requestLine[0];
+    request.path = requestLine[1];
+    request.headers = headers;
+    return request;
+}
+
+- (void)handleConnection:(int)fd {
+    SDTestHTTPRequest *request = [self readRequestFromConnection:fd];
+    if (!request) {
+        return;
+    }
+    @synchronized (self) {
+        request.index = self.requestCount;
+        self.requestCount++;
+        self.activeRequests++;
+        self.maxConcurrentRequests = MAX(self.maxConcurrentRequests, self.activeRequests);
+        [self.receivedDates addObject:[NSDate date]];
+    }
+
+    SDTestHTTPResponse *response = self.handler(request) ?: [SDTestHTTPResponse responseWithStatusCode:404 body:nil];
+    if (response.delay > 0) {
+        [NSThread sleepForTimeInterval:response.delay];
+    }
+    NSData *body = response.body ?: [NSData data];
+    NSMutableString *head = [NSMutableString stringWithFormat:@"HTTP/1.1 %ld %@\r\n", (long)response.statusCode, [NSHTTPURLResponse localizedStringForStatusCode:response.statusCode]];
+    [response.headers enumerateKeysAndObjectsUsingBlock:^(NSString *name, NSString *value, BOOL *stop) {
+        [head appendFormat:@"%@: %@\r\n", name, value];
+    }];
+    [head appendFormat:@"Content-Length: %lu\r\nConnection: close\r\n\r\n", (unsigned long)body.length];
+    NSData *headData = [head dataUsingEncoding:NSISOLatin1StringEncoding];
+
+    if (SDTestWriteAll(fd, headData.bytes, headData.length)) {
+        NSUInteger bodyLength = response.closesAfterLength > 0 ? MIN(response.closesAfterLength, body.length) : body.length;
+        NSUInteger chunkLength = response.chunkLength > 0 ? response.chunkLength : bodyLength;
+        for (NSUInteger offset = 0; offset < bodyLength; offset += chunkLength) {
+            NSUInteger length = MIN(chunkLength, bodyLength - offset);
+            if (!SDTestWriteAll(fd, (const uint8_t *)body.bytes + offset, length)) {
+                break;
+            }
+            @synchronized (self) {
+                self.bodyBytesSent += length;
+            }
+            if (response.chunkDelay > 0 && offset + length < bodyLength) {
+                [NSThread sleepForTimeInterval:response.chunkDelay];
+            }
+        }
+    }
+    @synchronized (self) {
+        self.activeRequests--;
+    }
+}
+
+@end
+
+static size_t SDTestGetGrayBytes(void *info, void *buffer, size_t count) {
+    memset(buffer, 0x80, count);
+    return count;
+}
+
+static size_t SDTestGetNoiseBytes(void *info, void *buffer, size_t count) {
+    arc4random_buf(buffer, count);
+    return count;
+}
+
+NSData *SDTestPNGImageData(size_t width, size_t height, BOOL noise) {
+    CGDataProviderSequentialCallbacks callbacks = {0, noise ? SDTestGetNoiseBytes : SDTestGetGrayBytes, NULL, NULL, NULL};
+    CGDataProviderRef provider = CGDataProviderCreateSequential(NULL, &callbacks);
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceGray();
+    CGImageRef imageRef = CGImageCreate(width, height, 8, 8, width, colorSpace, kCGImageAlphaNone, provider, NULL, false, kCGRenderingIntentDefault);
+    CGColorSpaceRelease(colorSpace);
+    CGDataProviderRelease(provider);
+    if (!imageRef) {
+        return nil;
+    }
+    NSMutableData *data = [NSMutableData new];
+    CGImageDestinationRef destination = CGImageDestinationCreateWithData((__bridge CFMutableDataRef)data, kUTTypePNG, 1, NULL);
+    CGImageDestinationAddImage(destination, imageRef, NULL);
+    BOOL finalized = CGImageDestinationFinalize(destination);
+    CFRelease(destination);
+    CGImageRelease(imageRef);
+    return finalized ? data : nil;
+}
@@ -0,0 +1,30 @@
+/*
+ * This file is part of the SDWebImage package.
+ * (c) Olivier Poitrey <rs@dailymotion.com>
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#import <XCTest/XCTest.h>
+#import "SDWebImagePixelKernelsTests.h"
+#import "SDWebImageGIFDecoderTests.h"
+
+// Runs the tests of the C modules, written in C so that they also build with a plain C compiler. Each failed check is
+// printed to the console
+//运行C模块的测试，失败的检查会打印到控制台
+@interface SDWebImageCTests : XCTestCase
+
+@end
+
+@implementation SDWebImageCTests
+
+- (void)testPixelKernels {
+    XCTAssertEqual(SDPixelKernelsRunTests(), 0);
+}
+
+- (void)testGIFDecoder {
+    XCTAssertEqual(SDGIFDecoderRunTests(), 0);
+}
+
+@end
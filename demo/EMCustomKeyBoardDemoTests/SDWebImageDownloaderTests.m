@@ -0,0 +1,299 @@
+/*
+ * This file is part of the SDWebImage package.
+ * (c) Olivier Poitrey <rs@dailymotion.com>
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#import <XCTest/XCTest.h>
+#import "SDTestHTTPServer.h"
+#import "SDWebImageDownloader.h"
+#import "SDImageCache.h"
+
+@interface SDWebImageDownloaderTests : XCTestCase
+
+@property (strong, nonatomic) NSData *imageData;
+@property (strong, nonatomic) SDWebImageDownloader *downloader;
+
+@end
+
+@implementation SDWebImageDownloaderTests
+
+- (void)setUp {
+    [super setUp];
+    self.imageData = SDTestPNGImageData(8, 8, NO);
+    self.downloader = [SDWebImageDownloader new];
+}
+
+- (void)tearDown {
+    self.downloader = nil;
+    [super tearDown];
+}
+
+- (SDTestHTTPServer *)startedServerWithDelay:(NSTimeInterval)delay {
+    NSData *imageData = self.imageData;
+    SDTestHTTPServer *server = [[SDTestHTTPServer alloc] initWithHandler:^SDTestHTTPResponse *(SDTestHTTPRequest *request) {
+        SDTestHTTPResponse *response = [SDTestHTTPResponse responseWithStatusCode:200 body:imageData];
+        response.headers[@"Content-Type"] = @"image/png";
+        response.delay = delay;
+        return response;
+    }];
+    XCTAssertTrue([server start]);
+    return server;
+}
+
+- (void)downloadPaths:(NSUInteger)count fromServer:(SDTestHTTPServer *)server {
+    for (NSUInteger i = 0; i < count; i++) {
+        NSURL *url = [server URLForPath:[NSString stringWithFormat:@"/%lu.png", (unsigned long)i]];
+        XCTestExpectation *expectation = [self expectationWithDescription:url.absoluteString];
+        [self.downloader downloadImageWithURL:url options:0 progress:nil completed:^(UIImage *image, NSData *data, NSError *error, BOOL finished) {
+            XCTAssertNotNil(image);
+            XCTAssertNil(error);
+            [expectation fulfill];
+        }];
+    }
+}
+
+- (void)waitForHostStatisticsToDrain {
+    NSDate *deadline = [NSDate dateWithTimeIntervalSinceNow:5];
+    while (self.downloader.hostStatistics.count > 0 && [deadline timeIntervalSinceNow] > 0) {
+        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.05]];
+    }
+}
+
+- (void)testPerHostLimitAppliesToEachOrigin {
+    SDTestHTTPServer *first = [self startedServerWithDelay:0.3];
+    SDTestHTTPServer *second = [self startedServerWithDelay:0.3];
+    XCTAssertNotEqual(first.port, second.port);
+
+    self.downloader.maxConcurrentDownloads = 4;
+    self.downloader.maxConcurrentDownloadsPerHost = 1;
+    [self downloadPaths:4 fromServer:first];
+    [self downloadPaths:2 fromServer:second];
+    [self waitForExpectationsWithTimeout:20 handler:nil];
+
+    XCTAssertEqual(first.requestCount, 4u);
+    XCTAssertEqual(second.requestCount, 2u);
+    XCTAssertEqual(first.maxConcurrentRequests, 1u);
+    XCTAssertEqual(second.maxConcurrentRequests, 1u);
+    // The second origin did not wait for the first one to drain
+    XCTAssertEqual([second.requestDates.firstObject compare:first.requestDates.lastObject], NSOrderedAscending);
+
+    [self waitForHostStatisticsToDrain];
+    XCTAssertEqual(self.downloader.hostStatistics.count, 0u);
+}
+
+- (void)testOriginsTakeTurns {
+    SDTestHTTPServer *first = [self startedServerWithDelay:0.1];
+    SDTestHTTPServer *second = [self startedServerWithDelay:0.1];
+
+    self.downloader.maxConcurrentDownloads = 1;
+    self.downloader.maxConcurrentDownloadsPerHost = 1;
+    [self downloadPaths:3 fromServer:first];
+    [self downloadPaths:3 fromServer:second];
+    [self waitForExpectationsWithTimeout:20 handler:nil];
+
+    // Queued after every download of the first origin, the second origin is still served second
+    NSArray *firstDates = first.requestDates;
+    NSArray *secondDates = second.requestDates;
+    XCTAssertEqual(firstDates.count, 3u);
+    XCTAssertEqual(secondDates.count, 3u);
+    XCTAssertEqual([secondDates[0] compare:firstDates[1]], NSOrderedAscending);
+    XCTAssertEqual([firstDates[1] compare:secondDates[1]], NSOrderedAscending);
+}
+
+- (void)testInterruptedDownloadResumesFromTheInjectedCache {
+    NSData *imageData = SDTestPNGImageData(256, 256, YES);
+    XCTAssertGreaterThan(imageData.length, 48 * 1024u);
+    NSMutableArray *requests = [NSMutableArray new];
+    SDTestHTTPServer *server = [[SDTestHTTPServer alloc] initWithHandler:^SDTestHTTPResponse *(SDTestHTTPRequest *request) {
+        BOOL firstRequest;
+        @synchronized (requests) {
+            firstRequest = ![[requests valueForKey:@"path"] containsObject:request.path];
+            [requests addObject:request];
+        }
+        // Lowercase header names, as HTTP/2 servers send them
+        NSString *range = request.headers[@"range"];
+        if (range) {
+            NSUInteger start = (NSUInteger)[[range substringFromIndex:@"bytes=".length] integerValue];
+            // This one does not start the range where it was asked to
+            if ([request.path isEqualToString:@"/misaligned.png"]) {
+                start -= 1024;
+            }
+            SDTestHTTPResponse *response = [SDTestHTTPResponse responseWithStatusCode:206 body:[imageData subdataWithRange:NSMakeRange(start, imageData.length - start)]];
+            response.headers[@"content-range"] = [NSString stringWithFormat:@"bytes %lu-%lu/%lu", (unsigned long)start, (unsigned long)imageData.length - 1, (unsigned long)imageData.length];
+            response.headers[@"etag"] = @"\"v1\"";
+            return response;
+        }
+        SDTestHTTPResponse *response = [SDTestHTTPResponse responseWithStatusCode:200 body:imageData];
+        response.headers[@"etag"] = @"\"v1\"";
+        response.headers[@"accept-ranges"] = @"bytes";
+        if (firstRequest) {
+            response.closesAfterLength = 40 * 1024;
+        }
+        return response;
+    }];
+    XCTAssertTrue([server start]);
+    SDImageCache *cache = [[SDImageCache alloc] initWithNamespace:@"SDWebImageDownloaderTests"];
+    NSDictionary *context = @{SDWebImageContextImageCache : cache, SDWebImageContextCacheKey : @"resumed"};
+    NSURL *url = [server URLForPath:@"/resumed.png"];
+
+    XCTestExpectation *dropped = [self expectationWithDescription:@"dropped"];
+    [self.downloader downloadImageWithURL:url options:0 context:context progress:nil completed:^(UIImage *image, NSData *data, NSError *error, BOOL finished) {
+        XCTAssertNil(image);
+        XCTAssertNotNil(error);
+        [dropped fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+
+    // Stored on the IO queue, which reads in order
+    XCTestExpectation *stored = [self expectationWithDescription:@"stored"];
+    __block NSUInteger partialLength = 0;
+    [cache queryPartialDataForKey:@"resumed" completion:^(NSData *data, NSString *validator) {
+        partialLength = data.length;
+        XCTAssertEqualObjects(validator, @"\"v1\"");
+        [stored fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+    XCTAssertGreaterThanOrEqual(partialLength, 32 * 1024u);
+
+    XCTestExpectation *resumed = [self expectationWithDescription:@"resumed"];
+    [self.downloader downloadImageWithURL:url options:0 context:context progress:nil completed:^(UIImage *image, NSData *data, NSError *error, BOOL finished) {
+        XCTAssertNotNil(image);
+        XCTAssertEqualObjects(data, imageData);
+        [resumed fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+
+    XCTAssertEqual(requests.count, 2u);
+    SDTestHTTPRequest *resumeRequest = requests.lastObject;
+    XCTAssertEqualObjects(resumeRequest.headers[@"range"], ([NSString stringWithFormat:@"bytes=%lu-", (unsigned long)partialLength]));
+    XCTAssertEqualObjects(resumeRequest.headers[@"if-range"], @"\"v1\"");
+
+    // A range that does not start where the partial data ends is not appended to it, the image is downloaded again whole
+    NSDictionary *misalignedContext = @{SDWebImageContextImageCache : cache, SDWebImageContextCacheKey : @"misaligned"};
+    NSURL *misalignedURL = [server URLForPath:@"/misaligned.png"];
+    XCTestExpectation *misalignedDropped = [self expectationWithDescription:@"misaligned dropped"];
+    [self.downloader downloadImageWithURL:misalignedURL options:0 context:misalignedContext progress:nil completed:^(UIImage *image, NSData *data, NSError *error, BOOL finished) {
+        XCTAssertNotNil(error);
+        [misalignedDropped fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+    XCTestExpectation *misalignedStored = [self expectationWithDescription:@"misaligned stored"];
+    [cache queryPartialDataForKey:@"misaligned" completion:^(NSData *data, NSString *validator) {
+        XCTAssertGreaterThanOrEqual(data.length, 32 * 1024u);
+        [misalignedStored fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+
+    XCTestExpectation *restarted = [self expectationWithDescription:@"restarted"];
+    [self.downloader downloadImageWithURL:misalignedURL options:0 context:misalignedContext progress:nil completed:^(UIImage *image, NSData *data, NSError *error, BOOL finished) {
+        XCTAssertNotNil(image);
+        XCTAssertEqualObjects(data, imageData);
+        [restarted fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+
+    XCTAssertEqual(requests.count, 5u);
+    XCTAssertNotNil([requests[3] headers][@"range"]);
+    XCTAssertNil([requests[4] headers][@"range"]);
+    XCTAssertNil([requests[4] headers][@"if-range"]);
+    XCTestExpectation *removed = [self expectationWithDescription:@"removed"];
+    [cache queryPartialDataForKey:@"misaligned" completion:^(NSData *data, NSString *validator) {
+        XCTAssertNil(data);
+        [removed fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+    [cache clearDisk];
+}
+
+- (void)testStreamedBodyIsCachedOnlyOnceDecoded {
+    NSData *imageData = SDTestPNGImageData(600, 600, YES);
+    NSMutableData *corruptData = [NSMutableData dataWithLength:imageData.length];
+    arc4random_buf(corruptData.mutableBytes, corruptData.length);
+    [corruptData replaceBytesInRange:NSMakeRange(0, 16) withBytes:imageData.bytes];
+    SDTestHTTPServer *server = [[SDTestHTTPServer alloc] initWithHandler:^SDTestHTTPResponse *(SDTestHTTPRequest *request) {
+        return [SDTestHTTPResponse responseWithStatusCode:200 body:[request.path isEqualToString:@"/corrupt.png"] ? corruptData : imageData];
+    }];
+    XCTAssertTrue([server start]);
+    SDImageCache *cache = [[SDImageCache alloc] initWithNamespace:@"SDWebImageDownloaderTests"];
+
+    XCTestExpectation *failed = [self expectationWithDescription:@"corrupt"];
+    NSDictionary *corruptContext = @{SDWebImageContextImageCache : cache, SDWebImageContextCacheKey : @"corrupt"};
+    [self.downloader downloadImageWithURL:[server URLForPath:@"/corrupt.png"] options:SDWebImageDownloaderStreamToDisk context:corruptContext progress:nil completed:^(UIImage *image, NSData *data, NSError *error, BOOL finished) {
+        XCTAssertNil(image);
+        XCTAssertFalse([cache diskImageExistsWithKey:@"corrupt"]);
+        [failed fulfill];
+    }];
+    XCTestExpectation *decoded = [self expectationWithDescription:@"decoded"];
+    NSDictionary *context = @{SDWebImageContextImageCache : cache, SDWebImageContextCacheKey : @"streamed"};
+    [self.downloader downloadImageWithURL:[server URLForPath:@"/streamed.png"] options:SDWebImageDownloaderStreamToDisk context:context progress:nil completed:^(UIImage *image, NSData *data, NSError *error, BOOL finished) {
+        XCTAssertNotNil(image);
+        XCTAssertEqualObjects(data, imageData);
+        XCTAssertTrue([cache diskImageExistsWithKey:@"streamed"]);
+        [decoded fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+    [cache clearDisk];
+}
+
+// A flat 5000x5000 PNG compresses to a few KB, served slowly so that an abort leaves most of it unsent
+- (SDTestHTTPServer *)startedServerWithHugeImageData:(NSData *)imageData {
+    SDTestHTTPServer *server = [[SDTestHTTPServer alloc] initWithHandler:^SDTestHTTPResponse *(SDTestHTTPRequest *request) {
+        SDTestHTTPResponse *response = [SDTestHTTPResponse responseWithStatusCode:200 body:imageData];
+        response.headers[@"Content-Type"] = @"image/png";
+        response.chunkLength = 512;
+        response.chunkDelay = 0.02;
+        return response;
+    }];
+    XCTAssertTrue([server start]);
+    return server;
+}
+
+- (void)testOversizedImageIsAbortedFromItsHeader {
+    NSData *imageData = SDTestPNGImageData(5000, 5000, NO);
+    XCTAssertGreaterThan(imageData.length, 512 * 8u);
+    SDTestHTTPServer *server = [self startedServerWithHugeImageData:imageData];
+    self.downloader.maxDecodedPixelCount = 1000 * 1000;
+    self.downloader.oversizedImagePolicy = SDWebImageDownloaderOversizedImageAbort;
+
+    XCTestExpectation *aborted = [self expectationWithDescription:@"aborted"];
+    [self.downloader downloadImageWithURL:[server URLForPath:@"/huge.png"] options:0 progress:nil completed:^(UIImage *image, NSData *data, NSError *error, BOOL finished) {
+        XCTAssertNil(image);
+        XCTAssertEqualObjects(error.domain, SDWebImageErrorDomain);
+        XCTAssertEqual(error.code, SDWebImageErrorImageTooLarge);
+        [aborted fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+
+    // The server stops writing once the connection is closed
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.2]];
+    XCTAssertEqual(server.requestCount, 1u);
+    XCTAssertLessThan(server.bodyBytesSent, imageData.length / 2);
+}
+
+- (void)testOversizedImageIsDownsampledToTheBudget {
+    NSData *imageData = SDTestPNGImageData(5000, 5000, NO);
+    SDTestHTTPServer *server = [self startedServerWithHugeImageData:imageData];
+    self.downloader.maxDecodedPixelCount = 1000 * 1000;
+    self.downloader.oversizedImagePolicy = SDWebImageDownloaderOversizedImageDownsample;
+
+    XCTestExpectation *downsampled = [self expectationWithDescription:@"downsampled"];
+    [self.downloader downloadImageWithURL:[server URLForPath:@"/huge.png"] options:0 progress:nil completed:^(UIImage *image, NSData *data, NSError *error, BOOL finished) {
+        XCTAssertNil(error);
+        XCTAssertEqualObjects(data, imageData);
+        CGImageRef imageRef = image.CGImage;
+        XCTAssertTrue(imageRef != NULL);
+        size_t pixelCount = CGImageGetWidth(imageRef) * CGImageGetHeight(imageRef);
+        XCTAssertGreaterThan(pixelCount, 0u);
+        XCTAssertLessThanOrEqual(pixelCount, 1000 * 1000u);
+        // Square, as the source
+        XCTAssertEqual(CGImageGetWidth(imageRef), CGImageGetHeight(imageRef));
+        [downsampled fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:20 handler:nil];
+    XCTAssertEqual(server.bodyBytesSent, imageData.length);
+}
+
+@end
@@ -0,0 +1,554 @@
+/*
+ * This file is part of the SDWebImage package.
+ * (c) Olivier Poitrey <rs@dailymotion.com>
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+// Tests of the GIF decoder on a corpus of GIF files written here, each frame compared with a reference compositor,
+// run by SDWebImageCTests. Without Xcode, from this directory (add -fsanitize=address to catch out of bounds reads):
+//   gcc -std=c99 -DSD_TESTS_MAIN -I../EMCustomKeyBoardDemo/SDWebImage SDWebImageGIFDecoderTests.c ../EMCustomKeyBoardDemo/SDWebImage/SDWebImageGIFDecoder.c && ./a.out
+//GIF解码器测试：在这里生成GIF文件，每一帧与参考合成结果逐像素比较
+
+#include "SDWebImageGIFDecoderTests.h"
+#include "SDWebImageGIFDecoder.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int SDGIFDecoderFailures;
+
+#define SDGIFExpect(condition, ...) do { \
+    if (!(condition)) { \
+        SDGIFDecoderFailures++; \
+        fprintf(stderr, "%s:%d: ", __FILE__, __LINE__); \
+        fprintf(stderr, __VA_ARGS__); \
+        fprintf(stderr, "\n"); \
+    } \
+} while (0)
+
+// MARK: - Corpus
+
+typedef struct {
+    uint32_t x, y, width, height;
+    int disposal;
+    int transparentIndex;   // -1 for none
+    uint32_t delay;
+    int interlaced;
+    int localColorCount;    // a power of two, 0 to use the global palette
+    uint8_t *indexes;       // in row order, whether interlaced or not
+} SDGIFTestFrame;
+
+typedef struct {
+    const char *name;
+    uint32_t width, height;
+    int globalColorCount;   // a power of two, 0 for none
+    int loopCount;          // -1 for no NETSCAPE2.0 extension
+    SDGIFTestFrame frames[8];
+    size_t frameCount;
+} SDGIFTestImage;
+
+// The colors of the global palette (seed 0) and of the local palette of each frame
+static void SDGIFTestColor(int seed, int index, uint8_t rgb[3]) {
+    rgb[0] = (uint8_t)(index * 37 + seed * 101 + 11);
+    rgb[1] = (uint8_t)(index * 91 + seed * 53 + 7);
+    rgb[2] = (uint8_t)(index * 151 + seed * 29 + 3);
+}
+
+static uint8_t *SDGIFTestIndexes(size_t count, int colorCount, int pattern) {
+    uint8_t *indexes = malloc(count ? count : 1);
+    for (size_t i = 0; i < count; i++) {
+        // Noise, or runs that exercise the strings defined by the code being read (KwKwK)
+        indexes[i] = (uint8_t)(pattern ? (i / (size_t)pattern) % (size_t)colorCount : (size_t)rand() % (size_t)colorCount);
+    }
+    return indexes;
+}
+
+static int SDGIFMinCodeSize(int colorCount) {
+    int size = 2;
+    while ((1 << size) < colorCount) {
+        size++;
+    }
+    return size;
+}
+
+static int SDGIFPaletteBits(int colorCount) {
+    int bits = 1;
+    while ((1 << bits) < colorCount) {
+        bits++;
+    }
+    return bits;
+}
+
+// MARK: - Writer
+
+typedef struct {
+    uint8_t *bytes;
+    size_t length;
+    size_t capacity;
+} SDGIFTestBuffer;
+
+static void SDGIFPut(SDGIFTestBuffer *buffer, const void *bytes, size_t length) {
+    if (buffer->length + length > buffer->capacity) {
+        buffer->capacity = (buffer->length + length) * 2;
+        buffer->bytes = realloc(buffer->bytes, buffer->capacity);
+    }
+    memcpy(buffer->bytes + buffer->length, bytes, length);
+    buffer->length += length;
+}
+
+static void SDGIFPutByte(SDGIFTestBuffer *buffer, uint32_t byte) {
+    uint8_t value = (uint8_t)byte;
+    SDGIFPut(buffer, &value, 1);
+}
+
+static void SDGIFPutUInt16(SDGIFTestBuffer *buffer, uint32_t value) {
+    SDGIFPutByte(buffer, value & 0xff);
+    SDGIFPutByte(buffer, value >> 8);
+}
+
+static void SDGIFPutPalette(SDGIFTestBuffer *buffer, int seed, int colorCount) {
+    for (int i = 0; i < colorCount; i++) {
+        uint8_t rgb[3];
+        SDGIFTestColor(seed, i, rgb);
+        SDGIFPut(buffer, rgb, 3);
+    }
+}
+
+typedef struct {
+    SDGIFTestBuffer *codes;
+    uint32_t bits;
+    int bitCount;
+} SDGIFBitWriter;
+
+static void SDGIFPutCode(SDGIFBitWriter *writer, int code, int codeSize) {
+    writer->bits |= (uint32_t)code << writer->bitCount;
+    writer->bitCount += codeSize;
+    while (writer->bitCount >= 8) {
+        SDGIFPutByte(writer->codes, writer->bits & 0xff);
+        writer->bits >>= 8;
+        writer->bitCount -= 8;
+    }
+}
+
+// A plain LZW encoder: a clear code first, and again whenever the table is full
+static void SDGIFPutLZW(SDGIFTestBuffer *buffer, int minCodeSize, const uint8_t *indexes, size_t count) {
+    static int16_t table[4096][256];
+    SDGIFTestBuffer codes = {0};
+    SDGIFBitWriter writer = {&codes, 0, 0};
+    int clearCode = 1 << minCodeSize;
+    int codeSize = minCodeSize + 1;
+    int nextCode = clearCode + 2;
+    memset(table, 0, sizeof(table));
+    SDGIFPutCode(&writer, clearCode, codeSize);
+    if (count > 0) {
+        int prefix = indexes[0];
+        for (size_t i = 1; i < count; i++) {
+            int index = indexes[i];
+            if (table[prefix][index]) {
+                prefix = table[prefix][index];
+                continue;
+            }
+            SDGIFPutCode(&writer, prefix, codeSize);
+            if (nextCode < 4096) {
+                table[prefix][index] = (int16_t)nextCode++;
+                // The decoder defines each code one code later, so it widens its codes one code later as well
+                if (nextCode > (1 << codeSize) && codeSize < 12) {
+                    codeSize++;
+                }
+            }
+            else {
+                SDGIFPutCode(&writer, clearCode, codeSize);
+                memset(table, 0, sizeof(table));
+                codeSize = minCodeSize + 1;
+                nextCode = clearCode + 2;
+            }
+            prefix = index;
+        }
+        SDGIFPutCode(&writer, prefix, codeSize);
+    }
+    SDGIFPutCode(&writer, clearCode + 1, codeSize);
+    if (writer.bitCount > 0) {
+        SDGIFPutByte(&codes, writer.bits & 0xff);
+    }
+
+    SDGIFPutByte(buffer, (uint32_t)minCodeSize);
+    for (size_t offset = 0; offset < codes.length; offset += 255) {
+        size_t length = codes.length - offset < 255 ? codes.length - offset : 255;
+        SDGIFPutByte(buffer, (uint32_t)length);
+        SDGIFPut(buffer, codes.bytes + offset, length);
+    }
+    SDGIFPutByte(buffer, 0);
+    free(codes.bytes);
+}
+
+static SDGIFTestBuffer SDGIFWriteImage(const SDGIFTestImage *image) {
+    SDGIFTestBuffer buffer = {0};
+    SDGIFPut(&buffer, "GIF89a", 6);
+    SDGIFPutUInt16(&buffer, image->width);
+    SDGIFPutUInt16(&buffer, image->height);
+    SDGIFPutByte(&buffer, image->globalColorCount ? 0x80 | (uint32_t)(SDGIFPaletteBits(image->globalColorCount) - 1) : 0);
+    SDGIFPutByte(&buffer, 0);
+    SDGIFPutByte(&buffer, 0);
+    SDGIFPutPalette(&buffer, 0, image->globalColorCount);
+    if (image->loopCount >= 0) {
+        SDGIFPut(&buffer, "\x21\xff\x0bNETSCAPE2.0\x03\x01", 16);
+        SDGIFPutUInt16(&buffer, (uint32_t)image->loopCount);
+        SDGIFPutByte(&buffer, 0);
+    }
+    for (size_t f = 0; f < image->frameCount; f++) {
+        const SDGIFTestFrame *frame = &image->frames[f];
+        int colorCount = frame->localColorCount ? frame->localColorCount : image->globalColorCount;
+        SDGIFPut(&buffer, "\x21\xf9\x04", 3);
+        SDGIFPutByte(&buffer, (uint32_t)(frame->disposal << 2) | (frame->transparentIndex >= 0));
+        SDGIFPutUInt16(&buffer, frame->delay);
+        SDGIFPutByte(&buffer, frame->transparentIndex >= 0 ? (uint32_t)frame->transparentIndex : 0);
+        SDGIFPutByte(&buffer, 0);
+
+        SDGIFPutByte(&buffer, 0x2c);
+        SDGIFPutUInt16(&buffer, frame->x);
+        SDGIFPutUInt16(&buffer, frame->y);
+        SDGIFPutUInt16(&buffer, frame->width);
+        SDGIFPutUInt16(&buffer, frame->height);
+        SDGIFPutByte(&buffer, (frame->localColorCount ? 0x80 | (uint32_t)(SDGIFPaletteBits(frame->localColorCount) - 1) : 0) | (frame->interlaced ? 0x40 : 0));
+        SDGIFPutPalette(&buffer, (int)f + 1, frame->localColorCount);
+
+        // Interlaced rows are written every 8th from 0, every 8th from 4, every 4th from 2, every 2nd from 1
+        size_t count = (size_t)frame->width * frame->height;
+        uint8_t *indexes = malloc(count ? count : 1);
+        if (frame->interlaced) {
+            static const uint32_t starts[] = {0, 4, 2, 1}, steps[] = {8, 8, 4, 2};
+            size_t written = 0;
+            for (int pass = 0; pass < 4; pass++) {
+                for (uint32_t row = starts[pass]; row < frame->height; row += steps[pass]) {
+                    memcpy(indexes + written * frame->width, frame->indexes + (size_t)row * frame->width, frame->width);
+                    written++;
+                }
+            }
+        }
+        else {
+            memcpy(indexes, frame->indexes, count);
+        }
+        SDGIFPutLZW(&buffer, SDGIFMinCodeSize(colorCount), indexes, count);
+        free(indexes);
+    }
+    SDGIFPutByte(&buffer, 0x3b);
+    return buffer;
+}
+
+// MARK: - Reference
+
+static uint32_t SDGIFReferenceColor(const SDGIFTestImage *image, size_t f, int index) {
+    const SDGIFTestFrame *frame = &image->frames[f];
+    int colorCount = frame->localColorCount ? frame->localColorCount : image->globalColorCount;
+    if (index >= colorCount) {
+        return 0xff000000u;
+    }
+    uint8_t rgb[3];
+    SDGIFTestColor(frame->localColorCount ? (int)f + 1 : 0, index, rgb);
+    return 0xff000000u | ((uint32_t)rgb[0] << 16) | ((uint32_t)rgb[1] << 8) | rgb[2];
+}
+
+// The canvas after each frame, straight from the GIF89a definitions of the disposal methods
+static uint32_t **SDGIFReferenceCanvases(const SDGIFTestImage *image) {
+    size_t pixels = (size_t)image->width * image->height;
+    uint32_t **canvases = calloc(image->frameCount, sizeof(uint32_t *));
+    uint32_t *canvas = calloc(pixels, 4);
+    uint32_t *previous = malloc(pixels * 4);
+    for (size_t f = 0; f < image->frameCount; f++) {
+        const SDGIFTestFrame *frame = &image->frames[f];
+        if (f > 0) {
+            const SDGIFTestFrame *last = &image->frames[f - 1];
+            for (uint32_t y = last->y; y < last->y + last->height && y < image->height; y++) {
+                for (uint32_t x = last->x; x < last->x + last->width && x < image->width; x++) {
+                    if (last->disposal == 2) {
+                        canvas[y * image->width + x] = 0;
+                    }
+                    else if (last->disposal == 3) {
+                        canvas[y * image->width + x] = previous[y * image->width + x];
+                    }
+                }
+            }
+        }
+        memcpy(previous, canvas, pixels * 4);
+        for (uint32_t y = 0; y < frame->height; y++) {
+            for (uint32_t x = 0; x < frame->width; x++) {
+                int index = frame->indexes[(size_t)y * frame->width + x];
+                if (frame->x + x < image->width && frame->y + y < image->height && index != frame->transparentIndex) {
+                    canvas[(frame->y + y) * image->width + frame->x + x] = SDGIFReferenceColor(image, f, index);
+                }
+            }
+        }
+        canvases[f] = malloc(pixels * 4);
+        memcpy(canvases[f], canvas, pixels * 4);
+    }
+    free(canvas);
+    free(previous);
+    return canvases;
+}
+
+// MARK: - Tests
+
+static void SDGIFExpectFrame(const SDGIFTestImage *image, const char *mode, SDGIFDecoder *decoder, const SDGIFFrameInfo *info, size_t f, uint32_t **canvases) {
+    if (f >= image->frameCount) {
+        SDGIFExpect(0, "%s (%s): decoded frame %zu of %zu", image->name, mode, f, image->frameCount);
+        return;
+    }
+    const SDGIFTestFrame *frame = &image->frames[f];
+    SDGIFExpect(info->index == f, "%s (%s): frame %zu has index %zu", image->name, mode, f, info->index);
+    SDGIFExpect(info->delayCentiseconds == frame->delay && info->disposal == frame->disposal && info->transparent == (frame->transparentIndex >= 0),
+                "%s (%s): frame %zu has delay %u, disposal %d, transparent %d", image->name, mode, f, info->delayCentiseconds, info->disposal, info->transparent);
+    SDGIFExpect(info->x == frame->x && info->y == frame->y && info->width == frame->width && info->height == frame->height,
+                "%s (%s): frame %zu has the rectangle %u,%u %ux%u", image->name, mode, f, info->x, info->y, info->width, info->height);
+    SDGIFExpect(SDGIFDecoderGetWidth(decoder) == image->width && SDGIFDecoderGetHeight(decoder) == image->height,
+                "%s (%s): the canvas is %zux%zu", image->name, mode, SDGIFDecoderGetWidth(decoder), SDGIFDecoderGetHeight(decoder));
+    const uint32_t *canvas = (const uint32_t *)(const void *)SDGIFDecoderGetCanvas(decoder);
+    size_t pixels = (size_t)image->width * image->height;
+    for (size_t i = 0; canvas && i < pixels; i++) {
+        if (canvas[i] != canvases[f][i]) {
+            SDGIFExpect(0, "%s (%s): frame %zu pixel %zu,%zu is %08x, expected %08x", image->name, mode, f, i % image->width, i / image->width, canvas[i], canvases[f][i]);
+            return;
+        }
+    }
+}
+
+// Passes the data as it would arrive in chunks of `chunkLength` bytes (0 for all at once), then decodes the
+// whole data again after a rewind
+static void SDGIFExpectDecodes(const SDGIFTestImage *image, const SDGIFTestBuffer *gif, uint32_t **canvases, size_t chunkLength) {
+    char mode[32];
+    snprintf(mode, sizeof(mode), "chunks of %zu", chunkLength);
+    SDGIFDecoder *decoder = SDGIFDecoderCreate();
+    size_t received = chunkLength ? 0 : gif->length;
+    size_t f = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        for (;;) {
+            int final = received >= gif->length;
+            SDGIFDecoderSetData(decoder, gif->bytes, received, final);
+            SDGIFFrameInfo info;
+            SDGIFDecoderStatus status = SDGIFDecoderDecodeFrame(decoder, &info);
+            if (status == SDGIFDecoderStatusNeedsData) {
+                SDGIFExpect(!final, "%s (%s): needs data after the final data", image->name, mode);
+                if (final) {
+                    break;
+                }
+                received = received + chunkLength < gif->length ? received + chunkLength : gif->length;
+            }
+            else if (status == SDGIFDecoderStatusFrame) {
+                SDGIFExpectFrame(image, mode, decoder, &info, f++, canvases);
+            }
+            else {
+                SDGIFExpect(status == SDGIFDecoderStatusFinished, "%s (%s): error after %zu frames", image->name, mode, f);
+                break;
+            }
+        }
+        SDGIFExpect(f == image->frameCount, "%s (%s): %zu frames instead of %zu", image->name, mode, f, image->frameCount);
+        SDGIFExpect(SDGIFDecoderGetLoopCount(decoder) == image->loopCount, "%s (%s): loop count %d", image->name, mode, SDGIFDecoderGetLoopCount(decoder));
+        SDGIFDecoderRewind(decoder);
+        snprintf(mode, sizeof(mode), "rewound");
+        f = 0;
+    }
+    SDGIFDecoderDestroy(decoder);
+}
+
+// Decodes the first `length` bytes as the final data
+static size_t SDGIFDecodeTruncated(const SDGIFTestBuffer *gif, size_t length, SDGIFDecoderStatus *lastStatus, SDGIFDecoder **decoderOut) {
+    SDGIFDecoder *decoder = SDGIFDecoderCreate();
+    // A copy, so that a read past the truncated length is caught by the address sanitizer
+    uint8_t *bytes = malloc(length ? length : 1);
+    memcpy(bytes, gif->bytes, length);
+    SDGIFDecoderSetData(decoder, bytes, length, 1);
+    size_t frames = 0;
+    SDGIFDecoderStatus status;
+    while ((status = SDGIFDecoderDecodeFrame(decoder, NULL)) == SDGIFDecoderStatusFrame && frames < 100) {
+        frames++;
+    }
+    *lastStatus = status;
+    free(bytes);
+    if (decoderOut) {
+        *decoderOut = decoder;
+    }
+    else {
+        SDGIFDecoderDestroy(decoder);
+    }
+    return frames;
+}
+
+static void SDTestCorpus(void) {
+    SDGIFTestImage images[5];
+    memset(images, 0, sizeof(images));
+
+    images[0].name = "static";
+    images[0].width = 7;
+    images[0].height = 5;
+    images[0].globalColorCount = 4;
+    images[0].loopCount = -1;
+    images[0].frameCount = 1;
+    images[0].frames[0] = (SDGIFTestFrame){0, 0, 7, 5, 0, -1, 0, 0, 0, NULL};
+
+    // Every disposal, transparency, clipping, a frame outside the canvas, local palettes, interlacing, and rectangles
+    // saved for restore to previous that grow
+    images[1].name = "animated";
+    images[1].width = 16;
+    images[1].height = 12;
+    images[1].globalColorCount = 16;
+    images[1].loopCount = 3;
+    images[1].frameCount = 8;
+    images[1].frames[0] = (SDGIFTestFrame){0, 0, 16, 12, 1, -1, 10, 0, 0, NULL};
+    images[1].frames[1] = (SDGIFTestFrame){3, 2, 5, 4, 2, 3, 20, 0, 0, NULL};
+    images[1].frames[2] = (SDGIFTestFrame){8, 6, 10, 10, 3, 1, 5, 0, 4, NULL};
+    images[1].frames[3] = (SDGIFTestFrame){1, 1, 4, 3, 3, -1, 7, 0, 0, NULL};
+    images[1].frames[4] = (SDGIFTestFrame){0, 0, 16, 12, 3, 0, 8, 1, 0, NULL};
+    images[1].frames[5] = (SDGIFTestFrame){20, 20, 4, 4, 2, -1, 9, 0, 0, NULL};
+    images[1].frames[6] = (SDGIFTestFrame){2, 3, 7, 9, 0, 1, 6, 1, 2, NULL};
+    images[1].frames[7] = (SDGIFTestFrame){0, 0, 3, 2, 0, -1, 0, 0, 0, NULL};
+
+    // Noise fills the code table, which the encoder clears
+    images[2].name = "noise";
+    images[2].width = 200;
+    images[2].height = 150;
+    images[2].globalColorCount = 256;
+    images[2].loopCount = 0;
+    images[2].frameCount = 1;
+    images[2].frames[0] = (SDGIFTestFrame){0, 0, 200, 150, 0, -1, 0, 0, 0, NULL};
+
+    images[3].name = "runs";
+    images[3].width = 300;
+    images[3].height = 20;
+    images[3].globalColorCount = 2;
+    images[3].loopCount = -1;
+    images[3].frameCount = 2;
+    images[3].frames[0] = (SDGIFTestFrame){0, 0, 300, 20, 3, -1, 4, 1, 0, NULL};
+    images[3].frames[1] = (SDGIFTestFrame){10, 5, 290, 15, 0, 0, 4, 0, 0, NULL};
+
+    // No global palette, and a frame larger than the canvas
+    images[4].name = "local";
+    images[4].width = 9;
+    images[4].height = 9;
+    images[4].globalColorCount = 0;
+    images[4].loopCount = 1;
+    images[4].frameCount = 2;
+    images[4].frames[0] = (SDGIFTestFrame){0, 0, 9, 9, 2, -1, 3, 0, 8, NULL};
+    images[4].frames[1] = (SDGIFTestFrame){4, 4, 12, 12, 0, 5, 3, 1, 8, NULL};
+
+    static const int patterns[] = {0, 0, 0, 157, 3};
+    for (size_t i = 0; i < sizeof(images) / sizeof(images[0]); i++) {
+        SDGIFTestImage *image = &images[i];
+        for (size_t f = 0; f < image->frameCount; f++) {
+            SDGIFTestFrame *frame = &image->frames[f];
+            int colorCount = frame->localColorCount ? frame->localColorCount : image->globalColorCount;
+            frame->indexes = SDGIFTestIndexes((size_t)frame->width * frame->height, colorCount, f == 0 ? patterns[i] : 0);
+        }
+        SDGIFTestBuffer gif = SDGIFWriteImage(image);
+        uint32_t **canvases = SDGIFReferenceCanvases(image);
+
+        static const size_t chunkLengths[] = {0, 1, 7, 256};
+        for (size_t c = 0; c < sizeof(chunkLengths) / sizeof(chunkLengths[0]); c++) {
+            SDGIFExpectDecodes(image, &gif, canvases, chunkLengths[c]);
+        }
+
+        // Without the last block terminator and the trailer, the final data still composites the last frame whole
+        SDGIFDecoderStatus status;
+        SDGIFDecoder *decoder = NULL;
+        size_t frames = SDGIFDecodeTruncated(&gif, gif.length - 2, &status, &decoder);
+        SDGIFExpect(frames == image->frameCount && status == SDGIFDecoderStatusFinished, "%s: %zu frames without the trailer", image->name, frames);
+        size_t pixels = (size_t)image->width * image->height;
+        SDGIFExpect(memcmp(SDGIFDecoderGetCanvas(decoder), canvases[image->frameCount - 1], pixels * 4) == 0, "%s: the last frame differs without the trailer", image->name);
+        SDGIFDecoderDestroy(decoder);
+
+        // Cut anywhere, the final data ends the animation without reading past it
+        for (size_t length = 0; length < gif.length; length += 1 + length / 16) {
+            frames = SDGIFDecodeTruncated(&gif, length, &status, NULL);
+            SDGIFExpect(frames <= image->frameCount && (status == SDGIFDecoderStatusFinished || (frames == 0 && status == SDGIFDecoderStatusError)),
+                        "%s: status %d after %zu frames when cut at %zu", image->name, status, frames, length);
+        }
+
+        // Corrupted LZW data keeps what was decoded and never reads out of bounds
+        for (size_t offset = 40; offset < gif.length - 1; offset += 23) {
+            uint8_t saved = gif.bytes[offset];
+            gif.bytes[offset] ^= 0xa5;
+            frames = SDGIFDecodeTruncated(&gif, gif.length, &status, NULL);
+            SDGIFExpect(frames <= image->frameCount + 1, "%s: %zu frames when corrupted at %zu", image->name, frames, offset);
+            gif.bytes[offset] = saved;
+        }
+
+        for (size_t f = 0; f < image->frameCount; f++) {
+            free(canvases[f]);
+            free(image->frames[f].indexes);
+        }
+        free(canvases);
+        free(gif.bytes);
+    }
+}
+
+static void SDTestTransparentPixel(void) {
+    // The 1x1 transparent GIF of countless web pages, from another encoder
+    static const uint8_t pixel[] = "GIF89a\x01\x00\x01\x00\x80\x00\x00\x00\x00\x00\xff\xff\xff!\xf9\x04\x01\x00\x00\x00\x00,\x00\x00\x00\x00\x01\x00\x01\x00\x00\x02\x02" "D\x01\x00;";
+    SDGIFDecoder *decoder = SDGIFDecoderCreate();
+    SDGIFDecoderSetData(decoder, pixel, sizeof(pixel) - 1, 1);
+    SDGIFFrameInfo info;
+    SDGIFExpect(SDGIFDecoderDecodeFrame(decoder, &info) == SDGIFDecoderStatusFrame, "transparent pixel: no frame");
+    SDGIFExpect(info.transparent && info.width == 1 && info.height == 1, "transparent pixel: frame info");
+    uint32_t canvas;
+    memcpy(&canvas, SDGIFDecoderGetCanvas(decoder), 4);
+    SDGIFExpect(canvas == 0, "transparent pixel: %08x", canvas);
+    SDGIFExpect(SDGIFDecoderDecodeFrame(decoder, &info) == SDGIFDecoderStatusFinished, "transparent pixel: not finished");
+    SDGIFExpect(SDGIFDecoderGetLoopCount(decoder) == -1, "transparent pixel: loop count");
+    SDGIFDecoderDestroy(decoder);
+
+    static const uint8_t png[] = "\x89PNG\r\n\x1a\n\0\0\0\rIHDR";
+    decoder = SDGIFDecoderCreate();
+    SDGIFDecoderSetData(decoder, png, sizeof(png) - 1, 1);
+    SDGIFExpect(SDGIFDecoderDecodeFrame(decoder, &info) == SDGIFDecoderStatusError, "PNG: decoded as a GIF");
+    SDGIFDecoderDestroy(decoder);
+}
+
+static void SDTestExpandPaletteRow(void) {
+    uint32_t palette[256];
+    for (int i = 0; i < 256; i++) {
+        palette[i] = 0xff000000u | (uint32_t)rand();
+    }
+    static const int transparentIndexes[] = {-1, 0, 7, 255};
+    // Any index, indexes below 16 for the table lookups, and blocks of 16 pixels alternating between both
+    static const char *ranges[] = {"any", "small", "mixed"};
+    uint8_t indexes[67];
+    uint32_t dst[67 + 4], expected[67];
+    for (size_t t = 0; t < sizeof(transparentIndexes) / sizeof(transparentIndexes[0]); t++) {
+        for (int range = 0; range < 3; range++) {
+            for (size_t count = 0; count <= 67; count++) {
+                for (size_t i = 0; i < count; i++) {
+                    int small = range == 1 || (range == 2 && (i / 16) % 2 == 0);
+                    indexes[i] = (uint8_t)(rand() % 9 == 0 ? transparentIndexes[t] : small ? rand() % 16 : rand());
+                }
+                for (size_t i = 0; i < 67 + 4; i++) {
+                    dst[i] = 0xcdcdcdcdu;
+                }
+                for (size_t i = 0; i < count; i++) {
+                    expected[i] = indexes[i] == transparentIndexes[t] ? 0xcdcdcdcdu : palette[indexes[i]];
+                }
+                SDGIFExpandPaletteRow(indexes, count, palette, transparentIndexes[t], dst);
+                SDGIFExpect(memcmp(dst, expected, count * 4) == 0, "SDGIFExpandPaletteRow(%zu %s pixels, transparent %d) differs", count, ranges[range], transparentIndexes[t]);
+                for (size_t i = count; i < 67 + 4; i++) {
+                    SDGIFExpect(dst[i] == 0xcdcdcdcdu, "SDGIFExpandPaletteRow(%zu pixels): wrote past the end at %zu", count, i);
+                }
+            }
+        }
+    }
+}
+
+int SDGIFDecoderRunTests(void) {
+    SDGIFDecoderFailures = 0;
+    srand(42);
+    SDTestCorpus();
+    SDTestTransparentPixel();
+    SDTestExpandPaletteRow();
+    return SDGIFDecoderFailures;
+}
+
+#ifdef SD_TESTS_MAIN
+int main(void) {
+    int failures = SDGIFDecoderRunTests();
+    printf("%d failure(s)\n", failures);
+    return failures == 0 ? 0 : 1;
+}
+#endif
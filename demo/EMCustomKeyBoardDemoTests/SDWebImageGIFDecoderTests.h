@@ -0,0 +1,27 @@
+/*
+ * This file is part of the SDWebImage package.
+ * (c) Olivier Poitrey <rs@dailymotion.com>
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef SDWebImageGIFDecoderTests_h
+#define SDWebImageGIFDecoderTests_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Runs the tests of `SDWebImageGIFDecoder` on a corpus of GIF files, printing each failure to stderr.
+ *
+ * @return The number of failed checks
+ */
+extern int SDGIFDecoderRunTests(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SDWebImageGIFDecoderTests_h */
@@ -0,0 +1,196 @@
+/*
+ * This file is part of the SDWebImage package.
+ * (c) Olivier Poitrey <rs@dailymotion.com>
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#import <XCTest/XCTest.h>
+#import "SDTestHTTPServer.h"
+#import "SDWebImageManager.h"
+
+@interface SDWebImageManagerTests : XCTestCase
+
+@property (strong, nonatomic) NSData *imageData;
+@property (strong, nonatomic) SDImageCache *imageCache;
+@property (strong, nonatomic) SDWebImageManager *manager;
+
+@end
+
+@implementation SDWebImageManagerTests
+
+- (void)setUp {
+    [super setUp];
+    self.imageData = SDTestPNGImageData(8, 8, NO);
+    self.imageCache = [[SDImageCache alloc] initWithNamespace:@"SDWebImageManagerTests"];
+    self.manager = [[SDWebImageManager alloc] initWithCache:self.imageCache downloader:[SDWebImageDownloader new]];
+    // Short backoffs, the tests only check how many requests are made
+    self.manager.retryBaseDelay = 0.05;
+    self.manager.retryMaxDelay = 0.2;
+}
+
+- (void)tearDown {
+    [self.imageCache clearMemory];
+    [self.imageCache clearDisk];
+    self.manager = nil;
+    self.imageCache = nil;
+    [super tearDown];
+}
+
+// Answers each request with the status code at its index, the last one for the following requests. 200 sends the image
+- (SDTestHTTPServer *)startedServerWithStatusCodes:(NSArray *)statusCodes {
+    NSData *imageData = self.imageData;
+    SDTestHTTPServer *server = [[SDTestHTTPServer alloc] initWithHandler:^SDTestHTTPResponse *(SDTestHTTPRequest *request) {
+        NSInteger statusCode = [statusCodes[MIN(request.index, statusCodes.count - 1)] integerValue];
+        return [SDTestHTTPResponse responseWithStatusCode:statusCode body:statusCode == 200 ? imageData : nil];
+    }];
+    XCTAssertTrue([server start]);
+    return server;
+}
+
+- (void)loadURL:(NSURL *)url options:(SDWebImageOptions)options expectImage:(BOOL)expectImage errorCode:(NSInteger)errorCode {
+    XCTestExpectation *expectation = [self expectationWithDescription:url.absoluteString];
+    [self.manager downloadImageWithURL:url options:options progress:nil completed:^(UIImage *image, NSError *error, SDImageCacheType cacheType, BOOL finished, NSURL *imageURL) {
+        if (expectImage) {
+            XCTAssertNotNil(image);
+            XCTAssertNil(error);
+        }
+        else {
+            XCTAssertNil(image);
+            XCTAssertEqual(error.code, errorCode);
+        }
+        [expectation fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+}
+
+- (void)testTransientErrorIsRetried {
+    SDTestHTTPServer *server = [self startedServerWithStatusCodes:@[@503, @429, @200]];
+    self.manager.maxRetryCount = 2;
+    [self loadURL:[server URLForPath:@"/retried.png"] options:0 expectImage:YES errorCode:0];
+    XCTAssertEqual(server.requestCount, 3u);
+}
+
+- (void)testRetriesAreBoundedThenTheURLIsBlacklisted {
+    SDTestHTTPServer *server = [self startedServerWithStatusCodes:@[@500]];
+    self.manager.maxRetryCount = 2;
+    NSURL *url = [server URLForPath:@"/failing.png"];
+    [self loadURL:url options:0 expectImage:NO errorCode:500];
+    XCTAssertEqual(server.requestCount, 3u);
+
+    // Refused without a request
+    [self loadURL:url options:0 expectImage:NO errorCode:NSURLErrorFileDoesNotExist];
+    XCTAssertEqual(server.requestCount, 3u);
+}
+
+- (void)testPermanentErrorIsNotRetried {
+    SDTestHTTPServer *server = [self startedServerWithStatusCodes:@[@404, @200]];
+    self.manager.maxRetryCount = 2;
+    NSURL *url = [server URLForPath:@"/missing.png"];
+    [self loadURL:url options:0 expectImage:NO errorCode:404];
+    XCTAssertEqual(server.requestCount, 1u);
+
+    [self loadURL:url options:0 expectImage:NO errorCode:NSURLErrorFileDoesNotExist];
+    XCTAssertEqual(server.requestCount, 1u);
+}
+
+- (void)testRetryFailedDownloadsABlacklistedURL {
+    SDTestHTTPServer *server = [self startedServerWithStatusCodes:@[@404, @200]];
+    NSURL *url = [server URLForPath:@"/missing.png"];
+    [self loadURL:url options:0 expectImage:NO errorCode:404];
+    [self loadURL:url options:SDWebImageRetryFailed expectImage:YES errorCode:0];
+    XCTAssertEqual(server.requestCount, 2u);
+
+    // The success lifted the blacklisting
+    [self.imageCache clearMemory];
+    [self.imageCache clearDisk];
+    [self loadURL:url options:0 expectImage:YES errorCode:0];
+    XCTAssertEqual(server.requestCount, 3u);
+}
+
+- (void)testBlacklistingExpires {
+    SDTestHTTPServer *server = [self startedServerWithStatusCodes:@[@404, @200]];
+    self.manager.failedURLTimeToLive = 0.3;
+    NSURL *url = [server URLForPath:@"/missing.png"];
+    [self loadURL:url options:0 expectImage:NO errorCode:404];
+    [self loadURL:url options:0 expectImage:NO errorCode:NSURLErrorFileDoesNotExist];
+    XCTAssertEqual(server.requestCount, 1u);
+
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.5]];
+    [self loadURL:url options:0 expectImage:YES errorCode:0];
+    XCTAssertEqual(server.requestCount, 2u);
+}
+
+- (void)testLeastRecentlyFailedURLIsEvicted {
+    SDTestHTTPServer *server = [self startedServerWithStatusCodes:@[@404, @404, @200]];
+    self.manager.maxFailedURLCount = 1;
+    NSURL *firstURL = [server URLForPath:@"/first.png"];
+    NSURL *secondURL = [server URLForPath:@"/second.png"];
+    [self loadURL:firstURL options:0 expectImage:NO errorCode:404];
+    [self loadURL:secondURL options:0 expectImage:NO errorCode:404];
+
+    [self loadURL:secondURL options:0 expectImage:NO errorCode:NSURLErrorFileDoesNotExist];
+    XCTAssertEqual(server.requestCount, 2u);
+    [self loadURL:firstURL options:0 expectImage:YES errorCode:0];
+    XCTAssertEqual(server.requestCount, 3u);
+}
+
+- (void)testCacheHitClearsTheBlacklisting {
+    SDTestHTTPServer *server = [self startedServerWithStatusCodes:@[@404, @200]];
+    NSURL *url = [server URLForPath:@"/cached.png"];
+    [self loadURL:url options:0 expectImage:NO errorCode:404];
+
+    // Another source put the image in the cache: the blacklisted URL is served from it
+    [self.manager saveImageToCache:[UIImage imageWithData:self.imageData] forURL:url];
+    [self loadURL:url options:0 expectImage:YES errorCode:0];
+    XCTAssertEqual(server.requestCount, 1u);
+
+    // Evicted, it is downloaded again
+    [self.imageCache clearMemory];
+    [self.imageCache clearDisk];
+    [self loadURL:url options:0 expectImage:YES errorCode:0];
+    XCTAssertEqual(server.requestCount, 2u);
+}
+
+- (void)testServerErrorIsNotBlacklistedOnceAnotherLoadSucceeded {
+    // The first load fails, the second one succeeds while the first one waits for its retry, which fails again
+    NSData *imageData = self.imageData;
+    SDTestHTTPServer *server = [[SDTestHTTPServer alloc] initWithHandler:^SDTestHTTPResponse *(SDTestHTTPRequest *request) {
+        if (request.index == 1) {
+            return [SDTestHTTPResponse responseWithStatusCode:200 body:imageData];
+        }
+        return [SDTestHTTPResponse responseWithStatusCode:500 body:nil];
+    }];
+    XCTAssertTrue([server start]);
+    self.manager.maxRetryCount = 1;
+    self.manager.retryBaseDelay = 1.0;
+    self.manager.retryMaxDelay = 1.0;
+    NSURL *url = [server URLForPath:@"/shared.png"];
+
+    XCTestExpectation *failed = [self expectationWithDescription:@"failed"];
+    [self.manager downloadImageWithURL:url options:0 progress:nil completed:^(UIImage *image, NSError *error, SDImageCacheType cacheType, BOOL finished, NSURL *imageURL) {
+        XCTAssertEqual(error.code, 500);
+        [failed fulfill];
+    }];
+    NSDate *deadline = [NSDate dateWithTimeIntervalSinceNow:5];
+    while (server.requestCount == 0 && [deadline timeIntervalSinceNow] > 0) {
+        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.02]];
+    }
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.1]];
+    XCTestExpectation *succeeded = [self expectationWithDescription:@"succeeded"];
+    [self.manager downloadImageWithURL:url options:0 progress:nil completed:^(UIImage *image, NSError *error, SDImageCacheType cacheType, BOOL finished, NSURL *imageURL) {
+        XCTAssertNotNil(image);
+        [succeeded fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+    XCTAssertEqual(server.requestCount, 3u);
+
+    // Not blacklisted: downloaded again once evicted from the cache
+    [self.imageCache clearMemory];
+    [self.imageCache clearDisk];
+    [self loadURL:url options:0 expectImage:NO errorCode:500];
+    XCTAssertEqual(server.requestCount, 5u);
+}
+
+@end
@@ -0,0 +1,233 @@
+/*
+ * This file is part of the SDWebImage package.
+ * (c) Olivier Poitrey <rs@dailymotion.com>
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+// Byte exact tests of the pixel kernels against scalar references, run by SDWebImageCTests. Without Xcode, from this
+// directory (add -mssse3 on Intel to test the SSSE3 shuffles as well):
+//   gcc -std=c99 -DSD_TESTS_MAIN -I../EMCustomKeyBoardDemo/SDWebImage SDWebImagePixelKernelsTests.c ../EMCustomKeyBoardDemo/SDWebImage/SDWebImagePixelKernels.c -lpthread && ./a.out
+//像素转换函数的逐字节测试，与标量参考实现比较
+
+#include "SDWebImagePixelKernelsTests.h"
+#include "SDWebImagePixelKernels.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int SDPixelKernelsFailures;
+
+#define SDPixelExpect(condition, ...) do { \
+    if (!(condition)) { \
+        SDPixelKernelsFailures++; \
+        fprintf(stderr, "%s:%d: ", __FILE__, __LINE__); \
+        fprintf(stderr, __VA_ARGS__); \
+        fprintf(stderr, "\n"); \
+    } \
+} while (0)
+
+// Pixel counts covering the vector loops, their tails, and the SSSE3 margin of the RGB kernel
+static const size_t SDPixelCounts[] = {0, 1, 3, 4, 5, 6, 7, 15, 16, 17, 31, 33, 64, 67};
+#define SD_PIXEL_COUNT_COUNT (sizeof(SDPixelCounts) / sizeof(SDPixelCounts[0]))
+
+// round(x * y / 255), the definition SDPixelMultiply must match
+static uint8_t SDReferenceMultiply(uint32_t x, uint32_t y) {
+    return (uint8_t)((x * y * 2 + 255) / 510);
+}
+
+static void SDFillRandom(uint8_t *bytes, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        bytes[i] = (uint8_t)(rand() & 0xff);
+    }
+}
+
+// Compares the converted bytes and checks that the kernel wrote nothing past them
+static void SDExpectBytes(const char *name, size_t count, const uint8_t *actual, const uint8_t *expected, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        if (actual[i] != expected[i]) {
+            SDPixelExpect(0, "%s(%zu pixels): byte %zu is %u, expected %u", name, count, i, actual[i], expected[i]);
+            return;
+        }
+    }
+    for (size_t i = length; i < length + 16; i++) {
+        SDPixelExpect(actual[i] == 0xcd, "%s(%zu pixels): wrote past the end at byte %zu", name, count, i);
+    }
+}
+
+static void SDTestPremultiply(void) {
+    // Every color and alpha pair, 256 pixels per alpha
+    uint8_t src[256 * 4], dst[256 * 4 + 16], expected[256 * 4];
+    for (uint32_t alpha = 0; alpha < 256; alpha++) {
+        for (uint32_t color = 0; color < 256; color++) {
+            uint8_t *s = src + color * 4;
+            s[0] = (uint8_t)color;
+            s[1] = (uint8_t)(255 - color);
+            s[2] = (uint8_t)(color ^ 0x5a);
+            s[3] = (uint8_t)alpha;
+            for (int c = 0; c < 3; c++) {
+                expected[color * 4 + c] = SDReferenceMultiply(s[c], alpha);
+            }
+            expected[color * 4 + 3] = (uint8_t)alpha;
+        }
+        memset(dst, 0xcd, sizeof(dst));
+        SDPixelPremultiply(src, dst, 256);
+        SDExpectBytes("SDPixelPremultiply", 256, dst, expected, sizeof(expected));
+        // In place
+        memcpy(dst, src, sizeof(src));
+        SDPixelPremultiply(dst, dst, 256);
+        SDExpectBytes("SDPixelPremultiply in place", 256, dst, expected, sizeof(expected));
+    }
+
+    uint8_t random[67 * 4], randomDst[67 * 4 + 16], randomExpected[67 * 4], swappedExpected[67 * 4];
+    for (size_t n = 0; n < SD_PIXEL_COUNT_COUNT; n++) {
+        size_t count = SDPixelCounts[n];
+        SDFillRandom(random, sizeof(random));
+        for (size_t i = 0; i < count; i++) {
+            const uint8_t *s = random + i * 4;
+            for (int c = 0; c < 3; c++) {
+                randomExpected[i * 4 + c] = SDReferenceMultiply(s[c], s[3]);
+            }
+            randomExpected[i * 4 + 3] = s[3];
+            swappedExpected[i * 4 + 0] = randomExpected[i * 4 + 2];
+            swappedExpected[i * 4 + 1] = randomExpected[i * 4 + 1];
+            swappedExpected[i * 4 + 2] = randomExpected[i * 4 + 0];
+            swappedExpected[i * 4 + 3] = s[3];
+        }
+        memset(randomDst, 0xcd, sizeof(randomDst));
+        SDPixelPremultiply(random, randomDst, count);
+        SDExpectBytes("SDPixelPremultiply", count, randomDst, randomExpected, count * 4);
+        memset(randomDst, 0xcd, sizeof(randomDst));
+        SDPixelPremultiplyRGBAToBGRA(random, randomDst, count);
+        SDExpectBytes("SDPixelPremultiplyRGBAToBGRA", count, randomDst, swappedExpected, count * 4);
+    }
+}
+
+static void SDTestUnpremultiply(void) {
+    // Premultiplying the result gives back the premultiplied color, for every premultiplied color and alpha
+    uint8_t src[256 * 4], dst[256 * 4], roundTrip[256 * 4];
+    for (uint32_t alpha = 1; alpha < 256; alpha++) {
+        for (uint32_t color = 0; color < 256; color++) {
+            uint8_t premultiplied = SDReferenceMultiply(color, alpha);
+            uint8_t *s = src + color * 4;
+            s[0] = s[1] = s[2] = premultiplied;
+            s[3] = (uint8_t)alpha;
+        }
+        SDPixelUnpremultiply(src, dst, 256);
+        SDPixelPremultiply(dst, roundTrip, 256);
+        for (size_t i = 0; i < sizeof(src); i++) {
+            if (roundTrip[i] != src[i]) {
+                SDPixelExpect(0, "SDPixelUnpremultiply(alpha %u): byte %zu does not round trip, %u instead of %u", alpha, i, roundTrip[i], src[i]);
+                break;
+            }
+        }
+    }
+}
+
+static void SDTestSwizzle(void) {
+    uint8_t rgb[67 * 3 + 16], rgba[67 * 4], dst[67 * 4 + 16], expected[67 * 4];
+    for (size_t n = 0; n < SD_PIXEL_COUNT_COUNT; n++) {
+        size_t count = SDPixelCounts[n];
+        SDFillRandom(rgb, sizeof(rgb));
+        SDFillRandom(rgba, sizeof(rgba));
+
+        for (size_t i = 0; i < count; i++) {
+            expected[i * 4 + 0] = rgb[i * 3 + 2];
+            expected[i * 4 + 1] = rgb[i * 3 + 1];
+            expected[i * 4 + 2] = rgb[i * 3 + 0];
+            expected[i * 4 + 3] = 0xff;
+        }
+        memset(dst, 0xcd, sizeof(dst));
+        SDPixelConvertRGBToBGRX(rgb, dst, count);
+        SDExpectBytes("SDPixelConvertRGBToBGRX", count, dst, expected, count * 4);
+
+        for (size_t i = 0; i < count; i++) {
+            expected[i * 4 + 0] = rgba[i * 4 + 2];
+            expected[i * 4 + 1] = rgba[i * 4 + 1];
+            expected[i * 4 + 2] = rgba[i * 4 + 0];
+            expected[i * 4 + 3] = rgba[i * 4 + 3];
+        }
+        memset(dst, 0xcd, sizeof(dst));
+        SDPixelSwapRedBlue(rgba, dst, count);
+        SDExpectBytes("SDPixelSwapRedBlue", count, dst, expected, count * 4);
+        // In place
+        memcpy(dst, rgba, count * 4);
+        SDPixelSwapRedBlue(dst, dst, count);
+        SDExpectBytes("SDPixelSwapRedBlue in place", count, dst, expected, count * 4);
+    }
+}
+
+// Where the source pixel (x, y) lands in the upright image, from the EXIF definitions
+static void SDReferenceOrient(int orientation, size_t width, size_t height, size_t x, size_t y, size_t *dx, size_t *dy) {
+    switch (orientation) {
+        case 2: *dx = width - 1 - x; *dy = y; break;                 // Mirrored horizontally
+        case 3: *dx = width - 1 - x; *dy = height - 1 - y; break;    // Rotated 180°
+        case 4: *dx = x; *dy = height - 1 - y; break;                // Mirrored vertically
+        case 5: *dx = y; *dy = x; break;                             // Transposed
+        case 6: *dx = height - 1 - y; *dy = x; break;                // Rotated 90° clockwise
+        case 7: *dx = height - 1 - y; *dy = width - 1 - x; break;    // Transversed
+        case 8: *dx = y; *dy = width - 1 - x; break;                 // Rotated 90° counterclockwise
+        default: *dx = x; *dy = y; break;
+    }
+}
+
+static void SDTestOrient(void) {
+    // Sizes with and without whole 4x4 blocks, rows padded on both sides
+    static const size_t sizes[][2] = {{1, 1}, {4, 4}, {8, 4}, {5, 7}, {7, 5}, {13, 9}, {16, 12}, {3, 17}};
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size_t width = sizes[s][0], height = sizes[s][1];
+        size_t srcBytesPerRow = width * 4 + 12;
+        uint8_t *src = malloc(srcBytesPerRow * height);
+        for (size_t y = 0; y < height; y++) {
+            for (size_t x = 0; x < width; x++) {
+                uint8_t *p = src + y * srcBytesPerRow + x * 4;
+                p[0] = (uint8_t)x;
+                p[1] = (uint8_t)y;
+                p[2] = (uint8_t)(x * 7 + y * 13);
+                p[3] = (uint8_t)(s + 1);
+            }
+        }
+        for (int orientation = 1; orientation <= 8; orientation++) {
+            int transposed = orientation >= 5;
+            size_t dstWidth = transposed ? height : width;
+            size_t dstHeight = transposed ? width : height;
+            size_t dstBytesPerRow = dstWidth * 4 + 20;
+            uint8_t *dst = malloc(dstBytesPerRow * dstHeight);
+            uint8_t *expected = malloc(dstBytesPerRow * dstHeight);
+            memset(dst, 0xcd, dstBytesPerRow * dstHeight);
+            memset(expected, 0xcd, dstBytesPerRow * dstHeight);
+            for (size_t y = 0; y < height; y++) {
+                for (size_t x = 0; x < width; x++) {
+                    size_t dx, dy;
+                    SDReferenceOrient(orientation, width, height, x, y, &dx, &dy);
+                    memcpy(expected + dy * dstBytesPerRow + dx * 4, src + y * srcBytesPerRow + x * 4, 4);
+                }
+            }
+            SDPixelOrient32(src, srcBytesPerRow, width, height, dst, dstBytesPerRow, orientation);
+            // The padding of the rows must be left untouched as well
+            SDPixelExpect(memcmp(dst, expected, dstBytesPerRow * dstHeight) == 0, "SDPixelOrient32(%zux%zu, orientation %d) differs from the reference", width, height, orientation);
+            free(dst);
+            free(expected);
+        }
+        free(src);
+    }
+}
+
+int SDPixelKernelsRunTests(void) {
+    SDPixelKernelsFailures = 0;
+    srand(42);
+    SDTestPremultiply();
+    SDTestUnpremultiply();
+    SDTestSwizzle();
+    SDTestOrient();
+    return SDPixelKernelsFailures;
+}
+
+#ifdef SD_TESTS_MAIN
+int main(void) {
+    int failures = SDPixelKernelsRunTests();
+    printf("%d failure(s)\n", failures);
+    return failures == 0 ? 0 : 1;
+}
+#endif
@@ -0,0 +1,27 @@
+/*
+ * This file is part of the SDWebImage package.
+ * (c) Olivier Poitrey <rs@dailymotion.com>
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef SDWebImagePixelKernelsTests_h
+#define SDWebImagePixelKernelsTests_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Runs the byte exact tests of `SDWebImagePixelKernels`, printing each failure to stderr.
+ *
+ * @return The number of failed checks
+ */
+extern int SDPixelKernelsRunTests(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SDWebImagePixelKernelsTests_h */